@@ -0,0 +1,26 @@
+#include <stdbool.h>
+#include <string.h>
+
+#include "asic_packet.h"
+#include "crc.h"
+
+uint8_t asic_packet_build(uint8_t *buf, uint8_t header, const uint8_t *data, uint8_t data_len)
+{
+    bool job = header & ASIC_PACKET_TYPE_JOB;
+
+    buf[0] = 0x55;
+    buf[1] = 0xAA;
+    buf[2] = header;
+    // the length counts header, length and crc, not the preamble
+    buf[3] = job ? data_len + 4 : data_len + 3;
+    memcpy(buf + 4, data, data_len);
+
+    if (job) {
+        uint16_t crc = crc16_false(buf + 2, data_len + 2);
+        buf[4 + data_len] = crc >> 8;
+        buf[5 + data_len] = crc & 0xFF;
+        return data_len + 6;
+    }
+    buf[4 + data_len] = crc5(buf + 2, data_len + 2);
+    return data_len + 5;
+}
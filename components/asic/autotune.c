@@ -0,0 +1,237 @@
+#include "autotune.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void start_window(autotune_chip * chip, uint32_t now_ms)
+{
+    chip->valid = 0;
+    chip->errors = 0;
+    chip->window_start_ms = now_ms;
+}
+
+bool autotune_init(autotune * tuner, const autotune_config * config, uint16_t chip_count, float start_mhz, uint32_t now_ms)
+{
+    // the result task may be recording into the chips while this runs, so they never go away
+    tuner->chip_count = 0;
+    tuner->config = *config;
+    tuner->settled = false;
+
+    if (chip_count == 0 || chip_count > AUTOTUNE_MAX_CHIPS) {
+        return false;
+    }
+
+    for (int i = 0; i < chip_count; i++) {
+        autotune_chip * chip = &tuner->chips[i];
+        memset(chip, 0, sizeof(*chip));
+        chip->state = AUTOTUNE_CLIMBING;
+        chip->frequency = start_mhz;
+        chip->previous_frequency = start_mhz;
+        start_window(chip, now_ms);
+    }
+    tuner->chip_count = chip_count;
+    return true;
+}
+
+void autotune_restore(autotune * tuner, const float * frequencies, uint32_t now_ms)
+{
+    for (int i = 0; i < tuner->chip_count; i++) {
+        autotune_chip * chip = &tuner->chips[i];
+        float frequency = frequencies[i];
+        if (frequency < tuner->config.min_mhz) {
+            frequency = tuner->config.min_mhz;
+        } else if (frequency > tuner->config.max_mhz) {
+            frequency = tuner->config.max_mhz;
+        }
+        chip->state = AUTOTUNE_STABLE;
+        chip->previous_frequency = chip->frequency;
+        chip->frequency = frequency;
+        chip->stable_frequency = frequency;
+        start_window(chip, now_ms);
+    }
+}
+
+void autotune_stop(autotune * tuner)
+{
+    tuner->chip_count = 0;
+}
+
+float autotune_max_frequency(const autotune * tuner, float fallback)
+{
+    if (tuner->chip_count == 0) {
+        return fallback;
+    }
+    float max = 0;
+    for (int i = 0; i < tuner->chip_count; i++) {
+        if (tuner->chips[i].frequency > max) {
+            max = tuner->chips[i].frequency;
+        }
+    }
+    return max;
+}
+
+void autotune_record(autotune * tuner, uint8_t chip_index, bool valid)
+{
+    if (chip_index >= tuner->chip_count) {
+        return;
+    }
+    if (valid) {
+        tuner->chips[chip_index].valid++;
+    } else {
+        tuner->chips[chip_index].errors++;
+    }
+}
+
+static bool window_healthy(autotune_chip * chip, const autotune_config * config, uint32_t now_ms)
+{
+    uint32_t results = chip->valid + chip->errors;
+    if (results == 0) {
+        // a chip that stopped answering altogether
+        chip->last_error_rate = 0;
+        return false;
+    }
+
+    chip->last_error_rate = (float) chip->errors / results;
+    if (chip->last_error_rate > config->max_error_rate) {
+        return false;
+    }
+
+    double elapsed_s = (now_ms - chip->window_start_ms) / 1000.0;
+    double rate = elapsed_s > 0 ? chip->valid / elapsed_s / chip->frequency : 0;
+    if (chip->healthy_windows > 0 && rate < chip->rate_per_mhz * (1.0 - AUTOTUNE_RATE_DROP)) {
+        return false;
+    }
+
+    chip->healthy_windows++;
+    chip->rate_per_mhz += (rate - chip->rate_per_mhz) / chip->healthy_windows;
+    return true;
+}
+
+static void move_to(autotune_chip * chip, float frequency)
+{
+    if (frequency != chip->frequency) {
+        chip->previous_frequency = chip->frequency;
+        chip->frequency = frequency;
+        chip->changed = true;
+    }
+}
+
+static void step_down(autotune * tuner, autotune_chip * chip)
+{
+    float frequency = chip->frequency - tuner->config.step_mhz;
+    move_to(chip, frequency < tuner->config.min_mhz ? tuner->config.min_mhz : frequency);
+    chip->state = AUTOTUNE_CONFIRMING;
+}
+
+int autotune_step(autotune * tuner, uint32_t now_ms, bool allow_up)
+{
+    int changed = 0;
+
+    for (int i = 0; i < tuner->chip_count; i++) {
+        autotune_chip * chip = &tuner->chips[i];
+        if (chip->valid + chip->errors < tuner->config.window_results &&
+            now_ms - chip->window_start_ms < tuner->config.window_timeout_ms) {
+            continue;
+        }
+
+        bool healthy = window_healthy(chip, &tuner->config, now_ms);
+        if (!healthy) {
+            chip->failed_windows++;
+        }
+
+        switch (chip->state) {
+        case AUTOTUNE_CLIMBING:
+            if (healthy) {
+                chip->stable_frequency = chip->frequency;
+                if (chip->frequency + tuner->config.step_mhz > tuner->config.max_mhz) {
+                    chip->state = AUTOTUNE_STABLE;
+                    tuner->settled = true;
+                } else if (allow_up) {
+                    move_to(chip, chip->frequency + tuner->config.step_mhz);
+                }
+            } else if (chip->stable_frequency > 0) {
+                // back to the last frequency that passed, which has to pass again
+                move_to(chip, chip->stable_frequency);
+                chip->state = AUTOTUNE_CONFIRMING;
+            } else {
+                step_down(tuner, chip);
+            }
+            break;
+        case AUTOTUNE_CONFIRMING:
+            if (healthy) {
+                chip->stable_frequency = chip->frequency;
+                chip->state = AUTOTUNE_STABLE;
+                tuner->settled = true;
+            } else {
+                step_down(tuner, chip);
+            }
+            break;
+        case AUTOTUNE_STABLE:
+            if (!healthy) {
+                // drifted, e.g. warmer than when it was tuned
+                step_down(tuner, chip);
+                tuner->settled = true;
+            }
+            break;
+        }
+
+        if (chip->changed) {
+            changed++;
+        }
+        start_window(chip, now_ms);
+    }
+
+    return changed;
+}
+
+size_t autotune_format_profile(const autotune * tuner, char * out, size_t size)
+{
+    size_t len = 0;
+    if (size > 0) {
+        out[0] = '\0';
+    }
+    for (int i = 0; i < tuner->chip_count && len < size; i++) {
+        int written = snprintf(out + len, size - len, "%s%.2f", i ? "," : "", tuner->chips[i].frequency);
+        if (written < 0 || (size_t) written >= size - len) {
+            break;
+        }
+        len += written;
+    }
+    return len;
+}
+
+int autotune_parse_profile(const char * profile, float * frequencies, int max)
+{
+    int count = 0;
+    const char * p = profile;
+
+    while (count < max && *p != '\0') {
+        char * end;
+        float frequency = strtof(p, &end);
+        if (end == p || frequency <= 0) {
+            return 0;
+        }
+        frequencies[count++] = frequency;
+        if (*end == ',') {
+            end++;
+        } else if (*end != '\0') {
+            return 0;
+        }
+        p = end;
+    }
+    return count;
+}
+
+const char * autotune_state_str(autotune_state state)
+{
+    switch (state) {
+    case AUTOTUNE_CLIMBING:
+        return "climbing";
+    case AUTOTUNE_CONFIRMING:
+        return "confirming";
+    case AUTOTUNE_STABLE:
+        return "stable";
+    }
+    return "unknown";
+}
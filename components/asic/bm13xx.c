@@ -0,0 +1,636 @@
+#include "bm13xx.h"
+
+#include "asic_packet.h"
+#include "global_state.h"
+#include "serial.h"
+#include "utils.h"
+#include "version_rolling.h"
+
+#include "driver/gpio.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#define GPIO_ASIC_RESET CONFIG_GPIO_ASIC_RESET
+
+// every chip comes out of reset at this frequency
+#define RESET_FREQUENCY 56.25
+#define FREQUENCY_STEP 6.25
+// The ramp doubles its step up to this and halves its dwell down to FREQUENCY_STEP_MIN_DELAY_MS
+// while no hardware errors come back, and drops to one step and the full delay when they do
+#define FREQUENCY_STEP_MAX 12.5
+#define FREQUENCY_STEP_DELAY_MS 100
+#define FREQUENCY_STEP_MIN_DELAY_MS 25
+
+#define BM13XX_TIMEOUT_MS 10000
+#define BM13XX_TIMEOUT_THRESHOLD 2
+
+static const char * TAG = "bm13xx";
+
+static const bm13xx_transport serial_transport = {
+    .send = SERIAL_send,
+    .receive = SERIAL_rx,
+};
+
+static const bm13xx_transport * transport = &serial_transport;
+
+static float current_frequency = RESET_FREQUENCY;
+static uint8_t job_id;
+static uint8_t timeouts;
+static task_result result;
+// spacing of the chip addresses, which also splits each job's nonces between the chips; 0 before init
+static uint16_t address_interval;
+// results below the ticket difficulty so far, watched while ramping; NULL for none
+static const volatile uint32_t * hardware_errors;
+// reads waiting for register replies; NULL for none
+static register_reads * pending_reads;
+
+// PLL0 values of every FREQUENCY_STEP up to BM13XX_PLL_TABLE_MAX_MHZ for pll_table_chip,
+// so a ramp looks its steps up instead of searching the dividers again. value[0] is 0 where
+// no divider set hits the frequency.
+static const bm13xx_chip * pll_table_chip;
+static uint8_t pll_table[BM13XX_PLL_TABLE_STEPS][4];
+
+void bm13xx_set_transport(const bm13xx_transport * new_transport)
+{
+    transport = new_transport != NULL ? new_transport : &serial_transport;
+}
+
+void bm13xx_set_error_counter(const volatile uint32_t * errors)
+{
+    hardware_errors = errors;
+}
+
+void bm13xx_set_register_reads(register_reads * reads)
+{
+    pending_reads = reads;
+}
+
+void bm13xx_send(const bm13xx_chip * chip, uint8_t header, uint8_t * data, uint8_t data_len, bool debug)
+{
+    // on the stack rather than one static buffer: the ASIC, job and power tasks all send
+    uint8_t frame[ASIC_PACKET_MAX_LEN];
+    uint8_t len = asic_packet_build(frame, header, data, data_len);
+
+    if (transport->send(frame, len, debug) == 0) {
+        ESP_LOGE(TAG, "Failed to send data to %s", chip->name);
+    }
+}
+
+void bm13xx_write_register(const bm13xx_chip * chip, uint8_t header, uint8_t address, uint8_t reg, const uint8_t value[4])
+{
+    uint8_t data[6] = {address, reg, value[0], value[1], value[2], value[3]};
+    bm13xx_send(chip, header, data, sizeof(data), chip->tx_debug);
+}
+
+static void write_all(const bm13xx_chip * chip, uint8_t reg, const uint8_t value[4])
+{
+    bm13xx_write_register(chip, BM13XX_TYPE_CMD | BM13XX_GROUP_ALL | BM13XX_CMD_WRITE, 0x00, reg, value);
+}
+
+static void send_command(const bm13xx_chip * chip, uint8_t header, uint8_t address)
+{
+    uint8_t data[2] = {address, 0x00};
+    bm13xx_send(chip, header, data, sizeof(data), chip->tx_debug);
+}
+
+void bm13xx_read_register(const bm13xx_chip * chip, int address, uint8_t reg)
+{
+    uint8_t header = BM13XX_TYPE_CMD | BM13XX_CMD_READ | (address == REGISTER_READ_ALL ? BM13XX_GROUP_ALL : BM13XX_GROUP_SINGLE);
+    uint8_t data[2] = {address == REGISTER_READ_ALL ? 0x00 : address, reg};
+    bm13xx_send(chip, header, data, sizeof(data), chip->tx_debug);
+}
+
+void bm13xx_dispatch_register(const bm13xx_chip * chip, const uint8_t * frame)
+{
+    // AA 55, the register value as stored, the answering chip's address, the register
+    uint32_t value = ((uint32_t) frame[2] << 24) | (frame[3] << 16) | (frame[4] << 8) | frame[5];
+    uint8_t address = frame[6];
+    uint8_t reg = frame[7];
+
+    if (pending_reads == NULL) {
+        ESP_LOGD(TAG, "Register %02X of chip %02X while mining: %08" PRIX32, reg, address, value);
+        return;
+    }
+    register_reads_match(pending_reads, address, address_interval ? address / address_interval : 0, reg, value);
+}
+
+void bm13xx_set_version_mask(const bm13xx_chip * chip, uint32_t version_mask)
+{
+    if (!chip->version_rolling) {
+        // rolls through the midstates of each job instead, whose count construct_bm_job
+        // derives from the mask
+        return;
+    }
+
+    int versions_to_roll = version_mask >> 13;
+    uint8_t value[4] = {0x90, 0x00, versions_to_roll >> 8, versions_to_roll & 0xFF};
+    write_all(chip, BM13XX_REG_VERSION_MASK, value);
+}
+
+uint32_t bm13xx_job_versions(const bm13xx_chip * chip, uint32_t version_mask)
+{
+    if (!chip->version_rolling) {
+        return version_rolling_midstate_count(version_mask);
+    }
+    // the register holds the 16 bits from bit 13 up
+    return 1u << __builtin_popcount((version_mask >> 13) & 0xFFFF);
+}
+
+void bm13xx_set_difficulty_mask(const bm13xx_chip * chip, int difficulty)
+{
+    // The mask must be a power of 2 so there are no holes
+    // Correct:  {0b00000000, 0b00000000, 0b11111111, 0b11111111}
+    // Incorrect: {0b00000000, 0b00000000, 0b11100111, 0b11111111}
+    // (difficulty - 1) if it is a pow 2 then step down to second largest for more hashrate sampling
+    difficulty = _largest_power_of_two(difficulty) - 1;
+
+    // The bytes are read in backwards to the register so each one is bit reversed
+    // Ex: 512 = {0x00, 0x00, 0x01, 0xff} is sent as {0x00, 0x00, 0x80, 0xff}
+    uint8_t value[4];
+    for (int i = 0; i < 4; i++) {
+        value[3 - i] = _reverse_bits((difficulty >> (8 * i)) & 0xFF);
+    }
+
+    ESP_LOGI(TAG, "Setting job ASIC mask to %d", difficulty);
+    write_all(chip, BM13XX_REG_TICKET_MASK, value);
+}
+
+// Baud formula = 25M/((denominator+1)*8), the denominator in misc_control bits 9-13,
+// or the chip's fast UART configuration
+int bm13xx_set_baud(const bm13xx_chip * chip, const bm13xx_baud * baud)
+{
+    ESP_LOGI(TAG, "Setting baud of %d", baud->baud);
+    write_all(chip, baud->reg, baud->value);
+    return baud->baud;
+}
+
+typedef struct
+{
+    uint16_t fb_divider;
+    uint8_t ref_divider;
+    uint8_t post_divider1;
+    uint8_t post_divider2;
+    float frequency;
+} pll_setting;
+
+static bool pll_first_fit(const bm13xx_pll * pll, float target, pll_setting * setting)
+{
+    for (uint8_t refdiv = 2; refdiv > 0; refdiv--) {
+        for (uint8_t postdiv1 = 7; postdiv1 > 0; postdiv1--) {
+            for (uint8_t postdiv2 = 1; postdiv2 < postdiv1; postdiv2++) {
+                int fb_divider = round(((float) (postdiv1 * postdiv2 * target * refdiv) / 25.0));
+                if (fb_divider < pll->fb_min || fb_divider > pll->fb_max) {
+                    continue;
+                }
+                float frequency = 25.0 * (float) fb_divider / (float) (refdiv * postdiv2 * postdiv1);
+                if (fabs(target - frequency) < pll->max_error_mhz) {
+                    *setting = (pll_setting){fb_divider, refdiv, postdiv1, postdiv2, frequency};
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+static bool pll_fewest_postdiv(const bm13xx_pll * pll, float target, pll_setting * setting)
+{
+    uint8_t postdiv_min = 255;
+    uint8_t postdiv2_min = 255;
+    bool found = false;
+
+    for (uint8_t refdiv = 2; refdiv > 0; refdiv--) {
+        for (uint8_t postdiv1 = 7; postdiv1 > 0; postdiv1--) {
+            for (uint8_t postdiv2 = 7; postdiv2 > 0; postdiv2--) {
+                uint16_t fb_divider = round(target / 25.0 * (refdiv * postdiv2 * postdiv1));
+                float frequency = 25.0 * fb_divider / (refdiv * postdiv2 * postdiv1);
+
+                if (fb_divider >= pll->fb_min && fb_divider <= pll->fb_max && fabs(target - frequency) < pll->max_error_mhz &&
+                    postdiv1 >= postdiv2 && postdiv1 * postdiv2 < postdiv_min && postdiv2 <= postdiv2_min) {
+                    postdiv2_min = postdiv2;
+                    postdiv_min = postdiv1 * postdiv2;
+                    *setting = (pll_setting){fb_divider, refdiv, postdiv1, postdiv2, frequency};
+                    found = true;
+                }
+            }
+        }
+    }
+    return found;
+}
+
+bool bm13xx_pll_find(const bm13xx_chip * chip, float frequency, uint8_t value[4])
+{
+    pll_setting setting;
+    bool found = chip->pll.search == BM13XX_PLL_FIRST_FIT ? pll_first_fit(&chip->pll, frequency, &setting)
+                                                            : pll_fewest_postdiv(&chip->pll, frequency, &setting);
+    if (!found) {
+        return false;
+    }
+
+    value[0] = (setting.fb_divider * 25 / setting.ref_divider >= 2400) ? 0x50 : 0x40;
+    value[1] = setting.fb_divider;
+    value[2] = setting.ref_divider;
+    value[3] = (((setting.post_divider1 - 1) & 0xf) << 4) | ((setting.post_divider2 - 1) & 0xf);
+    return true;
+}
+
+static void build_pll_table(const bm13xx_chip * chip)
+{
+    if (pll_table_chip == chip) {
+        return;
+    }
+    for (int step = 0; step < BM13XX_PLL_TABLE_STEPS; step++) {
+        if (!bm13xx_pll_find(chip, step * FREQUENCY_STEP, pll_table[step])) {
+            pll_table[step][0] = 0;
+        }
+    }
+    pll_table_chip = chip;
+}
+
+bool bm13xx_pll_lookup(const bm13xx_chip * chip, float frequency, uint8_t value[4])
+{
+    float steps = frequency / FREQUENCY_STEP;
+    int step = (int) steps;
+    if (pll_table_chip != chip || step != steps || step >= BM13XX_PLL_TABLE_STEPS) {
+        // off the step grid, e.g. a frequency set by hand
+        return bm13xx_pll_find(chip, frequency, value);
+    }
+    if (pll_table[step][0] == 0) {
+        return false;
+    }
+    memcpy(value, pll_table[step], 4);
+    return true;
+}
+
+// Programs PLL0 of one chip, or of every chip for address < 0
+static bool send_pll(const bm13xx_chip * chip, int address, float frequency)
+{
+    uint8_t value[4];
+    if (!bm13xx_pll_lookup(chip, frequency, value)) {
+        ESP_LOGE(TAG, "Didn't find PLL settings for target frequency %.2f", frequency);
+        return false;
+    }
+
+    if (address < 0) {
+        write_all(chip, BM13XX_REG_PLL0_PARAMETER, value);
+        ESP_LOGD(TAG, "Setting Frequency to %.2fMHz", frequency);
+    } else {
+        bm13xx_write_register(chip, BM13XX_TYPE_CMD | BM13XX_GROUP_SINGLE | BM13XX_CMD_WRITE, address,
+                              BM13XX_REG_PLL0_PARAMETER, value);
+        ESP_LOGD(TAG, "Setting Frequency of chip %02X to %.2fMHz", address, frequency);
+    }
+    return true;
+}
+
+bool bm13xx_send_frequency(const bm13xx_chip * chip, float frequency)
+{
+    if (chip->program_frequency != NULL) {
+        if (!chip->program_frequency(frequency)) {
+            return false;
+        }
+        current_frequency = frequency;
+        return true;
+    }
+
+    if (!send_pll(chip, -1, frequency)) {
+        return false;
+    }
+    current_frequency = frequency;
+    return true;
+}
+
+// Walks the PLL of one chip, or of all of them for address < 0, from current to target
+static bool ramp(const bm13xx_chip * chip, int address, float current, float target)
+{
+    // the PLL is only ever moved in small steps, growing while the chips keep up
+    bool up = target > current;
+    float step = FREQUENCY_STEP;
+    int delay_ms = FREQUENCY_STEP_MIN_DELAY_MS;
+    int steps = 0, waited_ms = 0;
+    bool ok = true;
+
+    if (chip->pll.ramp == BM13XX_RAMP_RESTART) {
+        ok &= send_pll(chip, address, current);
+    } else if (fmod(current, FREQUENCY_STEP) != 0) {
+        current = up ? ceil(current / FREQUENCY_STEP) * FREQUENCY_STEP : floor(current / FREQUENCY_STEP) * FREQUENCY_STEP;
+        ok &= send_pll(chip, address, current);
+        vTaskDelay(pdMS_TO_TICKS(delay_ms));
+        waited_ms += delay_ms;
+    }
+
+    uint32_t errors = hardware_errors != NULL ? *hardware_errors : 0;
+    while ((up && current < target) || (!up && current > target)) {
+        float next_step = fmin(step, fabs(target - current));
+        current += up ? next_step : -next_step;
+        ok &= send_pll(chip, address, current);
+        vTaskDelay(pdMS_TO_TICKS(delay_ms));
+        waited_ms += delay_ms;
+        steps++;
+
+        uint32_t now = hardware_errors != NULL ? *hardware_errors : 0;
+        if (now != errors) {
+            // bad nonces while the PLL moves: back to the slow, fine ramp
+            step = FREQUENCY_STEP;
+            delay_ms = FREQUENCY_STEP_DELAY_MS;
+            errors = now;
+        } else {
+            step = fmin(step * 2, FREQUENCY_STEP_MAX);
+            delay_ms = delay_ms / 2 > FREQUENCY_STEP_MIN_DELAY_MS ? delay_ms / 2 : FREQUENCY_STEP_MIN_DELAY_MS;
+        }
+    }
+
+    if (chip->pll.ramp == BM13XX_RAMP_ALIGN) {
+        ok &= send_pll(chip, address, target);
+    }
+    ESP_LOGI(TAG, "Reached %.2f MHz in %d steps, %d ms", target, steps, waited_ms);
+    return ok;
+}
+
+bool bm13xx_set_frequency(const bm13xx_chip * chip, float target)
+{
+    if (chip->program_frequency != NULL) {
+        return bm13xx_send_frequency(chip, target);
+    }
+    if (target == 0) {
+        ESP_LOGI(TAG, "Skipping frequency ramp");
+        return true;
+    }
+
+    ESP_LOGI(TAG, "Ramping frequency from %.2f MHz to %.2f MHz", current_frequency, target);
+    bool ok = ramp(chip, -1, current_frequency, target);
+    current_frequency = target;
+    return ok;
+}
+
+bool bm13xx_set_chip_frequency(const bm13xx_chip * chip, uint8_t chip_index, float current, float target)
+{
+    if (chip->program_frequency != NULL || address_interval == 0) {
+        // programs every chip at once, or the chain is not addressed yet
+        return false;
+    }
+    return ramp(chip, chip_index * address_interval, current, target);
+}
+
+static int enumerate_chips(const bm13xx_chip * chip)
+{
+    send_command(chip, BM13XX_TYPE_CMD | BM13XX_GROUP_ALL | BM13XX_CMD_READ, 0x00);
+
+    // every chip answers with its id register, AA 55 13 68 ...
+    uint8_t response[ASIC_FRAME_MAX_LEN];
+    int chip_counter = 0;
+    while (transport->receive(response, chip->response_len, chip->enumerate_timeout_ms) > 0) {
+        if (response[0] == ASIC_FRAME_PREAMBLE_0 && response[1] == ASIC_FRAME_PREAMBLE_1 &&
+            ((response[2] << 8) | response[3]) == chip->chip_id) {
+            chip_counter++;
+        }
+    }
+    return chip_counter;
+}
+
+static void reset_chain(void)
+{
+    esp_rom_gpio_pad_select_gpio(GPIO_ASIC_RESET);
+    gpio_set_direction(GPIO_ASIC_RESET, GPIO_MODE_OUTPUT);
+
+    gpio_set_level(GPIO_ASIC_RESET, 0);
+    vTaskDelay(100 / portTICK_PERIOD_MS);
+    gpio_set_level(GPIO_ASIC_RESET, 1);
+    vTaskDelay(100 / portTICK_PERIOD_MS);
+}
+
+uint8_t bm13xx_init(const bm13xx_chip * chip, float frequency, uint16_t asic_count)
+{
+    ESP_LOGI(TAG, "Initializing %s", chip->name);
+
+    reset_chain();
+    current_frequency = RESET_FREQUENCY;
+    job_id = 0;
+    timeouts = 0;
+    if (chip->program_frequency == NULL) {
+        build_pll_table(chip);
+    }
+
+    int chip_counter = 0;
+    address_interval = 0;
+
+    for (const bm13xx_step * step = chip->init; step->op != BM13XX_STEP_END; step++) {
+        switch (step->op) {
+        case BM13XX_STEP_WRITE_ALL:
+            write_all(chip, step->reg, step->value);
+            break;
+        case BM13XX_STEP_WRITE_FIRST:
+            bm13xx_write_register(chip, BM13XX_TYPE_CMD | BM13XX_GROUP_SINGLE | BM13XX_CMD_WRITE, 0x00, step->reg, step->value);
+            break;
+        case BM13XX_STEP_EACH_CHIP:
+            for (int i = 0; i < chip_counter; i++) {
+                for (int j = 1; j <= step->count; j++) {
+                    bm13xx_write_register(chip, BM13XX_TYPE_CMD | BM13XX_GROUP_SINGLE | BM13XX_CMD_WRITE, i * address_interval,
+                                          step[j].reg, step[j].value);
+                }
+                if (step->delay_ms) {
+                    vTaskDelay(pdMS_TO_TICKS(step->delay_ms));
+                }
+            }
+            step += step->count;
+            continue;
+        case BM13XX_STEP_VERSION_MASK:
+            for (int i = 0; i < step->count; i++) {
+                bm13xx_set_version_mask(chip, STRATUM_DEFAULT_VERSION_MASK);
+            }
+            break;
+        case BM13XX_STEP_ENUMERATE:
+            chip_counter = enumerate_chips(chip);
+            ESP_LOGI(TAG, "%i chip(s) detected on the chain, expected %i", chip_counter, asic_count);
+            if (chip_counter == 0 || (chip->strict_chip_count && chip_counter != asic_count)) {
+                ESP_LOGE(TAG, "Chip count mismatch. Expected: %d, Actual: %d", asic_count, chip_counter);
+                return 0;
+            }
+            // split the chip address space evenly
+            address_interval = 256 / chip_counter;
+            break;
+        case BM13XX_STEP_CHAIN_INACTIVE:
+            send_command(chip, BM13XX_TYPE_CMD | BM13XX_GROUP_ALL | BM13XX_CMD_INACTIVE, 0x00);
+            break;
+        case BM13XX_STEP_SET_ADDRESSES:
+            for (int i = 0; i < chip_counter; i++) {
+                send_command(chip, BM13XX_TYPE_CMD | BM13XX_GROUP_SINGLE | BM13XX_CMD_SETADDRESS, i * address_interval);
+            }
+            break;
+        case BM13XX_STEP_DIFFICULTY:
+            bm13xx_set_difficulty_mask(chip, chip->default_difficulty);
+            break;
+        case BM13XX_STEP_DEFAULT_BAUD:
+            bm13xx_set_baud(chip, &chip->default_baud);
+            break;
+        case BM13XX_STEP_FREQUENCY:
+            bm13xx_set_frequency(chip, frequency);
+            break;
+        case BM13XX_STEP_END:
+            break;
+        }
+
+        if (step->delay_ms) {
+            vTaskDelay(pdMS_TO_TICKS(step->delay_ms));
+        }
+    }
+
+    return chip_counter;
+}
+
+uint8_t bm13xx_next_job_id(const bm13xx_chip * chip)
+{
+    job_id = (job_id + chip->job_id_stride) % BM13XX_MAX_JOB_ID;
+    return job_id;
+}
+
+uint8_t bm13xx_build_job(const bm13xx_chip * chip, uint8_t id, const bm_job * job, uint8_t * out)
+{
+    if (chip->job_layout == BM13XX_JOB_MIDSTATES) {
+        bm13xx_midstate_job * midstate_job = (bm13xx_midstate_job *) out;
+        memset(midstate_job, 0, sizeof(*midstate_job));
+        midstate_job->job_id = id;
+        midstate_job->num_midstates = job->num_midstates;
+        memcpy(midstate_job->starting_nonce, &job->starting_nonce, 4);
+        memcpy(midstate_job->nbits, &job->target, 4);
+        memcpy(midstate_job->ntime, &job->ntime, 4);
+        memcpy(midstate_job->merkle4, job->merkle_root + 28, 4);
+        memcpy(midstate_job->midstates, job->midstates, job->num_midstates * sizeof(midstate_job->midstates[0]));
+        return sizeof(*midstate_job);
+    }
+
+    bm13xx_header_job * header_job = (bm13xx_header_job *) out;
+    header_job->job_id = id;
+    header_job->num_midstates = 0x01;
+    memcpy(header_job->starting_nonce, &job->starting_nonce, 4);
+    memcpy(header_job->nbits, &job->target, 4);
+    memcpy(header_job->ntime, &job->ntime, 4);
+    memcpy(header_job->merkle_root, job->merkle_root_be, 32);
+    memcpy(header_job->prev_block_hash, job->prev_block_hash_be, 32);
+    memcpy(header_job->version, &job->version, 4);
+    return sizeof(*header_job);
+}
+
+void bm13xx_send_job(const bm13xx_chip * chip, uint8_t id, const bm_job * job)
+{
+    uint8_t payload[sizeof(bm13xx_midstate_job)];
+    uint8_t len = bm13xx_build_job(chip, id, job, payload);
+
+    // debug sent jobs - this can get crazy if the interval is short
+    if (chip->jobs_debug) {
+        ESP_LOGI(TAG, "Send Job: %02X", id);
+    }
+
+    bm13xx_send(chip, BM13XX_TYPE_JOB | BM13XX_GROUP_SINGLE | BM13XX_CMD_WRITE, payload, len, chip->work_debug);
+}
+
+void bm13xx_send_work(const bm13xx_chip * chip, void * pvParameters, bm_job * next_bm_job)
+{
+    GlobalState * GLOBAL_STATE = (GlobalState *) pvParameters;
+
+    // a header dispatched before carries on past the nonces its last dispatch got to
+    const job_interval * interval = &GLOBAL_STATE->ASIC_TASK_MODULE.job_interval;
+    double coverage = interval->full_ms > 0 ? interval->interval_ms / interval->full_ms : 1.0;
+    next_bm_job->starting_nonce = nonce_schedule_next(&GLOBAL_STATE->ASIC_TASK_MODULE.nonce_schedule, next_bm_job, coverage);
+
+    uint8_t id = bm13xx_next_job_id(chip);
+    result_set_recycle(&GLOBAL_STATE->ASIC_TASK_MODULE.result_set, id);
+
+    // the slot holds the job until a later one takes it; results still in flight hold their own
+    next_bm_job->refs = 1;
+    pthread_mutex_lock(&GLOBAL_STATE->valid_jobs_lock);
+    bm_job * replaced = GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[id];
+    GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[id] = next_bm_job;
+    GLOBAL_STATE->valid_jobs[id] = 1;
+    pthread_mutex_unlock(&GLOBAL_STATE->valid_jobs_lock);
+
+    if (replaced != NULL) {
+        bm_job_release(replaced);
+    }
+
+    bm13xx_send_job(chip, id, next_bm_job);
+}
+
+void bm13xx_decode_result(const bm13xx_chip * chip, const uint8_t * frame, bm13xx_result * decoded)
+{
+    // AA 55, nonce, midstate number, job id, then the rolled version on chips that roll it
+    uint8_t raw_job_id = frame[7];
+
+    memcpy(&decoded->nonce, frame + 2, 4);
+    decoded->job_id = (raw_job_id & chip->job_id_mask) >> chip->job_id_shift;
+    decoded->small_core_id = raw_job_id & chip->small_core_mask;
+    decoded->core_id = (__builtin_bswap32(decoded->nonce) >> 25) & 0x7f;
+    // each chip hashes the nonces whose second byte falls in its own address range
+    decoded->chip_index = address_interval ? frame[3] / address_interval : 0;
+    decoded->version_bits = chip->version_rolling ? (uint32_t) ((frame[8] << 8) | frame[9]) << 13 : 0;
+}
+
+task_result * bm13xx_process_work(const bm13xx_chip * chip, void * pvParameters)
+{
+    uint8_t * frame;
+    asic_frame_type type = SERIAL_rx_frame(chip->response_len, &frame, BM13XX_TIMEOUT_MS);
+
+    if (type == ASIC_FRAME_UART_ERROR) {
+        ESP_LOGI(TAG, "UART Error in serial RX");
+        return NULL;
+    }
+    if (type == ASIC_FRAME_NONE) {
+        if (++timeouts >= BM13XX_TIMEOUT_THRESHOLD) {
+            ESP_LOGE(TAG, "ASIC not sending data");
+            timeouts = 0;
+        }
+        return NULL;
+    }
+    timeouts = 0;
+
+    // register reads answered while mining carry no nonce
+    if (type != ASIC_FRAME_JOB) {
+        bm13xx_dispatch_register(chip, frame);
+        return NULL;
+    }
+
+    bm13xx_result decoded;
+    bm13xx_decode_result(chip, frame, &decoded);
+
+    if (chip->on_result != NULL) {
+        chip->on_result(decoded.core_id, __builtin_bswap32(decoded.nonce));
+    }
+    if (chip->version_rolling) {
+        ESP_LOGI(TAG, "Job ID: %02X, Core: %d/%d, Ver: %08" PRIX32, decoded.job_id, decoded.core_id, decoded.small_core_id,
+                 decoded.version_bits);
+    }
+
+    GlobalState * GLOBAL_STATE = (GlobalState *) pvParameters;
+
+    // the ASIC task may hand the slot to a new job at any time, so the result keeps its own reference
+    pthread_mutex_lock(&GLOBAL_STATE->valid_jobs_lock);
+    bm_job * job = GLOBAL_STATE->valid_jobs[decoded.job_id] ? GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[decoded.job_id] : NULL;
+    if (job != NULL) {
+        bm_job_retain(job);
+    }
+    pthread_mutex_unlock(&GLOBAL_STATE->valid_jobs_lock);
+
+    if (job == NULL) {
+        ESP_LOGE(TAG, "Invalid job found, 0x%02X", decoded.job_id);
+        return NULL;
+    }
+
+    uint32_t rolled_version = chip->version_rolling ? job->version | decoded.version_bits
+                                                    : bm_job_midstate_version(job, decoded.small_core_id);
+
+    result.job = job;
+    result.job_id = decoded.job_id;
+    result.nonce = decoded.nonce;
+    result.rolled_version = rolled_version;
+    result.core_id = decoded.core_id;
+    result.chip_index = decoded.chip_index;
+    // a midstate index says nothing about where on the chip the nonce was found
+    result.small_core_id = chip->job_layout == BM13XX_JOB_MIDSTATES ? 0 : decoded.small_core_id;
+
+    return &result;
+}
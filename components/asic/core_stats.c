@@ -0,0 +1,141 @@
+#include "core_stats.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+bool core_stats_init(core_stats * stats, uint16_t cores, uint16_t small_cores, uint32_t now_s)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->started_s = now_s;
+
+    size_t slots = (size_t) cores * small_cores;
+    if (slots == 0 || slots > UINT16_MAX) {
+        return false;
+    }
+
+    // widest arrays first so each one stays aligned
+    size_t size = slots * (sizeof(*stats->valid) + sizeof(*stats->best_diff) + sizeof(*stats->last_seen_s) +
+                           sizeof(*stats->updated) + sizeof(*stats->invalid) + sizeof(*stats->flags));
+    uint8_t * block = calloc(1, size);
+    if (block == NULL) {
+        return false;
+    }
+
+    stats->valid = (uint32_t *) block;
+    stats->best_diff = (float *) (stats->valid + slots);
+    stats->last_seen_s = (uint32_t *) (stats->best_diff + slots);
+    stats->updated = stats->last_seen_s + slots;
+    stats->invalid = (uint16_t *) (stats->updated + slots);
+    stats->flags = (uint8_t *) (stats->invalid + slots);
+
+    stats->cores = cores;
+    stats->small_cores = small_cores;
+    stats->slots = slots;
+    return true;
+}
+
+void core_stats_record(core_stats * stats, uint8_t core_id, uint8_t small_core_id, double difficulty, uint32_t now_s)
+{
+    if (difficulty <= 0.0) {
+        stats->errors++;
+    }
+    if (core_id >= stats->cores || small_core_id >= stats->small_cores) {
+        stats->unknown++;
+        return;
+    }
+
+    uint16_t slot = core_id * stats->small_cores + small_core_id;
+    if (difficulty > 0.0) {
+        stats->valid[slot]++;
+        if (difficulty > stats->best_diff[slot]) {
+            stats->best_diff[slot] = difficulty;
+        }
+    } else if (stats->invalid[slot] < UINT16_MAX) {
+        stats->invalid[slot]++;
+    }
+    stats->last_seen_s[slot] = now_s;
+    stats->updated[slot] = ++stats->sequence;
+    stats->results++;
+}
+
+int core_stats_check(core_stats * stats, uint32_t now_s)
+{
+    // the wait for a core's next result if results were spread evenly over the slots
+    bool judge_silence = stats->results >= (uint32_t) stats->slots * CORE_STATS_SILENT_MIN_RESULTS;
+    uint32_t silent_after = 0;
+    if (judge_silence) {
+        silent_after = (uint32_t) ((uint64_t) (now_s - stats->started_s) * stats->slots * CORE_STATS_SILENT_INTERVALS /
+                                   stats->results);
+    }
+
+    int newly_flagged = 0;
+    uint16_t flagged = 0;
+    for (uint16_t slot = 0; slot < stats->slots; slot++) {
+        uint8_t flags = 0;
+
+        uint32_t since = stats->last_seen_s[slot] ? stats->last_seen_s[slot] : stats->started_s;
+        if (judge_silence && now_s - since > silent_after) {
+            flags |= CORE_STATS_SILENT;
+        }
+
+        uint32_t invalid = stats->invalid[slot];
+        if (invalid >= CORE_STATS_ERROR_MIN && invalid > (invalid + stats->valid[slot]) * CORE_STATS_ERROR_RATIO) {
+            flags |= CORE_STATS_ERRORS;
+        }
+
+        if (flags != stats->flags[slot]) {
+            if (flags & ~stats->flags[slot]) {
+                newly_flagged++;
+            }
+            stats->flags[slot] = flags;
+            stats->updated[slot] = ++stats->sequence;
+        }
+        if (flags) {
+            flagged++;
+        }
+    }
+
+    stats->flagged = flagged;
+    return newly_flagged;
+}
+
+size_t core_stats_encode_size(const core_stats * stats)
+{
+    return sizeof(core_stats_header) + (size_t) stats->slots * sizeof(core_stats_entry);
+}
+
+size_t core_stats_encode(const core_stats * stats, uint32_t since, uint32_t now_s, uint8_t * out, size_t size)
+{
+    if (size < core_stats_encode_size(stats)) {
+        return 0;
+    }
+
+    core_stats_header header = {
+        .sequence = stats->sequence,
+        .cores = stats->cores,
+        .small_cores = stats->small_cores,
+        .uptime_s = now_s,
+        .count = 0,
+    };
+    size_t len = sizeof(header);
+
+    for (uint16_t slot = 0; slot < stats->slots; slot++) {
+        if (stats->updated[slot] <= since) {
+            continue;
+        }
+        core_stats_entry entry = {
+            .slot = slot,
+            .valid = stats->valid[slot],
+            .invalid = stats->invalid[slot],
+            .best_diff = stats->best_diff[slot],
+            .last_seen_s = stats->last_seen_s[slot],
+            .flags = stats->flags[slot],
+        };
+        memcpy(out + len, &entry, sizeof(entry));
+        len += sizeof(entry);
+        header.count++;
+    }
+
+    memcpy(out, &header, sizeof(header));
+    return len;
+}
@@ -2,60 +2,63 @@
 #include <stdint.h>
 #include <string.h>
 
-#include "bm1397.h"
+#include "crc.h"
+
+/* crc5 (poly 0x05, init 0x1F, msb first) of one byte clocked into a zero register
+ * indexed by (crc << 3) ^ byte, the register's 5 bits lining up with the byte's top bits */
+static const uint8_t crc5_table[256] = {
+	0x00, 0x05, 0x0A, 0x0F, 0x14, 0x11, 0x1E, 0x1B, 0x0D, 0x08, 0x07, 0x02, 0x19, 0x1C, 0x13, 0x16,
+	0x1A, 0x1F, 0x10, 0x15, 0x0E, 0x0B, 0x04, 0x01, 0x17, 0x12, 0x1D, 0x18, 0x03, 0x06, 0x09, 0x0C,
+	0x11, 0x14, 0x1B, 0x1E, 0x05, 0x00, 0x0F, 0x0A, 0x1C, 0x19, 0x16, 0x13, 0x08, 0x0D, 0x02, 0x07,
+	0x0B, 0x0E, 0x01, 0x04, 0x1F, 0x1A, 0x15, 0x10, 0x06, 0x03, 0x0C, 0x09, 0x12, 0x17, 0x18, 0x1D,
+	0x07, 0x02, 0x0D, 0x08, 0x13, 0x16, 0x19, 0x1C, 0x0A, 0x0F, 0x00, 0x05, 0x1E, 0x1B, 0x14, 0x11,
+	0x1D, 0x18, 0x17, 0x12, 0x09, 0x0C, 0x03, 0x06, 0x10, 0x15, 0x1A, 0x1F, 0x04, 0x01, 0x0E, 0x0B,
+	0x16, 0x13, 0x1C, 0x19, 0x02, 0x07, 0x08, 0x0D, 0x1B, 0x1E, 0x11, 0x14, 0x0F, 0x0A, 0x05, 0x00,
+	0x0C, 0x09, 0x06, 0x03, 0x18, 0x1D, 0x12, 0x17, 0x01, 0x04, 0x0B, 0x0E, 0x15, 0x10, 0x1F, 0x1A,
+	0x0E, 0x0B, 0x04, 0x01, 0x1A, 0x1F, 0x10, 0x15, 0x03, 0x06, 0x09, 0x0C, 0x17, 0x12, 0x1D, 0x18,
+	0x14, 0x11, 0x1E, 0x1B, 0x00, 0x05, 0x0A, 0x0F, 0x19, 0x1C, 0x13, 0x16, 0x0D, 0x08, 0x07, 0x02,
+	0x1F, 0x1A, 0x15, 0x10, 0x0B, 0x0E, 0x01, 0x04, 0x12, 0x17, 0x18, 0x1D, 0x06, 0x03, 0x0C, 0x09,
+	0x05, 0x00, 0x0F, 0x0A, 0x11, 0x14, 0x1B, 0x1E, 0x08, 0x0D, 0x02, 0x07, 0x1C, 0x19, 0x16, 0x13,
+	0x09, 0x0C, 0x03, 0x06, 0x1D, 0x18, 0x17, 0x12, 0x04, 0x01, 0x0E, 0x0B, 0x10, 0x15, 0x1A, 0x1F,
+	0x13, 0x16, 0x19, 0x1C, 0x07, 0x02, 0x0D, 0x08, 0x1E, 0x1B, 0x14, 0x11, 0x0A, 0x0F, 0x00, 0x05,
+	0x18, 0x1D, 0x12, 0x17, 0x0C, 0x09, 0x06, 0x03, 0x15, 0x10, 0x1F, 0x1A, 0x01, 0x04, 0x0B, 0x0E,
+	0x02, 0x07, 0x08, 0x0D, 0x16, 0x13, 0x1C, 0x19, 0x0F, 0x0A, 0x05, 0x00, 0x1B, 0x1E, 0x11, 0x14};
 
 /* compute crc5 over given number of bytes */
-// adapted from https://mightydevices.com/index.php/2018/02/reverse-engineering-antminer-s1/
-uint8_t crc5(uint8_t *data, uint8_t len)
+uint8_t crc5(const uint8_t *data, uint8_t len)
 {
-	uint8_t i, j, k, index = 0;
 	uint8_t crc = CRC5_MASK;
-	/* registers */
-	uint8_t crcin[5] = {1, 1, 1, 1, 1};
-	uint8_t crcout[5] = {1, 1, 1, 1, 1};
-	uint8_t din = 0;
 
-	len *= 8;
+	while (len-- > 0)
+		crc = crc5_table[(uint8_t)(crc << 3) ^ *data++];
+
+	return crc;
+}
 
-	/* push data bits */
-	for (j = 0x80, k = 0, i = 0; i < len; i++)
+/* compute crc5 over the first bit_count bits, most significant bit first */
+// responses are checked this way: their crc covers the type bits sharing its byte
+uint8_t crc5_bits(const uint8_t *data, uint16_t bit_count)
+{
+	uint8_t crc = CRC5_MASK;
+	uint16_t bytes = bit_count / 8;
+
+	for (uint16_t i = 0; i < bytes; i++)
+		crc = crc5_table[(uint8_t)(crc << 3) ^ data[i]];
+
+	for (uint16_t i = 0; i < bit_count % 8; i++)
 	{
-		/* input bit */
-		din = (data[index] & j) != 0;
-		/* shift register */
-		crcout[0] = crcin[4] ^ din;
-		crcout[1] = crcin[0];
-		crcout[2] = crcin[1] ^ crcin[4] ^ din;
-		crcout[3] = crcin[2];
-		crcout[4] = crcin[3];
-		/* next bit */
-		j >>= 1, k++;
-		/* next byte */
-		if (k == 8)
-			j = 0x80, k = 0, index++;
-		/* apply new shift register value */
-		memcpy(crcin, crcout, 5);
-		// crcin = crcout[0];
+		uint8_t din = (data[bytes] >> (7 - i)) & 1;
+		uint8_t feedback = ((crc >> 4) & 1) ^ din;
+		crc = (crc << 1) & CRC5_MASK;
+		if (feedback)
+			crc ^= 0x05;
 	}
 
-	crc = 0;
-	/* extract bitmask from register */
-	if (crcin[4])
-		crc |= 0x10;
-	if (crcin[3])
-		crc |= 0x08;
-	if (crcin[2])
-		crc |= 0x04;
-	if (crcin[1])
-		crc |= 0x02;
-	if (crcin[0])
-		crc |= 0x01;
-
 	return crc;
 }
 
 // kindly provided by cgminer
-unsigned int crc16_table[256] = {
+static const uint16_t crc16_table[256] = {
 	0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
 	0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
 	0x1231, 0x0210, 0x3273, 0x2252, 0x52B5, 0x4294, 0x72F7, 0x62D6,
@@ -90,7 +93,7 @@ unsigned int crc16_table[256] = {
 	0x6E17, 0x7E36, 0x4E55, 0x5E74, 0x2E93, 0x3EB2, 0x0ED1, 0x1EF0};
 
 /* CRC-16/CCITT */
-uint16_t crc16(uint8_t *buffer, uint16_t len)
+uint16_t crc16(const uint8_t *buffer, uint16_t len)
 {
 	uint16_t crc;
 
@@ -102,7 +105,7 @@ uint16_t crc16(uint8_t *buffer, uint16_t len)
 }
 
 /* CRC-16/CCITT-FALSE */
-uint16_t crc16_false(uint8_t *buffer, uint16_t len)
+uint16_t crc16_false(const uint8_t *buffer, uint16_t len)
 {
 	uint16_t crc;
 
@@ -0,0 +1,87 @@
+#include <string.h>
+
+#include "crc.h"
+#include "frame_parser.h"
+
+void frame_parser_init(frame_parser * parser, uint8_t frame_len)
+{
+    memset(parser, 0, sizeof(*parser));
+    parser->frame_len = frame_len;
+    parser->in_sync = true;
+}
+
+void frame_parser_reset(frame_parser * parser)
+{
+    parser->fill = 0;
+}
+
+bool frame_parser_check_crc(const uint8_t * frame, uint8_t frame_len)
+{
+    // The CRC covers every bit after the preamble up to the CRC itself, so the three type
+    // bits at the top of the last byte are included
+    uint16_t bits = (frame_len - 2) * 8 - 5;
+    return crc5_bits(frame + 2, bits) == (frame[frame_len - 1] & ASIC_FRAME_CRC_MASK);
+}
+
+static void drop(frame_parser * parser, uint8_t count)
+{
+    memmove(parser->buffer, parser->buffer + count, parser->fill - count);
+    parser->fill -= count;
+    parser->stats.dropped_bytes += count;
+    if (parser->in_sync) {
+        parser->in_sync = false;
+        parser->stats.resyncs++;
+    }
+}
+
+// Skips to the next possible preamble in the buffer, or empties it
+static void resync(frame_parser * parser)
+{
+    uint8_t start = 1;
+    while (start < parser->fill) {
+        if (parser->buffer[start] == ASIC_FRAME_PREAMBLE_0 &&
+            (start + 1 == parser->fill || parser->buffer[start + 1] == ASIC_FRAME_PREAMBLE_1)) {
+            break;
+        }
+        start++;
+    }
+    drop(parser, start);
+}
+
+asic_frame_type frame_parser_push(frame_parser * parser, uint8_t byte)
+{
+    parser->buffer[parser->fill++] = byte;
+
+    if (parser->fill == 1) {
+        if (byte != ASIC_FRAME_PREAMBLE_0) {
+            drop(parser, 1);
+        }
+        return ASIC_FRAME_NONE;
+    }
+    if (parser->fill == 2) {
+        if (byte != ASIC_FRAME_PREAMBLE_1) {
+            // AA AA may still be the start of a frame one byte late
+            resync(parser);
+        }
+        return ASIC_FRAME_NONE;
+    }
+    if (parser->fill < parser->frame_len) {
+        return ASIC_FRAME_NONE;
+    }
+
+    if (!frame_parser_check_crc(parser->buffer, parser->frame_len)) {
+        // A preamble inside the rejected bytes may be the real frame start
+        parser->stats.crc_errors++;
+        resync(parser);
+        return ASIC_FRAME_NONE;
+    }
+
+    parser->fill = 0;
+    parser->in_sync = true;
+    if (parser->buffer[parser->frame_len - 1] & ASIC_FRAME_JOB_RESPONSE) {
+        parser->stats.job_frames++;
+        return ASIC_FRAME_JOB;
+    }
+    parser->stats.register_frames++;
+    return ASIC_FRAME_REGISTER;
+}
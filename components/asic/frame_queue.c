@@ -0,0 +1,51 @@
+#include <string.h>
+
+#include "frame_queue.h"
+
+void frame_queue_init(frame_queue * queue)
+{
+    memset(queue, 0, sizeof(*queue));
+}
+
+bool frame_queue_push(frame_queue * queue, const queued_frame * frame)
+{
+    uint32_t head = queue->head;
+    uint32_t tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+    uint32_t depth = head - tail;
+
+    if (depth == FRAME_QUEUE_SIZE) {
+        queue->drops++;
+        return false;
+    }
+
+    queue->entries[head % FRAME_QUEUE_SIZE] = *frame;
+    // the entry must be visible before the consumer can see the new head
+    __atomic_store_n(&queue->head, head + 1, __ATOMIC_RELEASE);
+
+    if (depth + 1 > queue->max_depth) {
+        queue->max_depth = depth + 1;
+    }
+    return true;
+}
+
+bool frame_queue_pop(frame_queue * queue, queued_frame * frame)
+{
+    uint32_t tail = queue->tail;
+    uint32_t head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+
+    if (head == tail) {
+        return false;
+    }
+
+    *frame = queue->entries[tail % FRAME_QUEUE_SIZE];
+    // hand the slot back only once it has been copied out
+    __atomic_store_n(&queue->tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+size_t frame_queue_count(const frame_queue * queue)
+{
+    uint32_t tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+    uint32_t head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+    return head - tail;
+}
@@ -0,0 +1,17 @@
+#ifndef ASIC_PACKET_H_
+#define ASIC_PACKET_H_
+
+#include <stdint.h>
+
+// Header bit that selects a job frame, CRC16 terminated; command frames end in a CRC5
+#define ASIC_PACKET_TYPE_JOB 0x20
+
+// Largest payload any chip takes: a BM1397 job with four midstates
+#define ASIC_PACKET_MAX_DATA 146
+#define ASIC_PACKET_MAX_LEN (ASIC_PACKET_MAX_DATA + 6)
+
+// Frames data behind the 55 AA preamble, header and length, followed by its CRC, into buf,
+// which holds ASIC_PACKET_MAX_LEN bytes. Returns the frame length.
+uint8_t asic_packet_build(uint8_t *buf, uint8_t header, const uint8_t *data, uint8_t data_len);
+
+#endif /* ASIC_PACKET_H_ */
@@ -0,0 +1,82 @@
+#ifndef AUTOTUNE_H_
+#define AUTOTUNE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// A window whose valid nonces per second per MHz fall this far below the chip's mean of its
+// healthy windows fails even without errors: cores that stop hashing do not report errors.
+// With 100 results a window is within 10% of the truth, so this is 2.5 standard deviations.
+#define AUTOTUNE_RATE_DROP 0.25
+
+// Longest chain the tuner takes on
+#define AUTOTUNE_MAX_CHIPS 32
+
+typedef enum
+{
+    AUTOTUNE_CLIMBING,   // stepping up after every healthy window
+    AUTOTUNE_CONFIRMING, // backed off after a failed window, stepping down until one passes
+    AUTOTUNE_STABLE,     // settled; a failed window steps down again
+} autotune_state;
+
+typedef struct
+{
+    float min_mhz;
+    float max_mhz;
+    float step_mhz;
+    uint32_t window_results;   // results that close a measurement window
+    uint32_t window_timeout_ms; // a window closes after this even with fewer results
+    float max_error_rate;      // errors / results a healthy window stays at or below
+} autotune_config;
+
+typedef struct
+{
+    autotune_state state;
+    float frequency;           // what the chip is programmed to
+    float previous_frequency;  // where it was before the last change
+    float stable_frequency;    // the last frequency a window passed at, 0 before any
+    bool changed;              // frequency moved; the caller programs it and clears this
+
+    // current window
+    uint32_t valid;
+    uint32_t errors;           // nonces below the ticket difficulty
+    uint32_t window_start_ms;
+
+    double rate_per_mhz;       // mean valid nonces per second per MHz of the healthy windows
+    uint32_t healthy_windows;
+    uint32_t failed_windows;
+    float last_error_rate;
+} autotune_chip;
+
+typedef struct
+{
+    autotune_config config;
+    uint16_t chip_count;       // 0 when off
+    autotune_chip chips[AUTOTUNE_MAX_CHIPS];
+    bool settled;              // a chip reached STABLE or stepped down from it; the profile is worth saving
+} autotune;
+
+// Starts every chip climbing from start_mhz; false, with chip_count 0, for more than AUTOTUNE_MAX_CHIPS
+bool autotune_init(autotune * tuner, const autotune_config * config, uint16_t chip_count, float start_mhz, uint32_t now_ms);
+// Takes the chips over at frequencies found earlier, watching them as STABLE
+void autotune_restore(autotune * tuner, const float * frequencies, uint32_t now_ms);
+void autotune_stop(autotune * tuner);
+
+// The fastest chip, which runs out of nonces first; fallback when the tuner is off
+float autotune_max_frequency(const autotune * tuner, float fallback);
+
+void autotune_record(autotune * tuner, uint8_t chip_index, bool valid);
+
+// Judges every window that is due. allow_up false holds climbing chips where they are, e.g.
+// while the board runs hot. Returns the chips whose frequency changed, flagged with changed.
+int autotune_step(autotune * tuner, uint32_t now_ms, bool allow_up);
+
+// "f0,f1,..." in MHz, as stored in NVS; returns the length written
+size_t autotune_format_profile(const autotune * tuner, char * out, size_t size);
+// Reads up to max frequencies; returns how many
+int autotune_parse_profile(const char * profile, float * frequencies, int max);
+
+const char * autotune_state_str(autotune_state state);
+
+#endif /* AUTOTUNE_H_ */
@@ -4,6 +4,8 @@
 #include "common.h"
 #include "driver/gpio.h"
 #include "mining.h"
+#include "bm13xx.h"
+#include "job_interval.h"
 
 #define ASIC_BM1370_JOB_FREQUENCY_MS 500
 
@@ -23,27 +25,19 @@ typedef struct
     float frequency;
 } bm1370Module;
 
-typedef struct __attribute__((__packed__))
-{
-    uint8_t job_id;
-    uint8_t num_midstates;
-    uint8_t starting_nonce[4];
-    uint8_t nbits[4];
-    uint8_t ntime[4];
-    uint8_t merkle_root[32];
-    uint8_t prev_block_hash[32];
-    uint8_t version[4];
-} BM1370_job;
+extern const bm13xx_chip BM1370_CHIP;
 
 uint8_t BM1370_init(uint64_t frequency, uint16_t asic_count);
 
-uint8_t BM1370_send_init(void);
 void BM1370_send_work(void * GLOBAL_STATE, bm_job * next_bm_job);
 void BM1370_set_job_difficulty_mask(int);
 void BM1370_set_version_mask(uint32_t version_mask);
 int BM1370_set_max_baud(void);
 int BM1370_set_default_baud(void);
-void BM1370_send_hash_frequency(int, float, float);
+bool BM1370_set_frequency(float target_freq);
+void BM1370_read_register(int address, uint8_t reg);
+bool BM1370_set_chip_frequency(uint8_t chip_index, float current, float target);
+void BM1370_job_interval(job_interval * interval, float frequency, uint16_t asic_count, uint32_t version_mask);
 task_result * BM1370_proccess_work(void * GLOBAL_STATE);
 
 #endif /* BM1370_H_ */
@@ -4,6 +4,8 @@
 #include "common.h"
 #include "driver/gpio.h"
 #include "mining.h"
+#include "bm13xx.h"
+#include "job_interval.h"
 
 #define ASIC_BM1397_JOB_FREQUENCY_MS 20 //not currently used
 
@@ -23,31 +25,15 @@ typedef struct
     float frequency;
 } bm1397Module;
 
-typedef enum
-{
-    JOB_PACKET = 0,
-    CMD_PACKET = 1,
-} packet_type_t;
-
 typedef enum
 {
     JOB_RESP = 0,
     CMD_RESP = 1,
 } response_type_t;
 
-typedef struct __attribute__((__packed__))
-{
-    uint8_t job_id;
-    uint8_t num_midstates;
-    uint8_t starting_nonce[4];
-    uint8_t nbits[4];
-    uint8_t ntime[4];
-    uint8_t merkle4[4];
-    uint8_t midstate[32];
-    uint8_t midstate1[32];
-    uint8_t midstate2[32];
-    uint8_t midstate3[32];
-} job_packet;
+typedef bm13xx_midstate_job job_packet;
+
+extern const bm13xx_chip BM1397_CHIP;
 
 uint8_t BM1397_init(uint64_t frequency, uint16_t asic_count);
 
@@ -56,7 +42,9 @@ void BM1397_set_job_difficulty_mask(int);
 void BM1397_set_version_mask(uint32_t version_mask);
 int BM1397_set_max_baud(void);
 int BM1397_set_default_baud(void);
-void BM1397_send_hash_frequency(float frequency);
+bool BM1397_set_frequency(float target_freq);
+void BM1397_read_register(int address, uint8_t reg);
+void BM1397_job_interval(job_interval * interval, float frequency, uint16_t asic_count, uint32_t version_mask);
 task_result * BM1397_proccess_work(void * GLOBAL_STATE);
 
 #endif /* BM1397_H_ */
\ No newline at end of file
@@ -0,0 +1,216 @@
+#ifndef BM13XX_H_
+#define BM13XX_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "common.h"
+#include "frame_parser.h"
+#include "mining.h"
+#include "register_reads.h"
+
+// Frame header bits shared by the whole family
+#define BM13XX_TYPE_JOB 0x20
+#define BM13XX_TYPE_CMD 0x40
+#define BM13XX_GROUP_SINGLE 0x00
+#define BM13XX_GROUP_ALL 0x10
+#define BM13XX_CMD_SETADDRESS 0x00
+#define BM13XX_CMD_WRITE 0x01
+#define BM13XX_CMD_READ 0x02
+#define BM13XX_CMD_INACTIVE 0x03
+
+// Registers the core writes itself
+#define BM13XX_REG_PLL0_PARAMETER 0x08
+#define BM13XX_REG_TICKET_MASK 0x14
+#define BM13XX_REG_MISC_CONTROL 0x18
+#define BM13XX_REG_VERSION_MASK 0xA4
+
+// Registers read back to watch the chips, as in the BM1397 register map
+#define BM13XX_REG_HASH_RATE 0x04
+#define BM13XX_REG_ERROR_FLAG 0x48
+#define BM13XX_REG_NONCE_ERROR_COUNTER 0x4C
+#define BM13XX_REG_NONCE_OVERFLOW_COUNTER 0x50
+
+// Job ids wrap at this; active_jobs and valid_jobs are sized for it
+#define BM13XX_MAX_JOB_ID 128
+
+// Frequencies the PLL table covers, in 6.25MHz steps from 0
+#define BM13XX_PLL_TABLE_MAX_MHZ 1200
+#define BM13XX_PLL_TABLE_STEPS (BM13XX_PLL_TABLE_MAX_MHZ * 4 / 25 + 1)
+
+// Job payload of the chips that hash the full header and roll versions themselves
+typedef struct __attribute__((__packed__))
+{
+    uint8_t job_id;
+    uint8_t num_midstates;
+    uint8_t starting_nonce[4];
+    uint8_t nbits[4];
+    uint8_t ntime[4];
+    uint8_t merkle_root[32];
+    uint8_t prev_block_hash[32];
+    uint8_t version[4];
+} bm13xx_header_job;
+
+// Job payload of the BM1397, which is handed precomputed midstates
+typedef struct __attribute__((__packed__))
+{
+    uint8_t job_id;
+    uint8_t num_midstates;
+    uint8_t starting_nonce[4];
+    uint8_t nbits[4];
+    uint8_t ntime[4];
+    uint8_t merkle4[4];
+    uint8_t midstates[4][32];
+} bm13xx_midstate_job;
+
+typedef enum
+{
+    BM13XX_JOB_HEADER,
+    BM13XX_JOB_MIDSTATES,
+} bm13xx_job_layout;
+
+// One entry of a chip's init sequence
+typedef enum
+{
+    BM13XX_STEP_END,
+    BM13XX_STEP_WRITE_ALL,      // reg <- value on every chip
+    BM13XX_STEP_WRITE_FIRST,    // reg <- value on the chip at address 0 only
+    BM13XX_STEP_EACH_CHIP,      // the next `count` WRITE_ALL steps, addressed to each chip in turn
+    BM13XX_STEP_VERSION_MASK,   // the default version rolling mask, `count` times
+    BM13XX_STEP_ENUMERATE,      // read the chip id register and count the replies
+    BM13XX_STEP_CHAIN_INACTIVE,
+    BM13XX_STEP_SET_ADDRESSES,  // spread the chips evenly over the address space
+    BM13XX_STEP_DIFFICULTY,     // the chip's default ticket mask
+    BM13XX_STEP_DEFAULT_BAUD,
+    BM13XX_STEP_FREQUENCY,      // bring the PLL to the requested frequency
+} bm13xx_step_op;
+
+typedef struct
+{
+    bm13xx_step_op op;
+    uint8_t reg;
+    uint8_t value[4];
+    uint16_t count;    // repeats, or steps covered by EACH_CHIP
+    uint16_t delay_ms; // after the step; after every chip for EACH_CHIP
+} bm13xx_step;
+
+#define BM13XX_WRITE(reg, b0, b1, b2, b3) {BM13XX_STEP_WRITE_ALL, (reg), {(b0), (b1), (b2), (b3)}, 0, 0}
+#define BM13XX_DO(op) {(op), 0, {0}, 1, 0}
+
+typedef struct
+{
+    uint8_t reg;
+    uint8_t value[4];
+    int baud;
+} bm13xx_baud;
+
+typedef enum
+{
+    BM13XX_PLL_FIRST_FIT,      // first divider set within max_error_mhz, searching large post dividers first
+    BM13XX_PLL_FEWEST_POSTDIV, // exact within max_error_mhz, smallest post divider product
+} bm13xx_pll_search;
+
+// How a frequency change walks the PLL there in 6.25MHz steps
+typedef enum
+{
+    BM13XX_RAMP_ALIGN,   // snap to the step grid first, program the target again at the end
+    BM13XX_RAMP_RESTART, // reprogram the current frequency first
+} bm13xx_ramp;
+
+typedef struct
+{
+    uint16_t fb_min;
+    uint16_t fb_max;
+    bm13xx_pll_search search;
+    float max_error_mhz;
+    bm13xx_ramp ramp;
+} bm13xx_pll;
+
+typedef struct
+{
+    const char * name;
+    uint16_t chip_id;
+    uint8_t response_len;      // 11, or 9 for chips whose results carry no version bits
+    uint16_t enumerate_timeout_ms;
+    bool strict_chip_count;    // fail init unless every expected chip answered
+
+    const bm13xx_step * init;  // ends with BM13XX_STEP_END
+    int default_difficulty;
+    bm13xx_baud default_baud;
+    bm13xx_baud max_baud;
+    bm13xx_pll pll;
+
+    bm13xx_job_layout job_layout;
+    uint8_t job_id_stride;     // job ids the chip reuses the low bits of for cores or midstates
+    uint8_t job_id_mask;       // result job id = (raw & mask) >> shift
+    uint8_t job_id_shift;
+    uint8_t small_core_mask;   // raw & this: small core, or the midstate for BM13XX_JOB_MIDSTATES
+    bool version_rolling;      // chip rolls version bits and reports them in its results
+
+    bool tx_debug;
+    bool work_debug;
+    bool jobs_debug;
+
+    // Special cases; NULL for the common behaviour
+    bool (*program_frequency)(float frequency); // replaces the PLL search and the ramp
+    void (*on_result)(uint8_t core_id, uint32_t nonce);
+} bm13xx_chip;
+
+// A job result as the chip reported it
+typedef struct
+{
+    uint8_t job_id;
+    uint8_t small_core_id; // the midstate index on BM13XX_JOB_MIDSTATES chips
+    uint8_t core_id;
+    uint8_t chip_index;    // position on the chain, from the nonce range the chip hashes
+    uint32_t nonce;        // as sent, little endian on the wire
+    uint32_t version_bits; // rolled bits, already in place; 0 without version rolling
+} bm13xx_result;
+
+// Where frames go and chip replies come from; the UART unless a test swaps it
+typedef struct
+{
+    int (*send)(uint8_t * data, int len, bool debug);
+    int16_t (*receive)(uint8_t * buf, uint16_t size, uint16_t timeout_ms);
+} bm13xx_transport;
+
+void bm13xx_set_transport(const bm13xx_transport * transport);
+
+uint8_t bm13xx_init(const bm13xx_chip * chip, float frequency, uint16_t asic_count);
+void bm13xx_send(const bm13xx_chip * chip, uint8_t header, uint8_t * data, uint8_t data_len, bool debug);
+void bm13xx_write_register(const bm13xx_chip * chip, uint8_t header, uint8_t address, uint8_t reg, const uint8_t value[4]);
+// Where register replies that arrive while mining go; NULL drops them
+void bm13xx_set_register_reads(register_reads * reads);
+// Sends CMD_READ to one chip, or to every chip for REGISTER_READ_ALL; the reply comes back through
+// bm13xx_process_work, so claim its slot with register_reads_begin() first
+void bm13xx_read_register(const bm13xx_chip * chip, int address, uint8_t reg);
+// Hands a register reply frame to the reads waiting for it
+void bm13xx_dispatch_register(const bm13xx_chip * chip, const uint8_t * frame);
+void bm13xx_set_version_mask(const bm13xx_chip * chip, uint32_t version_mask);
+// Versions each job is hashed for under version_mask: rolled on chip, or one per midstate
+uint32_t bm13xx_job_versions(const bm13xx_chip * chip, uint32_t version_mask);
+void bm13xx_set_difficulty_mask(const bm13xx_chip * chip, int difficulty);
+int bm13xx_set_baud(const bm13xx_chip * chip, const bm13xx_baud * baud);
+// Results below the ticket difficulty so far; a frequency ramp slows down when it moves
+void bm13xx_set_error_counter(const volatile uint32_t * errors);
+// PLL0 register value for a frequency, searched over the dividers the chip allows
+bool bm13xx_pll_find(const bm13xx_chip * chip, float frequency, uint8_t value[4]);
+// The same from the table bm13xx_init() builds, for frequencies on the 6.25MHz grid
+bool bm13xx_pll_lookup(const bm13xx_chip * chip, float frequency, uint8_t value[4]);
+bool bm13xx_send_frequency(const bm13xx_chip * chip, float frequency);
+bool bm13xx_set_frequency(const bm13xx_chip * chip, float frequency);
+// Ramps one chip of the chain on its own; false for chips that can only be programmed together
+bool bm13xx_set_chip_frequency(const bm13xx_chip * chip, uint8_t chip_index, float current, float target);
+
+// Next job id for the chip; ids step by the chip's stride and wrap at BM13XX_MAX_JOB_ID
+uint8_t bm13xx_next_job_id(const bm13xx_chip * chip);
+// Lays the job out in the chip's format into out, at least sizeof(bm13xx_midstate_job); returns its length
+uint8_t bm13xx_build_job(const bm13xx_chip * chip, uint8_t job_id, const bm_job * job, uint8_t * out);
+// Sends the job to the chain under job_id, as it stands: send_work picks its nonces and id first
+void bm13xx_send_job(const bm13xx_chip * chip, uint8_t job_id, const bm_job * job);
+void bm13xx_send_work(const bm13xx_chip * chip, void * GLOBAL_STATE, bm_job * next_bm_job);
+
+void bm13xx_decode_result(const bm13xx_chip * chip, const uint8_t * frame, bm13xx_result * result);
+task_result * bm13xx_process_work(const bm13xx_chip * chip, void * GLOBAL_STATE);
+
+#endif /* BM13XX_H_ */
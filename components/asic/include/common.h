@@ -3,11 +3,17 @@
 
 #include <stdint.h>
 
+#include "mining.h"
+
 typedef struct __attribute__((__packed__))
 {
+    bm_job * job; // a reference to the job the result is for, released by whoever consumes it
     uint8_t job_id;
     uint32_t nonce;
     uint32_t rolled_version;
+    uint8_t core_id;
+    uint8_t small_core_id;
+    uint8_t chip_index;
 } task_result;
 
 unsigned char _reverse_bits(unsigned char num);
@@ -0,0 +1,77 @@
+#ifndef CORE_STATS_H_
+#define CORE_STATS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Flags of a core that looks broken
+#define CORE_STATS_SILENT 0x01 // nothing from it for far longer than its share of the results predicts
+#define CORE_STATS_ERRORS 0x02 // too many of its nonces miss the ticket difficulty
+
+// A core is silent once it has gone this many of its expected result intervals without one.
+// Results arrive as a Poisson process, so a healthy core stays quiet that long with e^-10 odds.
+#define CORE_STATS_SILENT_INTERVALS 10
+// Results the chain has to report per core before silence means anything
+#define CORE_STATS_SILENT_MIN_RESULTS 4
+// A core with at least this many invalid nonces, making up this share of its results, is flagged
+#define CORE_STATS_ERROR_MIN 3
+#define CORE_STATS_ERROR_RATIO 0.1
+
+// Results of every (core, small core) of the chip, summed over the chips of the chain, which
+// share core ids. One slot per small core, core-major, each counter in its own array so a scan
+// over one of them walks contiguous memory.
+typedef struct
+{
+    uint16_t cores;
+    uint16_t small_cores;  // per core
+    uint16_t slots;        // cores * small_cores; 0 when the arrays could not be allocated
+
+    uint32_t * valid;       // nonces at or above the ticket difficulty
+    uint16_t * invalid;     // nonces below it, hardware errors
+    float * best_diff;
+    uint32_t * last_seen_s; // uptime of the last result, 0 for none yet
+    uint32_t * updated;     // sequence of the last change, for delta reads
+    uint8_t * flags;
+
+    uint32_t sequence;      // bumped on every change
+    uint32_t started_s;     // uptime the counters started at
+    uint32_t results;       // all results in the slots
+    uint32_t unknown;       // results from core ids outside the chip's layout
+    uint32_t errors;        // invalid results of every core, known or not
+    uint16_t flagged;
+} core_stats;
+
+// Allocates the slots in one block; false, with slots 0, when that fails
+bool core_stats_init(core_stats * stats, uint16_t cores, uint16_t small_cores, uint32_t now_s);
+void core_stats_record(core_stats * stats, uint8_t core_id, uint8_t small_core_id, double difficulty, uint32_t now_s);
+
+// Flags silent and error prone cores afresh; returns the slots that became flagged since the last check
+int core_stats_check(core_stats * stats, uint32_t now_s);
+
+// Binary delta: a core_stats_header, then a packed core_stats_record for every slot updated after since
+typedef struct __attribute__((__packed__))
+{
+    uint32_t sequence;
+    uint16_t cores;
+    uint16_t small_cores;
+    uint32_t uptime_s;
+    uint16_t count;
+} core_stats_header;
+
+typedef struct __attribute__((__packed__))
+{
+    uint16_t slot;
+    uint32_t valid;
+    uint16_t invalid;
+    float best_diff;
+    uint32_t last_seen_s;
+    uint8_t flags;
+} core_stats_entry;
+
+// Room for the delta with every slot in it
+size_t core_stats_encode_size(const core_stats * stats);
+// Writes the delta to out, which needs core_stats_encode_size() bytes; returns its length, 0 when out is short
+size_t core_stats_encode(const core_stats * stats, uint32_t since, uint32_t now_s, uint8_t * out, size_t size);
+
+#endif /* CORE_STATS_H_ */
@@ -0,0 +1,62 @@
+#ifndef FRAME_PARSER_H_
+#define FRAME_PARSER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Responses start AA 55 and end in a byte holding the response type in bit 7 and a CRC5
+// in the low five bits. The BM1397 sends 9 byte frames, the BM1366 family 11.
+#define ASIC_FRAME_PREAMBLE_0 0xAA
+#define ASIC_FRAME_PREAMBLE_1 0x55
+#define ASIC_FRAME_MAX_LEN 11
+#define ASIC_FRAME_JOB_RESPONSE 0x80
+#define ASIC_FRAME_CRC_MASK 0x1F
+
+typedef enum
+{
+    ASIC_FRAME_NONE = 0,   // no complete frame yet
+    ASIC_FRAME_JOB,        // nonce found
+    ASIC_FRAME_REGISTER,   // register read response
+    ASIC_FRAME_UART_ERROR, // the UART read itself failed
+} asic_frame_type;
+
+typedef struct
+{
+    uint32_t job_frames;
+    uint32_t register_frames;
+    uint32_t crc_errors;    // frames with a good preamble and a bad CRC5
+    uint32_t resyncs;       // times the stream lost frame alignment
+    uint32_t dropped_bytes; // bytes skipped to find the next preamble
+} asic_frame_stats;
+
+// Splits the UART byte stream into frames. A byte that does not fit is skipped on its own,
+// so one misaligned byte costs only itself and not the frames queued behind it.
+typedef struct
+{
+    uint8_t frame_len;
+    uint8_t fill;
+    bool in_sync;
+    uint8_t buffer[ASIC_FRAME_MAX_LEN];
+    asic_frame_stats stats;
+} frame_parser;
+
+void frame_parser_init(frame_parser * parser, uint8_t frame_len);
+
+// Drops any partial frame, e.g. after the UART was flushed or its baud changed
+void frame_parser_reset(frame_parser * parser);
+
+// Bytes still needed to complete the frame in progress
+static inline uint8_t frame_parser_needed(const frame_parser * parser)
+{
+    return parser->frame_len - parser->fill;
+}
+
+// Feeds one byte. On ASIC_FRAME_JOB or ASIC_FRAME_REGISTER the frame is in parser->buffer
+// until the next call.
+asic_frame_type frame_parser_push(frame_parser * parser, uint8_t byte);
+
+// Whether a complete frame carries a valid CRC5
+bool frame_parser_check_crc(const uint8_t * frame, uint8_t frame_len);
+
+#endif /* FRAME_PARSER_H_ */
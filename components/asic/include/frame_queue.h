@@ -0,0 +1,44 @@
+#ifndef FRAME_QUEUE_H_
+#define FRAME_QUEUE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "frame_parser.h"
+
+// Frames parsed by the UART RX task and not yet taken by the result task; a power of two
+#define FRAME_QUEUE_SIZE 64
+
+typedef struct
+{
+    asic_frame_type type;
+    int64_t received_us; // when the RX task saw the bytes arrive
+    uint8_t frame[ASIC_FRAME_MAX_LEN];
+} queued_frame;
+
+// Single producer, single consumer ring. head is only written by the producer and tail only by
+// the consumer, each published with release ordering, so neither side takes a lock.
+typedef struct
+{
+    queued_frame entries[FRAME_QUEUE_SIZE];
+    uint32_t head;
+    uint32_t tail;
+
+    // producer side statistics
+    uint32_t drops;     // frames lost to a full queue
+    uint32_t max_depth; // most frames ever waiting
+} frame_queue;
+
+void frame_queue_init(frame_queue * queue);
+
+// Producer: false and counted as a drop when the queue is full
+bool frame_queue_push(frame_queue * queue, const queued_frame * frame);
+
+// Consumer: false when empty
+bool frame_queue_pop(frame_queue * queue, queued_frame * frame);
+
+// Frames waiting; exact from either side, a snapshot from anywhere else
+size_t frame_queue_count(const frame_queue * queue);
+
+#endif /* FRAME_QUEUE_H_ */
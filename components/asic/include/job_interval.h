@@ -0,0 +1,65 @@
+#ifndef JOB_INTERVAL_H_
+#define JOB_INTERVAL_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Nonces in one version of a job header
+#define JOB_INTERVAL_NONCE_SPACE 4294967296.0
+
+// Share of a job's search space to let the chain cover before the next job replaces it. The
+// rest absorbs PLL error, UART latency and the ASIC task waking up late, any of which would
+// otherwise have the chips wrap around and hash nonces they already hashed.
+#define JOB_INTERVAL_SAFETY 0.8
+
+// Below this the job builder and the UART spend more time on jobs than the chips save
+#define JOB_INTERVAL_MIN_MS 10.0
+// Jobs also carry the pool's latest transactions, so they are replaced at least this often
+// even when their search space would last much longer
+#define JOB_INTERVAL_MAX_MS 10000.0
+
+// Work kept queued for the chain. A notify without clean_jobs leaves the queued jobs on their
+// way to the chips, so this bounds how far behind the pool's latest template the chain can be.
+#define JOB_INTERVAL_QUEUE_MS 3000.0
+
+typedef struct
+{
+    double hashrate;    // hashes per second of the whole chain
+    double space;       // hashes in one job: the nonce space times the versions it covers
+    double full_ms;     // time for the chain to cover all of space
+    double interval_ms; // time to leave each job on the chain
+} job_interval;
+
+// Every small core does a hash per clock, and the chips of a chain split each job's nonces
+void job_interval_compute(job_interval * interval, float frequency_mhz, uint32_t small_cores, uint16_t asic_count,
+                          uint32_t versions);
+
+// Jobs to keep queued to cover JOB_INTERVAL_QUEUE_MS, from one up to max_depth
+int job_interval_queue_depth(const job_interval * interval, int max_depth);
+
+// How much of each job's space the chain covered before it was replaced
+typedef struct
+{
+    uint32_t jobs;
+    uint32_t overruns;     // jobs left on past their whole space, so some nonces were hashed twice
+    double last_coverage;  // fraction of the space, 1.0 for all of it
+    double max_coverage;
+    double coverage_sum;
+
+    // Template age: time from a job's notify arriving to the job reaching the chips
+    uint32_t templates;            // jobs sent whose notify arrival time is known
+    double last_template_age_ms;
+    double max_template_age_ms;
+    double template_age_sum;
+    double notify_to_chip_ms;      // template age of the first job sent for the latest notify
+    double notify_to_chip_max_ms;
+} job_coverage;
+
+// Accounts for a job the chain worked on for elapsed_ms; returns its coverage
+double job_coverage_record(job_coverage * coverage, const job_interval * interval, double elapsed_ms);
+
+// Accounts for a job reaching the chips age_ms after its notify arrived; new_notify when it is
+// the first job of that notify to get there
+void job_coverage_record_age(job_coverage * coverage, double age_ms, bool new_notify);
+
+#endif /* JOB_INTERVAL_H_ */
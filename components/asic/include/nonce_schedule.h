@@ -0,0 +1,52 @@
+#ifndef NONCE_SCHEDULE_H_
+#define NONCE_SCHEDULE_H_
+
+#include <stdint.h>
+
+#include "mining.h"
+
+// The nonce space of a header is handed out in this many equal subranges
+#define NONCE_SCHEDULE_SUBRANGES 16
+#define NONCE_SCHEDULE_SUBRANGE_SIZE ((1ULL << 32) / NONCE_SCHEDULE_SUBRANGES)
+
+// Headers remembered, the oldest forgotten first: enough for the jobs of several notifies
+#define NONCE_SCHEDULE_HEADERS 64
+
+typedef struct
+{
+    uint32_t key;    // hash of the header without its nonce; 0 for a free entry
+    uint8_t next;    // subrange the next dispatch starts at
+    uint8_t handed;  // subranges handed out so far, at most NONCE_SCHEDULE_SUBRANGES
+} nonce_schedule_header;
+
+typedef struct
+{
+    uint32_t headers;    // distinct headers dispatched
+    uint32_t dispatches;
+    uint32_t repeats;    // dispatches of a header already dispatched, moved on to the subranges after
+    uint32_t overlaps;   // dispatches that ran out of fresh subranges, so search some nonces again
+    uint32_t assigned;   // subranges handed out for the first time
+} nonce_schedule_stats;
+
+// Every job header is unique through its extranonce2 and ntime, and the chips of the chain split
+// its nonces by address, so a header only gets searched twice when it is dispatched twice, e.g.
+// when a pool resends a notify unchanged. The schedule then starts it where the last dispatch
+// ended instead of at nonce 0 again.
+typedef struct
+{
+    nonce_schedule_header headers[NONCE_SCHEDULE_HEADERS];
+    uint8_t oldest;
+
+    uint32_t notify_key; // hash of the stratum job id the stats below are for
+    nonce_schedule_stats notify;
+    nonce_schedule_stats last_notify;
+    nonce_schedule_stats total;
+} nonce_schedule;
+
+void nonce_schedule_init(nonce_schedule * schedule);
+
+// The starting nonce for a dispatch of job that covers coverage of its nonce space, from 0 to 1,
+// before the next job replaces it
+uint32_t nonce_schedule_next(nonce_schedule * schedule, const bm_job * job, double coverage);
+
+#endif /* NONCE_SCHEDULE_H_ */
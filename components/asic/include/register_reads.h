@@ -0,0 +1,67 @@
+#ifndef REGISTER_READS_H_
+#define REGISTER_READS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Register reads in flight at once
+#define REGISTER_READS_SLOTS 8
+
+// Address of a read every chip of the chain answers
+#define REGISTER_READ_ALL -1
+
+// Called from the result task for every reply a read gets
+typedef void (*register_read_done)(void * ctx, uint8_t chip_index, uint8_t reg, uint32_t value);
+
+typedef enum
+{
+    REGISTER_READ_FREE,
+    REGISTER_READ_CLAIMED,    // being filled in by the requester
+    REGISTER_READ_PENDING,    // sent, waiting for replies
+    REGISTER_READ_DELIVERING, // a reply is being handed to done
+} register_read_state;
+
+typedef struct
+{
+    uint8_t state; // register_read_state, changed atomically
+    bool all;
+    uint8_t address;
+    uint8_t reg;
+    uint32_t deadline_ms;
+    uint16_t replies;
+    register_read_done done;
+    void * ctx;
+} register_read;
+
+// Replies to CMD_READ come back through the same RX stream as nonces. One task starts reads and
+// expires them, the result task matches the replies, each slot moving between them through its
+// atomic state, so neither side takes a lock and mining never waits on a read.
+typedef struct
+{
+    register_read slots[REGISTER_READS_SLOTS];
+
+    // requester side
+    uint32_t reads;
+    uint32_t timeouts;  // addressed reads without a reply, broadcast reads without any
+    uint32_t busy;      // reads refused for a full table or one already in flight
+
+    // result task side
+    uint32_t replies;
+    uint32_t unmatched; // replies no read was waiting for, e.g. after their timeout
+} register_reads;
+
+void register_reads_init(register_reads * reads);
+
+// Claims a slot for a read of reg from address, or from every chip for REGISTER_READ_ALL, before the
+// read is sent. An addressed read ends with its reply; a broadcast read collects replies until
+// timeout_ms passes. Returns false when every slot is taken or the same read is already waiting.
+bool register_reads_begin(register_reads * reads, int address, uint8_t reg, uint32_t timeout_ms, uint32_t now_ms,
+                          register_read_done done, void * ctx);
+
+// Result task: hands a reply to the read waiting for it; false when none is
+bool register_reads_match(register_reads * reads, uint8_t address, uint8_t chip_index, uint8_t reg, uint32_t value);
+
+// Frees the reads past their deadline; returns those that timed out
+int register_reads_expire(register_reads * reads, uint32_t now_ms);
+
+#endif /* REGISTER_READS_H_ */
@@ -0,0 +1,42 @@
+#ifndef RESULT_SET_H_
+#define RESULT_SET_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Results remembered across every job on the chain; a power of two
+#define RESULT_SET_SIZE 1024
+// Slots looked at per result, so a check costs the same however full the set is
+#define RESULT_SET_PROBES 8
+
+typedef struct
+{
+    uint32_t nonce;
+    uint32_t version; // rolled version the nonce was found for
+    uint16_t epoch;   // the job id's epoch when stored; stale once the id is recycled
+    uint8_t job_id;
+    bool used;
+} result_set_entry;
+
+// The (nonce, version) results seen for each active job. Chips now and then send a result twice,
+// and the pool rejects the second share as a duplicate. One open-addressing table is shared by
+// all job ids; recycling an id bumps its epoch, which retires its entries without touching them.
+typedef struct
+{
+    result_set_entry entries[RESULT_SET_SIZE];
+    uint16_t epochs[256]; // per job id, written by the ASIC task
+
+    uint32_t results;
+    uint32_t duplicates;
+    uint32_t evictions; // live results pushed out by probes that found no free slot
+} result_set;
+
+void result_set_init(result_set * set);
+
+// A new job is sent under job_id: forgets the results of the one it replaces
+void result_set_recycle(result_set * set, uint8_t job_id);
+
+// Stores a result; false when the job already had it
+bool result_set_insert(result_set * set, uint8_t job_id, uint32_t nonce, uint32_t version);
+
+#endif /* RESULT_SET_H_ */
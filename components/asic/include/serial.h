@@ -1,6 +1,19 @@
 #ifndef SERIAL_H_
 #define SERIAL_H_
 
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "frame_parser.h"
+
+typedef struct
+{
+    uint32_t fifo_overflows; // hardware FIFO overran before the driver emptied it
+    uint32_t buffer_full;    // driver RX buffer filled before the RX task read it
+    uint32_t queue_drops;    // frames lost because the result task fell behind
+    uint32_t queue_max;      // most parsed frames ever waiting for the result task
+} serial_rx_stats;
+
 #define SERIAL_BUF_SIZE 16
 #define CHUNK_SIZE 1024
 
@@ -8,7 +21,12 @@ int SERIAL_send(uint8_t *, int, bool);
 esp_err_t SERIAL_init(void);
 void SERIAL_debug_rx(void);
 int16_t SERIAL_rx(uint8_t *, uint16_t, uint16_t);
+asic_frame_type SERIAL_rx_frame(uint8_t frame_len, uint8_t **frame, uint16_t timeout_ms);
+int64_t SERIAL_frame_received_us(void);
+asic_frame_stats SERIAL_frame_stats(void);
+serial_rx_stats SERIAL_rx_stats(void);
 void SERIAL_clear_buffer(void);
+size_t SERIAL_rx_pending(void);
 esp_err_t SERIAL_set_baud(int baud);
 
 #endif /* SERIAL_H_ */
\ No newline at end of file
@@ -0,0 +1,74 @@
+#include <math.h>
+
+#include "job_interval.h"
+
+void job_interval_compute(job_interval * interval, float frequency_mhz, uint32_t small_cores, uint16_t asic_count,
+                          uint32_t versions)
+{
+    interval->hashrate = (double) frequency_mhz * 1e6 * small_cores * asic_count;
+    interval->space = JOB_INTERVAL_NONCE_SPACE * (versions > 0 ? versions : 1);
+
+    if (interval->hashrate <= 0) {
+        // nothing hashing yet, e.g. before the frequency is known
+        interval->full_ms = JOB_INTERVAL_MAX_MS;
+        interval->interval_ms = JOB_INTERVAL_MAX_MS;
+        return;
+    }
+
+    interval->full_ms = interval->space / interval->hashrate * 1000.0;
+
+    double interval_ms = interval->full_ms * JOB_INTERVAL_SAFETY;
+    if (interval_ms < JOB_INTERVAL_MIN_MS) {
+        interval_ms = JOB_INTERVAL_MIN_MS;
+    } else if (interval_ms > JOB_INTERVAL_MAX_MS) {
+        interval_ms = JOB_INTERVAL_MAX_MS;
+    }
+    interval->interval_ms = interval_ms;
+}
+
+int job_interval_queue_depth(const job_interval * interval, int max_depth)
+{
+    // not worked out yet
+    if (interval->interval_ms <= 0) {
+        return max_depth;
+    }
+
+    double depth = ceil(JOB_INTERVAL_QUEUE_MS / interval->interval_ms);
+    if (depth < 1) {
+        return 1;
+    }
+    return depth < max_depth ? (int) depth : max_depth;
+}
+
+double job_coverage_record(job_coverage * coverage, const job_interval * interval, double elapsed_ms)
+{
+    double covered = elapsed_ms / interval->full_ms;
+
+    coverage->jobs++;
+    if (covered > 1.0) {
+        coverage->overruns++;
+    }
+    if (covered > coverage->max_coverage) {
+        coverage->max_coverage = covered;
+    }
+    coverage->last_coverage = covered;
+    coverage->coverage_sum += covered;
+    return covered;
+}
+
+void job_coverage_record_age(job_coverage * coverage, double age_ms, bool new_notify)
+{
+    coverage->templates++;
+    coverage->last_template_age_ms = age_ms;
+    if (age_ms > coverage->max_template_age_ms) {
+        coverage->max_template_age_ms = age_ms;
+    }
+    coverage->template_age_sum += age_ms;
+
+    if (new_notify) {
+        coverage->notify_to_chip_ms = age_ms;
+        if (age_ms > coverage->notify_to_chip_max_ms) {
+            coverage->notify_to_chip_max_ms = age_ms;
+        }
+    }
+}
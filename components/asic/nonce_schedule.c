@@ -0,0 +1,92 @@
+#include <math.h>
+#include <string.h>
+
+#include "nonce_schedule.h"
+
+// FNV-1a; a collision only moves a fresh header off nonce 0, which searches just as well
+static uint32_t hash_bytes(uint32_t hash, const void * data, size_t len)
+{
+    const uint8_t * bytes = data;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static uint32_t header_key(const bm_job * job)
+{
+    // the chips roll the masked version bits themselves, so the rest of the version is the window
+    uint32_t version_window = job->version & ~job->version_mask;
+
+    uint32_t hash = 2166136261u;
+    hash = hash_bytes(hash, job->prev_block_hash, sizeof(job->prev_block_hash));
+    hash = hash_bytes(hash, job->merkle_root, sizeof(job->merkle_root));
+    hash = hash_bytes(hash, &job->ntime, sizeof(job->ntime));
+    hash = hash_bytes(hash, &version_window, sizeof(version_window));
+    hash = hash_bytes(hash, &job->version_mask, sizeof(job->version_mask));
+    return hash != 0 ? hash : 1;
+}
+
+static void count(nonce_schedule * schedule, int headers, int repeats, int overlaps, int assigned)
+{
+    nonce_schedule_stats * all[] = {&schedule->notify, &schedule->total};
+    for (int i = 0; i < 2; i++) {
+        all[i]->headers += headers;
+        all[i]->dispatches++;
+        all[i]->repeats += repeats;
+        all[i]->overlaps += overlaps;
+        all[i]->assigned += assigned;
+    }
+}
+
+void nonce_schedule_init(nonce_schedule * schedule)
+{
+    memset(schedule, 0, sizeof(*schedule));
+}
+
+uint32_t nonce_schedule_next(nonce_schedule * schedule, const bm_job * job, double coverage)
+{
+    uint32_t notify_key = job->jobid != NULL ? hash_bytes(2166136261u, job->jobid, strlen(job->jobid)) : 0;
+    if (notify_key != schedule->notify_key) {
+        schedule->last_notify = schedule->notify;
+        memset(&schedule->notify, 0, sizeof(schedule->notify));
+        schedule->notify_key = notify_key;
+    }
+
+    // subranges the chain gets into before the next job replaces this one
+    int span = coverage > 0 ? (int) ceil(coverage * NONCE_SCHEDULE_SUBRANGES) : NONCE_SCHEDULE_SUBRANGES;
+    if (span < 1) {
+        span = 1;
+    } else if (span > NONCE_SCHEDULE_SUBRANGES) {
+        span = NONCE_SCHEDULE_SUBRANGES;
+    }
+
+    uint32_t key = header_key(job);
+    nonce_schedule_header * header = NULL;
+    for (int i = 0; i < NONCE_SCHEDULE_HEADERS; i++) {
+        if (schedule->headers[i].key == key) {
+            header = &schedule->headers[i];
+            break;
+        }
+    }
+
+    bool repeat = header != NULL;
+    if (!repeat) {
+        header = &schedule->headers[schedule->oldest];
+        schedule->oldest = (schedule->oldest + 1) % NONCE_SCHEDULE_HEADERS;
+        header->key = key;
+        header->next = 0;
+        header->handed = 0;
+    }
+
+    int fresh = NONCE_SCHEDULE_SUBRANGES - header->handed;
+    if (fresh > span) {
+        fresh = span;
+    }
+    count(schedule, !repeat, repeat, fresh < span, fresh);
+
+    uint32_t starting_nonce = header->next * NONCE_SCHEDULE_SUBRANGE_SIZE;
+    header->handed += fresh;
+    header->next = (header->next + span) % NONCE_SCHEDULE_SUBRANGES;
+    return starting_nonce;
+}
@@ -0,0 +1,106 @@
+#include <string.h>
+
+#include "register_reads.h"
+
+static bool claim(register_read * slot, uint8_t from, uint8_t to)
+{
+    return __atomic_compare_exchange_n(&slot->state, &from, to, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+static void release(register_read * slot, uint8_t state)
+{
+    __atomic_store_n(&slot->state, state, __ATOMIC_RELEASE);
+}
+
+void register_reads_init(register_reads * reads)
+{
+    memset(reads, 0, sizeof(*reads));
+}
+
+bool register_reads_begin(register_reads * reads, int address, uint8_t reg, uint32_t timeout_ms, uint32_t now_ms,
+                          register_read_done done, void * ctx)
+{
+    bool all = address == REGISTER_READ_ALL;
+    register_read * free_slot = NULL;
+
+    for (int i = 0; i < REGISTER_READS_SLOTS; i++) {
+        register_read * slot = &reads->slots[i];
+        uint8_t state = __atomic_load_n(&slot->state, __ATOMIC_ACQUIRE);
+        if (state == REGISTER_READ_FREE) {
+            if (free_slot == NULL) {
+                free_slot = slot;
+            }
+            continue;
+        }
+        // a reply could not tell two reads of the same register apart
+        if (slot->reg == reg && (all || slot->all || slot->address == address)) {
+            reads->busy++;
+            return false;
+        }
+    }
+    if (free_slot == NULL || !claim(free_slot, REGISTER_READ_FREE, REGISTER_READ_CLAIMED)) {
+        reads->busy++;
+        return false;
+    }
+
+    free_slot->all = all;
+    free_slot->address = all ? 0 : address;
+    free_slot->reg = reg;
+    free_slot->deadline_ms = now_ms + timeout_ms;
+    free_slot->replies = 0;
+    free_slot->done = done;
+    free_slot->ctx = ctx;
+    release(free_slot, REGISTER_READ_PENDING);
+    reads->reads++;
+    return true;
+}
+
+bool register_reads_match(register_reads * reads, uint8_t address, uint8_t chip_index, uint8_t reg, uint32_t value)
+{
+    for (int i = 0; i < REGISTER_READS_SLOTS; i++) {
+        register_read * slot = &reads->slots[i];
+        if (__atomic_load_n(&slot->state, __ATOMIC_ACQUIRE) != REGISTER_READ_PENDING || slot->reg != reg ||
+            (!slot->all && slot->address != address)) {
+            continue;
+        }
+        // expiring it at the same time wins or loses here, never half way
+        if (!claim(slot, REGISTER_READ_PENDING, REGISTER_READ_DELIVERING)) {
+            continue;
+        }
+        if (slot->reg != reg || (!slot->all && slot->address != address)) {
+            // expired and taken by another read since the check above
+            release(slot, REGISTER_READ_PENDING);
+            continue;
+        }
+        slot->replies++;
+        if (slot->done != NULL) {
+            slot->done(slot->ctx, chip_index, reg, value);
+        }
+        release(slot, slot->all ? REGISTER_READ_PENDING : REGISTER_READ_FREE);
+        reads->replies++;
+        return true;
+    }
+    reads->unmatched++;
+    return false;
+}
+
+int register_reads_expire(register_reads * reads, uint32_t now_ms)
+{
+    int timed_out = 0;
+    for (int i = 0; i < REGISTER_READS_SLOTS; i++) {
+        register_read * slot = &reads->slots[i];
+        if (__atomic_load_n(&slot->state, __ATOMIC_ACQUIRE) != REGISTER_READ_PENDING ||
+            (int32_t) (now_ms - slot->deadline_ms) < 0) {
+            continue;
+        }
+        if (!claim(slot, REGISTER_READ_PENDING, REGISTER_READ_FREE)) {
+            // a reply is being delivered, the next call frees it
+            continue;
+        }
+        if (!slot->all || slot->replies == 0) {
+            timed_out++;
+        }
+    }
+    reads->timeouts += timed_out;
+    return timed_out;
+}
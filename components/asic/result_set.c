@@ -0,0 +1,58 @@
+#include <string.h>
+
+#include "result_set.h"
+
+static uint32_t result_hash(uint8_t job_id, uint32_t nonce, uint32_t version)
+{
+    uint32_t hash = nonce * 0x9E3779B1u ^ version * 0x85EBCA77u ^ job_id * 0xC2B2AE3Du;
+    hash ^= hash >> 15;
+    hash *= 0x2C1B3C6Du;
+    hash ^= hash >> 13;
+    return hash;
+}
+
+static bool is_live(const result_set * set, const result_set_entry * entry)
+{
+    return entry->used && entry->epoch == __atomic_load_n(&set->epochs[entry->job_id], __ATOMIC_RELAXED);
+}
+
+void result_set_init(result_set * set)
+{
+    memset(set, 0, sizeof(*set));
+}
+
+void result_set_recycle(result_set * set, uint8_t job_id)
+{
+    __atomic_store_n(&set->epochs[job_id], (uint16_t) (set->epochs[job_id] + 1), __ATOMIC_RELAXED);
+}
+
+bool result_set_insert(result_set * set, uint8_t job_id, uint32_t nonce, uint32_t version)
+{
+    uint32_t home = result_hash(job_id, nonce, version);
+    result_set_entry * free_entry = NULL;
+
+    // every probe is looked at, a free slot does not end the run of a result stored past it
+    for (uint32_t probe = 0; probe < RESULT_SET_PROBES; probe++) {
+        result_set_entry * entry = &set->entries[(home + probe) & (RESULT_SET_SIZE - 1)];
+        if (!is_live(set, entry)) {
+            if (free_entry == NULL) {
+                free_entry = entry;
+            }
+        } else if (entry->job_id == job_id && entry->nonce == nonce && entry->version == version) {
+            set->duplicates++;
+            return false;
+        }
+    }
+
+    if (free_entry == NULL) {
+        free_entry = &set->entries[home & (RESULT_SET_SIZE - 1)];
+        set->evictions++;
+    }
+    free_entry->nonce = nonce;
+    free_entry->version = version;
+    free_entry->epoch = __atomic_load_n(&set->epochs[job_id], __ATOMIC_RELAXED);
+    free_entry->job_id = job_id;
+    free_entry->used = true;
+    set->results++;
+    return true;
+}
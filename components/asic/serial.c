@@ -2,24 +2,47 @@
 #include <string.h>
 #include <stdlib.h>
 #include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include "freertos/task.h"
 
 #include "driver/uart.h"
 
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "soc/uart_struct.h"
 
 #include "bm1397.h"
 #include "bm1368.h"
 #include "serial.h"
+#include "frame_parser.h"
+#include "frame_queue.h"
 #include "utils.h"
 
 #define ECHO_TEST_TXD (17)
 #define ECHO_TEST_RXD (18)
 #define BUF_SIZE (1024)
 
+#define UART_EVENT_QUEUE_LEN 32
+// symbol times of silence before the UART interrupt reports received bytes; the driver
+// default of 10 adds about a frame's worth of latency to every result
+#define UART_RX_TIMEOUT_SYMBOLS 2
+#define RX_TASK_PRIORITY 20
+
 static const char *TAG = "serial";
 
+// Owned by the RX task once it runs, by the reading task before that
+static frame_parser rx_parser;
+
+static QueueHandle_t uart_events;
+static TaskHandle_t rx_task_handle;
+static frame_queue rx_frames;
+static SemaphoreHandle_t rx_frames_ready;
+static serial_rx_stats rx_stats;
+
+// Frame most recently handed out by SERIAL_rx_frame
+static queued_frame current_frame;
+
 esp_err_t SERIAL_init(void)
 {
     ESP_LOGI(TAG, "Initializing serial");
@@ -37,10 +60,14 @@ esp_err_t SERIAL_init(void)
     // Set UART1 pins(TX: IO17, RX: I018)
     ESP_ERROR_CHECK_WITHOUT_ABORT(uart_set_pin(UART_NUM_1, ECHO_TEST_TXD, ECHO_TEST_RXD, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
 
-    // Install UART driver (we don't need an event queue here)
+    // Install UART driver with an event queue for the RX task
     // tx buffer 0 so the tx time doesn't overlap with the job wait time
     //  by returning before the job is written
-    return uart_driver_install(UART_NUM_1, BUF_SIZE * 2, BUF_SIZE * 2, 0, NULL, 0);
+    esp_err_t err = uart_driver_install(UART_NUM_1, BUF_SIZE * 2, BUF_SIZE * 2, UART_EVENT_QUEUE_LEN, &uart_events, 0);
+    if (err != ESP_OK) {
+        return err;
+    }
+    return uart_set_rx_timeout(UART_NUM_1, UART_RX_TIMEOUT_SYMBOLS);
 }
 
 esp_err_t SERIAL_set_baud(int baud)
@@ -51,6 +78,9 @@ esp_err_t SERIAL_set_baud(int baud)
     ESP_ERROR_CHECK_WITHOUT_ABORT(uart_wait_tx_done(UART_NUM_1, 1000 / portTICK_PERIOD_MS));
 
     ESP_ERROR_CHECK_WITHOUT_ABORT(uart_set_baudrate(UART_NUM_1, baud));
+    if (rx_task_handle == NULL) {
+        frame_parser_reset(&rx_parser);
+    }
 
     return ESP_OK;
 }
@@ -88,6 +118,145 @@ int16_t SERIAL_rx(uint8_t *buf, uint16_t size, uint16_t timeout_ms)
     return bytes_read;
 }
 
+// Parse what the UART driver has buffered and queue the frames for the result task
+static void rx_task_read(int64_t received_us)
+{
+    uint8_t chunk[128];
+    int received;
+    while ((received = uart_read_bytes(UART_NUM_1, chunk, sizeof(chunk), 0)) > 0) {
+        for (int i = 0; i < received; i++) {
+            asic_frame_type type = frame_parser_push(&rx_parser, chunk[i]);
+            if (type == ASIC_FRAME_NONE) {
+                continue;
+            }
+            queued_frame frame = {.type = type, .received_us = received_us};
+            memcpy(frame.frame, rx_parser.buffer, rx_parser.frame_len);
+            if (frame_queue_push(&rx_frames, &frame)) {
+                xSemaphoreGive(rx_frames_ready);
+            }
+        }
+    }
+}
+
+/// @brief reads the chain's responses as they arrive, independent of how long the result task
+/// takes to verify and submit, so the UART FIFO is emptied even while shares are being sent
+static void rx_task(void *pvParameters)
+{
+    uart_event_t event;
+
+    while (1) {
+        if (xQueueReceive(uart_events, &event, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        // the event is posted by the UART interrupt; this task outranks every other reader,
+        // so this is as close to the bytes' arrival as the driver lets us look
+        int64_t received_us = esp_timer_get_time();
+
+        switch (event.type) {
+        case UART_DATA:
+            rx_task_read(received_us);
+            break;
+        case UART_FIFO_OVF:
+        case UART_BUFFER_FULL:
+            // bytes were lost; the parser resynchronizes on what follows
+            if (event.type == UART_FIFO_OVF) {
+                rx_stats.fifo_overflows++;
+            } else {
+                rx_stats.buffer_full++;
+            }
+            ESP_LOGW(TAG, "UART RX %s", event.type == UART_FIFO_OVF ? "FIFO overflow" : "buffer full");
+            uart_flush_input(UART_NUM_1);
+            xQueueReset(uart_events);
+            frame_parser_reset(&rx_parser);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+// The RX task starts with the first framed read, once the chip's frame length is known and
+// the raw reads of chip init are done
+static void start_rx_task(uint8_t frame_len)
+{
+    frame_parser_init(&rx_parser, frame_len);
+    frame_queue_init(&rx_frames);
+    rx_frames_ready = xSemaphoreCreateBinary();
+    xQueueReset(uart_events);
+
+    if (xTaskCreate(rx_task, "uart rx", 4096, NULL, RX_TASK_PRIORITY, &rx_task_handle) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start UART RX task");
+        rx_task_handle = NULL;
+    }
+}
+
+/// @brief waits for the next valid response frame from the chain
+/// bytes that do not frame are skipped one at a time instead of flushing the UART, so the
+/// frames already queued behind a bad byte are still delivered
+/// @param frame_len 9 for the BM1397, 11 for the BM1366 family
+/// @param frame set to the frame, valid until the next call
+/// @return frame type, ASIC_FRAME_NONE on timeout
+asic_frame_type SERIAL_rx_frame(uint8_t frame_len, uint8_t **frame, uint16_t timeout_ms)
+{
+    if (rx_task_handle == NULL && uart_events != NULL) {
+        start_rx_task(frame_len);
+    }
+
+    if (rx_task_handle != NULL) {
+        while (!frame_queue_pop(&rx_frames, &current_frame)) {
+            if (xSemaphoreTake(rx_frames_ready, timeout_ms / portTICK_PERIOD_MS) != pdTRUE) {
+                return ASIC_FRAME_NONE;
+            }
+        }
+        *frame = current_frame.frame;
+        return current_frame.type;
+    }
+
+    // no RX task: parse straight from the driver
+    if (rx_parser.frame_len != frame_len) {
+        frame_parser_init(&rx_parser, frame_len);
+    }
+
+    uint8_t chunk[ASIC_FRAME_MAX_LEN];
+    while (true) {
+        // never read past the frame in progress, the rest stays in the UART buffer
+        int16_t received = SERIAL_rx(chunk, frame_parser_needed(&rx_parser), timeout_ms);
+        if (received < 0) {
+            return ASIC_FRAME_UART_ERROR;
+        }
+        if (received == 0) {
+            return ASIC_FRAME_NONE;
+        }
+        for (int i = 0; i < received; i++) {
+            asic_frame_type type = frame_parser_push(&rx_parser, chunk[i]);
+            if (type != ASIC_FRAME_NONE) {
+                current_frame.received_us = esp_timer_get_time();
+                *frame = rx_parser.buffer;
+                return type;
+            }
+        }
+    }
+}
+
+// When the frame last returned by SERIAL_rx_frame arrived
+int64_t SERIAL_frame_received_us(void)
+{
+    return current_frame.received_us;
+}
+
+serial_rx_stats SERIAL_rx_stats(void)
+{
+    serial_rx_stats stats = rx_stats;
+    stats.queue_drops = rx_frames.drops;
+    stats.queue_max = rx_frames.max_depth;
+    return stats;
+}
+
+asic_frame_stats SERIAL_frame_stats(void)
+{
+    return rx_parser.stats;
+}
+
 void SERIAL_debug_rx(void)
 {
     int ret;
@@ -106,4 +275,19 @@ void SERIAL_debug_rx(void)
 void SERIAL_clear_buffer(void)
 {
     uart_flush(UART_NUM_1);
+    if (rx_task_handle == NULL) {
+        frame_parser_reset(&rx_parser);
+    }
+}
+
+// Data already received and waiting to be read, so a reader can drain without blocking:
+// queued frames once the RX task runs, buffered bytes before
+size_t SERIAL_rx_pending(void)
+{
+    if (rx_task_handle != NULL) {
+        return frame_queue_count(&rx_frames);
+    }
+    size_t len = 0;
+    uart_get_buffered_data_len(UART_NUM_1, &len);
+    return len;
 }
@@ -0,0 +1,457 @@
+#!/usr/bin/env python3
+"""
+Virtual BM1366/BM1368/BM1370 chain on a pseudo-terminal.
+
+The simulator speaks the BM13xx serial protocol: it answers the chip id read used for
+enumeration, takes addresses, keeps the registers written to each chip and hashes the
+jobs it is sent on the CPU. Nonces that meet the ticket mask go back as result frames
+laid out the way bm13xx_decode_result() reads them: the core id in the top seven bits
+of the first nonce byte, the job id and small core in the job id byte and the rolled
+version bits behind it.
+
+    ./bm13xx_sim.py --chip BM1370 --chips 2 --link /tmp/ttyASIC0
+
+A CPU does a few hundred thousand hashes a second against the terahashes of a real
+chain, so at the firmware's ticket difficulty of 256 results would take days. Use
+--difficulty-divisor to scale the ticket target up: 2**24 returns about one nonce in
+256. Such results are real partial solutions, just below the ticket difficulty.
+
+Each chip runs at the frequency its PLL0 register was last written with, and hashes in
+proportion to it. --error-curve injects hardware errors for the frequency tuner to find:
+
+    ./bm13xx_sim.py --chips 2 --error-curve 1:500=0,550=0.05,575=0.5
+
+makes chip 1 corrupt none of its results up to 500MHz, 5% at 550MHz and half at 575MHz,
+interpolating in between. A corrupted result carries a nonce that fails verification.
+
+Each chip counts the hashes it did in register 0x04 and its corrupted results in 0x4C,
+so the firmware's register poller reads back what was injected.
+
+The BM1397 is not simulated: it is sent midstates, which hashlib cannot resume from.
+"""
+
+import argparse
+import hashlib
+import os
+import random
+import struct
+import sys
+import threading
+import time
+import tty
+
+TYPE_JOB = 0x20
+GROUP_ALL = 0x10
+CMD_SETADDRESS = 0x00
+CMD_WRITE = 0x01
+CMD_READ = 0x02
+CMD_INACTIVE = 0x03
+
+REG_CHIP_ID = 0x00
+REG_HASH_RATE = 0x04
+REG_PLL0_PARAMETER = 0x08
+REG_TICKET_MASK = 0x14
+REG_FAST_UART_CONFIGURATION = 0x28
+REG_NONCE_ERROR_COUNTER = 0x4C
+REG_VERSION_MASK = 0xA4
+
+RESPONSE_JOB = 0x80
+
+DIFF1_TARGET = 0xFFFF << 208
+
+# Frequency at which a chip hashes a whole batch per round; faster chips hash more of one
+REFERENCE_MHZ = 500.0
+
+# Rolled versions a chip interleaves with its nonces, so results show version bits
+# long before a nonce range could run out on a CPU
+VERSION_SPREAD = 16
+
+
+class ChipModel:
+    def __init__(self, chip_id, cores, small_cores, job_id_shift):
+        self.chip_id = chip_id
+        self.cores = cores
+        self.small_cores = small_cores
+        self.job_id_shift = job_id_shift
+
+
+# job_id_shift and small_cores mirror job_id_mask/job_id_shift/small_core_mask of the
+# chip descriptors in components/asic
+MODELS = {
+    'BM1366': ChipModel(0x1366, 112, 8, 0),
+    'BM1368': ChipModel(0x1368, 80, 16, 1),
+    'BM1370': ChipModel(0x1370, 128, 16, 1),
+}
+
+
+def crc5_bits(data, bits):
+    crc = 0x1F
+    for i in range(bits):
+        bit = (data[i // 8] >> (7 - i % 8)) & 1
+        feedback = ((crc >> 4) & 1) ^ bit
+        crc = (crc << 1) & 0x1F
+        if feedback:
+            crc ^= 0x05
+    return crc
+
+
+def crc5(data):
+    return crc5_bits(data, len(data) * 8)
+
+
+def crc16_false(data):
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xFFFF
+    return crc
+
+
+def reverse_bits(byte):
+    return int('{:08b}'.format(byte)[::-1], 2)
+
+
+def deposit_bits(value, mask):
+    """Spreads the low bits of value over the set bits of mask"""
+    out = 0
+    bit = 0
+    while mask:
+        low = mask & -mask
+        if (value >> bit) & 1:
+            out |= low
+        mask &= mask - 1
+        bit += 1
+    return out
+
+
+def pll_frequency(value):
+    """MHz a PLL0 parameter sets, 0 for a PLL never written"""
+    fb, ref, post = value[1], value[2], value[3]
+    postdiv = ((post >> 4) + 1) * ((post & 0xF) + 1)
+    return 25.0 * fb / (ref * postdiv) if ref else 0.0
+
+
+def interpolate(curve, x):
+    """Piecewise linear through sorted (x, y) points, flat beyond both ends"""
+    if x <= curve[0][0]:
+        return curve[0][1]
+    for (x0, y0), (x1, y1) in zip(curve, curve[1:]):
+        if x <= x1:
+            return y0 + (y1 - y0) * (x - x0) / (x1 - x0)
+    return curve[-1][1]
+
+
+def parse_error_curve(text):
+    """CHIP:MHZ=RATE,MHZ=RATE,... into (chip, [(mhz, rate), ...])"""
+    chip, points = text.split(':', 1)
+    curve = []
+    for point in points.split(','):
+        mhz, rate = point.split('=')
+        curve.append((float(mhz), float(rate)))
+    return int(chip), sorted(curve)
+
+
+def reverse_words(data):
+    """Job packets carry the merkle root and previous block hash with their words in reverse order"""
+    return b''.join(data[i:i + 4] for i in range(len(data) - 4, -1, -4))
+
+
+def response_frame(payload, job):
+    """AA 55, eight bytes of payload, then the response type and CRC5 of everything after the preamble"""
+    frame = bytearray(b'\xaa\x55' + payload + b'\x00')
+    frame[-1] = RESPONSE_JOB if job else 0
+    frame[-1] |= crc5_bits(frame[2:], (len(frame) - 2) * 8 - 5)
+    return bytes(frame)
+
+
+class Job:
+    def __init__(self, payload):
+        (self.job_id, _, self.starting_nonce, self.nbits, self.ntime) = struct.unpack_from('<BBIII', payload, 0)
+        merkle_root = reverse_words(payload[14:46])
+        prev_block_hash = reverse_words(payload[46:78])
+        (self.version,) = struct.unpack_from('<I', payload, 78)
+        self.header_tail = merkle_root[28:] + struct.pack('<II', self.ntime, self.nbits)
+        self.header_head = prev_block_hash + merkle_root[:28]
+        self.first_blocks = {}
+
+    def hash(self, version, nonce):
+        """Double SHA256 of the 80 byte header, resuming from the first block of each version"""
+        first = self.first_blocks.get(version)
+        if first is None:
+            first = hashlib.sha256(struct.pack('<I', version) + self.header_head)
+            self.first_blocks[version] = first
+        inner = first.copy()
+        inner.update(self.header_tail + struct.pack('<I', nonce))
+        return hashlib.sha256(inner.digest()).digest()
+
+
+class Chip:
+    def __init__(self, index, model):
+        self.index = index
+        self.model = model
+        self.address = None
+        self.registers = {REG_CHIP_ID: struct.pack('>HH', model.chip_id, 0)}
+        self.job = None
+        self.counter = 0
+
+    def register(self, reg):
+        return self.registers.get(reg, b'\x00\x00\x00\x00')
+
+    def count(self, reg, n):
+        value = (struct.unpack('>I', self.register(reg))[0] + n) & 0xFFFFFFFF
+        self.registers[reg] = struct.pack('>I', value)
+
+    def ticket_difficulty(self):
+        value = self.register(REG_TICKET_MASK)
+        mask = 0
+        for i in range(4):
+            mask |= reverse_bits(value[3 - i]) << (8 * i)
+        return mask + 1
+
+    def version_mask(self):
+        value = self.register(REG_VERSION_MASK)
+        return ((value[2] << 8) | value[3]) << 13
+
+    def frequency(self):
+        return pll_frequency(self.register(REG_PLL0_PARAMETER))
+
+    def next_candidate(self, chips):
+        """
+        The next (core, small core, version bits, nonce) to hash. Cores take turns, each
+        owning the nonces whose first byte is 2 * core or 2 * core + 1. Each chip owns the
+        nonces whose second byte falls in its address range, as bm13xx_decode_result()
+        expects, and walks them from the job's starting nonce.
+        """
+        k = self.counter
+        self.counter += 1
+        core = k % self.model.cores
+        rest = k // self.model.cores
+        small_core = rest % self.model.small_cores
+        version_bits = 0
+        mask = self.version_mask()
+        if mask:
+            version_bits = deposit_bits(rest % VERSION_SPREAD, mask)
+            rest //= VERSION_SPREAD
+        interval = 256 // chips
+        position = ((self.job.starting_nonce >> 8) & 0xFF) % interval + (rest >> 1)
+        upper = ((self.job.starting_nonce >> 16) + position // interval) & 0xFFFF
+        second = self.address + position % interval
+        return core, small_core, version_bits, (upper << 16) | (second << 8) | (2 * core + (rest & 1))
+
+    def result(self, small_core, version_bits, nonce):
+        job_id = ((self.job.job_id << self.model.job_id_shift) & 0xFF) | small_core
+        payload = struct.pack('<IBB', nonce, 0, job_id) + struct.pack('>H', version_bits >> 13)
+        return response_frame(payload, True)
+
+
+class Simulator:
+    def __init__(self, model, chips, difficulty_divisor=1, hashrate=0, verbose=False, error_curves=None, seed=None):
+        self.model = model
+        self.error_curves = error_curves or {}
+        self.random = random.Random(seed)
+        self.chips = [Chip(i, model) for i in range(chips)]
+        self.difficulty_divisor = difficulty_divisor
+        self.hashrate = hashrate
+        self.verbose = verbose
+        self.lock = threading.Lock()
+        self.write_lock = threading.Lock()
+        self.running = False
+        self.stats = {'frames': 0, 'crc_errors': 0, 'jobs': 0, 'hashes': 0, 'results': 0, 'errors': 0}
+
+        self.master, self.slave = os.openpty()
+        tty.setraw(self.slave)
+        tty.setraw(self.master)
+        self.port = os.ttyname(self.slave)
+
+    def log(self, message):
+        if self.verbose:
+            print(message, file=sys.stderr, flush=True)
+
+    def write(self, data):
+        with self.write_lock:
+            os.write(self.master, data)
+
+    # --- host to chain ---
+
+    def handle_frame(self, header, data):
+        if header & TYPE_JOB:
+            job = Job(data)
+            with self.lock:
+                for chip in self.chips:
+                    chip.job = job
+                    chip.counter = 0
+            self.stats['jobs'] += 1
+            self.log('job {:02X} version {:08X} nbits {:08X}'.format(job.job_id, job.version, job.nbits))
+            return
+
+        command = header & 0x0F
+        broadcast = bool(header & GROUP_ALL)
+        if command == CMD_INACTIVE:
+            for chip in self.chips:
+                chip.address = None
+        elif command == CMD_SETADDRESS:
+            # the first chip without an address takes it, as the chain passes it down
+            for chip in self.chips:
+                if chip.address is None:
+                    chip.address = data[0]
+                    self.log('chip {} at address {:02X}'.format(chip.index, data[0]))
+                    break
+        elif command == CMD_WRITE:
+            address, reg, value = data[0], data[1], bytes(data[2:6])
+            with self.lock:
+                for chip in self.chips:
+                    if broadcast or chip.address == address:
+                        chip.registers[reg] = value
+            self.log_write(reg, value, 'all' if broadcast else '{:02X}'.format(address))
+        elif command == CMD_READ:
+            address, reg = data[0], data[1]
+            with self.lock:
+                replies = [chip.register(reg) + bytes([chip.address or 0, reg, 0, 0])
+                           for chip in self.chips if broadcast or chip.address == address]
+            for payload in replies:
+                self.write(response_frame(payload, False))
+
+    def log_write(self, reg, value, target):
+        if reg == REG_PLL0_PARAMETER:
+            self.log('{}: PLL to {:.2f}MHz'.format(target, pll_frequency(value)))
+        elif reg == REG_TICKET_MASK:
+            self.log('{}: ticket difficulty {}'.format(target, self.chips[0].ticket_difficulty()))
+        elif reg == REG_VERSION_MASK:
+            self.log('{}: version mask {:08X}'.format(target, self.chips[0].version_mask()))
+        elif reg == REG_FAST_UART_CONFIGURATION:
+            self.log('{}: fast uart {}'.format(target, value.hex()))
+        else:
+            self.log('{}: reg {:02X} = {}'.format(target, reg, value.hex()))
+
+    def read_loop(self):
+        buffer = bytearray()
+        while self.running:
+            try:
+                chunk = os.read(self.master, 4096)
+            except OSError:
+                break
+            buffer += chunk
+            while True:
+                start = buffer.find(b'\x55\xaa')
+                if start < 0:
+                    del buffer[:-1]
+                    break
+                del buffer[:start]
+                if len(buffer) < 4 or len(buffer) < buffer[3] + 2:
+                    break
+                header, length = buffer[2], buffer[3]
+                frame = bytes(buffer[:length + 2])
+                if header & TYPE_JOB:
+                    good = crc16_false(frame[2:-2]) == struct.unpack('>H', frame[-2:])[0]
+                    data = frame[4:-2]
+                else:
+                    good = crc5(frame[2:-1]) == frame[-1]
+                    data = frame[4:-1]
+                if not good:
+                    # resynchronize on the next preamble
+                    self.stats['crc_errors'] += 1
+                    del buffer[:2]
+                    continue
+                del buffer[:length + 2]
+                self.stats['frames'] += 1
+                self.handle_frame(header, data)
+
+    # --- chain to host ---
+
+    def hash_loop(self):
+        started = time.monotonic()
+        while self.running:
+            with self.lock:
+                working = [chip for chip in self.chips if chip.job is not None and chip.address is not None]
+                if not working:
+                    found = []
+                else:
+                    found = self.hash_batch(working, 256)
+            if not working:
+                time.sleep(0.01)
+                continue
+            for frame in found:
+                self.write(frame)
+            if self.hashrate:
+                ahead = self.stats['hashes'] / self.hashrate - (time.monotonic() - started)
+                if ahead > 0:
+                    time.sleep(ahead)
+
+    def hash_batch(self, chips, count):
+        found = []
+        for chip in chips:
+            target = DIFF1_TARGET * self.difficulty_divisor // chip.ticket_difficulty()
+            job = chip.job
+            frequency = chip.frequency()
+            hashes = max(1, round(count * frequency / REFERENCE_MHZ)) if frequency else count
+            curve = self.error_curves.get(chip.index)
+            error_rate = interpolate(curve, frequency) if curve else 0.0
+            for _ in range(hashes):
+                _, small_core, version_bits, nonce = chip.next_candidate(len(self.chips))
+                digest = job.hash(job.version | version_bits, nonce)
+                if int.from_bytes(digest, 'little') <= target:
+                    if error_rate and self.random.random() < error_rate:
+                        # a hardware error: the top nonce byte comes back garbled
+                        nonce ^= 0x5A << 24
+                        self.stats['errors'] += 1
+                        chip.count(REG_NONCE_ERROR_COUNTER, 1)
+                    found.append(chip.result(small_core, version_bits, nonce))
+            chip.count(REG_HASH_RATE, hashes)
+            self.stats['hashes'] += hashes
+        self.stats['results'] += len(found)
+        return found
+
+    def start(self):
+        self.running = True
+        self.threads = [threading.Thread(target=self.read_loop, daemon=True),
+                        threading.Thread(target=self.hash_loop, daemon=True)]
+        for thread in self.threads:
+            thread.start()
+
+    def stop(self):
+        self.running = False
+        os.close(self.slave)
+        os.close(self.master)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Virtual BM13xx chain on a pseudo-terminal')
+    parser.add_argument('--chip', choices=sorted(MODELS), default='BM1370')
+    parser.add_argument('--chips', type=int, default=1, help='chips on the chain')
+    parser.add_argument('--difficulty-divisor', type=int, default=1,
+                        help='scale the ticket target up by this, so a CPU finds results')
+    parser.add_argument('--hashrate', type=float, default=0, help='hashes per second, 0 for as fast as the CPU goes')
+    parser.add_argument('--error-curve', action='append', default=[], metavar='CHIP:MHZ=RATE,...',
+                        help='share of results a chip corrupts by frequency, interpolated between points')
+    parser.add_argument('--link', help='symlink to create to the pty, e.g. /tmp/ttyASIC0')
+    parser.add_argument('--verbose', action='store_true')
+    args = parser.parse_args()
+
+    error_curves = dict(parse_error_curve(curve) for curve in args.error_curve)
+    sim = Simulator(MODELS[args.chip], args.chips, args.difficulty_divisor, args.hashrate, args.verbose, error_curves)
+    if args.link:
+        if os.path.islink(args.link):
+            os.unlink(args.link)
+        os.symlink(sim.port, args.link)
+    print('{}x {} on {}'.format(args.chips, args.chip, args.link or sim.port), flush=True)
+
+    sim.start()
+    started = time.monotonic()
+    try:
+        while True:
+            time.sleep(10)
+            elapsed = time.monotonic() - started
+            print('{frames} frames, {jobs} jobs, {results} results, {errors} errors, {crc_errors} crc errors, '.format(**sim.stats) +
+                  '{:.0f} H/s'.format(sim.stats['hashes'] / elapsed), flush=True)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        sim.stop()
+        if args.link and os.path.islink(args.link):
+            os.unlink(args.link)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,220 @@
+#!/usr/bin/env python3
+"""
+Drives bm13xx_sim over its pty the way the firmware does and checks what comes back.
+
+    python3 -m unittest components/asic/test/simulator/test_bm13xx_sim.py
+"""
+
+import os
+import select
+import struct
+import sys
+import time
+import unittest
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import bm13xx_sim as sim  # noqa: E402
+
+# The genesis block: its nonce has difficulty ~2536, above the firmware's ticket mask of 256
+GENESIS_VERSION = 1
+GENESIS_PREV = bytes(32)
+GENESIS_MERKLE = bytes.fromhex('3ba3edfd7a7b12b27ac72c3e67768f617fc81bc3888a51323a9fb8aa4b1e5e4a')
+GENESIS_TIME = 1231006505
+GENESIS_BITS = 0x1d00ffff
+GENESIS_NONCE = 0x7c2bac1d
+
+
+def command(header, data):
+    frame = bytes([0x55, 0xAA, header, len(data) + 3]) + bytes(data)
+    return frame + bytes([sim.crc5(frame[2:])])
+
+
+def write_all(reg, value):
+    return command(0x51, [0x00, reg] + list(value))
+
+
+def ticket_mask(difficulty):
+    # as bm13xx_set_difficulty_mask() encodes it
+    mask = (1 << (difficulty.bit_length() - 1)) - 1
+    return [sim.reverse_bits((mask >> (8 * (3 - i))) & 0xFF) for i in range(4)]
+
+
+def job_frame(job_id, starting_nonce, version=GENESIS_VERSION, merkle_root=GENESIS_MERKLE):
+    # as bm13xx_build_job() lays out a bm13xx_header_job
+    data = struct.pack('<BBIII', job_id, 1, starting_nonce, GENESIS_BITS, GENESIS_TIME)
+    data += sim.reverse_words(merkle_root) + sim.reverse_words(GENESIS_PREV) + struct.pack('<I', version)
+    frame = bytes([0x55, 0xAA, 0x21, len(data) + 4]) + data
+    return frame + struct.pack('>H', sim.crc16_false(frame[2:]))
+
+
+class SimulatorTest(unittest.TestCase):
+    def start(self, model, chips, divisor=1):
+        self.sim = sim.Simulator(sim.MODELS[model], chips, difficulty_divisor=divisor)
+        self.sim.start()
+        self.port = os.open(self.sim.port, os.O_RDWR | os.O_NOCTTY)
+        self.buffer = b''
+        self.addCleanup(self.stop)
+
+    def stop(self):
+        os.close(self.port)
+        self.sim.stop()
+
+    def send(self, *frames):
+        for frame in frames:
+            os.write(self.port, frame)
+
+    def receive(self, count, timeout=10.0):
+        frames = []
+        deadline = time.monotonic() + timeout
+        while len(frames) < count and time.monotonic() < deadline:
+            if len(self.buffer) < 11:
+                ready, _, _ = select.select([self.port], [], [], 0.1)
+                if ready:
+                    self.buffer += os.read(self.port, 1024)
+            # frames read past count stay for the next call
+            while len(self.buffer) >= 11 and len(frames) < count:
+                self.assertEqual(b'\xaa\x55', self.buffer[:2])
+                frames.append(self.buffer[:11])
+                self.buffer = self.buffer[11:]
+        self.assertEqual(count, len(frames))
+        for frame in frames:
+            self.assertEqual(sim.crc5_bits(frame[2:], 8 * 9 - 5), frame[10] & 0x1F)
+        return frames
+
+    def enumerate(self, chips):
+        self.send(command(0x52, [0x00, 0x00]), command(0x53, [0x00, 0x00]))
+        for i in range(chips):
+            self.send(command(0x40, [i * (256 // chips), 0x00]))
+        return self.receive(chips)
+
+    def test_enumeration_and_register_reads(self):
+        self.start('BM1368', 3)
+        for frame in self.enumerate(3):
+            self.assertEqual(b'\x13\x68', frame[2:4])
+            self.assertFalse(frame[10] & sim.RESPONSE_JOB)
+
+        # a write to one chip is read back from that chip only
+        self.send(command(0x41, [0x55, 0xA8, 0x00, 0x07, 0x01, 0xF0]), command(0x52, [0x00, 0xA8]))
+        values = sorted(frame[2:7] for frame in self.receive(3))
+        self.assertEqual([b'\x00\x00\x00\x00\x00', b'\x00\x00\x00\x00\xaa', b'\x00\x07\x01\xf0\x55'], values)
+
+    def test_finds_the_genesis_nonce(self):
+        self.start('BM1370', 1)
+        self.enumerate(1)
+        self.send(write_all(sim.REG_TICKET_MASK, ticket_mask(256)))
+        self.send(job_frame(24, GENESIS_NONCE & 0xFFFFFF00))
+
+        frame = self.receive(1)[0]
+        self.assertTrue(frame[10] & sim.RESPONSE_JOB)
+        nonce = struct.unpack_from('<I', frame, 2)[0]
+        self.assertEqual(GENESIS_NONCE, nonce)
+        # decoded as bm13xx_decode_result() does for the BM1370
+        self.assertEqual(24, (frame[7] & 0xF0) >> 1)
+        self.assertEqual(0x1d >> 1, (struct.unpack('>I', frame[2:6])[0] >> 25) & 0x7F)
+        self.assertEqual(0, (frame[8] << 8) | frame[9])
+
+    def test_results_meet_the_scaled_ticket_target(self):
+        divisor = 1 << 24
+        self.start('BM1366', 2, divisor)
+        self.enumerate(2)
+        self.send(write_all(sim.REG_TICKET_MASK, ticket_mask(256)),
+                  write_all(sim.REG_VERSION_MASK, [0x90, 0x00, 0xFF, 0xFF]),
+                  job_frame(8, 0x12345600, version=0x20000000, merkle_root=bytes(range(32))))
+
+        job = sim.Job(job_frame(8, 0x12345600, version=0x20000000, merkle_root=bytes(range(32)))[4:-2])
+        target = sim.DIFF1_TARGET * divisor // 256
+        nonces = set()
+        rolled = set()
+        for frame in self.receive(8, timeout=60):
+            self.assertEqual(8, frame[7] & 0xF8)
+            version_bits = ((frame[8] << 8) | frame[9]) << 13
+            nonce = struct.unpack_from('<I', frame, 2)[0]
+            digest = job.hash(0x20000000 | version_bits, nonce)
+            self.assertLessEqual(int.from_bytes(digest, 'little'), target)
+            self.assertLess((nonce & 0xFF) >> 1, sim.MODELS['BM1366'].cores)
+            nonces.add((version_bits, nonce))
+            rolled.add(version_bits)
+        self.assertEqual(8, len(nonces))
+        self.assertGreater(len(rolled), 1)
+
+    def dispatch(self, job_id, starting_nonce, count):
+        """Sends the test header as job job_id and collects the nonces of its first count results"""
+        self.send(job_frame(job_id, starting_nonce, merkle_root=bytes(range(32))))
+        nonces = []
+        while len(nonces) < count:
+            for frame in self.receive(1, timeout=60):
+                # results of the job before may still be on their way
+                if frame[10] & sim.RESPONSE_JOB and frame[7] & 0xF8 == job_id:
+                    nonces.append(struct.unpack_from('<I', frame, 2)[0])
+        return nonces
+
+    def test_resent_header_searches_fresh_nonces_from_the_next_subrange(self):
+        # the same header dispatched again, as when a pool resends a notify unchanged
+        self.start('BM1366', 1, 1 << 24)
+        self.enumerate(1)
+        self.send(write_all(sim.REG_TICKET_MASK, ticket_mask(256)))
+
+        first = self.dispatch(8, 0, 6)
+        # started at nonce 0 again, the chain finds the very same results
+        self.assertEqual(first, self.dispatch(16, 0, 6))
+        # where nonce_schedule_next() starts its second dispatch of the header, none of them
+        resent = self.dispatch(24, 1 << 28, 6)
+        self.assertEqual(6, len(set(resent)))
+        self.assertFalse(set(first) & set(resent))
+        self.assertTrue(all(nonce >= 1 << 28 for nonce in resent))
+
+    def test_error_curve_corrupts_the_results_of_one_chip(self):
+        divisor = 1 << 24
+        self.sim = sim.Simulator(sim.MODELS['BM1366'], 2, difficulty_divisor=divisor,
+                                 error_curves={1: [(400, 0.0), (500, 1.0)]}, seed=1)
+        self.sim.start()
+        self.port = os.open(self.sim.port, os.O_RDWR | os.O_NOCTTY)
+        self.buffer = b''
+        self.addCleanup(self.stop)
+        self.enumerate(2)
+
+        # 25MHz * 160 / (2 * 4 * 1): 500MHz on the second chip alone, 400MHz on the first
+        self.send(write_all(sim.REG_PLL0_PARAMETER, [0x40, 128, 2, 0x30]),
+                  command(0x41, [0x80, sim.REG_PLL0_PARAMETER, 0x40, 160, 2, 0x30]))
+        self.send(write_all(sim.REG_TICKET_MASK, ticket_mask(256)),
+                  job_frame(8, 0x12345600, merkle_root=bytes(range(32))))
+        job = sim.Job(job_frame(8, 0x12345600, merkle_root=bytes(range(32)))[4:-2])
+        target = sim.DIFF1_TARGET * divisor // 256
+
+        chips = set()
+        for frame in self.receive(16, timeout=60):
+            nonce = struct.unpack_from('<I', frame, 2)[0]
+            # the chip as bm13xx_decode_result() tells it: second nonce byte over the address interval
+            chip = frame[3] // 128
+            chips.add(chip)
+            if chip == 1:
+                # found, then garbled; the garbled nonce itself still meets the target one time in 256
+                nonce ^= 0x5A << 24
+            self.assertLessEqual(int.from_bytes(job.hash(GENESIS_VERSION, nonce), 'little'), target)
+        self.assertEqual({0, 1}, chips)
+        self.assertGreater(self.sim.stats['errors'], 0)
+
+        # the errors are counted by the chip that made them, as a broadcast read gets them back
+        self.send(command(0x52, [0x00, sim.REG_NONCE_ERROR_COUNTER]))
+        counters = {}
+        deadline = time.monotonic() + 10
+        while len(counters) < 2 and time.monotonic() < deadline:
+            for frame in self.receive(1):
+                if not frame[10] & sim.RESPONSE_JOB:
+                    self.assertEqual(sim.REG_NONCE_ERROR_COUNTER, frame[7])
+                    counters[frame[6]] = struct.unpack_from('>I', frame, 2)[0]
+        self.assertEqual(0, counters[0x00])
+        self.assertGreater(counters[0x80], 0)
+        self.assertLessEqual(counters[0x80], self.sim.stats['errors'])
+
+    def test_bad_crc_is_skipped(self):
+        self.start('BM1370', 1)
+        broken = bytearray(command(0x52, [0x00, 0x00]))
+        broken[-1] ^= 1
+        self.send(bytes(broken))
+        self.enumerate(1)
+        self.assertEqual(1, self.sim.stats['crc_errors'])
+
+
+if __name__ == '__main__':
+    unittest.main()
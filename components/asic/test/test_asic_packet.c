@@ -0,0 +1,179 @@
+#include "unity.h"
+
+#include "asic_packet.h"
+#include "crc.h"
+#include "esp_timer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The bit-serial shift register crc5 was computed with before it went table driven
+static uint8_t legacy_crc5(const uint8_t * data, uint8_t len)
+{
+    uint8_t crcin[5] = {1, 1, 1, 1, 1};
+    uint8_t crcout[5];
+
+    for (int i = 0; i < len * 8; i++) {
+        uint8_t din = (data[i / 8] >> (7 - i % 8)) & 1;
+        crcout[0] = crcin[4] ^ din;
+        crcout[1] = crcin[0];
+        crcout[2] = crcin[1] ^ crcin[4] ^ din;
+        crcout[3] = crcin[2];
+        crcout[4] = crcin[3];
+        memcpy(crcin, crcout, 5);
+    }
+    return crcin[4] << 4 | crcin[3] << 3 | crcin[2] << 2 | crcin[1] << 1 | crcin[0];
+}
+
+static uint16_t bitwise_crc16(const uint8_t * data, uint16_t len, uint16_t crc)
+{
+    while (len-- > 0) {
+        crc ^= *data++ << 8;
+        for (int i = 0; i < 8; i++) {
+            crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+static uint32_t next(uint32_t * seed)
+{
+    *seed = *seed * 1664525 + 1013904223;
+    return *seed >> 24;
+}
+
+TEST_CASE("Table CRC5 matches the bit-serial CRC5", "[asic_packet]")
+{
+    uint32_t seed = 42;
+    uint8_t data[ASIC_PACKET_MAX_LEN];
+
+    for (int round = 0; round < 2000; round++) {
+        uint8_t len = next(&seed) % sizeof(data);
+        for (int i = 0; i < len; i++) {
+            data[i] = next(&seed);
+        }
+        TEST_ASSERT_EQUAL_HEX8(legacy_crc5(data, len), crc5(data, len));
+        TEST_ASSERT_EQUAL_HEX8(legacy_crc5(data, len), crc5_bits(data, len * 8));
+    }
+}
+
+TEST_CASE("CRC16 tables match the bitwise polynomial", "[asic_packet]")
+{
+    const uint8_t check[] = "123456789";
+    TEST_ASSERT_EQUAL_HEX16(0x29B1, crc16_false(check, 9));
+    TEST_ASSERT_EQUAL_HEX16(0x31C3, crc16(check, 9));
+
+    uint32_t seed = 7;
+    uint8_t data[ASIC_PACKET_MAX_LEN];
+    for (int round = 0; round < 500; round++) {
+        uint8_t len = next(&seed) % sizeof(data);
+        for (int i = 0; i < len; i++) {
+            data[i] = next(&seed);
+        }
+        TEST_ASSERT_EQUAL_HEX16(bitwise_crc16(data, len, 0xFFFF), crc16_false(data, len));
+        TEST_ASSERT_EQUAL_HEX16(bitwise_crc16(data, len, 0), crc16(data, len));
+    }
+}
+
+TEST_CASE("Packet builder reproduces known command frames", "[asic_packet]")
+{
+    // frames quoted in the drivers, sent as-is by _send_simple
+    static const uint8_t frames[][11] = {
+        {0x55, 0xAA, 0x51, 0x09, 0x00, 0xA8, 0x00, 0x07, 0x00, 0x00, 0x03},
+        {0x55, 0xAA, 0x51, 0x09, 0x00, 0x3C, 0x80, 0x00, 0x8B, 0x00, 0x12},
+        {0x55, 0xAA, 0x41, 0x09, 0x00, 0xA8, 0x00, 0x07, 0x01, 0xF0, 0x15},
+    };
+    uint8_t buf[ASIC_PACKET_MAX_LEN];
+
+    for (size_t i = 0; i < sizeof(frames) / sizeof(frames[0]); i++) {
+        TEST_ASSERT_EQUAL(11, asic_packet_build(buf, frames[i][2], frames[i] + 4, 6));
+        TEST_ASSERT_EQUAL_HEX8_ARRAY(frames[i], buf, 11);
+    }
+
+    const uint8_t read_chip_id[] = {0x55, 0xAA, 0x52, 0x05, 0x00, 0x00, 0x0A};
+    TEST_ASSERT_EQUAL(7, asic_packet_build(buf, 0x52, read_chip_id + 4, 2));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(read_chip_id, buf, 7);
+}
+
+TEST_CASE("Packet builder reproduces a BM1397 job frame", "[asic_packet]")
+{
+    // job cmd from components/stratum/test/verifiers/bm1397.py, zero padded after the midstate
+    static const uint8_t payload[] = {0x04, 0x04, 0x00, 0x00, 0x00, 0x00, 0x01, 0xDD, 0x05, 0x17, 0xD8, 0x8B,
+                                      0x65, 0x64, 0xC6, 0x04, 0xA8, 0x46, 0x4D, 0x31, 0x85, 0xF2, 0x5F, 0x7D,
+                                      0x5D, 0xE0, 0xE3, 0x59, 0x17, 0x41, 0xCB, 0x21, 0xCA, 0xE1, 0x15, 0x74,
+                                      0xDD, 0xD6, 0x5D, 0x49, 0x0D, 0x3D, 0x68, 0x73, 0x9F, 0x8A, 0x52, 0xEA,
+                                      0xDF, 0x91};
+    uint8_t data[ASIC_PACKET_MAX_DATA] = {0};
+    memcpy(data, payload, sizeof(payload));
+
+    uint8_t buf[ASIC_PACKET_MAX_LEN];
+    TEST_ASSERT_EQUAL(ASIC_PACKET_MAX_LEN, asic_packet_build(buf, 0x21, data, sizeof(data)));
+    TEST_ASSERT_EQUAL_HEX8(0x55, buf[0]);
+    TEST_ASSERT_EQUAL_HEX8(0xAA, buf[1]);
+    TEST_ASSERT_EQUAL_HEX8(0x21, buf[2]);
+    TEST_ASSERT_EQUAL_HEX8(0x96, buf[3]);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(data, buf + 4, sizeof(data));
+    TEST_ASSERT_EQUAL_HEX8(0x6B, buf[ASIC_PACKET_MAX_LEN - 2]);
+    TEST_ASSERT_EQUAL_HEX8(0x1D, buf[ASIC_PACKET_MAX_LEN - 1]);
+}
+
+TEST_CASE("Packet builder and CRC throughput", "[asic_packet][bench]")
+{
+    const int iterations = 20000;
+    uint8_t data[ASIC_PACKET_MAX_DATA];
+    uint8_t buf[ASIC_PACKET_MAX_LEN];
+    uint32_t seed = 1;
+    volatile uint32_t sink = 0;
+
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = next(&seed);
+    }
+
+    // the old path: allocate, frame, crc, free
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < iterations; i++) {
+        data[0] = i;
+        uint8_t * frame = malloc(sizeof(data) + 6);
+        frame[0] = 0x55;
+        frame[1] = 0xAA;
+        frame[2] = 0x21;
+        frame[3] = sizeof(data) + 4;
+        memcpy(frame + 4, data, sizeof(data));
+        uint16_t crc = crc16_false(frame + 2, sizeof(data) + 2);
+        frame[4 + sizeof(data)] = crc >> 8;
+        frame[5 + sizeof(data)] = crc & 0xFF;
+        sink += frame[5 + sizeof(data)];
+        free(frame);
+    }
+    int64_t malloc_us = esp_timer_get_time() - start;
+
+    start = esp_timer_get_time();
+    for (int i = 0; i < iterations; i++) {
+        data[0] = i;
+        sink += buf[asic_packet_build(buf, 0x21, data, sizeof(data)) - 1];
+    }
+    int64_t build_us = esp_timer_get_time() - start;
+
+    printf("job frames: malloc %.0f/s, in place %.0f/s\n", iterations * 1e6 / (malloc_us ? malloc_us : 1),
+           iterations * 1e6 / (build_us ? build_us : 1));
+
+    start = esp_timer_get_time();
+    for (int i = 0; i < iterations; i++) {
+        data[0] = i;
+        sink += legacy_crc5(data, sizeof(data));
+    }
+    int64_t legacy_us = esp_timer_get_time() - start;
+
+    start = esp_timer_get_time();
+    for (int i = 0; i < iterations; i++) {
+        data[0] = i;
+        sink += crc5(data, sizeof(data));
+    }
+    int64_t table_us = esp_timer_get_time() - start;
+
+    double bytes = (double) iterations * sizeof(data);
+    printf("crc5: bit-serial %.2f MB/s, table %.2f MB/s\n", bytes / (legacy_us ? legacy_us : 1),
+           bytes / (table_us ? table_us : 1));
+    TEST_ASSERT_TRUE(sink != 0);
+}
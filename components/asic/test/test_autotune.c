@@ -0,0 +1,146 @@
+#include "unity.h"
+
+#include "autotune.h"
+
+#include <string.h>
+
+// Window of 100 results, at most 2% errors, 500-600MHz in 25MHz steps
+static const autotune_config config = {
+    .min_mhz = 500,
+    .max_mhz = 600,
+    .step_mhz = 25,
+    .window_results = 100,
+    .window_timeout_ms = 600000,
+    .max_error_rate = 0.02,
+};
+
+// Hardware errors per 1000 results of a chip at a frequency: none up to its knee, then rising fast
+static int errors_per_mille(float knee_mhz, float frequency)
+{
+    return frequency <= knee_mhz ? 0 : (int) (frequency - knee_mhz) * 4;
+}
+
+// Feeds every chip one window of 100 results at its frequency, 10 seconds long, and steps the tuner
+static uint32_t run_window(autotune * tuner, const float * knees, uint32_t now_ms, bool allow_up)
+{
+    for (int i = 0; i < tuner->chip_count; i++) {
+        int errors = errors_per_mille(knees[i], tuner->chips[i].frequency) / 10;
+        for (int n = 0; n < 100; n++) {
+            autotune_record(tuner, i, n >= errors);
+        }
+    }
+    now_ms += 10000;
+    autotune_step(tuner, now_ms, allow_up);
+    for (int i = 0; i < tuner->chip_count; i++) {
+        tuner->chips[i].changed = false;
+    }
+    return now_ms;
+}
+
+TEST_CASE("Autotune settles each chip below its own error knee", "[autotune]")
+{
+    autotune tuner;
+    TEST_ASSERT_TRUE(autotune_init(&tuner, &config, 3, 500, 0));
+
+    // chip 0 fails above 540MHz, chip 1 above 565MHz, chip 2 never within range
+    const float knees[] = {540, 565, 1000};
+    uint32_t now_ms = 0;
+    for (int w = 0; w < 10; w++) {
+        now_ms = run_window(&tuner, knees, now_ms, true);
+    }
+
+    TEST_ASSERT_EQUAL(AUTOTUNE_STABLE, tuner.chips[0].state);
+    TEST_ASSERT_EQUAL_FLOAT(525, tuner.chips[0].frequency);
+    TEST_ASSERT_EQUAL(AUTOTUNE_STABLE, tuner.chips[1].state);
+    TEST_ASSERT_EQUAL_FLOAT(550, tuner.chips[1].frequency);
+    TEST_ASSERT_EQUAL(AUTOTUNE_STABLE, tuner.chips[2].state);
+    TEST_ASSERT_EQUAL_FLOAT(600, tuner.chips[2].frequency);
+    TEST_ASSERT_EQUAL(1, tuner.chips[0].failed_windows);
+    TEST_ASSERT_EQUAL(0, tuner.chips[2].failed_windows);
+    TEST_ASSERT_TRUE(tuner.settled);
+
+    // results from chips past the chain are ignored
+    autotune_record(&tuner, 3, false);
+    TEST_ASSERT_EQUAL(0, tuner.chips[2].errors);
+    TEST_ASSERT_EQUAL_FLOAT(600, autotune_max_frequency(&tuner, 500));
+}
+
+TEST_CASE("Autotune steps down a chip whose nonce rate drops", "[autotune]")
+{
+    autotune tuner;
+    TEST_ASSERT_TRUE(autotune_init(&tuner, &config, 1, 500, 0));
+
+    // a healthy window: 100 results in 10 seconds
+    for (int n = 0; n < 100; n++) {
+        autotune_record(&tuner, 0, true);
+    }
+    TEST_ASSERT_EQUAL(1, autotune_step(&tuner, 10000, true));
+    TEST_ASSERT_EQUAL_FLOAT(525, tuner.chips[0].frequency);
+
+    // not due before its window is full
+    TEST_ASSERT_EQUAL(0, autotune_step(&tuner, 11000, true));
+
+    // no errors, but half its cores stopped: 100 results take 20 seconds at a higher frequency
+    for (int n = 0; n < 100; n++) {
+        autotune_record(&tuner, 0, true);
+    }
+    TEST_ASSERT_EQUAL(1, autotune_step(&tuner, 30000, true));
+    TEST_ASSERT_EQUAL(AUTOTUNE_CONFIRMING, tuner.chips[0].state);
+    TEST_ASSERT_EQUAL_FLOAT(500, tuner.chips[0].frequency);
+    TEST_ASSERT_EQUAL_FLOAT(525, tuner.chips[0].previous_frequency);
+
+    // a chip that stopped answering fails when its window times out
+    TEST_ASSERT_EQUAL(0, autotune_step(&tuner, 30000 + config.window_timeout_ms - 1, true));
+    autotune_step(&tuner, 30000 + config.window_timeout_ms, true);
+    TEST_ASSERT_EQUAL(AUTOTUNE_CONFIRMING, tuner.chips[0].state);
+    TEST_ASSERT_EQUAL_FLOAT(config.min_mhz, tuner.chips[0].frequency);
+    TEST_ASSERT_EQUAL(2, tuner.chips[0].failed_windows);
+}
+
+TEST_CASE("Autotune holds climbing chips when told to", "[autotune]")
+{
+    autotune tuner;
+    TEST_ASSERT_TRUE(autotune_init(&tuner, &config, 2, 500, 0));
+
+    const float knees[] = {1000, 1000};
+    uint32_t now_ms = run_window(&tuner, knees, 0, false);
+    TEST_ASSERT_EQUAL_FLOAT(500, tuner.chips[0].frequency);
+    TEST_ASSERT_EQUAL(AUTOTUNE_CLIMBING, tuner.chips[0].state);
+
+    run_window(&tuner, knees, now_ms, true);
+    TEST_ASSERT_EQUAL_FLOAT(525, tuner.chips[0].frequency);
+    TEST_ASSERT_EQUAL_FLOAT(525, tuner.chips[1].frequency);
+}
+
+TEST_CASE("Autotune profiles round trip through their NVS string", "[autotune]")
+{
+    autotune tuner;
+    TEST_ASSERT_TRUE(autotune_init(&tuner, &config, 3, 500, 0));
+    TEST_ASSERT_FALSE(autotune_init(&tuner, &config, AUTOTUNE_MAX_CHIPS + 1, 500, 0));
+    TEST_ASSERT_EQUAL(0, tuner.chip_count);
+    TEST_ASSERT_EQUAL_FLOAT(500, autotune_max_frequency(&tuner, 500));
+
+    TEST_ASSERT_TRUE(autotune_init(&tuner, &config, 3, 500, 0));
+    const float saved[] = {512.5, 700, 450};
+    autotune_restore(&tuner, saved, 0);
+    TEST_ASSERT_EQUAL(AUTOTUNE_STABLE, tuner.chips[0].state);
+    // clamped to the range of the current base frequency
+    TEST_ASSERT_EQUAL_FLOAT(600, tuner.chips[1].frequency);
+    TEST_ASSERT_EQUAL_FLOAT(500, tuner.chips[2].frequency);
+
+    char profile[64];
+    TEST_ASSERT_EQUAL(strlen("512.50,600.00,500.00"), autotune_format_profile(&tuner, profile, sizeof(profile)));
+    TEST_ASSERT_EQUAL_STRING("512.50,600.00,500.00", profile);
+
+    float frequencies[AUTOTUNE_MAX_CHIPS];
+    TEST_ASSERT_EQUAL(3, autotune_parse_profile(profile, frequencies, AUTOTUNE_MAX_CHIPS));
+    TEST_ASSERT_EQUAL_FLOAT(512.5, frequencies[0]);
+    TEST_ASSERT_EQUAL_FLOAT(500, frequencies[2]);
+
+    TEST_ASSERT_EQUAL(0, autotune_parse_profile("", frequencies, AUTOTUNE_MAX_CHIPS));
+    TEST_ASSERT_EQUAL(0, autotune_parse_profile("512.5,x", frequencies, AUTOTUNE_MAX_CHIPS));
+    TEST_ASSERT_EQUAL(0, autotune_parse_profile("512.5;600", frequencies, AUTOTUNE_MAX_CHIPS));
+
+    // too short for the whole profile: stops at the last chip that fits
+    TEST_ASSERT_EQUAL(strlen("512.50"), autotune_format_profile(&tuner, profile, 10));
+}
@@ -0,0 +1,424 @@
+#include "unity.h"
+
+#include "bm1366.h"
+#include "bm1368.h"
+#include "bm1370.h"
+#include "bm1397.h"
+#include "bm13xx.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static uint8_t tx[1024];
+static int tx_len;
+// bumped on every frame sent while set, as if each PLL step brought back a bad nonce
+static volatile uint32_t hardware_errors;
+static bool error_per_frame;
+static uint8_t reply[11];
+static int replies_left;
+
+static int capture_send(uint8_t * data, int len, bool debug)
+{
+    if (tx_len + len <= (int) sizeof(tx)) {
+        memcpy(tx + tx_len, data, len);
+        tx_len += len;
+    }
+    if (error_per_frame) {
+        hardware_errors++;
+    }
+    return len;
+}
+
+// answers the chip id read with `replies_left` copies of `reply`
+static int16_t scripted_receive(uint8_t * buf, uint16_t size, uint16_t timeout_ms)
+{
+    if (replies_left == 0) {
+        return 0;
+    }
+    replies_left--;
+    memcpy(buf, reply, size < sizeof(reply) ? size : sizeof(reply));
+    return size;
+}
+
+static const bm13xx_transport capture_transport = {capture_send, scripted_receive};
+
+static void capture(const bm13xx_chip * chip, int chips)
+{
+    memset(reply, 0, sizeof(reply));
+    reply[0] = 0xAA;
+    reply[1] = 0x55;
+    reply[2] = chip->chip_id >> 8;
+    reply[3] = chip->chip_id & 0xFF;
+    replies_left = chips;
+    tx_len = 0;
+    bm13xx_set_transport(&capture_transport);
+}
+
+static int hex_to_bytes(const char * hex, uint8_t * out)
+{
+    int len = 0;
+    for (; hex[0] && hex[1]; hex += 2) {
+        unsigned int byte;
+        sscanf(hex, "%2x", &byte);
+        out[len++] = byte;
+    }
+    return len;
+}
+
+static void assert_sent(const char * hex)
+{
+    static uint8_t expected[sizeof(tx)];
+    int len = hex_to_bytes(hex, expected);
+    TEST_ASSERT_EQUAL(len, tx_len);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, tx, len);
+    tx_len = 0;
+}
+
+TEST_CASE("BM1397 init sends the frames of the hand written driver", "[bm13xx]")
+{
+    capture(&BM1397_CHIP, 2);
+    TEST_ASSERT_EQUAL(2, BM1397_init(150, 2));
+    // read chip id, chain inactive, addresses 00 and 80, init1-6 with the ticket mask, baud, then the PLL twice over
+    assert_sent("55AA520500000A" "55AA5305000003" "55AA400500001C" "55AA4005800010"
+                "55AA51090080000000001C" "55AA510900840000000011" "55AA510900200000000102" "55AA5109003C8000807410"
+                "55AA51090014000000FF08" "55AA51090068C070011100" "55AA510900280600000F18" "55AA5109001800007A3115"
+                "55AA510900700F0F0F0019" "55AA510900700F0F0F0019" "55AA5109000840B402351A" "55AA5109000840B402351A");
+}
+
+static void fill_job(bm_job * job, uint8_t seed)
+{
+    memset(job, 0, sizeof(*job));
+    job->version = 0x20000000;
+    job->target = 0x17034219;
+    job->ntime = 0x66A1B2C3 + seed;
+    for (int i = 0; i < 32; i++) {
+        job->merkle_root_be[i] = i * 7 + seed;
+        job->prev_block_hash_be[i] = 0xFF - i * 3;
+    }
+}
+
+// three jobs under the ids send_work gives them, each a fresh header the nonce schedule starts at 0
+static void send_jobs(const bm13xx_chip * chip)
+{
+    bm_job job;
+    for (uint8_t seed = 0; seed < 3; seed++) {
+        fill_job(&job, seed);
+        bm13xx_send_job(chip, bm13xx_next_job_id(chip), &job);
+    }
+}
+
+TEST_CASE("BM1366 init and jobs send the frames of the hand written driver", "[bm13xx]")
+{
+    capture(&BM1366_CHIP, 2);
+    TEST_ASSERT_EQUAL(2, BM1366_init(150, 2));
+    // version mask three times, read chip id, chain inactive, addresses 00 and 80, core and UART
+    // setup, each chip's registers, the PLL ramp to 150MHz, hash counting, the version mask again
+    assert_sent("55AA510900A49000FFFF1C" "55AA510900A49000FFFF1C" "55AA510900A49000FFFF1C" "55AA520500000A"
+                "55AA510900A80007000003" "55AA51090018FF0FC10000" "55AA5305000003" "55AA400500001C" "55AA4005800010"
+                "55AA5109003C800085400C" "55AA5109003C8000802019" "55AA51090014000000FF08" "55AA51090054000000031D"
+                "55AA510900580211111106" "55AA4109002C007C000303" "55AA410900A8000701F015" "55AA41090018F000C1000C"
+                "55AA4109003C8000854004" "55AA4109003C8000802011" "55AA4109003C800082AA05" "55AA410980A8000701F00D"
+                "55AA41098018F000C10014" "55AA4109803C800085401C" "55AA4109803C8000802009" "55AA4109803C800082AA1D"
+                "55AA5109000840AF026408" "55AA5109000840A8026311" "55AA510900084093026209" "55AA5109000840A8026214"
+                "55AA5109000840BD02621A" "55AA5109000850D202621E" "55AA51090008409A026100" "55AA5109000840A802611B"
+                "55AA5109000840A802611B" "55AA510900100000151C02" "55AA510900A49000FFFF1C");
+
+    send_jobs(&BM1366_CHIP);
+    assert_sent("55AA215608010000000019420317C3B2A16600070E151C232A31383F464D545B626970777E858C939AA1A8AF"
+                "B6BDC4CBD2D9FFFCF9F6F3F0EDEAE7E4E1DEDBD8D5D2CFCCC9C6C3C0BDBAB7B4B1AEABA8A5A200000020451D"
+                "55AA215610010000000019420317C4B2A16601080F161D242B323940474E555C636A71787F868D949BA2A9B0"
+                "B7BEC5CCD3DAFFFCF9F6F3F0EDEAE7E4E1DEDBD8D5D2CFCCC9C6C3C0BDBAB7B4B1AEABA8A5A2000000207C4C"
+                "55AA215618010000000019420317C5B2A166020910171E252C333A41484F565D646B727980878E959CA3AAB1"
+                "B8BFC6CDD4DBFFFCF9F6F3F0EDEAE7E4E1DEDBD8D5D2CFCCC9C6C3C0BDBAB7B4B1AEABA8A5A2000000201360");
+}
+
+TEST_CASE("BM1368 init and jobs send the frames of the hand written driver", "[bm13xx]")
+{
+    capture(&BM1368_CHIP, 2);
+    TEST_ASSERT_EQUAL(2, BM1368_init(150, 2));
+    // version mask four times, read chip id, chain inactive, core and UART setup, addresses 00 and
+    // 80, each chip's registers, difficulty, the PLL ramp to 150MHz, hash counting, version mask
+    assert_sent("55AA510900A49000FFFF1C" "55AA510900A49000FFFF1C" "55AA510900A49000FFFF1C" "55AA510900A49000FFFF1C"
+                "55AA520500000A" "55AA5305000003" "55AA510900A80007000003" "55AA51090018FF0FC10000"
+                "55AA5109003C80008B0012" "55AA5109003C800080181F" "55AA51090014000000FF08" "55AA51090054000000031D"
+                "55AA510900580211111106" "55AA400500001C" "55AA4005800010" "55AA410900A8000701F015"
+                "55AA41090018F000C1000C" "55AA4109003C80008B001A" "55AA4109003C8000801817" "55AA4109003C800082AA05"
+                "55AA410980A8000701F00D" "55AA41098018F000C10014" "55AA4109803C80008B0002" "55AA4109803C800080180F"
+                "55AA4109803C800082AA1D" "55AA51090014000000FF08" "55AA51090008409602540B" "55AA51090008409002530A"
+                "55AA510900084093026209" "55AA51090008409002520F" "55AA5109000840A2025214" "55AA51090008409602420F"
+                "55AA51090008409A026100" "55AA510900084090025100" "55AA510900084090025100" "55AA51090010000015A40A"
+                "55AA510900A49000FFFF1C");
+
+    send_jobs(&BM1368_CHIP);
+    assert_sent("55AA215618010000000019420317C3B2A16600070E151C232A31383F464D545B626970777E858C939AA1A8AF"
+                "B6BDC4CBD2D9FFFCF9F6F3F0EDEAE7E4E1DEDBD8D5D2CFCCC9C6C3C0BDBAB7B4B1AEABA8A5A20000002096E8"
+                "55AA215630010000000019420317C4B2A16601080F161D242B323940474E555C636A71787F868D949BA2A9B0"
+                "B7BEC5CCD3DAFFFCF9F6F3F0EDEAE7E4E1DEDBD8D5D2CFCCC9C6C3C0BDBAB7B4B1AEABA8A5A200000020CB87"
+                "55AA215648010000000019420317C5B2A166020910171E252C333A41484F565D646B727980878E959CA3AAB1"
+                "B8BFC6CDD4DBFFFCF9F6F3F0EDEAE7E4E1DEDBD8D5D2CFCCC9C6C3C0BDBAB7B4B1AEABA8A5A200000020BF22");
+}
+
+TEST_CASE("BM1370 init and jobs send the frames of the hand written driver", "[bm13xx]")
+{
+    capture(&BM1370_CHIP, 2);
+    TEST_ASSERT_EQUAL(2, BM1370_init(150, 2));
+    // version mask, read chip id, chain inactive, addresses 00 and 80, core and UART setup, each
+    // chip's registers, IO drive strength, the PLL ramp to 150MHz and the hash counting number
+    assert_sent("55AA510900A49000FFFF1C" "55AA510900A49000FFFF1C" "55AA510900A49000FFFF1C" "55AA520500000A"
+                "55AA510900A49000FFFF1C" "55AA510900A80007000003" "55AA51090018F000C10004" "55AA5305000003"
+                "55AA400500001C" "55AA4005800010" "55AA5109003C80008B0012" "55AA5109003C8000800C11"
+                "55AA51090014000000FF08" "55AA51090058000111110D" "55AA410900A8000701F015" "55AA41090018F000C1000C"
+                "55AA4109003C80008B001A" "55AA4109003C8000800C19" "55AA4109003C800082AA05" "55AA410980A8000701F00D"
+                "55AA41098018F000C10014" "55AA4109803C80008B0002" "55AA4109803C8000800C01" "55AA4109803C800082AA1D"
+                "55AA510900B9000044800D" "55AA510900540000000218" "55AA510900B9000044800D" "55AA5109003C80008DEE1B"
+                "55AA5109000840A202550F" "55AA5109000840AF026408" "55AA5109000840A8026311" "55AA5109000840A802531A"
+                "55AA5109000840A8026214" "55AA5109000840A2025214" "55AA5109000840B4025217" "55AA5109000840A502420C"
+                "55AA5109000840A802611B" "55AA5109001000001EB50F");
+
+    send_jobs(&BM1370_CHIP);
+    assert_sent("55AA215618010000000019420317C3B2A16600070E151C232A31383F464D545B626970777E858C939AA1A8AF"
+                "B6BDC4CBD2D9FFFCF9F6F3F0EDEAE7E4E1DEDBD8D5D2CFCCC9C6C3C0BDBAB7B4B1AEABA8A5A20000002096E8"
+                "55AA215630010000000019420317C4B2A16601080F161D242B323940474E555C636A71787F868D949BA2A9B0"
+                "B7BEC5CCD3DAFFFCF9F6F3F0EDEAE7E4E1DEDBD8D5D2CFCCC9C6C3C0BDBAB7B4B1AEABA8A5A200000020CB87"
+                "55AA215648010000000019420317C5B2A166020910171E252C333A41484F565D646B727980878E959CA3AAB1"
+                "B8BFC6CDD4DBFFFCF9F6F3F0EDEAE7E4E1DEDBD8D5D2CFCCC9C6C3C0BDBAB7B4B1AEABA8A5A200000020BF22");
+}
+
+TEST_CASE("BM13xx init addresses every detected chip", "[bm13xx]")
+{
+    capture(&BM1368_CHIP, 2);
+    TEST_ASSERT_EQUAL(2, BM1368_init(150, 2));
+
+    int set_address = 0, per_chip[2] = {0};
+    for (int i = 0; i < tx_len;) {
+        TEST_ASSERT_EQUAL_HEX8(0x55, tx[i]);
+        TEST_ASSERT_EQUAL_HEX8(0xAA, tx[i + 1]);
+        uint8_t header = tx[i + 2];
+        if (header == (BM13XX_TYPE_CMD | BM13XX_GROUP_SINGLE | BM13XX_CMD_SETADDRESS)) {
+            TEST_ASSERT_EQUAL_HEX8(set_address++ * 0x80, tx[i + 4]);
+        } else if (header == (BM13XX_TYPE_CMD | BM13XX_GROUP_SINGLE | BM13XX_CMD_WRITE)) {
+            TEST_ASSERT_TRUE(tx[i + 4] == 0x00 || tx[i + 4] == 0x80);
+            per_chip[tx[i + 4] >> 7]++;
+        }
+        i += tx[i + 3] + 2;
+    }
+    TEST_ASSERT_EQUAL(2, set_address);
+    TEST_ASSERT_EQUAL(5, per_chip[0]);
+    TEST_ASSERT_EQUAL(5, per_chip[1]);
+}
+
+TEST_CASE("BM13xx ramps one chip's PLL and attributes results to their chip", "[bm13xx]")
+{
+    capture(&BM1368_CHIP, 2);
+    TEST_ASSERT_EQUAL(2, BM1368_init(150, 2));
+    tx_len = 0;
+
+    // up from 150MHz in 6.25MHz steps, each written to the second chip alone
+    TEST_ASSERT_TRUE(BM1368_set_chip_frequency(1, 150, 162.5));
+    int writes = 0;
+    for (int i = 0; i < tx_len; i += tx[i + 3] + 2) {
+        TEST_ASSERT_EQUAL_HEX8(BM13XX_TYPE_CMD | BM13XX_GROUP_SINGLE | BM13XX_CMD_WRITE, tx[i + 2]);
+        TEST_ASSERT_EQUAL_HEX8(0x80, tx[i + 4]);
+        TEST_ASSERT_EQUAL_HEX8(0x08, tx[i + 5]);
+        writes++;
+    }
+    TEST_ASSERT_TRUE(writes >= 2);
+
+    // the second nonce byte falls in the address range of the chip that found it
+    bm13xx_result result;
+    const uint8_t first[] = {0xAA, 0x55, 0x18, 0x7F, 0xA3, 0x8C, 0x00, 0x35, 0x01, 0x23, 0x00};
+    const uint8_t second[] = {0xAA, 0x55, 0x18, 0x80, 0xA3, 0x8C, 0x00, 0x35, 0x01, 0x23, 0x00};
+    bm13xx_decode_result(&BM1368_CHIP, first, &result);
+    TEST_ASSERT_EQUAL(0, result.chip_index);
+    bm13xx_decode_result(&BM1368_CHIP, second, &result);
+    TEST_ASSERT_EQUAL(1, result.chip_index);
+}
+
+// PLL0 writes in what was sent, clearing it
+static int count_pll_writes(void)
+{
+    int writes = 0;
+    for (int i = 0; i < tx_len; i += tx[i + 3] + 2) {
+        if (tx[i + 5] == BM13XX_REG_PLL0_PARAMETER) {
+            writes++;
+        }
+    }
+    tx_len = 0;
+    return writes;
+}
+
+TEST_CASE("BM13xx PLL table matches the divider search", "[bm13xx]")
+{
+    const bm13xx_chip * chips[] = {&BM1366_CHIP, &BM1368_CHIP, &BM1370_CHIP};
+    uint8_t (*init[])(uint64_t, uint16_t) = {BM1366_init, BM1368_init, BM1370_init};
+
+    for (int c = 0; c < 3; c++) {
+        capture(chips[c], 1);
+        TEST_ASSERT_EQUAL(1, init[c](150, 1));
+        for (int step = 0; step < BM13XX_PLL_TABLE_STEPS; step++) {
+            uint8_t table[4], searched[4];
+            bool in_table = bm13xx_pll_lookup(chips[c], step * 6.25, table);
+            TEST_ASSERT_EQUAL(bm13xx_pll_find(chips[c], step * 6.25, searched), in_table);
+            if (in_table) {
+                TEST_ASSERT_EQUAL_HEX8_ARRAY(searched, table, 4);
+            }
+        }
+    }
+
+    // off the grid it searches
+    uint8_t value[4];
+    TEST_ASSERT_TRUE(bm13xx_pll_lookup(&BM1370_CHIP, 490, value));
+    TEST_ASSERT_EQUAL_HEX8(0xC4, value[1]);
+}
+
+TEST_CASE("BM13xx ramps in growing steps until bad nonces come back", "[bm13xx]")
+{
+    capture(&BM1368_CHIP, 1);
+    TEST_ASSERT_EQUAL(1, BM1368_init(150, 1));
+    bm13xx_set_error_counter(&hardware_errors);
+    tx_len = 0;
+
+    // 156.25, then 12.5MHz at a time to 200, and the target once more
+    TEST_ASSERT_TRUE(BM1368_set_frequency(200));
+    TEST_ASSERT_EQUAL(6, count_pll_writes());
+
+    // every step 6.25MHz when errors keep coming
+    error_per_frame = true;
+    TEST_ASSERT_TRUE(BM1368_set_frequency(250));
+    TEST_ASSERT_EQUAL(9, count_pll_writes());
+
+    // down again, the same way
+    TEST_ASSERT_TRUE(BM1368_set_frequency(200));
+    TEST_ASSERT_EQUAL(9, count_pll_writes());
+
+    error_per_frame = false;
+    bm13xx_set_error_counter(NULL);
+}
+
+static uint32_t read_back[2];
+
+static void store_read(void * ctx, uint8_t chip_index, uint8_t reg, uint32_t value)
+{
+    read_back[chip_index] = value;
+}
+
+TEST_CASE("BM13xx reads registers back through the result stream", "[bm13xx]")
+{
+    capture(&BM1370_CHIP, 2);
+    TEST_ASSERT_EQUAL(2, BM1370_init(150, 2));
+    tx_len = 0;
+
+    register_reads reads;
+    register_reads_init(&reads);
+    bm13xx_set_register_reads(&reads);
+
+    BM1370_read_register(REGISTER_READ_ALL, BM13XX_REG_NONCE_ERROR_COUNTER);
+    BM1370_read_register(0x80, BM13XX_REG_HASH_RATE);
+    assert_sent("55AA5205004C14" "55AA4205800416");
+
+    // each chip answers with its value, its address and the register
+    TEST_ASSERT_TRUE(register_reads_begin(&reads, REGISTER_READ_ALL, BM13XX_REG_NONCE_ERROR_COUNTER, 100, 0, store_read, NULL));
+    const uint8_t first[] = {0xAA, 0x55, 0x00, 0x00, 0x01, 0x02, 0x00, 0x4C, 0x00, 0x00, 0x00};
+    const uint8_t second[] = {0xAA, 0x55, 0x00, 0x00, 0x00, 0x07, 0x80, 0x4C, 0x00, 0x00, 0x00};
+    bm13xx_dispatch_register(&BM1370_CHIP, first);
+    bm13xx_dispatch_register(&BM1370_CHIP, second);
+    TEST_ASSERT_EQUAL_HEX32(0x0102, read_back[0]);
+    TEST_ASSERT_EQUAL_HEX32(0x07, read_back[1]);
+    TEST_ASSERT_EQUAL(2, reads.replies);
+
+    bm13xx_set_register_reads(NULL);
+    bm13xx_dispatch_register(&BM1370_CHIP, first);
+    TEST_ASSERT_EQUAL(2, reads.replies);
+}
+
+TEST_CASE("BM13xx init gives up when chips go missing", "[bm13xx]")
+{
+    capture(&BM1366_CHIP, 0);
+    TEST_ASSERT_EQUAL(0, BM1366_init(150, 1));
+
+    // the BM1368 wants every chip it was promised
+    capture(&BM1368_CHIP, 1);
+    TEST_ASSERT_EQUAL(0, BM1368_init(150, 2));
+
+    // replies from another chip type are not counted
+    capture(&BM1370_CHIP, 1);
+    reply[3] = 0x68;
+    TEST_ASSERT_EQUAL(0, BM1370_init(150, 1));
+}
+
+TEST_CASE("BM13xx PLL search follows the chip descriptor", "[bm13xx]")
+{
+    capture(&BM1366_CHIP, 0);
+    TEST_ASSERT_TRUE(bm13xx_send_frequency(&BM1366_CHIP, 600));
+    assert_sent("55AA5109000850C0023005");
+    TEST_ASSERT_TRUE(bm13xx_send_frequency(&BM1368_CHIP, 600));
+    assert_sent("55AA510900084090022009");
+    TEST_ASSERT_TRUE(bm13xx_send_frequency(&BM1370_CHIP, 525));
+    assert_sent("55AA5109000840A8023003");
+
+    // nothing in range hits 1MHz exactly, so nothing is written
+    TEST_ASSERT_FALSE(bm13xx_send_frequency(&BM1370_CHIP, 10));
+    TEST_ASSERT_EQUAL(0, tx_len);
+}
+
+TEST_CASE("BM13xx lays out jobs for both job formats", "[bm13xx]")
+{
+    bm_job job;
+    uint8_t * bytes = (uint8_t *) &job;
+    for (size_t i = 0; i < sizeof(job); i++) {
+        bytes[i] = i * 7 + 1;
+    }
+    job.num_midstates = 2;
+    job.starting_nonce = 0x11223344;
+
+    uint8_t out[sizeof(bm13xx_midstate_job)];
+    TEST_ASSERT_EQUAL(sizeof(bm13xx_header_job), bm13xx_build_job(&BM1368_CHIP, 24, &job, out));
+    bm13xx_header_job * header = (bm13xx_header_job *) out;
+    TEST_ASSERT_EQUAL(24, header->job_id);
+    TEST_ASSERT_EQUAL(1, header->num_midstates);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(&job.starting_nonce, header->starting_nonce, 4);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(&job.target, header->nbits, 4);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(job.merkle_root_be, header->merkle_root, 32);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(job.prev_block_hash_be, header->prev_block_hash, 32);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(&job.version, header->version, 4);
+
+    TEST_ASSERT_EQUAL(sizeof(bm13xx_midstate_job), bm13xx_build_job(&BM1397_CHIP, 8, &job, out));
+    bm13xx_midstate_job * midstates = (bm13xx_midstate_job *) out;
+    TEST_ASSERT_EQUAL(8, midstates->job_id);
+    TEST_ASSERT_EQUAL(2, midstates->num_midstates);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(job.merkle_root + 28, midstates->merkle4, 4);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(job.midstates, midstates->midstates, 2 * 32);
+    TEST_ASSERT_EACH_EQUAL_HEX8(0, midstates->midstates[2], 2 * 32);
+}
+
+TEST_CASE("BM13xx decodes results per chip", "[bm13xx]")
+{
+    bm13xx_result result;
+
+    // BM1370: job id in bits 4-7 of the id byte, shifted down one, small core in the low nibble
+    const uint8_t bm1370[] = {0xAA, 0x55, 0x18, 0x6F, 0xA3, 0x8C, 0x00, 0x35, 0x01, 0x23, 0x00};
+    bm13xx_decode_result(&BM1370_CHIP, bm1370, &result);
+    TEST_ASSERT_EQUAL(0x18, result.job_id);
+    TEST_ASSERT_EQUAL(0x05, result.small_core_id);
+    TEST_ASSERT_EQUAL(0x0C, result.core_id);
+    TEST_ASSERT_EQUAL_HEX32(0x8CA36F18, result.nonce);
+    TEST_ASSERT_EQUAL_HEX32(0x0123 << 13, result.version_bits);
+
+    // BM1397: nine bytes, the midstate in the low two bits and no version bits
+    const uint8_t bm1397[] = {0xAA, 0x55, 0x18, 0x6F, 0xA3, 0x8C, 0x02, 0x0E, 0x00};
+    bm13xx_decode_result(&BM1397_CHIP, bm1397, &result);
+    TEST_ASSERT_EQUAL(0x0C, result.job_id);
+    TEST_ASSERT_EQUAL(0x02, result.small_core_id);
+    TEST_ASSERT_EQUAL(0, result.version_bits);
+}
+
+TEST_CASE("BM13xx jobs cover every version the chip rolls", "[bm13xx]")
+{
+    TEST_ASSERT_EQUAL(1, bm13xx_job_versions(&BM1370_CHIP, 0));
+    TEST_ASSERT_EQUAL(1 << 16, bm13xx_job_versions(&BM1370_CHIP, 0x1fffe000));
+    TEST_ASSERT_EQUAL(1 << 8, bm13xx_job_versions(&BM1366_CHIP, 0x01fe0000));
+
+    // the BM1397 hashes one midstate per version
+    TEST_ASSERT_EQUAL(1, bm13xx_job_versions(&BM1397_CHIP, 0));
+    TEST_ASSERT_EQUAL(4, bm13xx_job_versions(&BM1397_CHIP, 0x1fffe000));
+}
@@ -0,0 +1,119 @@
+#include "unity.h"
+
+#include "core_stats.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+TEST_CASE("Core stats count results per small core", "[core_stats]")
+{
+    core_stats stats;
+    TEST_ASSERT_TRUE(core_stats_init(&stats, 4, 2, 100));
+    TEST_ASSERT_EQUAL(8, stats.slots);
+
+    core_stats_record(&stats, 3, 1, 512.0, 101);
+    core_stats_record(&stats, 3, 1, 300.0, 102);
+    core_stats_record(&stats, 3, 1, 0.0, 103);
+    core_stats_record(&stats, 0, 0, 256.0, 104);
+
+    TEST_ASSERT_EQUAL(2, stats.valid[7]);
+    TEST_ASSERT_EQUAL(1, stats.invalid[7]);
+    TEST_ASSERT_EQUAL_FLOAT(512.0, stats.best_diff[7]);
+    TEST_ASSERT_EQUAL(103, stats.last_seen_s[7]);
+    TEST_ASSERT_EQUAL(3, stats.updated[7]);
+    TEST_ASSERT_EQUAL(1, stats.valid[0]);
+    TEST_ASSERT_EQUAL(0, stats.valid[1]);
+    TEST_ASSERT_EQUAL(4, stats.sequence);
+    TEST_ASSERT_EQUAL(4, stats.results);
+
+    // core ids past the layout are counted apart instead of landing in another slot
+    core_stats_record(&stats, 4, 0, 256.0, 105);
+    core_stats_record(&stats, 0, 2, 256.0, 105);
+    TEST_ASSERT_EQUAL(2, stats.unknown);
+    TEST_ASSERT_EQUAL(4, stats.results);
+
+    core_stats_record(&stats, 9, 0, 0.0, 106);
+    TEST_ASSERT_EQUAL(2, stats.errors);
+
+    free(stats.valid);
+}
+
+TEST_CASE("Core stats flag silent and erroring cores", "[core_stats]")
+{
+    core_stats stats;
+    TEST_ASSERT_TRUE(core_stats_init(&stats, 2, 2, 0));
+
+    // too few results to tell a silent core from an unlucky one
+    core_stats_record(&stats, 0, 0, 256.0, 10);
+    TEST_ASSERT_EQUAL(0, core_stats_check(&stats, 1000));
+
+    // a result a second from three slots, slot 3 never answers
+    for (uint32_t t = 1; t <= 99; t++) {
+        core_stats_record(&stats, (t % 3) / 2, (t % 3) % 2, 256.0, t);
+    }
+    // 100 results over 4 slots in 100s: one every 4s per slot, silent after 40s
+    TEST_ASSERT_EQUAL(1, core_stats_check(&stats, 100));
+    TEST_ASSERT_EQUAL_HEX8(CORE_STATS_SILENT, stats.flags[3]);
+    TEST_ASSERT_EQUAL_HEX8(0, stats.flags[0]);
+    TEST_ASSERT_EQUAL(1, stats.flagged);
+
+    // flagging again does not count as new
+    TEST_ASSERT_EQUAL(0, core_stats_check(&stats, 100));
+
+    // when it does answer, it is with nonces that miss the ticket difficulty
+    for (int i = 0; i < CORE_STATS_ERROR_MIN; i++) {
+        core_stats_record(&stats, 1, 1, 0.0, 100);
+    }
+    TEST_ASSERT_EQUAL(1, core_stats_check(&stats, 100));
+    TEST_ASSERT_EQUAL_HEX8(CORE_STATS_ERRORS, stats.flags[3]);
+    TEST_ASSERT_EQUAL(1, stats.flagged);
+
+    // the others went quiet for too long
+    core_stats_check(&stats, 1000);
+    TEST_ASSERT_EQUAL_HEX8(CORE_STATS_SILENT, stats.flags[0]);
+    TEST_ASSERT_EQUAL(4, stats.flagged);
+
+    free(stats.valid);
+}
+
+TEST_CASE("Core stats encode only the slots changed since a sequence", "[core_stats]")
+{
+    core_stats stats;
+    TEST_ASSERT_TRUE(core_stats_init(&stats, 2, 2, 0));
+
+    uint8_t out[128];
+    TEST_ASSERT_TRUE(core_stats_encode_size(&stats) <= sizeof(out));
+    TEST_ASSERT_EQUAL(0, core_stats_encode(&stats, 0, 5, out, sizeof(core_stats_header)));
+
+    core_stats_record(&stats, 1, 0, 1024.0, 3);
+    core_stats_record(&stats, 0, 1, 256.0, 4);
+    uint32_t since = stats.sequence;
+    core_stats_record(&stats, 1, 0, 0.0, 5);
+
+    core_stats_header header;
+    core_stats_entry entry;
+
+    size_t len = core_stats_encode(&stats, 0, 6, out, sizeof(out));
+    TEST_ASSERT_EQUAL(sizeof(header) + 2 * sizeof(entry), len);
+    memcpy(&header, out, sizeof(header));
+    TEST_ASSERT_EQUAL(3, header.sequence);
+    TEST_ASSERT_EQUAL(2, header.cores);
+    TEST_ASSERT_EQUAL(2, header.small_cores);
+    TEST_ASSERT_EQUAL(6, header.uptime_s);
+    TEST_ASSERT_EQUAL(2, header.count);
+
+    len = core_stats_encode(&stats, since, 6, out, sizeof(out));
+    TEST_ASSERT_EQUAL(sizeof(header) + sizeof(entry), len);
+    memcpy(&entry, out + sizeof(header), sizeof(entry));
+    TEST_ASSERT_EQUAL(2, entry.slot);
+    TEST_ASSERT_EQUAL(1, entry.valid);
+    TEST_ASSERT_EQUAL(1, entry.invalid);
+    TEST_ASSERT_EQUAL_FLOAT(1024.0, entry.best_diff);
+    TEST_ASSERT_EQUAL(5, entry.last_seen_s);
+
+    // nothing new after the latest sequence
+    len = core_stats_encode(&stats, stats.sequence, 6, out, sizeof(out));
+    TEST_ASSERT_EQUAL(sizeof(header), len);
+
+    free(stats.valid);
+}
@@ -0,0 +1,188 @@
+#include "unity.h"
+
+#include "crc.h"
+#include "frame_parser.h"
+
+#include <string.h>
+
+// Chip ID responses read off real chains
+static const uint8_t BM1368_CHIP_ID[11] = {0xAA, 0x55, 0x13, 0x68, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0F};
+static const uint8_t BM1397_CHIP_ID[9] = {0xAA, 0x55, 0x13, 0x97, 0x18, 0x00, 0x00, 0x00, 0x06};
+
+static void job_frame(uint8_t frame[11], uint32_t nonce, uint8_t job_id)
+{
+    frame[0] = 0xAA;
+    frame[1] = 0x55;
+    memcpy(frame + 2, &nonce, 4);
+    frame[6] = 0x00;
+    frame[7] = job_id;
+    frame[8] = 0x12;
+    frame[9] = 0x34;
+    frame[10] = ASIC_FRAME_JOB_RESPONSE;
+    frame[10] |= crc5_bits(frame + 2, 8 * 8 + 3);
+}
+
+typedef struct
+{
+    int jobs;
+    int registers;
+    uint32_t nonces[64];
+} parsed;
+
+static parsed feed(frame_parser * parser, const uint8_t * data, size_t len)
+{
+    parsed out = {0};
+    for (size_t i = 0; i < len; i++) {
+        asic_frame_type type = frame_parser_push(parser, data[i]);
+        if (type == ASIC_FRAME_JOB) {
+            if (out.jobs < 64) {
+                memcpy(&out.nonces[out.jobs], parser->buffer + 2, 4);
+            }
+            out.jobs++;
+        } else if (type == ASIC_FRAME_REGISTER) {
+            out.registers++;
+        }
+    }
+    return out;
+}
+
+TEST_CASE("Response CRC5 matches captured frames", "[frame_parser]")
+{
+    TEST_ASSERT_TRUE(frame_parser_check_crc(BM1368_CHIP_ID, sizeof(BM1368_CHIP_ID)));
+    TEST_ASSERT_TRUE(frame_parser_check_crc(BM1397_CHIP_ID, sizeof(BM1397_CHIP_ID)));
+
+    uint8_t corrupted[11];
+    memcpy(corrupted, BM1368_CHIP_ID, sizeof(corrupted));
+    corrupted[5] ^= 0x10;
+    TEST_ASSERT_FALSE(frame_parser_check_crc(corrupted, sizeof(corrupted)));
+
+    // on whole bytes the bit-length CRC is the command CRC
+    uint8_t command[4] = {0x52, 0x05, 0x00, 0x00};
+    TEST_ASSERT_EQUAL_HEX8(0x0A, crc5_bits(command, 32));
+    TEST_ASSERT_EQUAL_HEX8(crc5(command, 4), crc5_bits(command, 32));
+}
+
+TEST_CASE("Frame parser splits a clean stream", "[frame_parser]")
+{
+    uint8_t stream[11 * 6];
+    for (int i = 0; i < 5; i++) {
+        job_frame(stream + i * 11, 0x1000 + i, i * 8);
+    }
+    memcpy(stream + 55, BM1368_CHIP_ID, 11);
+
+    frame_parser parser;
+    frame_parser_init(&parser, 11);
+    parsed out = feed(&parser, stream, sizeof(stream));
+    TEST_ASSERT_EQUAL(5, out.jobs);
+    TEST_ASSERT_EQUAL(1, out.registers);
+    for (int i = 0; i < 5; i++) {
+        TEST_ASSERT_EQUAL_HEX32(0x1000 + i, out.nonces[i]);
+    }
+    TEST_ASSERT_EQUAL(0, parser.stats.dropped_bytes);
+    TEST_ASSERT_EQUAL(0, parser.stats.resyncs);
+    TEST_ASSERT_EQUAL(0, parser.stats.crc_errors);
+
+    frame_parser_init(&parser, 9);
+    out = feed(&parser, BM1397_CHIP_ID, sizeof(BM1397_CHIP_ID));
+    TEST_ASSERT_EQUAL(1, out.registers);
+}
+
+TEST_CASE("Frame parser skips stray bytes without losing frames", "[frame_parser]")
+{
+    uint8_t stream[128];
+    size_t len = 0;
+    const uint8_t noise[] = {0x00, 0x55, 0xAA, 0xAA, 0x13};
+
+    // a stray byte before the first frame, an AA AA run between two, and a tail of noise
+    stream[len++] = 0x7F;
+    job_frame(stream + len, 1, 0x08);
+    len += 11;
+    memcpy(stream + len, noise, sizeof(noise));
+    len += sizeof(noise);
+    job_frame(stream + len, 2, 0x10);
+    len += 11;
+    job_frame(stream + len, 3, 0x18);
+    len += 11;
+
+    frame_parser parser;
+    frame_parser_init(&parser, 11);
+    parsed out = feed(&parser, stream, len);
+    TEST_ASSERT_EQUAL(3, out.jobs);
+    TEST_ASSERT_EQUAL_HEX32(1, out.nonces[0]);
+    TEST_ASSERT_EQUAL_HEX32(2, out.nonces[1]);
+    TEST_ASSERT_EQUAL_HEX32(3, out.nonces[2]);
+    TEST_ASSERT_EQUAL(1 + sizeof(noise), parser.stats.dropped_bytes);
+    TEST_ASSERT_EQUAL(2, parser.stats.resyncs);
+    TEST_ASSERT_EQUAL(0, parser.stats.crc_errors);
+}
+
+TEST_CASE("Frame parser recovers from corrupted and truncated frames", "[frame_parser]")
+{
+    uint8_t stream[128];
+    size_t len = 0;
+
+    job_frame(stream + len, 1, 0x08);
+    stream[len + 4] ^= 0x01; // bit error inside the nonce
+    len += 11;
+    job_frame(stream + len, 2, 0x10);
+    len += 11;
+    job_frame(stream + len, 3, 0x18);
+    len += 6; // cut short, the next frame's preamble lands inside it
+    job_frame(stream + len, 4, 0x20);
+    len += 11;
+    job_frame(stream + len, 5, 0x28);
+    len += 11;
+
+    frame_parser parser;
+    frame_parser_init(&parser, 11);
+    parsed out = feed(&parser, stream, len);
+    TEST_ASSERT_EQUAL(3, out.jobs);
+    TEST_ASSERT_EQUAL_HEX32(2, out.nonces[0]);
+    TEST_ASSERT_EQUAL_HEX32(4, out.nonces[1]);
+    TEST_ASSERT_EQUAL_HEX32(5, out.nonces[2]);
+    TEST_ASSERT_EQUAL(2, parser.stats.crc_errors);
+    TEST_ASSERT_EQUAL(11 + 6, parser.stats.dropped_bytes);
+}
+
+TEST_CASE("Frame parser keeps every frame framed by noise without a preamble", "[frame_parser]")
+{
+    uint32_t seed = 12345;
+    uint8_t stream[4096];
+    size_t len = 0;
+    int frames = 0;
+    size_t noise_bytes = 0;
+
+    while (len + 11 + 8 < sizeof(stream)) {
+        seed = seed * 1664525 + 1013904223;
+        int noise = (seed >> 24) % 4;
+        for (int i = 0; i < noise; i++) {
+            seed = seed * 1664525 + 1013904223;
+            uint8_t byte = seed >> 24;
+            stream[len++] = byte == 0xAA ? 0xAB : byte;
+            noise_bytes++;
+        }
+        job_frame(stream + len, frames, frames & 0x78);
+        len += 11;
+        frames++;
+    }
+
+    frame_parser parser;
+    frame_parser_init(&parser, 11);
+    parsed out = feed(&parser, stream, len);
+    TEST_ASSERT_EQUAL(frames, out.jobs);
+    TEST_ASSERT_EQUAL(noise_bytes, parser.stats.dropped_bytes);
+
+    // random bytes dense in preambles only ever surface frames whose CRC checks out
+    for (size_t i = 0; i < sizeof(stream); i++) {
+        seed = seed * 1664525 + 1013904223;
+        stream[i] = (seed >> 29) == 0 ? 0xAA : (seed >> 29) == 1 ? 0x55 : seed >> 24;
+    }
+    frame_parser_init(&parser, 11);
+    for (size_t i = 0; i < sizeof(stream); i++) {
+        if (frame_parser_push(&parser, stream[i]) != ASIC_FRAME_NONE) {
+            TEST_ASSERT_TRUE(frame_parser_check_crc(parser.buffer, parser.frame_len));
+        }
+        TEST_ASSERT_TRUE(parser.fill < parser.frame_len);
+    }
+    TEST_ASSERT_TRUE(parser.stats.dropped_bytes > 0);
+}
@@ -0,0 +1,89 @@
+#include "unity.h"
+
+#include "frame_queue.h"
+
+#include <pthread.h>
+#include <string.h>
+
+static queued_frame numbered_frame(uint32_t n)
+{
+    queued_frame frame = {.type = ASIC_FRAME_JOB, .received_us = n};
+    memcpy(frame.frame + 2, &n, sizeof(n));
+    return frame;
+}
+
+static uint32_t frame_number(const queued_frame * frame)
+{
+    uint32_t n;
+    memcpy(&n, frame->frame + 2, sizeof(n));
+    return n;
+}
+
+TEST_CASE("Frame queue keeps order and counts drops", "[frame_queue]")
+{
+    static frame_queue queue;
+    frame_queue_init(&queue);
+    queued_frame frame;
+
+    TEST_ASSERT_FALSE(frame_queue_pop(&queue, &frame));
+    for (uint32_t n = 0; n < FRAME_QUEUE_SIZE + 3; n++) {
+        queued_frame pushed = numbered_frame(n);
+        TEST_ASSERT_EQUAL(n < FRAME_QUEUE_SIZE, frame_queue_push(&queue, &pushed));
+    }
+    TEST_ASSERT_EQUAL(FRAME_QUEUE_SIZE, frame_queue_count(&queue));
+    TEST_ASSERT_EQUAL(3, queue.drops);
+    TEST_ASSERT_EQUAL(FRAME_QUEUE_SIZE, queue.max_depth);
+
+    for (uint32_t n = 0; n < FRAME_QUEUE_SIZE; n++) {
+        TEST_ASSERT_TRUE(frame_queue_pop(&queue, &frame));
+        TEST_ASSERT_EQUAL_UINT32(n, frame_number(&frame));
+        TEST_ASSERT_EQUAL(n, frame.received_us);
+    }
+    TEST_ASSERT_FALSE(frame_queue_pop(&queue, &frame));
+    TEST_ASSERT_EQUAL(0, frame_queue_count(&queue));
+
+    // indexes keep running past the ring size
+    for (uint32_t n = 0; n < 1000; n++) {
+        queued_frame pushed = numbered_frame(n);
+        TEST_ASSERT_TRUE(frame_queue_push(&queue, &pushed));
+        TEST_ASSERT_TRUE(frame_queue_pop(&queue, &frame));
+        TEST_ASSERT_EQUAL_UINT32(n, frame_number(&frame));
+    }
+}
+
+#define STRESS_FRAMES 200000
+
+static frame_queue stress_queue;
+
+static void * stress_producer(void * arg)
+{
+    for (uint32_t n = 0; n < STRESS_FRAMES;) {
+        queued_frame frame = numbered_frame(n);
+        if (frame_queue_push(&stress_queue, &frame)) {
+            n++;
+        }
+    }
+    return NULL;
+}
+
+TEST_CASE("Frame queue hands frames between threads without a lock", "[frame_queue]")
+{
+    frame_queue_init(&stress_queue);
+    pthread_t producer;
+    pthread_create(&producer, NULL, stress_producer, NULL);
+
+    uint32_t expected = 0;
+    bool in_order = true;
+    while (expected < STRESS_FRAMES) {
+        queued_frame frame;
+        if (frame_queue_pop(&stress_queue, &frame)) {
+            in_order &= frame_number(&frame) == expected && frame.received_us == expected;
+            expected++;
+        }
+    }
+    pthread_join(producer, NULL);
+
+    TEST_ASSERT_TRUE(in_order);
+    TEST_ASSERT_EQUAL(0, frame_queue_count(&stress_queue));
+    TEST_ASSERT_TRUE(stress_queue.max_depth <= FRAME_QUEUE_SIZE);
+}
@@ -0,0 +1,83 @@
+#include "unity.h"
+
+#include "job_interval.h"
+
+TEST_CASE("Job interval covers the job's space at the chain's hashrate", "[job_interval]")
+{
+    job_interval interval;
+
+    // BM1397 at 400MHz with four midstates: 4 x 2^32 hashes at 268.8GH/s
+    job_interval_compute(&interval, 400, 672, 1, 4);
+    TEST_ASSERT_DOUBLE_WITHIN(1e3, 268.8e9, interval.hashrate);
+    TEST_ASSERT_DOUBLE_WITHIN(0.01, 63.91, interval.full_ms);
+    TEST_ASSERT_DOUBLE_WITHIN(0.01, 63.91 * JOB_INTERVAL_SAFETY, interval.interval_ms);
+
+    // the chips of a chain split the nonces, and a faster clock covers them sooner
+    job_interval_compute(&interval, 800, 672, 2, 4);
+    TEST_ASSERT_DOUBLE_WITHIN(0.01, 63.91 / 4, interval.full_ms);
+
+    // a BM1370 without version rolling runs through 2^32 nonces in a few milliseconds
+    job_interval_compute(&interval, 525, 2040, 1, 1);
+    TEST_ASSERT_DOUBLE_WITHIN(0.01, 4.01, interval.full_ms);
+    TEST_ASSERT_EQUAL_DOUBLE(JOB_INTERVAL_MIN_MS, interval.interval_ms);
+
+    // and takes minutes with all sixteen bits
+    job_interval_compute(&interval, 525, 2040, 1, 1 << 16);
+    TEST_ASSERT_GREATER_THAN(JOB_INTERVAL_MAX_MS, interval.full_ms);
+    TEST_ASSERT_EQUAL_DOUBLE(JOB_INTERVAL_MAX_MS, interval.interval_ms);
+
+    // no frequency yet
+    job_interval_compute(&interval, 0, 2040, 1, 1);
+    TEST_ASSERT_EQUAL_DOUBLE(JOB_INTERVAL_MAX_MS, interval.interval_ms);
+}
+
+TEST_CASE("Job coverage counts jobs left on past their space", "[job_interval]")
+{
+    job_interval interval;
+    job_coverage coverage = {0};
+    job_interval_compute(&interval, 400, 672, 1, 4);
+
+    TEST_ASSERT_DOUBLE_WITHIN(0.001, JOB_INTERVAL_SAFETY, job_coverage_record(&coverage, &interval, interval.interval_ms));
+    TEST_ASSERT_DOUBLE_WITHIN(0.001, 0.25, job_coverage_record(&coverage, &interval, interval.full_ms / 4));
+    TEST_ASSERT_DOUBLE_WITHIN(0.001, 2.0, job_coverage_record(&coverage, &interval, interval.full_ms * 2));
+
+    TEST_ASSERT_EQUAL(3, coverage.jobs);
+    TEST_ASSERT_EQUAL(1, coverage.overruns);
+    TEST_ASSERT_DOUBLE_WITHIN(0.001, 2.0, coverage.max_coverage);
+    TEST_ASSERT_DOUBLE_WITHIN(0.001, 2.0, coverage.last_coverage);
+    TEST_ASSERT_DOUBLE_WITHIN(0.001, JOB_INTERVAL_SAFETY + 2.25, coverage.coverage_sum);
+}
+
+TEST_CASE("Job queue holds a few seconds of work however long each job stays on", "[job_interval]")
+{
+    job_interval interval;
+
+    // BM1370 with all sixteen version bits: every job is on for the longest interval
+    job_interval_compute(&interval, 525, 2040, 1, 1 << 16);
+    TEST_ASSERT_EQUAL(1, job_interval_queue_depth(&interval, 10));
+
+    // BM1397 at 400MHz with four midstates, about 51ms a job
+    job_interval_compute(&interval, 400, 672, 1, 4);
+    TEST_ASSERT_EQUAL(10, job_interval_queue_depth(&interval, 10));
+
+    interval.interval_ms = 500;
+    TEST_ASSERT_EQUAL(6, job_interval_queue_depth(&interval, 10));
+    interval.interval_ms = 2000;
+    TEST_ASSERT_EQUAL(2, job_interval_queue_depth(&interval, 10));
+}
+
+TEST_CASE("Job coverage tracks how old the template is when a job reaches the chips", "[job_interval]")
+{
+    job_coverage coverage = {0};
+
+    job_coverage_record_age(&coverage, 40, true);
+    job_coverage_record_age(&coverage, 10040, false);
+    job_coverage_record_age(&coverage, 25, true);
+
+    TEST_ASSERT_EQUAL(3, coverage.templates);
+    TEST_ASSERT_EQUAL_DOUBLE(25, coverage.last_template_age_ms);
+    TEST_ASSERT_EQUAL_DOUBLE(10040, coverage.max_template_age_ms);
+    TEST_ASSERT_EQUAL_DOUBLE(10105, coverage.template_age_sum);
+    TEST_ASSERT_EQUAL_DOUBLE(25, coverage.notify_to_chip_ms);
+    TEST_ASSERT_EQUAL_DOUBLE(40, coverage.notify_to_chip_max_ms);
+}
@@ -0,0 +1,95 @@
+#include "unity.h"
+
+#include "nonce_schedule.h"
+
+#include <string.h>
+
+static bm_job make_job(uint8_t root, char * jobid)
+{
+    bm_job job;
+    memset(&job, 0, sizeof(job));
+    job.version = 0x20000000;
+    job.version_mask = 0x1fffe000;
+    job.merkle_root[0] = root;
+    job.ntime = 1700000000;
+    job.jobid = jobid;
+    return job;
+}
+
+TEST_CASE("Nonce schedule starts fresh headers at nonce 0", "[nonce_schedule]")
+{
+    nonce_schedule schedule;
+    nonce_schedule_init(&schedule);
+
+    char jobid[] = "1a";
+    for (int root = 0; root < 4; root++) {
+        bm_job job = make_job(root, jobid);
+        TEST_ASSERT_EQUAL_HEX32(0, nonce_schedule_next(&schedule, &job, 0.8));
+    }
+
+    // rolled ntime is another header
+    bm_job job = make_job(0, jobid);
+    job.ntime++;
+    TEST_ASSERT_EQUAL_HEX32(0, nonce_schedule_next(&schedule, &job, 0.8));
+    // a version that differs in the rolled bits only is the same header
+    job = make_job(0, jobid);
+    job.version = 0x20004000;
+    TEST_ASSERT_EQUAL_HEX32(0xD0000000, nonce_schedule_next(&schedule, &job, 0.8));
+
+    TEST_ASSERT_EQUAL(5, schedule.notify.headers);
+    TEST_ASSERT_EQUAL(6, schedule.notify.dispatches);
+    TEST_ASSERT_EQUAL(1, schedule.notify.repeats);
+    // only 3 of the 13 subranges it gets into were left
+    TEST_ASSERT_EQUAL(1, schedule.notify.overlaps);
+}
+
+TEST_CASE("Nonce schedule hands a repeated header the subranges after its last dispatch", "[nonce_schedule]")
+{
+    nonce_schedule schedule;
+    nonce_schedule_init(&schedule);
+
+    char jobid[] = "1a";
+    bm_job job = make_job(7, jobid);
+
+    // a quarter of the space per dispatch: four dispatches before any nonce comes round again
+    for (uint32_t i = 0; i < 4; i++) {
+        TEST_ASSERT_EQUAL_HEX32(i * 0x40000000, nonce_schedule_next(&schedule, &job, 0.25));
+    }
+    TEST_ASSERT_EQUAL(0, schedule.notify.overlaps);
+    TEST_ASSERT_EQUAL(NONCE_SCHEDULE_SUBRANGES, schedule.notify.assigned);
+
+    TEST_ASSERT_EQUAL_HEX32(0, nonce_schedule_next(&schedule, &job, 0.25));
+    TEST_ASSERT_EQUAL(1, schedule.notify.overlaps);
+    TEST_ASSERT_EQUAL(NONCE_SCHEDULE_SUBRANGES, schedule.notify.assigned);
+
+    // the pool resends the notify: the stats start again, the header keeps its place
+    char resent[] = "1b";
+    job.jobid = resent;
+    TEST_ASSERT_EQUAL_HEX32(0x40000000, nonce_schedule_next(&schedule, &job, 0.25));
+    TEST_ASSERT_EQUAL(5, schedule.last_notify.dispatches);
+    TEST_ASSERT_EQUAL(1, schedule.notify.dispatches);
+    TEST_ASSERT_EQUAL(1, schedule.notify.repeats);
+    TEST_ASSERT_EQUAL(6, schedule.total.dispatches);
+}
+
+TEST_CASE("Nonce schedule rounds partial subranges up and forgets the oldest header", "[nonce_schedule]")
+{
+    nonce_schedule schedule;
+    nonce_schedule_init(&schedule);
+
+    char jobid[] = "1a";
+    bm_job job = make_job(0, jobid);
+
+    // 80% of the space is 12.8 subranges, so the second dispatch starts at the 14th
+    TEST_ASSERT_EQUAL_HEX32(0, nonce_schedule_next(&schedule, &job, 0.8));
+    TEST_ASSERT_EQUAL_HEX32(13 * NONCE_SCHEDULE_SUBRANGE_SIZE, nonce_schedule_next(&schedule, &job, 0.8));
+    TEST_ASSERT_EQUAL(1, schedule.notify.overlaps);
+    // no coverage known yet counts as all of it
+    TEST_ASSERT_EQUAL_HEX32(10 * NONCE_SCHEDULE_SUBRANGE_SIZE, nonce_schedule_next(&schedule, &job, 0));
+
+    for (int root = 1; root <= NONCE_SCHEDULE_HEADERS; root++) {
+        bm_job other = make_job(root, jobid);
+        nonce_schedule_next(&schedule, &other, 0.8);
+    }
+    TEST_ASSERT_EQUAL_HEX32(0, nonce_schedule_next(&schedule, &job, 0.8));
+}
@@ -0,0 +1,97 @@
+#include "unity.h"
+
+#include "register_reads.h"
+
+#include <string.h>
+
+static uint32_t values[4];
+static int deliveries;
+
+static void store(void * ctx, uint8_t chip_index, uint8_t reg, uint32_t value)
+{
+    TEST_ASSERT_EQUAL_PTR(values, ctx);
+    values[chip_index] = value;
+    deliveries++;
+}
+
+static void reset(register_reads * reads)
+{
+    register_reads_init(reads);
+    memset(values, 0, sizeof(values));
+    deliveries = 0;
+}
+
+TEST_CASE("Register reads match a reply by address and register", "[register_reads]")
+{
+    register_reads reads;
+    reset(&reads);
+
+    TEST_ASSERT_TRUE(register_reads_begin(&reads, 0x80, 0x4C, 100, 0, store, values));
+    // the same read twice could not tell its replies apart
+    TEST_ASSERT_FALSE(register_reads_begin(&reads, 0x80, 0x4C, 100, 0, store, values));
+    TEST_ASSERT_FALSE(register_reads_begin(&reads, REGISTER_READ_ALL, 0x4C, 100, 0, store, values));
+    TEST_ASSERT_TRUE(register_reads_begin(&reads, 0x00, 0x4C, 100, 0, store, values));
+    TEST_ASSERT_EQUAL(2, reads.busy);
+
+    // another chip's or register's reply is not it
+    TEST_ASSERT_FALSE(register_reads_match(&reads, 0x40, 2, 0x4C, 7));
+    TEST_ASSERT_FALSE(register_reads_match(&reads, 0x80, 1, 0x50, 7));
+    TEST_ASSERT_EQUAL(2, reads.unmatched);
+    TEST_ASSERT_EQUAL(0, deliveries);
+
+    TEST_ASSERT_TRUE(register_reads_match(&reads, 0x80, 1, 0x4C, 0x12345678));
+    TEST_ASSERT_EQUAL_HEX32(0x12345678, values[1]);
+    // done with its reply, so a late duplicate finds nothing
+    TEST_ASSERT_FALSE(register_reads_match(&reads, 0x80, 1, 0x4C, 0x12345678));
+    TEST_ASSERT_EQUAL(1, deliveries);
+
+    // the read of chip 0 never gets its reply
+    TEST_ASSERT_EQUAL(0, register_reads_expire(&reads, 99));
+    TEST_ASSERT_EQUAL(1, register_reads_expire(&reads, 100));
+    TEST_ASSERT_EQUAL(1, reads.timeouts);
+    TEST_ASSERT_EQUAL(1, reads.replies);
+    TEST_ASSERT_FALSE(register_reads_match(&reads, 0x00, 0, 0x4C, 1));
+}
+
+TEST_CASE("Broadcast register reads collect every chip until their deadline", "[register_reads]")
+{
+    register_reads reads;
+    reset(&reads);
+
+    // deadlines past the wrap of the millisecond uptime still order right
+    uint32_t now = UINT32_MAX - 10;
+    TEST_ASSERT_TRUE(register_reads_begin(&reads, REGISTER_READ_ALL, 0x04, 50, now, store, values));
+    TEST_ASSERT_FALSE(register_reads_begin(&reads, 0x40, 0x04, 50, now, store, values));
+
+    for (int chip = 0; chip < 4; chip++) {
+        TEST_ASSERT_TRUE(register_reads_match(&reads, chip * 0x40, chip, 0x04, 100 + chip));
+    }
+    TEST_ASSERT_EQUAL(4, deliveries);
+    TEST_ASSERT_EQUAL(103, values[3]);
+
+    TEST_ASSERT_EQUAL(0, register_reads_expire(&reads, now + 49));
+    // answered, so ending is not a timeout
+    TEST_ASSERT_EQUAL(0, register_reads_expire(&reads, now + 50));
+    TEST_ASSERT_FALSE(register_reads_match(&reads, 0x00, 0, 0x04, 1));
+
+    // nobody answered this one
+    TEST_ASSERT_TRUE(register_reads_begin(&reads, REGISTER_READ_ALL, 0x04, 50, now, store, values));
+    TEST_ASSERT_EQUAL(1, register_reads_expire(&reads, now + 50));
+}
+
+TEST_CASE("Register reads refuse more reads than slots", "[register_reads]")
+{
+    register_reads reads;
+    reset(&reads);
+
+    for (int i = 0; i < REGISTER_READS_SLOTS; i++) {
+        TEST_ASSERT_TRUE(register_reads_begin(&reads, i, 0x4C, 10, 0, NULL, NULL));
+    }
+    TEST_ASSERT_FALSE(register_reads_begin(&reads, REGISTER_READS_SLOTS, 0x4C, 10, 0, NULL, NULL));
+    TEST_ASSERT_EQUAL(REGISTER_READS_SLOTS, reads.reads);
+
+    // a read without a callback still ends with its reply
+    TEST_ASSERT_TRUE(register_reads_match(&reads, 3, 0, 0x4C, 1));
+    TEST_ASSERT_TRUE(register_reads_begin(&reads, REGISTER_READS_SLOTS, 0x4C, 10, 0, NULL, NULL));
+    TEST_ASSERT_EQUAL(REGISTER_READS_SLOTS, register_reads_expire(&reads, 10));
+}
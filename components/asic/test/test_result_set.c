@@ -0,0 +1,60 @@
+#include "unity.h"
+
+#include "result_set.h"
+
+static result_set set;
+
+TEST_CASE("Result set catches a result sent twice for the same job", "[result_set]")
+{
+    result_set_init(&set);
+
+    TEST_ASSERT_TRUE(result_set_insert(&set, 8, 0x12345678, 0x20000000));
+    TEST_ASSERT_FALSE(result_set_insert(&set, 8, 0x12345678, 0x20000000));
+    // the same nonce for another rolled version or another job is another result
+    TEST_ASSERT_TRUE(result_set_insert(&set, 8, 0x12345678, 0x20002000));
+    TEST_ASSERT_TRUE(result_set_insert(&set, 16, 0x12345678, 0x20000000));
+
+    TEST_ASSERT_EQUAL(3, set.results);
+    TEST_ASSERT_EQUAL(1, set.duplicates);
+
+    // a new job under the id starts with nothing seen
+    result_set_recycle(&set, 8);
+    TEST_ASSERT_TRUE(result_set_insert(&set, 8, 0x12345678, 0x20000000));
+    TEST_ASSERT_FALSE(result_set_insert(&set, 16, 0x12345678, 0x20000000));
+}
+
+TEST_CASE("Result set keeps every result of a busy job", "[result_set]")
+{
+    result_set_init(&set);
+
+    // a quarter of the set for one job, then all of it seen again
+    for (uint32_t i = 0; i < RESULT_SET_SIZE / 4; i++) {
+        TEST_ASSERT_TRUE(result_set_insert(&set, 24, i * 0x01000193u, 0x20000000 | (i << 13)));
+    }
+    for (uint32_t i = 0; i < RESULT_SET_SIZE / 4; i++) {
+        TEST_ASSERT_FALSE(result_set_insert(&set, 24, i * 0x01000193u, 0x20000000 | (i << 13)));
+    }
+    TEST_ASSERT_EQUAL(0, set.evictions);
+    TEST_ASSERT_EQUAL(RESULT_SET_SIZE / 4, set.duplicates);
+}
+
+TEST_CASE("Result set reuses the slots of recycled jobs and evicts when full", "[result_set]")
+{
+    result_set_init(&set);
+
+    for (uint32_t i = 0; i < RESULT_SET_SIZE; i++) {
+        result_set_insert(&set, i % 16, i, 0x20000000);
+    }
+    // a full set pushes older results out rather than growing
+    uint32_t evictions = set.evictions;
+    TEST_ASSERT_TRUE(evictions > 0);
+
+    for (uint8_t id = 0; id < 16; id++) {
+        result_set_recycle(&set, id);
+    }
+    // every slot is free again, so a quarter fills without pushing anything out
+    for (uint32_t i = 0; i < RESULT_SET_SIZE / 4; i++) {
+        TEST_ASSERT_TRUE(result_set_insert(&set, 32, i, 0x20000000));
+    }
+    TEST_ASSERT_EQUAL(evictions, set.evictions);
+}
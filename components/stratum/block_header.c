@@ -0,0 +1,42 @@
+#include <string.h>
+#include "block_header.h"
+
+void block_header_midstate(const block_header_t * header, uint32_t state[SHA256_STATE_WORDS])
+{
+    sha256_midstate((const uint8_t *) header, state);
+}
+
+void block_header_tail_block(const block_header_t * header, uint32_t block[SHA256_BLOCK_WORDS])
+{
+    block[0] = sha256_load_be32(header->merkle_root + 28);
+    block[1] = sha256_load_be32((const uint8_t *) &header->ntime);
+    block[2] = sha256_load_be32((const uint8_t *) &header->nbits);
+    block[3] = sha256_load_be32((const uint8_t *) &header->nonce);
+    memcpy(block + 4, SHA256_PAD_80, sizeof(SHA256_PAD_80));
+}
+
+void block_header_hash_from_midstate(const block_header_t * header, const uint32_t midstate[SHA256_STATE_WORDS],
+                                     uint32_t hash[SHA256_STATE_WORDS])
+{
+    uint32_t block[SHA256_BLOCK_WORDS];
+    memcpy(block, midstate, SHA256_STATE_WORDS * sizeof(uint32_t));
+    uint32_t tail[SHA256_BLOCK_WORDS];
+    block_header_tail_block(header, tail);
+    sha256_compress(block, tail);
+
+    // The first digest is the state words, padded for a 32 byte message
+    memcpy(block + SHA256_STATE_WORDS, SHA256_PAD_32, sizeof(SHA256_PAD_32));
+    memcpy(hash, SHA256_IV, SHA256_STATE_WORDS * sizeof(uint32_t));
+    sha256_compress(hash, block);
+}
+
+void block_header_hash(const block_header_t * header, uint8_t digest[SHA256_DIGEST_SIZE])
+{
+    uint32_t midstate[SHA256_STATE_WORDS];
+    uint32_t hash[SHA256_STATE_WORDS];
+    block_header_midstate(header, midstate);
+    block_header_hash_from_midstate(header, midstate, hash);
+    for (int i = 0; i < SHA256_STATE_WORDS; i++) {
+        sha256_store_be32(digest + i * 4, hash[i]);
+    }
+}
@@ -0,0 +1,83 @@
+#include <stdlib.h>
+#include "extranonce2.h"
+#include "hex_codec.h"
+
+bool extranonce2_space_init(extranonce2_space * space, size_t len, uint32_t partition_index, uint32_t partition_count,
+                            uint64_t offset)
+{
+    if (len == 0 || partition_count == 0 || partition_index >= partition_count) {
+        return false;
+    }
+
+    // floor(total / count), where a field of 8 bytes or more holds all 2^64 values
+    uint64_t size;
+    if (len < sizeof(uint64_t)) {
+        uint64_t total = 1ULL << (8 * len);
+        if (partition_count > total) {
+            return false;
+        }
+        size = total / partition_count;
+    } else {
+        // 2^64 / count from (2^64 - 1) / count, one more when count divides 2^64;
+        // a single partition wraps to 0, meaning all of them
+        size = UINT64_MAX / partition_count;
+        if (UINT64_MAX % partition_count == partition_count - 1) {
+            size++;
+        }
+    }
+
+    space->len = len;
+    space->partition_size = size;
+    space->partition_start = size * partition_index;
+    space->offset = size != 0 ? offset % size : offset;
+    space->used = 0;
+    return true;
+}
+
+void extranonce2_space_reset(extranonce2_space * space)
+{
+    space->used = 0;
+}
+
+bool extranonce2_space_exhausted(const extranonce2_space * space)
+{
+    return space->partition_size != 0 && space->used >= space->partition_size;
+}
+
+bool extranonce2_next(extranonce2_space * space, uint64_t * value)
+{
+    if (extranonce2_space_exhausted(space)) {
+        return false;
+    }
+
+    uint64_t position = space->offset + space->used;
+    if (space->partition_size != 0) {
+        position %= space->partition_size;
+    }
+    *value = space->partition_start + position;
+    space->used++;
+    return true;
+}
+
+void extranonce2_write(uint64_t value, uint8_t * field, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        field[i] = i < sizeof(value) ? (uint8_t) (value >> (8 * i)) : 0;
+    }
+}
+
+char * extranonce2_to_hex(uint64_t value, size_t len)
+{
+    uint8_t * field = malloc(len > 0 ? len : 1);
+    char * hex = malloc(len * 2 + 1);
+    if (field == NULL || hex == NULL) {
+        free(field);
+        free(hex);
+        return NULL;
+    }
+
+    extranonce2_write(value, field, len);
+    hex_encode(field, len, hex);
+    free(field);
+    return hex;
+}
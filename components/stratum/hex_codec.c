@@ -0,0 +1,200 @@
+#include <string.h>
+#include "hex_codec.h"
+
+// Hex sits on every notify decode, coinbase and submit, so it is table driven with no
+// per-digit branches: SSE2 or NEON 16 bytes at a time on hosts, 32-bit SWAR on the ESP32.
+
+static const char HEX_DIGITS[16] = "0123456789abcdef";
+
+// Digit value plus one, 0 for anything that is not a hex digit: minus one, that wraps to 0xff
+static const uint8_t HEX_VALUES[256] = {
+    ['0'] = 1, ['1'] = 2, ['2'] = 3, ['3'] = 4, ['4'] = 5, ['5'] = 6, ['6'] = 7, ['7'] = 8, ['8'] = 9, ['9'] = 10,
+    ['a'] = 11, ['b'] = 12, ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16,
+    ['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16,
+};
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__) && !defined(ESP_PLATFORM)
+#define HEX_SSE2 1
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON) && !defined(ESP_PLATFORM)
+#define HEX_NEON 1
+#include <arm_neon.h>
+#endif
+
+#if HEX_SSE2
+
+// Nibbles to digits: '0' + n, plus 39 more to reach 'a' for n above 9
+static inline __m128i nibbles_to_digits(__m128i n)
+{
+    __m128i letters = _mm_and_si128(_mm_cmpgt_epi8(n, _mm_set1_epi8(9)), _mm_set1_epi8(39));
+    return _mm_add_epi8(n, _mm_add_epi8(_mm_set1_epi8('0'), letters));
+}
+
+// Digit values, and all ones in valid for each lane holding a hex digit
+static inline __m128i digits_to_nibbles(__m128i c, __m128i * valid)
+{
+    // x - base < limit as unsigned is the signed compare after flipping the top bit
+    const __m128i flip = _mm_set1_epi8((char) 0x80);
+    __m128i digit = _mm_sub_epi8(c, _mm_set1_epi8('0'));
+    __m128i is_digit = _mm_cmplt_epi8(_mm_xor_si128(digit, flip), _mm_set1_epi8((char) (0x80 + 10)));
+    // OR 0x20 folds 'A'-'F' onto 'a'-'f' and nothing else onto them
+    __m128i letter = _mm_sub_epi8(_mm_or_si128(c, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+    __m128i is_letter = _mm_cmplt_epi8(_mm_xor_si128(letter, flip), _mm_set1_epi8((char) (0x80 + 6)));
+
+    *valid = _mm_or_si128(is_digit, is_letter);
+    return _mm_or_si128(_mm_and_si128(is_digit, digit),
+                        _mm_and_si128(is_letter, _mm_add_epi8(letter, _mm_set1_epi8(10))));
+}
+
+static size_t encode_blocks(const uint8_t * bin, size_t len, char * hex)
+{
+    size_t done = 0;
+    for (; done + 16 <= len; done += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (bin + done));
+        __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), _mm_set1_epi8(0x0f));
+        __m128i lo = _mm_and_si128(v, _mm_set1_epi8(0x0f));
+        hi = nibbles_to_digits(hi);
+        lo = nibbles_to_digits(lo);
+        _mm_storeu_si128((__m128i *) (hex + 2 * done), _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128((__m128i *) (hex + 2 * done + 16), _mm_unpackhi_epi8(hi, lo));
+    }
+    return done;
+}
+
+static size_t decode_blocks(const char * hex, size_t len, uint8_t * bin, bool * ok)
+{
+    size_t done = 0;
+    __m128i valid_all = _mm_set1_epi8((char) 0xff);
+    for (; done + 16 <= len; done += 16) {
+        __m128i valid_a, valid_b;
+        __m128i a = digits_to_nibbles(_mm_loadu_si128((const __m128i *) (hex + 2 * done)), &valid_a);
+        __m128i b = digits_to_nibbles(_mm_loadu_si128((const __m128i *) (hex + 2 * done + 16)), &valid_b);
+        valid_all = _mm_and_si128(valid_all, _mm_and_si128(valid_a, valid_b));
+
+        // Each 16-bit lane holds the high digit in its low byte: byte = high << 4 | low
+        __m128i a16 = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(a, _mm_set1_epi16(0x00ff)), 4), _mm_srli_epi16(a, 8));
+        __m128i b16 = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(b, _mm_set1_epi16(0x00ff)), 4), _mm_srli_epi16(b, 8));
+        _mm_storeu_si128((__m128i *) (bin + done), _mm_packus_epi16(a16, b16));
+    }
+    *ok = _mm_movemask_epi8(valid_all) == 0xffff;
+    return done;
+}
+
+#elif HEX_NEON
+
+static inline uint8x16_t nibbles_to_digits(uint8x16_t n)
+{
+    uint8x16_t letters = vandq_u8(vcgtq_u8(n, vdupq_n_u8(9)), vdupq_n_u8(39));
+    return vaddq_u8(n, vaddq_u8(vdupq_n_u8('0'), letters));
+}
+
+static inline uint8x16_t digits_to_nibbles(uint8x16_t c, uint8x16_t * valid)
+{
+    uint8x16_t digit = vsubq_u8(c, vdupq_n_u8('0'));
+    uint8x16_t is_digit = vcltq_u8(digit, vdupq_n_u8(10));
+    uint8x16_t letter = vsubq_u8(vorrq_u8(c, vdupq_n_u8(0x20)), vdupq_n_u8('a'));
+    uint8x16_t is_letter = vcltq_u8(letter, vdupq_n_u8(6));
+
+    *valid = vorrq_u8(is_digit, is_letter);
+    return vorrq_u8(vandq_u8(is_digit, digit), vandq_u8(is_letter, vaddq_u8(letter, vdupq_n_u8(10))));
+}
+
+static size_t encode_blocks(const uint8_t * bin, size_t len, char * hex)
+{
+    size_t done = 0;
+    for (; done + 16 <= len; done += 16) {
+        uint8x16_t v = vld1q_u8(bin + done);
+        uint8x16x2_t digits;
+        digits.val[0] = nibbles_to_digits(vshrq_n_u8(v, 4));
+        digits.val[1] = nibbles_to_digits(vandq_u8(v, vdupq_n_u8(0x0f)));
+        vst2q_u8((uint8_t *) hex + 2 * done, digits);
+    }
+    return done;
+}
+
+static size_t decode_blocks(const char * hex, size_t len, uint8_t * bin, bool * ok)
+{
+    size_t done = 0;
+    uint8x16_t valid_all = vdupq_n_u8(0xff);
+    for (; done + 16 <= len; done += 16) {
+        // vld2 splits the high and low digit of each byte into separate vectors
+        uint8x16x2_t c = vld2q_u8((const uint8_t *) hex + 2 * done);
+        uint8x16_t valid_hi, valid_lo;
+        uint8x16_t hi = digits_to_nibbles(c.val[0], &valid_hi);
+        uint8x16_t lo = digits_to_nibbles(c.val[1], &valid_lo);
+        valid_all = vandq_u8(valid_all, vandq_u8(valid_hi, valid_lo));
+        vst1q_u8(bin + done, vorrq_u8(vshlq_n_u8(hi, 4), lo));
+    }
+    *ok = vminvq_u8(valid_all) == 0xff;
+    return done;
+}
+
+#else
+
+// Four bytes at a time: spread the nibbles over the bytes of a 64-bit word, high nibble first
+// in memory, then turn all eight into digits with the same add as a single one
+static size_t encode_blocks(const uint8_t * bin, size_t len, char * hex)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    size_t done = 0;
+    for (; done + 4 <= len; done += 4) {
+        uint32_t v;
+        memcpy(&v, bin + done, 4);
+        uint64_t spread = (uint64_t) (v & 0xff) | ((uint64_t) (v & 0xff00) << 8) | ((uint64_t) (v & 0xff0000) << 16) |
+                          ((uint64_t) (v & 0xff000000) << 24);
+        uint64_t n = ((spread >> 4) & 0x000f000f000f000fULL) | ((spread & 0x000f000f000f000fULL) << 8);
+        uint64_t letters = ((n + 0x0606060606060606ULL) >> 4) & 0x0101010101010101ULL;
+        uint64_t digits = n + 0x3030303030303030ULL + letters * 39;
+        memcpy(hex + 2 * done, &digits, 8);
+    }
+    return done;
+#else
+    return 0;
+#endif
+}
+
+static size_t decode_blocks(const char * hex, size_t len, uint8_t * bin, bool * ok)
+{
+    *ok = true;
+    return 0;
+}
+
+#endif
+
+void hex_encode(const uint8_t * bin, size_t len, char * hex)
+{
+    for (size_t i = encode_blocks(bin, len, hex); i < len; i++) {
+        hex[2 * i] = HEX_DIGITS[bin[i] >> 4];
+        hex[2 * i + 1] = HEX_DIGITS[bin[i] & 0x0f];
+    }
+    hex[2 * len] = '\0';
+}
+
+bool hex_decode(const char * hex, size_t len, uint8_t * bin)
+{
+    bool ok;
+    size_t i = decode_blocks(hex, len, bin, &ok);
+
+    // Invalid digits have the top bit set, so one test at the end covers all of them
+    uint8_t invalid = 0;
+    for (; i < len; i++) {
+        uint8_t hi = HEX_VALUES[(uint8_t) hex[2 * i]] - 1;
+        uint8_t lo = HEX_VALUES[(uint8_t) hex[2 * i + 1]] - 1;
+        invalid |= hi | lo;
+        bin[i] = (uint8_t) (hi << 4) | lo;
+    }
+    return ok && (invalid & 0x80) == 0;
+}
+
+int hex_digit_value(char c)
+{
+    return HEX_VALUES[(uint8_t) c] - 1;
+}
+
+void hex_encode_u32(uint32_t value, char hex[8])
+{
+    for (int i = 7; i >= 0; i--) {
+        hex[i] = HEX_DIGITS[value & 0x0f];
+        value >>= 4;
+    }
+}
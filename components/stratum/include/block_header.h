@@ -0,0 +1,49 @@
+#ifndef BLOCK_HEADER_H_
+#define BLOCK_HEADER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sha256_backend.h"
+
+// An 80 byte block header laid out exactly as it is serialized and hashed, so the struct is
+// the message. Integer fields are little-endian on the wire and are stored in host order,
+// which is little-endian on every target this builds for.
+typedef struct __attribute__((packed))
+{
+    uint32_t version;
+    uint8_t prev_block_hash[32]; // internal byte order, as hashed
+    uint8_t merkle_root[32];     // internal byte order, as hashed
+    uint32_t ntime;
+    uint32_t nbits;
+    uint32_t nonce;
+} block_header_t;
+
+_Static_assert(sizeof(block_header_t) == 80, "a block header serializes to 80 bytes");
+_Static_assert(offsetof(block_header_t, prev_block_hash) == 4, "prev_block_hash at byte 4");
+_Static_assert(offsetof(block_header_t, merkle_root) == 36, "merkle_root at byte 36");
+_Static_assert(offsetof(block_header_t, ntime) == 68, "ntime at byte 68");
+_Static_assert(offsetof(block_header_t, nbits) == 72, "nbits at byte 72");
+_Static_assert(offsetof(block_header_t, nonce) == 76, "nonce at byte 76");
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "block_header_t keeps integer fields in host order, which must be little-endian"
+#endif
+
+// The first SHA256 block ends 28 bytes into the merkle root; the rest is the second block
+#define BLOCK_HEADER_TAIL_OFFSET 64
+
+// State after the first 64 bytes: the midstate, shared by every nonce and ntime
+void block_header_midstate(const block_header_t * header, uint32_t state[SHA256_STATE_WORDS]);
+
+// Second block: the 16 header bytes after the midstate followed by the constant 80 byte padding
+void block_header_tail_block(const block_header_t * header, uint32_t block[SHA256_BLOCK_WORDS]);
+
+// Double SHA256 of the header from its midstate: two compressions with constant padding
+// blocks and no length handling. hash holds the digest as big-endian state words.
+void block_header_hash_from_midstate(const block_header_t * header, const uint32_t midstate[SHA256_STATE_WORDS],
+                                     uint32_t hash[SHA256_STATE_WORDS]);
+
+// Double SHA256 of the header; block explorers print these bytes reversed
+void block_header_hash(const block_header_t * header, uint8_t digest[SHA256_DIGEST_SIZE]);
+
+#endif /* BLOCK_HEADER_H_ */
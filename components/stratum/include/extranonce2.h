@@ -0,0 +1,44 @@
+#ifndef EXTRANONCE2_H_
+#define EXTRANONCE2_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// The extranonce2 values this miner may put in a coinbase. The pool grants extranonce2_size
+// bytes; values are written little-endian and zero padded, so the first 8 bytes carry the
+// value and longer fields simply have a larger space than is ever used.
+//
+// The space can be split into equal partitions so several chips or proxied downstreams
+// sharing one extranonce1 never hash the same coinbase. Counting starts at an offset into
+// the partition and wraps around inside it, and the space is exhausted once every value in
+// the partition has been handed out for the current notify.
+typedef struct
+{
+    size_t len;                // field size in bytes, as granted by the pool
+    uint64_t partition_start;  // first value of this partition
+    uint64_t partition_size;   // values in this partition, 0 for all 2^64
+    uint64_t offset;           // where counting starts within the partition
+    uint64_t used;             // values handed out since the last reset
+} extranonce2_space;
+
+// Partition index of count over the values len bytes can hold. Fails for a zero length or
+// when there are more partitions than values.
+bool extranonce2_space_init(extranonce2_space * space, size_t len, uint32_t partition_index, uint32_t partition_count,
+                            uint64_t offset);
+
+// Start handing out values again, for a new notify
+void extranonce2_space_reset(extranonce2_space * space);
+
+bool extranonce2_space_exhausted(const extranonce2_space * space);
+
+// Next value in the partition; false once the partition is exhausted
+bool extranonce2_next(extranonce2_space * space, uint64_t * value);
+
+// value little-endian into a len byte coinbase field, zero padded
+void extranonce2_write(uint64_t value, uint8_t * field, size_t len);
+
+// Hex of the field for mining.submit; caller frees
+char * extranonce2_to_hex(uint64_t value, size_t len);
+
+#endif /* EXTRANONCE2_H_ */
@@ -0,0 +1,21 @@
+#ifndef HEX_CODEC_H_
+#define HEX_CODEC_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Lowercase hex of len bytes: writes 2 * len digits and a terminating NUL
+void hex_encode(const uint8_t * bin, size_t len, char * hex);
+
+// Decodes 2 * len hex digits of either case into len bytes. Returns false, with bin
+// partly written, if any of them is not a hex digit.
+bool hex_decode(const char * hex, size_t len, uint8_t * bin);
+
+// Value of one hex digit of either case, -1 if c is not one
+int hex_digit_value(char c);
+
+// value as exactly 8 lowercase digits, most significant first ("%08x"), no terminator
+void hex_encode_u32(uint32_t value, char hex[8]);
+
+#endif /* HEX_CODEC_H_ */
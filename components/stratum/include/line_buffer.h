@@ -0,0 +1,44 @@
+#ifndef LINE_BUFFER_H_
+#define LINE_BUFFER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum
+{
+    LINE_BUFFER_OK,
+    LINE_BUFFER_OVERSIZED,   // a line exceeded max_line_length and is being dropped
+    LINE_BUFFER_NO_MEMORY,   // growing the buffer failed, the partial line was dropped
+} line_buffer_status;
+
+// Newline-delimited receive buffer with a hard memory budget.
+// Holds at most max_line_length bytes of an unfinished line plus one receive chunk;
+// anything longer is discarded up to the next newline so the stream resyncs on the
+// following message instead of growing the heap or restarting the device.
+typedef struct
+{
+    char * data;
+    size_t len;
+    size_t capacity;
+    size_t chunk_size;
+    size_t max_line_length;
+    size_t partial_start;   // offset of the first byte after the last '\n' in data
+    bool discarding;        // dropping the rest of an oversized line
+
+    size_t high_water;      // largest capacity ever allocated
+    uint32_t lines;
+    uint32_t dropped_lines;   // oversized, or lost to a failed allocation
+} line_buffer;
+
+bool line_buffer_init(line_buffer * buffer, size_t chunk_size, size_t max_line_length);
+
+void line_buffer_free(line_buffer * buffer);
+
+void line_buffer_reset(line_buffer * buffer);
+
+line_buffer_status line_buffer_append(line_buffer * buffer, const char * data, size_t len);
+
+char * line_buffer_next_line(line_buffer * buffer);
+
+#endif /* LINE_BUFFER_H_ */
@@ -0,0 +1,66 @@
+#ifndef MERKLE_WINDOW_H_
+#define MERKLE_WINDOW_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "stratum_api.h"
+#include "version_rolling.h"
+#include "extranonce2.h"
+
+// Merkle root and midstates for one extranonce2 of the current notify: everything in a
+// job that costs SHA256 work. The rest of the job is copied from the notify.
+typedef struct
+{
+    uint64_t extranonce_2;
+    uint8_t merkle_root[32];
+    uint8_t midstates[VERSION_ROLLING_MAX_MIDSTATES][32];
+} merkle_window_entry;
+
+// Entries for the next extranonce2 values, computed ahead of time while the ASIC queue is
+// full so a job only costs a copy when the queue runs low. The ring holds the values most
+// recently drawn from the extranonce2 space, oldest first.
+typedef struct
+{
+    merkle_window_entry * entries;
+    uint16_t capacity;
+    uint16_t head;
+    uint16_t count;
+    extranonce2_space extranonce_2;
+
+    mining_notify * notify;
+    uint32_t version_mask;
+
+    // coinbase in binary, with extranonce2 rewritten in place for each entry
+    uint8_t * coinbase;
+    size_t coinbase_len;
+    size_t coinbase_capacity;
+    size_t extranonce_2_offset;
+
+    uint32_t precomputed;  // entries handed out from the ring
+    uint32_t computed_inline;  // entries computed on demand because the ring was empty
+} merkle_window;
+
+bool merkle_window_init(merkle_window * window, uint16_t capacity);
+
+void merkle_window_free(merkle_window * window);
+
+// Bytes held by the window: the ring and the binary coinbase
+size_t merkle_window_memory(const merkle_window * window);
+
+// Start over on a new notify, drawing extranonce2 values from space from its start.
+// notify must stay valid until the next reset.
+bool merkle_window_reset(merkle_window * window, mining_notify * notify, const char * extranonce_1,
+                         const extranonce2_space * space, uint32_t version_mask);
+
+// Midstates depend on the mask, so a change recomputes them for the entries in the ring
+void merkle_window_set_version_mask(merkle_window * window, uint32_t version_mask);
+
+// Compute one more entry if the ring has room; false when full, exhausted or without a notify
+bool merkle_window_fill_one(merkle_window * window);
+
+// Entry for the next extranonce2, from the ring or computed now if it is empty. precomputed
+// says which. Returns false when the ring is empty and the extranonce2 space is exhausted.
+bool merkle_window_take(merkle_window * window, merkle_window_entry * entry, bool * precomputed);
+
+#endif /* MERKLE_WINDOW_H_ */
@@ -0,0 +1,31 @@
+#ifndef MIDSTATE_ENGINE_H_
+#define MIDSTATE_ENGINE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "block_header.h"
+
+// Midstates hashed per sha256_compress_lanes pass, the widest backend
+#define MIDSTATE_ENGINE_LANES 8
+
+// Midstates of one header for consecutive rolled versions. Only the version word of the
+// first block changes between them, so the other 60 bytes are loaded once and every
+// version is a copy of that block with word 0 replaced, hashed as a batch.
+typedef struct
+{
+    uint32_t block[SHA256_BLOCK_WORDS]; // first header block as big-endian words
+    uint32_t version;                   // version of index 0
+    uint32_t version_mask;
+} midstate_engine;
+
+void midstate_engine_init(midstate_engine * engine, const block_header_t * header, uint32_t version_mask);
+
+// States for versions first .. first + count - 1; versions may be NULL
+void midstate_engine_run(const midstate_engine * engine, uint32_t first, size_t count,
+                         uint32_t (*states)[SHA256_STATE_WORDS], uint32_t * versions);
+
+// Version rolled index times inside mask, the same as applying increment_bitmask index
+// times, at a cost that does not grow with index
+uint32_t midstate_engine_version(uint32_t version, uint32_t version_mask, uint32_t index);
+
+#endif /* MIDSTATE_ENGINE_H_ */
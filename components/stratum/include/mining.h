@@ -2,6 +2,9 @@
 #define MINING_H_
 
 #include "stratum_api.h"
+#include "uint256.h"
+#include "block_header.h"
+#include "version_rolling.h"
 
 typedef struct
 {
@@ -16,25 +19,78 @@ typedef struct
     uint32_t starting_nonce;
 
     uint8_t num_midstates;
-    uint8_t midstate[32];
-    uint8_t midstate1[32];
-    uint8_t midstate2[32];
-    uint8_t midstate3[32];
-    uint32_t pool_diff;
+    // job packet byte order, one per rolled version; sized for the chip taking the most
+    uint8_t midstates[VERSION_ROLLING_MAX_MIDSTATES][32];
+    uint32_t midstate_versions[VERSION_ROLLING_MAX_MIDSTATES];
+    double pool_diff;
+    // share and block targets for pool_diff and nbits, worked out once per job
+    uint256_target pool_target;
+    uint256_target network_target;
+    uint32_t generation; // share_filter generation of the notify this job was built from
+    int64_t notify_us;   // local time that notify arrived, 0 when unknown
+    // first-block hash state of the last verified version that has no midstate of its own
+    bool verify_cached;
+    uint32_t verify_version;
+    uint32_t verify_state[8];
     char *jobid;
     char *extranonce2;
+    // holders of the job once it is on the chain: its active_jobs slot and each of its results
+    // being verified or submitted; the last one to let go frees it
+    uint32_t refs;
 } bm_job;
 
 void free_bm_job(bm_job *job);
 
+void bm_job_retain(bm_job *job);
+
+void bm_job_release(bm_job *job);
+
 char *construct_coinbase_tx(const char *coinbase_1, const char *coinbase_2,
                             const char *extranonce, const char *extranonce_2);
 
 char *calculate_merkle_root_hash(const char *coinbase_tx, const uint8_t merkle_branches[][32], const int num_merkle_branches);
 
+void calculate_merkle_root_bin(const uint8_t *coinbase_tx, const size_t coinbase_tx_len,
+                               const uint8_t merkle_branches[][32], const int num_merkle_branches, uint8_t merkle_root[32]);
+
 bm_job construct_bm_job(mining_notify *params, const char *merkle_root, const uint32_t version_mask);
 
-double test_nonce_value(const bm_job *job, const uint32_t nonce, const uint32_t rolled_version);
+uint8_t construct_bm_job_midstates(const mining_notify *params, const uint8_t merkle_root[32], const uint32_t version_mask,
+                                   uint8_t midstates[][32]);
+
+bm_job construct_bm_job_from_root(mining_notify *params, const uint8_t merkle_root[32], const uint32_t version_mask,
+                                  const uint8_t midstates[][32]);
+
+bm_job construct_bm_job_rolled_ntime(const bm_job *job, const uint32_t ntime);
+
+uint32_t bm_job_midstate_version(const bm_job *job, const uint8_t midstate_index);
+
+void construct_block_header(const bm_job *job, const uint32_t rolled_version, const uint32_t nonce, block_header_t *header);
+
+typedef struct
+{
+    double difficulty; // 0.0 when the nonce is below the ticket difficulty
+    bool pool_share;   // hash meets the job's pool target
+    bool block;        // hash meets the network target
+} nonce_result;
+
+double test_nonce_value(bm_job *job, const uint32_t nonce, const uint32_t rolled_version);
+
+double test_nonce_value_ticket(bm_job *job, const uint32_t nonce, const uint32_t rolled_version, const uint32_t ticket_difficulty);
+
+nonce_result test_nonce_result(bm_job *job, const uint32_t nonce, const uint32_t rolled_version, const uint32_t ticket_difficulty);
+
+// Nonces verified per pass of test_nonce_batch, the widest sha256_compress_lanes backend
+#define NONCE_BATCH_LANES 8
+
+typedef struct
+{
+    bm_job *job;
+    uint32_t nonce;
+    uint32_t rolled_version;
+} nonce_check;
+
+void test_nonce_batch(const nonce_check *checks, const size_t count, const uint32_t ticket_difficulty, nonce_result *results);
 
 char *extranonce_2_generate(uint32_t extranonce_2, uint32_t length);
 
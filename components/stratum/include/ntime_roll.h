@@ -0,0 +1,24 @@
+#ifndef NTIME_ROLL_H_
+#define NTIME_ROLL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Pools accept a share whose ntime is at or after the notify's ntime and not too far ahead of
+// their own clock. The pool's clock is tracked as the notify ntime plus local time elapsed
+// since the notify arrived, so no wall clock or SNTP sync is needed.
+typedef struct
+{
+    uint32_t ntime;       // ntime from mining.notify
+    int64_t received_us;  // local time the notify arrived
+    uint32_t max_ahead;   // seconds a rolled ntime may run ahead of the pool's clock
+} ntime_window;
+
+void ntime_window_init(ntime_window * window, uint32_t ntime, int64_t received_us, uint32_t max_ahead);
+
+// Largest ntime the pool will take at now_us
+uint32_t ntime_window_max(const ntime_window * window, int64_t now_us);
+
+bool ntime_window_allows(const ntime_window * window, uint32_t ntime, int64_t now_us);
+
+#endif /* NTIME_ROLL_H_ */
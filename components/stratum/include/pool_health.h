@@ -0,0 +1,98 @@
+#ifndef POOL_HEALTH_H_
+#define POOL_HEALTH_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define POOL_HEALTH_PRIMARY 0
+#define POOL_HEALTH_FALLBACK 1
+#define POOL_HEALTH_POOL_COUNT 2
+
+typedef enum
+{
+    POOL_SHARE_ACCEPTED,
+    POOL_SHARE_REJECTED,
+    POOL_SHARE_STALE,
+} pool_share_result;
+
+typedef enum
+{
+    POOL_SWITCH_NONE,
+    POOL_SWITCH_CONNECT_FAILURES,
+    POOL_SWITCH_DEGRADED,
+    POOL_SWITCH_RETURN_TO_PRIMARY,
+    POOL_SWITCH_NO_FALLBACK,
+} pool_switch_reason;
+
+typedef struct
+{
+    uint8_t fail_score;               // leave the active pool once its score drops below this
+    uint8_t return_score;             // go back to primary once its score is at least this
+    uint8_t switch_margin;            // a degraded switch needs the other pool ahead by this much
+    uint8_t max_connect_failures;     // consecutive connect failures that force a switch
+    uint32_t min_dwell_ms;            // minimum time on a pool before a score-based switch
+    uint32_t notify_interval_ms;      // expected time between mining.notify messages
+    uint32_t rtt_target_ms;           // submit round trips at or below this score full marks
+} pool_health_policy;
+
+typedef struct
+{
+    // raw counters
+    uint32_t connect_attempts;
+    uint32_t connect_failures;
+    uint32_t consecutive_connect_failures;
+    uint32_t shares_accepted;
+    uint32_t shares_rejected;
+    uint32_t shares_stale;
+
+    // smoothed inputs
+    float connect_success; // ewma of connect outcomes, 1.0 = always connects
+    float submit_rtt_ms;   // ewma of submit round trip, 0 = no samples yet
+    float reject_ratio;    // ewma of rejected (non-stale) submits
+    float stale_ratio;     // ewma of stale submits
+
+    bool connected;
+    int64_t connected_us;
+    int64_t last_notify_us;
+    int64_t scored_us;
+
+    // last computed score and its components, 0..100
+    float score;
+    float connect_score;
+    float rtt_score;
+    float reject_score;
+    float freshness_score;
+    float stale_score;
+} pool_health;
+
+typedef struct
+{
+    pool_health pools[POOL_HEALTH_POOL_COUNT];
+    pool_health_policy policy;
+    int active;
+    int64_t active_since_us;
+    uint32_t switch_count;
+    pool_switch_reason last_switch_reason;
+} pool_health_monitor;
+
+void pool_health_policy_default(pool_health_policy * policy);
+
+void pool_health_init(pool_health_monitor * monitor, const pool_health_policy * policy, int64_t now_us);
+
+void pool_health_record_connect(pool_health * pool, bool success);
+
+void pool_health_record_session(pool_health * pool, int64_t now_us);
+
+void pool_health_record_disconnect(pool_health * pool);
+
+void pool_health_record_notify(pool_health * pool, int64_t now_us);
+
+void pool_health_record_share(pool_health * pool, pool_share_result result, double rtt_ms);
+
+float pool_health_score(pool_health * pool, const pool_health_policy * policy, int64_t now_us);
+
+int pool_health_select(pool_health_monitor * monitor, bool has_fallback, int64_t now_us);
+
+const char * pool_health_switch_reason_str(pool_switch_reason reason);
+
+#endif /* POOL_HEALTH_H_ */
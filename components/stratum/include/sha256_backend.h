@@ -0,0 +1,67 @@
+#ifndef SHA256_BACKEND_H_
+#define SHA256_BACKEND_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "sha256_core.h"
+
+#define SHA256_DIGEST_SIZE 32
+#define SHA256_BLOCK_SIZE 64
+
+/**
+ * One SHA-256 implementation. Blocks are handed over as big-endian words, the form the
+ * header tail and second hash in test_nonce_value are built in, so no backend has to
+ * byte-swap them again.
+ */
+typedef struct
+{
+    const char * name;
+
+    // Whether this build and CPU can run the backend
+    bool (*available)(void);
+
+    void (*compress)(uint32_t state[SHA256_STATE_WORDS], const uint32_t block[SHA256_BLOCK_WORDS]);
+
+    // count independent (state, block) compressions; NULL loops over compress
+    void (*compress_lanes)(uint32_t (*states)[SHA256_STATE_WORDS], const uint32_t (*blocks)[SHA256_BLOCK_WORDS],
+                           size_t count);
+
+    // Whole message hash when the backend has a faster path than compress; NULL pads in software
+    void (*hash)(const uint8_t * data, size_t len, uint8_t digest[SHA256_DIGEST_SIZE]);
+} sha256_backend;
+
+extern const sha256_backend sha256_backend_generic;
+extern const sha256_backend sha256_backend_shani;
+extern const sha256_backend sha256_backend_avx2;
+extern const sha256_backend sha256_backend_armv8;
+extern const sha256_backend sha256_backend_esp32;
+
+// Backends compiled into this build, available or not, in order of preference
+size_t sha256_backend_count(void);
+const sha256_backend * sha256_backend_at(size_t index);
+bool sha256_backend_is_available(const sha256_backend * backend);
+
+// Backend the primitives below use; the most preferred available one until one is selected
+const sha256_backend * sha256_backend_active(void);
+
+// Returns false and keeps the current backend if name is unknown or unavailable here
+bool sha256_backend_select(const char * name);
+
+void sha256_hash(const uint8_t * data, size_t len, uint8_t digest[SHA256_DIGEST_SIZE]);
+void sha256_double(const uint8_t * data, size_t len, uint8_t digest[SHA256_DIGEST_SIZE]);
+
+// State after the first 64 bytes of data, starting from the IV
+void sha256_midstate(const uint8_t data[SHA256_BLOCK_SIZE], uint32_t state[SHA256_STATE_WORDS]);
+
+void sha256_compress(uint32_t state[SHA256_STATE_WORDS], const uint32_t block[SHA256_BLOCK_WORDS]);
+void sha256_compress_lanes(uint32_t (*states)[SHA256_STATE_WORDS], const uint32_t (*blocks)[SHA256_BLOCK_WORDS],
+                           size_t count);
+
+// Same primitives on an explicit backend, for tests and benchmarks
+void sha256_hash_with(const sha256_backend * backend, const uint8_t * data, size_t len, uint8_t digest[SHA256_DIGEST_SIZE]);
+void sha256_double_with(const sha256_backend * backend, const uint8_t * data, size_t len, uint8_t digest[SHA256_DIGEST_SIZE]);
+void sha256_compress_lanes_with(const sha256_backend * backend, uint32_t (*states)[SHA256_STATE_WORDS],
+                                const uint32_t (*blocks)[SHA256_BLOCK_WORDS], size_t count);
+
+#endif /* SHA256_BACKEND_H_ */
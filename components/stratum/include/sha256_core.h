@@ -0,0 +1,34 @@
+#ifndef SHA256_CORE_H_
+#define SHA256_CORE_H_
+
+#include <stdint.h>
+
+#define SHA256_STATE_WORDS 8
+#define SHA256_BLOCK_WORDS 16
+
+extern const uint32_t SHA256_IV[SHA256_STATE_WORDS];
+extern const uint32_t SHA256_K[64];
+
+// Padding words of the last block for the two message sizes mining hashes: words 4-15 after
+// the 16 byte tail of an 80 byte header, and words 8-15 after a 32 byte digest
+extern const uint32_t SHA256_PAD_80[12];
+extern const uint32_t SHA256_PAD_32[8];
+
+// One SHA-256 compression of a block already loaded as big-endian words.
+// Portable C; the reference every sha256_backend is checked against.
+void sha256_core_compress(uint32_t state[SHA256_STATE_WORDS], const uint32_t block[SHA256_BLOCK_WORDS]);
+
+static inline uint32_t sha256_load_be32(const uint8_t * p)
+{
+    return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | (uint32_t) p[3];
+}
+
+static inline void sha256_store_be32(uint8_t * p, uint32_t v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+#endif /* SHA256_CORE_H_ */
@@ -0,0 +1,45 @@
+#ifndef SHARE_FILTER_H_
+#define SHARE_FILTER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define PREV_BLOCK_HASH_HEX_SIZE 65
+
+typedef enum
+{
+    SHARE_REJECT_STALE,
+    SHARE_REJECT_LOW_DIFFICULTY,
+    SHARE_REJECT_DUPLICATE,
+    SHARE_REJECT_JOB_NOT_FOUND,
+    SHARE_REJECT_OTHER,
+    SHARE_REJECT_REASON_COUNT,
+} share_reject_reason;
+
+typedef struct
+{
+    // Bumped on every clean_jobs notify and every prev block hash change.
+    // Jobs are stamped with the generation of the notify they were built from;
+    // a share from an older generation can no longer be accepted by the pool.
+    volatile uint32_t generation;
+    char prev_block_hash[PREV_BLOCK_HASH_HEX_SIZE];
+
+    uint32_t stale_suppressed;
+    uint32_t rejects[SHARE_REJECT_REASON_COUNT];
+} share_filter;
+
+void share_filter_init(share_filter * filter);
+
+uint32_t share_filter_on_notify(share_filter * filter, const char * prev_block_hash, bool clean_jobs);
+
+bool share_filter_is_stale(const share_filter * filter, uint32_t job_generation);
+
+void share_filter_record_suppressed(share_filter * filter);
+
+share_reject_reason share_filter_classify_reject(int error_code, const char * error_str);
+
+void share_filter_record_reject(share_filter * filter, share_reject_reason reason);
+
+const char * share_filter_reject_reason_str(share_reject_reason reason);
+
+#endif /* SHARE_FILTER_H_ */
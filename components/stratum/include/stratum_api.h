@@ -2,6 +2,7 @@
 #define STRATUM_API_H
 
 #include "cJSON.h"
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -9,6 +10,10 @@
 #define HASH_SIZE 32
 #define COINBASE_SIZE 100
 #define COINBASE2_SIZE 128
+#define MAX_REQUEST_IDS 1024
+// Longest stratum line accepted when no budget is configured; covers a notify with
+// MAX_MERKLE_BRANCHES branches and a coinbase far larger than any pool sends
+#define STRATUM_DEFAULT_MAX_LINE_LENGTH 16384
 
 typedef enum
 {
@@ -16,6 +21,7 @@ typedef enum
     MINING_NOTIFY,
     MINING_SET_DIFFICULTY,
     MINING_SET_VERSION_MASK,
+    MINING_SET_EXTRANONCE,
     STRATUM_RESULT,
     STRATUM_RESULT_SETUP,
     STRATUM_RESULT_VERSION_MASK,
@@ -38,9 +44,26 @@ typedef struct
     uint32_t version_mask;
     uint32_t target;
     uint32_t ntime;
-    uint32_t difficulty;
+    double difficulty; // fractional pool difficulties are allowed
+    uint32_t generation;
+    int64_t received_us; // local time the notify arrived, bounds ntime rolling
 } mining_notify;
 
+typedef struct
+{
+    int64_t timestamp_us;
+    bool tracking;
+} RequestTiming;
+
+typedef struct
+{
+    size_t max_line_length;
+    size_t buffer_high_water;
+    uint32_t lines_received;
+    uint32_t lines_dropped;
+    uint32_t malformed_messages;
+} StratumRxStats;
+
 typedef struct
 {
     char * extranonce_str;
@@ -54,33 +77,42 @@ typedef struct
     int should_abandon_work;
     mining_notify *mining_notification;
     // mining.set_difficulty
-    uint32_t new_difficulty;
+    double new_difficulty;
     // mining.set_version_mask
     uint32_t version_mask;
     // result
     bool response_success;
+    int error_code;
     char * error_str;
 } StratumApiV1Message;
 
-void STRATUM_V1_reset_uid();
+void STRATUM_V1_stamp_tx(int request_id);
+
+double STRATUM_V1_get_response_time_ms(int request_id);
+
+void STRATUM_V1_initialize_buffer(size_t max_line_length);
 
-void STRATUM_V1_initialize_buffer();
+void STRATUM_V1_reset_buffer();
 
 char *STRATUM_V1_receive_jsonrpc_line(int sockfd);
 
-int STRATUM_V1_subscribe(int socket, char * model);
+void STRATUM_V1_get_rx_stats(StratumRxStats *stats);
+
+int STRATUM_V1_subscribe(int socket, int send_uid, const char * model);
 
 void STRATUM_V1_parse(StratumApiV1Message *message, const char *stratum_json);
 
 void STRATUM_V1_free_mining_notify(mining_notify *params);
 
-int STRATUM_V1_authenticate(int socket, const char *username, const char *pass);
+int STRATUM_V1_authorize(int socket, int send_uid, const char *username, const char *pass);
+
+int STRATUM_V1_extranonce_subscribe(int socket, int send_uid);
 
-int STRATUM_V1_configure_version_rolling(int socket, uint32_t * version_mask);
+int STRATUM_V1_configure_version_rolling(int socket, int send_uid, uint32_t version_mask, int min_bit_count);
 
-int STRATUM_V1_suggest_difficulty(int socket, uint32_t difficulty);
+int STRATUM_V1_suggest_difficulty(int socket, int send_uid, uint32_t difficulty);
 
-int STRATUM_V1_submit_share(int socket, const char *username, const char *jobid,
+int STRATUM_V1_submit_share(int socket, int send_uid, const char *username, const char *jobid,
                             const char *extranonce_2, const uint32_t ntime, const uint32_t nonce,
                             const uint32_t version);
 
@@ -0,0 +1,59 @@
+#ifndef UINT256_H_
+#define UINT256_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Unsigned 256-bit integer in 32-bit limbs, w[0] least significant, the same layout as
+// Bitcoin Core's arith_uint256. Hashes compare against targets as little-endian numbers.
+typedef struct
+{
+    uint32_t w[8];
+} uint256_t;
+
+// A target with its leading zero count cached: a hash with more leading zeros always meets
+// it and one with fewer never does, so only hashes right at the boundary need a full compare
+typedef struct
+{
+    uint256_t value;
+    int leading_zeros;
+} uint256_target;
+
+void uint256_set_u64(uint256_t * r, uint64_t v);
+void uint256_set_max(uint256_t * r);
+void uint256_from_le_bytes(uint256_t * r, const uint8_t bytes[32]);
+void uint256_to_le_bytes(const uint256_t * a, uint8_t bytes[32]);
+
+// Big-endian hex as printed by block explorers, at most 64 digits; false on other characters
+bool uint256_set_hex(uint256_t * r, const char * hex);
+
+bool uint256_is_zero(const uint256_t * a);
+int uint256_cmp(const uint256_t * a, const uint256_t * b);
+int uint256_leading_zeros(const uint256_t * a);
+
+void uint256_shl(uint256_t * r, const uint256_t * a, unsigned int shift);
+void uint256_shr(uint256_t * r, const uint256_t * a, unsigned int shift);
+void uint256_sub(uint256_t * r, const uint256_t * a, const uint256_t * b);
+// Quotient of a / b; b must not be zero
+void uint256_div(uint256_t * q, const uint256_t * a, const uint256_t * b);
+double uint256_to_double(const uint256_t * a);
+
+// nBits compact encoding with Bitcoin Core's SetCompact/GetCompact semantics
+void uint256_set_compact(uint256_t * r, uint32_t compact, bool * negative, bool * overflow);
+uint32_t uint256_get_compact(const uint256_t * a, bool negative);
+
+// Difficulty 1 target, 0xFFFF << 208
+void uint256_difficulty_one(uint256_t * r);
+
+// Target for a share difficulty, fractional difficulties included; saturates below difficulty 2^-32
+void uint256_from_difficulty(uint256_t * target, double difficulty);
+
+// Difficulty of a hash or target: difficulty 1 target / value
+double uint256_to_difficulty(const uint256_t * value);
+
+void uint256_target_init(uint256_target * target, const uint256_t * value);
+
+// Whether hash is at or below target
+bool uint256_target_met(const uint256_target * target, const uint256_t * hash);
+
+#endif /* UINT256_H_ */
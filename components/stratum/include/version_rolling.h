@@ -0,0 +1,26 @@
+#ifndef VERSION_ROLLING_H_
+#define VERSION_ROLLING_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "utils.h"
+
+// Bits we ask the pool for in mining.configure: the BIP320 general purpose bits,
+// which is also the field every BM13xx version rolling register covers
+#define VERSION_ROLLING_REQUEST_MASK STRATUM_DEFAULT_VERSION_MASK
+
+// BIP310 version-rolling.min-bit-count. Two bits are what the BM1397 needs to
+// hash four midstates per job; newer chips roll versions on-chip and use more.
+#define VERSION_ROLLING_MIN_BIT_COUNT 2
+
+#define VERSION_ROLLING_MAX_MIDSTATES 4
+
+int version_rolling_bit_count(uint32_t mask);
+
+uint32_t version_rolling_negotiate(uint32_t requested_mask, uint32_t pool_mask);
+
+uint8_t version_rolling_midstate_count(uint32_t mask);
+
+bool version_rolling_is_allowed(uint32_t version, uint32_t rolled_version, uint32_t mask);
+
+#endif /* VERSION_ROLLING_H_ */
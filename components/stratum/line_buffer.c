@@ -0,0 +1,169 @@
+#include <stdlib.h>
+#include <string.h>
+#include "line_buffer.h"
+
+bool line_buffer_init(line_buffer * buffer, size_t chunk_size, size_t max_line_length)
+{
+    memset(buffer, 0, sizeof(*buffer));
+    buffer->chunk_size = chunk_size;
+    buffer->max_line_length = max_line_length < chunk_size ? chunk_size : max_line_length;
+    buffer->data = malloc(chunk_size);
+    if (buffer->data == NULL) {
+        return false;
+    }
+    buffer->capacity = chunk_size;
+    buffer->high_water = chunk_size;
+    return true;
+}
+
+void line_buffer_free(line_buffer * buffer)
+{
+    free(buffer->data);
+    buffer->data = NULL;
+    buffer->capacity = 0;
+    buffer->len = 0;
+}
+
+/**
+ * Drop everything held and give back whatever was grown beyond one chunk
+ * Used after a disconnect so a single large line does not pin heap for the next session
+ */
+void line_buffer_reset(line_buffer * buffer)
+{
+    buffer->len = 0;
+    buffer->partial_start = 0;
+    buffer->discarding = false;
+    if (buffer->capacity > buffer->chunk_size) {
+        char * shrunk = realloc(buffer->data, buffer->chunk_size);
+        if (shrunk != NULL) {
+            buffer->data = shrunk;
+            buffer->capacity = buffer->chunk_size;
+        }
+    }
+}
+
+// Grow in chunk_size steps, never past one max length line plus one receive chunk
+static bool line_buffer_reserve(line_buffer * buffer, size_t needed)
+{
+    if (needed <= buffer->capacity) {
+        return true;
+    }
+
+    size_t limit = buffer->max_line_length + buffer->chunk_size;
+    size_t capacity = ((needed + buffer->chunk_size - 1) / buffer->chunk_size) * buffer->chunk_size;
+    if (capacity > limit) {
+        capacity = limit;
+    }
+    if (capacity < needed) {
+        return false;
+    }
+
+    char * grown = realloc(buffer->data, capacity);
+    if (grown == NULL) {
+        return false;
+    }
+    buffer->data = grown;
+    buffer->capacity = capacity;
+    if (capacity > buffer->high_water) {
+        buffer->high_water = capacity;
+    }
+    return true;
+}
+
+// Forget the unfinished line and skip input until the next newline
+static void line_buffer_drop_partial(line_buffer * buffer)
+{
+    buffer->len = buffer->partial_start;
+    buffer->discarding = true;
+    buffer->dropped_lines++;
+}
+
+/**
+ * Add received bytes to the buffer
+ *
+ * Complete lines are kept for line_buffer_next_line(). The unfinished tail is capped at
+ * max_line_length: once it goes over, it is thrown away together with the rest of that
+ * line as it arrives, and assembly resumes after the next newline.
+ *
+ * @return LINE_BUFFER_OK, or the reason part of the input was dropped
+ */
+line_buffer_status line_buffer_append(line_buffer * buffer, const char * data, size_t len)
+{
+    line_buffer_status status = LINE_BUFFER_OK;
+
+    while (len > 0) {
+        const char * newline = memchr(data, '\n', len);
+        size_t segment = newline != NULL ? (size_t) (newline - data) + 1 : len;
+
+        if (buffer->discarding) {
+            if (newline != NULL) {
+                buffer->discarding = false;
+            }
+            data += segment;
+            len -= segment;
+            continue;
+        }
+
+        size_t line_length = buffer->len - buffer->partial_start + segment - (newline != NULL ? 1 : 0);
+        if (line_length > buffer->max_line_length) {
+            line_buffer_drop_partial(buffer);
+            status = LINE_BUFFER_OVERSIZED;
+            continue;
+        }
+
+        if (!line_buffer_reserve(buffer, buffer->len + segment)) {
+            line_buffer_drop_partial(buffer);
+            status = LINE_BUFFER_NO_MEMORY;
+            continue;
+        }
+
+        memcpy(buffer->data + buffer->len, data, segment);
+        buffer->len += segment;
+        if (newline != NULL) {
+            buffer->partial_start = buffer->len;
+        }
+        data += segment;
+        len -= segment;
+    }
+
+    return status;
+}
+
+/**
+ * Pop the next complete line
+ * Empty lines are skipped and a trailing '\r' is stripped
+ *
+ * @return Heap allocated line the caller must free, or NULL when no complete line is buffered
+ */
+char * line_buffer_next_line(line_buffer * buffer)
+{
+    while (buffer->partial_start > 0) {
+        char * newline = memchr(buffer->data, '\n', buffer->partial_start);
+        size_t consumed = (size_t) (newline - buffer->data) + 1;
+        size_t length = consumed - 1;
+        if (length > 0 && buffer->data[length - 1] == '\r') {
+            length--;
+        }
+
+        char * line = NULL;
+        if (length > 0) {
+            line = malloc(length + 1);
+            if (line != NULL) {
+                memcpy(line, buffer->data, length);
+                line[length] = '\0';
+                buffer->lines++;
+            } else {
+                buffer->dropped_lines++;
+            }
+        }
+
+        memmove(buffer->data, buffer->data + consumed, buffer->len - consumed);
+        buffer->len -= consumed;
+        buffer->partial_start -= consumed;
+
+        if (line != NULL) {
+            return line;
+        }
+    }
+    return NULL;
+}
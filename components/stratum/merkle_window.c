@@ -0,0 +1,130 @@
+#include <stdlib.h>
+#include <string.h>
+#include "merkle_window.h"
+#include "mining.h"
+#include "utils.h"
+
+bool merkle_window_init(merkle_window * window, uint16_t capacity)
+{
+    memset(window, 0, sizeof(*window));
+    if (capacity > 0) {
+        window->entries = malloc(capacity * sizeof(merkle_window_entry));
+        if (window->entries == NULL) {
+            return false;
+        }
+    }
+    window->capacity = capacity;
+    return true;
+}
+
+void merkle_window_free(merkle_window * window)
+{
+    free(window->entries);
+    free(window->coinbase);
+    memset(window, 0, sizeof(*window));
+}
+
+size_t merkle_window_memory(const merkle_window * window)
+{
+    return window->capacity * sizeof(merkle_window_entry) + window->coinbase_capacity;
+}
+
+bool merkle_window_reset(merkle_window * window, mining_notify * notify, const char * extranonce_1,
+                         const extranonce2_space * space, uint32_t version_mask)
+{
+    window->head = 0;
+    window->count = 0;
+    window->extranonce_2 = *space;
+    extranonce2_space_reset(&window->extranonce_2);
+    window->notify = NULL;
+    window->version_mask = version_mask;
+
+    size_t extranonce_2_len = space->len;
+    size_t coinbase_1_len = strlen(notify->coinbase_1) / 2;
+    size_t extranonce_1_len = strlen(extranonce_1) / 2;
+    size_t coinbase_2_len = strlen(notify->coinbase_2) / 2;
+    size_t len = coinbase_1_len + extranonce_1_len + extranonce_2_len + coinbase_2_len;
+
+    // Coinbases are a similar size from one notify to the next, so the buffer is kept
+    if (len > window->coinbase_capacity) {
+        uint8_t * coinbase = realloc(window->coinbase, len);
+        if (coinbase == NULL) {
+            return false;
+        }
+        window->coinbase = coinbase;
+        window->coinbase_capacity = len;
+    }
+
+    uint8_t * p = window->coinbase;
+    hex2bin(notify->coinbase_1, p, coinbase_1_len);
+    p += coinbase_1_len;
+    hex2bin(extranonce_1, p, extranonce_1_len);
+    p += extranonce_1_len;
+    memset(p, 0, extranonce_2_len);
+    p += extranonce_2_len;
+    hex2bin(notify->coinbase_2, p, coinbase_2_len);
+
+    window->coinbase_len = len;
+    window->extranonce_2_offset = coinbase_1_len + extranonce_1_len;
+    window->notify = notify;
+    return true;
+}
+
+void merkle_window_set_version_mask(merkle_window * window, uint32_t version_mask)
+{
+    if (version_mask == window->version_mask) {
+        return;
+    }
+    window->version_mask = version_mask;
+
+    // The roots still hold, only the midstates change
+    for (uint16_t i = 0; i < window->count; i++) {
+        merkle_window_entry * entry = &window->entries[(window->head + i) % window->capacity];
+        construct_bm_job_midstates(window->notify, entry->merkle_root, version_mask, entry->midstates);
+    }
+}
+
+static void compute_entry(merkle_window * window, uint64_t extranonce_2, merkle_window_entry * entry)
+{
+    const mining_notify * notify = window->notify;
+
+    extranonce2_write(extranonce_2, window->coinbase + window->extranonce_2_offset, window->extranonce_2.len);
+    entry->extranonce_2 = extranonce_2;
+    calculate_merkle_root_bin(window->coinbase, window->coinbase_len, (const uint8_t(*)[32]) notify->merkle_branches,
+                              notify->n_merkle_branches, entry->merkle_root);
+    construct_bm_job_midstates(notify, entry->merkle_root, window->version_mask, entry->midstates);
+}
+
+bool merkle_window_fill_one(merkle_window * window)
+{
+    uint64_t extranonce_2;
+    if (window->notify == NULL || window->count >= window->capacity || !extranonce2_next(&window->extranonce_2, &extranonce_2)) {
+        return false;
+    }
+
+    uint16_t slot = (window->head + window->count) % window->capacity;
+    compute_entry(window, extranonce_2, &window->entries[slot]);
+    window->count++;
+    return true;
+}
+
+bool merkle_window_take(merkle_window * window, merkle_window_entry * entry, bool * precomputed)
+{
+    if (window->count > 0) {
+        *entry = window->entries[window->head];
+        window->head = (window->head + 1) % window->capacity;
+        window->count--;
+        window->precomputed++;
+        *precomputed = true;
+        return true;
+    }
+
+    uint64_t extranonce_2;
+    if (window->notify == NULL || !extranonce2_next(&window->extranonce_2, &extranonce_2)) {
+        return false;
+    }
+    compute_entry(window, extranonce_2, entry);
+    window->computed_inline++;
+    *precomputed = false;
+    return true;
+}
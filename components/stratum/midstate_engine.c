@@ -0,0 +1,77 @@
+#include <string.h>
+#include "midstate_engine.h"
+
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+// The mask bits of value packed down to the low bits, and the reverse
+static uint32_t extract_bits(uint32_t value, uint32_t mask)
+{
+#if defined(__BMI2__)
+    return _pext_u32(value, mask);
+#else
+    uint32_t result = 0;
+    for (uint32_t bit = 1; mask != 0; bit <<= 1, mask &= mask - 1) {
+        if (value & mask & -mask) {
+            result |= bit;
+        }
+    }
+    return result;
+#endif
+}
+
+static uint32_t deposit_bits(uint32_t value, uint32_t mask)
+{
+#if defined(__BMI2__)
+    return _pdep_u32(value, mask);
+#else
+    uint32_t result = 0;
+    for (uint32_t bit = 1; mask != 0; bit <<= 1, mask &= mask - 1) {
+        if (value & bit) {
+            result |= mask & -mask;
+        }
+    }
+    return result;
+#endif
+}
+
+void midstate_engine_init(midstate_engine * engine, const block_header_t * header, uint32_t version_mask)
+{
+    const uint8_t * bytes = (const uint8_t *) header;
+    for (int i = 0; i < SHA256_BLOCK_WORDS; i++) {
+        engine->block[i] = sha256_load_be32(bytes + i * 4);
+    }
+    engine->version = header->version;
+    engine->version_mask = version_mask;
+}
+
+uint32_t midstate_engine_version(uint32_t version, uint32_t version_mask, uint32_t index)
+{
+    // The rolled bits form a counter spread over the mask; adding index to it and putting it
+    // back is what index calls to increment_bitmask do, carries and wrap included
+    uint32_t counter = extract_bits(version, version_mask) + index;
+    return (version & ~version_mask) | deposit_bits(counter, version_mask);
+}
+
+void midstate_engine_run(const midstate_engine * engine, uint32_t first, size_t count,
+                         uint32_t (*states)[SHA256_STATE_WORDS], uint32_t * versions)
+{
+    uint32_t blocks[MIDSTATE_ENGINE_LANES][SHA256_BLOCK_WORDS];
+    uint32_t version = midstate_engine_version(engine->version, engine->version_mask, first);
+
+    for (size_t done = 0; done < count; done += MIDSTATE_ENGINE_LANES) {
+        size_t lanes = count - done < MIDSTATE_ENGINE_LANES ? count - done : MIDSTATE_ENGINE_LANES;
+        for (size_t i = 0; i < lanes; i++) {
+            memcpy(blocks[i], engine->block, sizeof(engine->block));
+            blocks[i][0] = __builtin_bswap32(version);
+            memcpy(states[done + i], SHA256_IV, SHA256_STATE_WORDS * sizeof(uint32_t));
+            if (versions != NULL) {
+                versions[done + i] = version;
+            }
+            // next version: the carry of +1 ripples through the gaps between mask bits
+            version = (version & ~engine->version_mask) | (((version | ~engine->version_mask) + 1) & engine->version_mask);
+        }
+        sha256_compress_lanes(states + done, (const uint32_t (*)[SHA256_BLOCK_WORDS]) blocks, lanes);
+    }
+}
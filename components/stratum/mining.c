@@ -5,16 +5,15 @@
 #include <time.h>
 #include "mining.h"
 #include "utils.h"
-#include "mbedtls/sha256.h"
+#include "sha256_backend.h"
+#include "version_rolling.h"
+#include "midstate_engine.h"
+#include "extranonce2.h"
 
 // ================================================================================================
 // CONSTANTS AND GLOBAL TRACKING VARIABLES
 // ================================================================================================
 
-// Bitcoin's difficulty-1 target value - used to calculate share difficulty
-// This represents the maximum target value (easiest difficulty)
-static const double truediffone = 26959535291011309493156476344723991336010898738574164086137773096960.0;
-
 // Global variables to track the best share found during mining session
 static double best_diff = 0.0;           // Highest difficulty share found
 static uint32_t best_nonce = 0;          // Nonce that produced the best share
@@ -66,6 +65,23 @@ void free_bm_job(bm_job *job) {
     free(job);              // Free the job structure itself
 }
 
+/**
+ * Take another reference to a job on the chain, so a job sent after it can take its slot
+ * while its results are still being verified or submitted
+ */
+void bm_job_retain(bm_job *job) {
+    __atomic_add_fetch(&job->refs, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * Drop a reference taken by bm_job_retain or held by the job's slot, freeing the job with the last
+ */
+void bm_job_release(bm_job *job) {
+    if (__atomic_sub_fetch(&job->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        free_bm_job(job);
+    }
+}
+
 // ================================================================================================
 // COINBASE TRANSACTION CONSTRUCTION
 // ================================================================================================
@@ -118,31 +134,56 @@ char *calculate_merkle_root_hash(const char *coinbase_tx, const uint8_t merkle_b
     uint8_t *coinbase_tx_bin = malloc(coinbase_tx_bin_len);
     hex2bin(coinbase_tx, coinbase_tx_bin, coinbase_tx_bin_len);
 
+    uint8_t merkle_root[32];
+    calculate_merkle_root_bin(coinbase_tx_bin, coinbase_tx_bin_len, merkle_branches, num_merkle_branches, merkle_root);
+    free(coinbase_tx_bin);
+
+    // Convert final merkle root to hex string for return
+    char *merkle_root_hash = malloc(65);  // 32 bytes * 2 + null terminator
+    bin2hex(merkle_root, 32, merkle_root_hash, 65);
+    return merkle_root_hash;
+}
+
+/**
+ * calculate_merkle_root_hash() on a binary coinbase, without heap allocation
+ *
+ * @param merkle_root - Receives the 32 byte root in header byte order
+ */
+void calculate_merkle_root_bin(const uint8_t *coinbase_tx, const size_t coinbase_tx_len,
+                               const uint8_t merkle_branches[][32], const int num_merkle_branches, uint8_t merkle_root[32]) {
     // Start merkle tree calculation with coinbase transaction hash
     uint8_t both_merkles[64];  // Buffer for combining two 32-byte hashes
-    uint8_t *new_root = double_sha256_bin(coinbase_tx_bin, coinbase_tx_bin_len);
-    free(coinbase_tx_bin);
-    memcpy(both_merkles, new_root, 32);  // Copy initial hash to working buffer
-    free(new_root);
+    sha256_double(coinbase_tx, coinbase_tx_len, both_merkles);
 
     // Iteratively combine with each merkle branch
     for (int i = 0; i < num_merkle_branches; i++) {
         memcpy(both_merkles + 32, merkle_branches[i], 32);  // Add next branch
-        uint8_t *new_root = double_sha256_bin(both_merkles, 64);  // Hash combined data
-        memcpy(both_merkles, new_root, 32);  // Update working hash
-        free(new_root);
+        sha256_double(both_merkles, 64, both_merkles);       // Hash combined data into the working hash
     }
 
-    // Convert final merkle root to hex string for return
-    char *merkle_root_hash = malloc(65);  // 32 bytes * 2 + null terminator
-    bin2hex(both_merkles, 32, merkle_root_hash, 65);
-    return merkle_root_hash;
+    memcpy(merkle_root, both_merkles, 32);
 }
 
 // ================================================================================================
 // MINING JOB CONSTRUCTION AND OPTIMIZATION
 // ================================================================================================
 
+/**
+ * Midstate in the byte order of the BM1397 job packet:
+ * state words serialized little-endian, then the whole 32 bytes reversed
+ */
+static void midstate_to_job_bytes(const uint32_t state[SHA256_STATE_WORDS], uint8_t *dest) {
+    for (int i = 0; i < SHA256_STATE_WORDS; i++) {
+        sha256_store_be32(dest + 28 - i * 4, state[i]);
+    }
+}
+
+static void job_bytes_to_midstate(const uint8_t *src, uint32_t state[SHA256_STATE_WORDS]) {
+    for (int i = 0; i < SHA256_STATE_WORDS; i++) {
+        state[i] = sha256_load_be32(src + 28 - i * 4);
+    }
+}
+
 /**
  * Convert mining notification parameters into optimized mining job structure
  * This is the core function that prepares data for efficient mining operations
@@ -155,10 +196,51 @@ char *calculate_merkle_root_hash(const char *coinbase_tx, const uint8_t merkle_b
  * @param params - Mining notification from pool (contains basic block data)
  * @param merkle_root - Calculated merkle root hash (hex string)
  * @param version_mask - Bitmask for version rolling (0 = disabled)
- * @param difficulty - Pool difficulty setting
  * @return Fully constructed and optimized mining job structure
  */
-bm_job construct_bm_job(mining_notify *params, const char *merkle_root, const uint32_t version_mask, const uint32_t difficulty) {
+bm_job construct_bm_job(mining_notify *params, const char *merkle_root, const uint32_t version_mask) {
+    uint8_t merkle_root_bin[32];
+    hex2bin(merkle_root, merkle_root_bin, 32);
+    return construct_bm_job_from_root(params, merkle_root_bin, version_mask, NULL);
+}
+
+/**
+ * SHA256 midstates of the header's first 64 bytes
+ * The BM1397 hashes one midstate per rolled version; how many it gets depends on
+ * how many version bits the pool granted (see version_rolling_midstate_count).
+ *
+ * @param merkle_root - Binary merkle root in header byte order
+ * @param midstates - Receives the midstates in the byte order the job packet carries them
+ * @return Number of midstates written
+ */
+uint8_t construct_bm_job_midstates(const mining_notify *params, const uint8_t merkle_root[32], const uint32_t version_mask,
+                                   uint8_t midstates[][32]) {
+    block_header_t header = {0};
+    header.version = params->version;
+    swap_endian_words(params->prev_block_hash, header.prev_block_hash);
+    memcpy(header.merkle_root, merkle_root, 32);
+
+    // All rolled versions in one batch off the same first block
+    midstate_engine engine;
+    uint32_t states[VERSION_ROLLING_MAX_MIDSTATES][SHA256_STATE_WORDS];
+    uint8_t num_midstates = version_rolling_midstate_count(version_mask);
+    midstate_engine_init(&engine, &header, version_mask);
+    midstate_engine_run(&engine, 0, num_midstates, states, NULL);
+    for (int i = 0; i < num_midstates; i++) {
+        midstate_to_job_bytes(states[i], midstates[i]);
+    }
+    return num_midstates;
+}
+
+/**
+ * construct_bm_job() from a binary merkle root, optionally with its midstates already
+ * computed by construct_bm_job_midstates() for the same notify and version mask
+ *
+ * @param merkle_root - Binary merkle root in header byte order
+ * @param midstates - Precomputed midstates, or NULL to compute them here
+ */
+bm_job construct_bm_job_from_root(mining_notify *params, const uint8_t merkle_root[32], const uint32_t version_mask,
+                                  const uint8_t midstates[][32]) {
     bm_job new_job;
     
     // Copy basic parameters from mining notification
@@ -166,12 +248,22 @@ bm_job construct_bm_job(mining_notify *params, const char *merkle_root, const ui
     new_job.target = params->target;
     new_job.ntime = params->ntime;
     new_job.starting_nonce = 0;
-    new_job.pool_diff = difficulty;
-
-    // Convert merkle root to binary and handle endianness
-    hex2bin(merkle_root, new_job.merkle_root, 32);
-    swap_endian_words(merkle_root, new_job.merkle_root_be);
-    reverse_bytes(new_job.merkle_root_be, 32);
+    new_job.pool_diff = params->difficulty;
+
+    // Share and block targets, so each nonce is classified by integer compare
+    uint256_t target;
+    uint256_from_difficulty(&target, params->difficulty);
+    uint256_target_init(&new_job.pool_target, &target);
+    uint256_set_compact(&target, params->target, NULL, NULL);
+    uint256_target_init(&new_job.network_target, &target);
+    new_job.generation = params->generation;  // Lets the result path spot shares made stale by a newer notify
+    new_job.notify_us = params->received_us;  // Lets the ASIC task tell how old the template is on the chips
+
+    // Merkle root as hashed, and with its words in reverse order for the BM1366 family
+    memcpy(new_job.merkle_root, merkle_root, 32);
+    for (int i = 0; i < 8; i++) {
+        memcpy(new_job.merkle_root_be + 28 - i * 4, merkle_root + i * 4, 4);
+    }
 
     // Convert previous block hash and handle endianness  
     swap_endian_words(params->prev_block_hash, new_job.prev_block_hash);
@@ -179,47 +271,64 @@ bm_job construct_bm_job(mining_notify *params, const char *merkle_root, const ui
     reverse_bytes(new_job.prev_block_hash_be, 32);
 
     // *** MIDSTATE OPTIMIZATION ***
-    // Pre-compute SHA256 midstate for the first 64 bytes of block header
-    // This avoids repeating the same hash operations for every nonce test
-    uint8_t midstate_data[64];
-    memcpy(midstate_data, &new_job.version, 4);           // Bytes 0-3: Version
-    memcpy(midstate_data + 4, new_job.prev_block_hash, 32); // Bytes 4-35: Previous block hash
-    memcpy(midstate_data + 36, new_job.merkle_root, 28);   // Bytes 36-63: First 28 bytes of merkle root
-
-    // Compute and store the midstate (partial SHA256 state)
-    midstate_sha256_bin(midstate_data, 64, new_job.midstate);
-    reverse_bytes(new_job.midstate, 32);  // Reverse for hardware compatibility
-
-    // *** VERSION ROLLING SUPPORT ***
-    // Generate additional midstates for different version values
-    // This allows mining multiple version variations in parallel
-    if (version_mask != 0) {
-        // Generate midstate for version + 1
-        uint32_t rolled_version = increment_bitmask(new_job.version, version_mask);
-        memcpy(midstate_data, &rolled_version, 4);
-        midstate_sha256_bin(midstate_data, 64, new_job.midstate1);
-        reverse_bytes(new_job.midstate1, 32);
-
-        // Generate midstate for version + 2
-        rolled_version = increment_bitmask(rolled_version, version_mask);
-        memcpy(midstate_data, &rolled_version, 4);
-        midstate_sha256_bin(midstate_data, 64, new_job.midstate2);
-        reverse_bytes(new_job.midstate2, 32);
-
-        // Generate midstate for version + 3
-        rolled_version = increment_bitmask(rolled_version, version_mask);
-        memcpy(midstate_data, &rolled_version, 4);
-        midstate_sha256_bin(midstate_data, 64, new_job.midstate3);
-        reverse_bytes(new_job.midstate3, 32);
-
-        new_job.num_midstates = 4;  // We have 4 midstates available
-    } else {
-        new_job.num_midstates = 1;  // Only base midstate available
+    // Pre-compute SHA256 midstates for the first 64 bytes of block header
+    // This avoids repeating the same hash operations for every nonce test.
+    // *** VERSION ROLLING SUPPORT ***: one midstate per rolled version
+    uint8_t computed[VERSION_ROLLING_MAX_MIDSTATES][32];
+    new_job.version_mask = version_mask;
+    new_job.num_midstates = version_rolling_midstate_count(version_mask);
+    if (midstates == NULL) {
+        construct_bm_job_midstates(params, merkle_root, version_mask, computed);
+        midstates = (const uint8_t (*)[32]) computed;
     }
+    memcpy(new_job.midstates, midstates, new_job.num_midstates * sizeof(new_job.midstates[0]));
+    for (int i = 0; i < new_job.num_midstates; i++) {
+        new_job.midstate_versions[i] = midstate_engine_version(params->version, version_mask, i);
+    }
+    new_job.verify_cached = false;
 
     return new_job;
 }
 
+/**
+ * Derive a job from one built by construct_bm_job with a different ntime
+ * ntime sits in the second SHA256 block of the header, so the midstates, the cached
+ * verification state and the targets all carry over and no hashing is needed.
+ *
+ * @param job - Job to roll; its jobid and extranonce2 are not copied
+ * @param ntime - ntime for the new job, within what the pool accepts
+ */
+bm_job construct_bm_job_rolled_ntime(const bm_job *job, const uint32_t ntime) {
+    bm_job new_job = *job;
+    new_job.ntime = ntime;
+    new_job.jobid = NULL;
+    new_job.extranonce2 = NULL;
+    return new_job;
+}
+
+/**
+ * Version the ASIC rolled a result to, from the midstate index it reports
+ * Table lookup for the job's own midstates; an index past them is rolled the same way.
+ */
+uint32_t bm_job_midstate_version(const bm_job *job, const uint8_t midstate_index) {
+    if (midstate_index < job->num_midstates) {
+        return job->midstate_versions[midstate_index];
+    }
+    return midstate_engine_version(job->version, job->version_mask, midstate_index);
+}
+
+/**
+ * The header a job's nonce is hashed as, for rolled_version
+ */
+void construct_block_header(const bm_job *job, const uint32_t rolled_version, const uint32_t nonce, block_header_t *header) {
+    header->version = rolled_version;
+    memcpy(header->prev_block_hash, job->prev_block_hash, 32);
+    memcpy(header->merkle_root, job->merkle_root, 32);
+    header->ntime = job->ntime;
+    header->nbits = job->target;
+    header->nonce = nonce;
+}
+
 // ================================================================================================
 // UTILITY FUNCTIONS
 // ================================================================================================
@@ -233,30 +342,45 @@ bm_job construct_bm_job(mining_notify *params, const char *merkle_root, const ui
  * @return Dynamically allocated hex string with zero padding
  */
 char *extranonce_2_generate(uint32_t extranonce_2, uint32_t length) {
-    // Allocate string buffer (2 hex chars per byte + null terminator)
-    char *extranonce_2_str = malloc(length * 2 + 1);
-    
-    // Initialize with zeros for proper padding
-    memset(extranonce_2_str, '0', length * 2);
-    extranonce_2_str[length * 2] = '\0';
-    
-    // Convert binary value to hex string (overwrites trailing zeros)
-    bin2hex((uint8_t *)&extranonce_2, length, extranonce_2_str, length * 2 + 1);
-    
-    return extranonce_2_str;
+    // Little-endian and zero padded, so lengths past 4 bytes never read beyond the value
+    return extranonce2_to_hex(extranonce_2, length);
 }
 
 // ================================================================================================
 // CORE MINING ALGORITHM - NONCE TESTING AND VALIDATION
 // ================================================================================================
 
+/**
+ * First-block SHA256 state of the header for rolled_version
+ * The versions the BM1397 midstates were built for are read straight from the job; any other
+ * version is compressed once and kept in the job, since an ASIC returns several nonces per
+ * version before moving on.
+ */
+static void job_first_block_state(bm_job *job, uint32_t rolled_version, uint32_t state[SHA256_STATE_WORDS]) {
+    for (int i = 0; i < job->num_midstates; i++) {
+        if (job->midstate_versions[i] == rolled_version) {
+            job_bytes_to_midstate(job->midstates[i], state);
+            return;
+        }
+    }
+
+    if (!job->verify_cached || job->verify_version != rolled_version) {
+        block_header_t header;
+        construct_block_header(job, rolled_version, 0, &header);
+        block_header_midstate(&header, job->verify_state);
+        job->verify_version = rolled_version;
+        job->verify_cached = true;
+    }
+    memcpy(state, job->verify_state, sizeof(job->verify_state));
+}
+
 /**
  * Test a specific nonce value and calculate its difficulty
  * This is the core mining function that validates potential solutions
  * 
  * Process:
- * 1. Construct complete 80-byte block header with the nonce
- * 2. Perform double SHA256 hash (Bitcoin's proof-of-work algorithm)
+ * 1. Start from the cached state of the first 64 header bytes
+ * 2. Compress the 16 byte header tail (merkle root end, time, bits, nonce) and hash the result again
  * 3. Convert hash result to difficulty value
  * 4. Log and track valid shares (difficulty > 1.0)
  * 
@@ -265,51 +389,149 @@ char *extranonce_2_generate(uint32_t extranonce_2, uint32_t length) {
  * @param rolled_version - Version value (may be rolled for version rolling)
  * @return Calculated difficulty (>1.0 indicates valid share, higher = better)
  */
-double test_nonce_value(const bm_job *job, const uint32_t nonce, const uint32_t rolled_version) {
-    double d64, s64, ds;
-    unsigned char header[80];  // Bitcoin block header is exactly 80 bytes
-
-    // *** CONSTRUCT BLOCK HEADER ***
-    // Bitcoin block header format (80 bytes total):
-    memcpy(header, &rolled_version, 4);           // Bytes 0-3: Block version
-    memcpy(header + 4, job->prev_block_hash, 32); // Bytes 4-35: Previous block hash
-    memcpy(header + 36, job->merkle_root, 32);    // Bytes 36-67: Merkle root hash
-    memcpy(header + 68, &job->ntime, 4);          // Bytes 68-71: Timestamp
-    memcpy(header + 72, &job->target, 4);         // Bytes 72-75: Difficulty target
-    memcpy(header + 76, &nonce, 4);               // Bytes 76-79: Nonce (what we're testing)
-
-    // *** BITCOIN PROOF-OF-WORK CALCULATION ***
-    // Bitcoin uses double SHA256 for proof-of-work
-    unsigned char hash_buffer[32];   // Buffer for first hash
-    unsigned char hash_result[32];   // Buffer for final hash
-    
-    mbedtls_sha256(header, 80, hash_buffer, 0);      // First SHA256
-    mbedtls_sha256(hash_buffer, 32, hash_result, 0); // Second SHA256
+double test_nonce_value(bm_job *job, const uint32_t nonce, const uint32_t rolled_version) {
+    return test_nonce_value_ticket(job, nonce, rolled_version, 0);
+}
+
+/**
+ * test_nonce_value() with an early exit for nonces that cannot meet the ASIC ticket difficulty
+ * Such nonces are hardware errors; they are rejected on the top 64 bits of the hash
+ * before any floating point work.
+ *
+ * @param ticket_difficulty - Difficulty the ASIC was told to report at, 0 to always compute
+ * @return Calculated difficulty, or 0.0 when the hash is above the ticket target
+ */
+double test_nonce_value_ticket(bm_job *job, const uint32_t nonce, const uint32_t rolled_version, const uint32_t ticket_difficulty) {
+    return test_nonce_result(job, nonce, rolled_version, ticket_difficulty).difficulty;
+}
+
+/**
+ * Second block of the header: bytes 64-79 plus the constant padding of an 80 byte message
+ * Same as block_header_tail_block, straight from the job so no header is assembled per nonce.
+ */
+static void header_tail_block(const bm_job *job, const uint32_t nonce, uint32_t block[SHA256_BLOCK_WORDS]) {
+    block[0] = sha256_load_be32(job->merkle_root + 28);
+    block[1] = sha256_load_be32((const uint8_t *) &job->ntime);
+    block[2] = sha256_load_be32((const uint8_t *) &job->target);
+    block[3] = sha256_load_be32((const uint8_t *) &nonce);
+    memcpy(block + 4, SHA256_PAD_80, sizeof(SHA256_PAD_80));
+}
+
+/**
+ * Second hash input: the 32 byte digest is the state words in big-endian order, so they feed straight in
+ */
+static void digest_block(const uint32_t state[SHA256_STATE_WORDS], uint32_t block[SHA256_BLOCK_WORDS]) {
+    memcpy(block, state, SHA256_STATE_WORDS * sizeof(uint32_t));
+    memcpy(block + SHA256_STATE_WORDS, SHA256_PAD_32, sizeof(SHA256_PAD_32));
+}
+
+/**
+ * Ticket check, target classification and best-share tracking for a finished header hash
+ */
+static nonce_result classify_nonce(bm_job *job, const uint32_t nonce, const uint32_t rolled_version,
+                                   const uint32_t hash[SHA256_STATE_WORDS], const uint32_t ticket_difficulty) {
+    nonce_result result = {0};
+
+    // The hash is read as a little-endian 256-bit number, so each limb is a digest word byte-swapped
+    uint256_t value;
+    for (int i = 0; i < SHA256_STATE_WORDS; i++) {
+        value.w[i] = flip32(hash[i]);
+    }
+
+    // *** TICKET CHECK ***
+    // Difficulty 1 is 0xFFFF0000 in the top 64 bits, so anything above
+    // 0xFFFF0000 / ticket_difficulty there cannot reach the ticket.
+    if (ticket_difficulty > 0) {
+        uint64_t top = ((uint64_t) value.w[7] << 32) | value.w[6];
+        if (top > 0xFFFF0000ULL / ticket_difficulty) {
+            return result;
+        }
+    }
+
+    result.pool_share = uint256_target_met(&job->pool_target, &value);
+    result.block = uint256_target_met(&job->network_target, &value);
 
     // *** DIFFICULTY CALCULATION ***
-    // Difficulty = truediffone / hash_value
+    // Difficulty = difficulty 1 target / hash value
     // Higher difficulty means smaller hash value (more leading zeros)
-    d64 = truediffone;                    // Maximum target (difficulty 1)
-    s64 = le256todouble(hash_result);     // Convert hash to double (little-endian)
-    ds = d64 / s64;                       // Calculate actual difficulty
+    result.difficulty = uint256_to_difficulty(&value);
 
     // *** SHARE VALIDATION AND TRACKING ***
     // Any difficulty > 1.0 is considered a valid share
-    if (ds > 1.0) {
-        log_share(ds, nonce, job->midstate, "DIFF");  // Log the valid share
+    if (result.difficulty > 1.0) {
+        log_share(result.difficulty, nonce, job->midstates[0], "DIFF");  // Log the valid share
         
         // Update best share tracking if this is better than previous best
-        if (ds > best_diff) {
-            best_diff = ds;
+        if (result.difficulty > best_diff) {
+            best_diff = result.difficulty;
             best_nonce = nonce;
             best_version = rolled_version;
             // Note: best_extranonce2 would need to be passed in to track properly
         }
     }
     
-    return ds;  // Return calculated difficulty
+    return result;
+}
+
+/**
+ * Hash a nonce and classify it against the job's pool and network targets
+ * The classification is an exact integer compare against targets precomputed in
+ * construct_bm_job; the difficulty is only for logs and best-share tracking.
+ *
+ * @param ticket_difficulty - Difficulty the ASIC was told to report at, 0 to always compute
+ */
+nonce_result test_nonce_result(bm_job *job, const uint32_t nonce, const uint32_t rolled_version, const uint32_t ticket_difficulty) {
+    uint32_t state[SHA256_STATE_WORDS];
+    uint32_t block[SHA256_BLOCK_WORDS];
+
+    // *** FIRST HASH, SECOND BLOCK ***
+    job_first_block_state(job, rolled_version, state);
+    header_tail_block(job, nonce, block);
+    sha256_compress(state, block);
+
+    // *** SECOND HASH ***
+    uint32_t hash[SHA256_STATE_WORDS];
+    memcpy(hash, SHA256_IV, sizeof(hash));
+    digest_block(state, block);
+    sha256_compress(hash, block);
+
+    return classify_nonce(job, nonce, rolled_version, hash, ticket_difficulty);
 }
 
+/**
+ * test_nonce_result() for many nonces at once
+ * Both compressions of every nonce go through sha256_compress_lanes, NONCE_BATCH_LANES at a
+ * time, so a backend with a multi-lane kernel hashes a burst of results together. Checks for
+ * the same job should be adjacent so its first-block state cache is reused.
+ */
+void test_nonce_batch(const nonce_check *checks, const size_t count, const uint32_t ticket_difficulty, nonce_result *results) {
+    uint32_t states[NONCE_BATCH_LANES][SHA256_STATE_WORDS];
+    uint32_t blocks[NONCE_BATCH_LANES][SHA256_BLOCK_WORDS];
+    uint32_t hashes[NONCE_BATCH_LANES][SHA256_STATE_WORDS];
+
+    for (size_t done = 0; done < count; done += NONCE_BATCH_LANES) {
+        size_t lanes = count - done < NONCE_BATCH_LANES ? count - done : NONCE_BATCH_LANES;
+        const nonce_check *batch = checks + done;
+
+        for (size_t i = 0; i < lanes; i++) {
+            job_first_block_state(batch[i].job, batch[i].rolled_version, states[i]);
+            header_tail_block(batch[i].job, batch[i].nonce, blocks[i]);
+        }
+        sha256_compress_lanes(states, (const uint32_t (*)[SHA256_BLOCK_WORDS]) blocks, lanes);
+
+        for (size_t i = 0; i < lanes; i++) {
+            memcpy(hashes[i], SHA256_IV, sizeof(hashes[i]));
+            digest_block(states[i], blocks[i]);
+        }
+        sha256_compress_lanes(hashes, (const uint32_t (*)[SHA256_BLOCK_WORDS]) blocks, lanes);
+
+        for (size_t i = 0; i < lanes; i++) {
+            results[done + i] = classify_nonce(batch[i].job, batch[i].nonce, batch[i].rolled_version, hashes[i], ticket_difficulty);
+        }
+    }
+}
+
+
 // ================================================================================================
 // VERSION ROLLING UTILITY
 // ================================================================================================
@@ -333,20 +555,10 @@ uint32_t increment_bitmask(const uint32_t value, const uint32_t mask) {
     if (mask == 0)
         return value;
 
-    // Increment the least significant bit set in the mask
-    uint32_t carry = (value & mask) + (mask & -mask);
-    
-    // Check for overflow outside the mask boundaries
-    uint32_t overflow = carry & ~mask;
-    
-    // Combine unchanged bits with new incremented bits
-    uint32_t new_value = (value & ~mask) | (carry & mask);
+    // Setting every bit outside the mask makes the carry of +1 ripple straight through the
+    // gaps between mask bits, and wrap around to zero once all mask bits are set
+    uint32_t rolled = ((value | ~mask) + 1) & mask;
 
-    // Handle carry propagation to higher bits if needed
-    if (overflow > 0) {
-        uint32_t carry_mask = (overflow << 1);  // Shift overflow to next bit position
-        new_value = increment_bitmask(new_value, carry_mask);  // Recursively handle carry
-    }
-
-    return new_value;
+    // Combine unchanged bits with new incremented bits
+    return (value & ~mask) | rolled;
 }
@@ -0,0 +1,20 @@
+#include "ntime_roll.h"
+
+void ntime_window_init(ntime_window * window, uint32_t ntime, int64_t received_us, uint32_t max_ahead)
+{
+    window->ntime = ntime;
+    window->received_us = received_us;
+    window->max_ahead = max_ahead;
+}
+
+uint32_t ntime_window_max(const ntime_window * window, int64_t now_us)
+{
+    int64_t elapsed = now_us > window->received_us ? (now_us - window->received_us) / 1000000 : 0;
+    return window->ntime + (uint32_t) elapsed + window->max_ahead;
+}
+
+bool ntime_window_allows(const ntime_window * window, uint32_t ntime, int64_t now_us)
+{
+    // ntime is unsigned and wraps in 2106; compare as offsets from the notify
+    return ntime - window->ntime <= ntime_window_max(window, now_us) - window->ntime;
+}
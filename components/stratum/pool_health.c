@@ -0,0 +1,308 @@
+#include <string.h>
+#include <math.h>
+#include "pool_health.h"
+
+// ================================================================================================
+// SCORING CONSTANTS
+// ================================================================================================
+
+// EWMA smoothing factors - connects are rare so they move the average quickly,
+// share outcomes are frequent so a single reject only nudges it
+#define CONNECT_ALPHA 0.25f
+#define SHARE_ALPHA 0.05f
+#define RTT_ALPHA 0.2f
+
+// Acceptance reaches zero once this fraction of submits come back rejected or stale
+#define BAD_RATIO_ZERO 0.5f
+
+// Slow submit round trips can at most halve the score - late shares show up as stales anyway
+#define RTT_FLOOR 0.5f
+
+// RTT and notify age fall linearly from full marks at the target to zero at this multiple of it
+#define RTT_ZERO_MULTIPLE 4.0f
+#define NOTIFY_ZERO_MULTIPLE 3.0f
+
+// ================================================================================================
+// HELPERS
+// ================================================================================================
+
+static float clampf(float value, float lo, float hi)
+{
+    if (value < lo) return lo;
+    if (value > hi) return hi;
+    return value;
+}
+
+/**
+ * Linear falloff: 1.0 at or below target, 0.0 at or above target * zero_multiple
+ */
+static float falloff(float value, float target, float zero_multiple)
+{
+    if (target <= 0.0f || value <= target) {
+        return 1.0f;
+    }
+    return clampf(1.0f - (value - target) / (target * (zero_multiple - 1.0f)), 0.0f, 1.0f);
+}
+
+static float ewma(float average, float sample, float alpha)
+{
+    return average + alpha * (sample - average);
+}
+
+// ================================================================================================
+// POLICY AND STATE
+// ================================================================================================
+
+/**
+ * Fill a policy with conservative defaults
+ * The gap between fail_score and return_score is the hysteresis band that stops flapping
+ */
+void pool_health_policy_default(pool_health_policy * policy)
+{
+    policy->fail_score = 40;
+    policy->return_score = 70;
+    policy->switch_margin = 15;
+    policy->max_connect_failures = 3;
+    policy->min_dwell_ms = 120000;
+    policy->notify_interval_ms = 60000;
+    policy->rtt_target_ms = 500;
+}
+
+static void pool_health_reset(pool_health * pool)
+{
+    memset(pool, 0, sizeof(*pool));
+    pool->connect_success = 1.0f;
+    pool->score = 100.0f;
+    pool->connect_score = 100.0f;
+    pool->rtt_score = 100.0f;
+    pool->reject_score = 100.0f;
+    pool->freshness_score = 100.0f;
+    pool->stale_score = 100.0f;
+}
+
+/**
+ * Reset both pools to a clean slate and start on the primary
+ *
+ * @param monitor - Monitor to initialize
+ * @param policy - Switching policy, copied into the monitor
+ * @param now_us - Current time in microseconds
+ */
+void pool_health_init(pool_health_monitor * monitor, const pool_health_policy * policy, int64_t now_us)
+{
+    memset(monitor, 0, sizeof(*monitor));
+    for (int i = 0; i < POOL_HEALTH_POOL_COUNT; i++) {
+        pool_health_reset(&monitor->pools[i]);
+    }
+    monitor->policy = *policy;
+    monitor->active = POOL_HEALTH_PRIMARY;
+    monitor->active_since_us = now_us;
+    monitor->last_switch_reason = POOL_SWITCH_NONE;
+}
+
+// ================================================================================================
+// EVENT RECORDING
+// ================================================================================================
+
+/**
+ * Record the outcome of a connection attempt (session connect or heartbeat probe)
+ */
+void pool_health_record_connect(pool_health * pool, bool success)
+{
+    pool->connect_attempts++;
+    pool->connect_success = ewma(pool->connect_success, success ? 1.0f : 0.0f, CONNECT_ALPHA);
+
+    if (success) {
+        pool->consecutive_connect_failures = 0;
+        return;
+    }
+
+    pool->connect_failures++;
+    pool->consecutive_connect_failures++;
+}
+
+/**
+ * Mark the pool as holding the live mining session
+ * Notify freshness is measured from this point until the first notify arrives
+ */
+void pool_health_record_session(pool_health * pool, int64_t now_us)
+{
+    pool->connected = true;
+    pool->connected_us = now_us;
+    pool->last_notify_us = 0;
+}
+
+void pool_health_record_disconnect(pool_health * pool)
+{
+    pool->connected = false;
+}
+
+void pool_health_record_notify(pool_health * pool, int64_t now_us)
+{
+    pool->last_notify_us = now_us;
+}
+
+/**
+ * Record a share response
+ *
+ * @param rtt_ms - Submit round trip in milliseconds, negative when unknown
+ */
+void pool_health_record_share(pool_health * pool, pool_share_result result, double rtt_ms)
+{
+    switch (result) {
+        case POOL_SHARE_ACCEPTED:
+            pool->shares_accepted++;
+            break;
+        case POOL_SHARE_REJECTED:
+            pool->shares_rejected++;
+            break;
+        case POOL_SHARE_STALE:
+            pool->shares_stale++;
+            break;
+    }
+
+    pool->reject_ratio = ewma(pool->reject_ratio, result == POOL_SHARE_REJECTED ? 1.0f : 0.0f, SHARE_ALPHA);
+    pool->stale_ratio = ewma(pool->stale_ratio, result == POOL_SHARE_STALE ? 1.0f : 0.0f, SHARE_ALPHA);
+
+    if (rtt_ms >= 0) {
+        pool->submit_rtt_ms = pool->submit_rtt_ms == 0.0f ? (float) rtt_ms : ewma(pool->submit_rtt_ms, (float) rtt_ms, RTT_ALPHA);
+    }
+}
+
+// ================================================================================================
+// SCORING
+// ================================================================================================
+
+/**
+ * Recompute the pool's 0..100 health score and its per-component breakdown
+ *
+ * The score is a product of factors, each the fraction of value the pool still delivers:
+ * reachability (connect success), work flow (notify freshness), acceptance (1 - rejects - stales)
+ * and latency. A pool that cannot be reached or sends no work is worth nothing no matter how
+ * clean its share history is.
+ *
+ * Freshness only counts while the pool holds the live session; a standby pool is judged
+ * by its heartbeat connects and the share history it built while it was active. That
+ * history fades with a half-life of min_dwell_ms so a pool that was once rejecting can
+ * earn its way back.
+ */
+float pool_health_score(pool_health * pool, const pool_health_policy * policy, int64_t now_us)
+{
+    if (!pool->connected && pool->scored_us != 0 && policy->min_dwell_ms > 0) {
+        float keep = exp2f(-((float) (now_us - pool->scored_us) / 1000.0f) / (float) policy->min_dwell_ms);
+        pool->reject_ratio *= keep;
+        pool->stale_ratio *= keep;
+        if (pool->submit_rtt_ms > policy->rtt_target_ms) {
+            pool->submit_rtt_ms = policy->rtt_target_ms + (pool->submit_rtt_ms - policy->rtt_target_ms) * keep;
+        }
+    }
+    pool->scored_us = now_us;
+
+    float connect = pool->connect_success;
+    float rtt = pool->submit_rtt_ms == 0.0f ? 1.0f : falloff(pool->submit_rtt_ms, policy->rtt_target_ms, RTT_ZERO_MULTIPLE);
+    float acceptance = clampf(1.0f - (pool->reject_ratio + pool->stale_ratio) / BAD_RATIO_ZERO, 0.0f, 1.0f);
+    float freshness = 1.0f;
+
+    if (pool->connected) {
+        int64_t since_us = pool->last_notify_us ? pool->last_notify_us : pool->connected_us;
+        float age_ms = (float) (now_us - since_us) / 1000.0f;
+        freshness = falloff(age_ms, policy->notify_interval_ms, NOTIFY_ZERO_MULTIPLE);
+    }
+
+    pool->connect_score = connect * 100.0f;
+    pool->rtt_score = rtt * 100.0f;
+    pool->reject_score = clampf(1.0f - pool->reject_ratio / BAD_RATIO_ZERO, 0.0f, 1.0f) * 100.0f;
+    pool->stale_score = clampf(1.0f - pool->stale_ratio / BAD_RATIO_ZERO, 0.0f, 1.0f) * 100.0f;
+    pool->freshness_score = freshness * 100.0f;
+
+    pool->score = 100.0f * connect * freshness * acceptance * (RTT_FLOOR + (1.0f - RTT_FLOOR) * rtt);
+    return pool->score;
+}
+
+// ================================================================================================
+// SWITCHING POLICY
+// ================================================================================================
+
+static int pool_health_switch(pool_health_monitor * monitor, int next, pool_switch_reason reason, int64_t now_us)
+{
+    monitor->pools[monitor->active].connected = false;
+    monitor->active = next;
+    monitor->active_since_us = now_us;
+    monitor->switch_count++;
+    monitor->last_switch_reason = reason;
+
+    // give the pool we are moving to a full set of connect attempts
+    monitor->pools[next].consecutive_connect_failures = 0;
+    return next;
+}
+
+/**
+ * Decide which pool should hold the mining session
+ *
+ * Rules, in order:
+ *  - without a fallback configured, always use the primary
+ *  - repeated connect failures on the active pool force a switch immediately
+ *  - otherwise nothing moves until the active pool has been held for min_dwell_ms
+ *  - on fallback, go back once the primary scores at least return_score and its last probe succeeded
+ *  - a pool scoring below fail_score is abandoned if the other one is ahead by switch_margin
+ *
+ * @return Index of the pool to use (POOL_HEALTH_PRIMARY or POOL_HEALTH_FALLBACK)
+ */
+int pool_health_select(pool_health_monitor * monitor, bool has_fallback, int64_t now_us)
+{
+    const pool_health_policy * policy = &monitor->policy;
+    int active = monitor->active;
+    int other = active == POOL_HEALTH_PRIMARY ? POOL_HEALTH_FALLBACK : POOL_HEALTH_PRIMARY;
+    pool_health * current = &monitor->pools[active];
+    pool_health * candidate = &monitor->pools[other];
+    pool_health * primary = &monitor->pools[POOL_HEALTH_PRIMARY];
+
+    for (int i = 0; i < POOL_HEALTH_POOL_COUNT; i++) {
+        pool_health_score(&monitor->pools[i], policy, now_us);
+    }
+
+    if (!has_fallback) {
+        if (active != POOL_HEALTH_PRIMARY) {
+            return pool_health_switch(monitor, POOL_HEALTH_PRIMARY, POOL_SWITCH_NO_FALLBACK, now_us);
+        }
+        // keep retrying the primary forever, like a single-pool setup always has
+        if (current->consecutive_connect_failures >= policy->max_connect_failures) {
+            current->consecutive_connect_failures = 0;
+        }
+        return active;
+    }
+
+    if (current->consecutive_connect_failures >= policy->max_connect_failures) {
+        return pool_health_switch(monitor, other, POOL_SWITCH_CONNECT_FAILURES, now_us);
+    }
+
+    if (now_us - monitor->active_since_us < (int64_t) policy->min_dwell_ms * 1000) {
+        return active;
+    }
+
+    if (active == POOL_HEALTH_FALLBACK && primary->score >= policy->return_score && primary->consecutive_connect_failures == 0) {
+        return pool_health_switch(monitor, POOL_HEALTH_PRIMARY, POOL_SWITCH_RETURN_TO_PRIMARY, now_us);
+    }
+
+    if (current->score < policy->fail_score && candidate->score >= current->score + policy->switch_margin) {
+        return pool_health_switch(monitor, other, POOL_SWITCH_DEGRADED, now_us);
+    }
+
+    return active;
+}
+
+const char * pool_health_switch_reason_str(pool_switch_reason reason)
+{
+    switch (reason) {
+        case POOL_SWITCH_CONNECT_FAILURES:
+            return "connect_failures";
+        case POOL_SWITCH_DEGRADED:
+            return "degraded";
+        case POOL_SWITCH_RETURN_TO_PRIMARY:
+            return "return_to_primary";
+        case POOL_SWITCH_NO_FALLBACK:
+            return "no_fallback";
+        case POOL_SWITCH_NONE:
+        default:
+            return "none";
+    }
+}
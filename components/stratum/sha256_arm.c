@@ -0,0 +1,60 @@
+#include "sha256_backend.h"
+
+// ARMv8 crypto extension backend, for host builds on aarch64 (Apple silicon, Raspberry Pi 4/5
+// with a crypto-enabled -march). Only compiled in when the compiler targets the extension.
+
+#if defined(__aarch64__) && !defined(ESP_PLATFORM) && (defined(__ARM_FEATURE_SHA2) || defined(__ARM_FEATURE_CRYPTO))
+
+#include <arm_neon.h>
+
+#if defined(__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+static bool armv8_available(void)
+{
+#if defined(__linux__) && defined(HWCAP_SHA2)
+    return (getauxval(AT_HWCAP) & HWCAP_SHA2) != 0;
+#else
+    return true;
+#endif
+}
+
+static void armv8_compress(uint32_t state[SHA256_STATE_WORDS], const uint32_t block[SHA256_BLOCK_WORDS])
+{
+    uint32x4_t state0 = vld1q_u32(&state[0]);
+    uint32x4_t state1 = vld1q_u32(&state[4]);
+    uint32x4_t abcd_save = state0;
+    uint32x4_t efgh_save = state1;
+
+    uint32x4_t msg[4];
+    for (int i = 0; i < 4; i++) {
+        msg[i] = vld1q_u32(&block[i * 4]);
+    }
+
+    for (int i = 0; i < 16; i++) {
+        uint32x4_t wk = vaddq_u32(msg[i & 3], vld1q_u32(&SHA256_K[i * 4]));
+        if (i < 12) {
+            msg[i & 3] = vsha256su1q_u32(vsha256su0q_u32(msg[i & 3], msg[(i + 1) & 3]), msg[(i + 2) & 3], msg[(i + 3) & 3]);
+        }
+        uint32x4_t abcd = state0;
+        state0 = vsha256hq_u32(state0, state1, wk);
+        state1 = vsha256h2q_u32(state1, abcd, wk);
+    }
+
+    vst1q_u32(&state[0], vaddq_u32(state0, abcd_save));
+    vst1q_u32(&state[4], vaddq_u32(state1, efgh_save));
+}
+
+const sha256_backend sha256_backend_armv8 = {
+    .name = "armv8",
+    .available = armv8_available,
+    .compress = armv8_compress,
+};
+
+#else
+
+const sha256_backend sha256_backend_armv8 = {.name = "armv8"};
+
+#endif
@@ -0,0 +1,181 @@
+#include <string.h>
+#include "sha256_backend.h"
+
+static bool generic_available(void)
+{
+    return true;
+}
+
+const sha256_backend sha256_backend_generic = {
+    .name = "generic",
+    .available = generic_available,
+    .compress = sha256_core_compress,
+};
+
+// Preference order: dedicated hashing hardware first, then SIMD, then portable C
+static const sha256_backend * const backends[] = {
+    &sha256_backend_esp32,
+    &sha256_backend_shani,
+    &sha256_backend_armv8,
+    &sha256_backend_avx2,
+    &sha256_backend_generic,
+};
+
+#define BACKEND_COUNT (sizeof(backends) / sizeof(backends[0]))
+
+static const sha256_backend * active_backend = NULL;
+
+size_t sha256_backend_count(void)
+{
+    return BACKEND_COUNT;
+}
+
+const sha256_backend * sha256_backend_at(size_t index)
+{
+    return index < BACKEND_COUNT ? backends[index] : NULL;
+}
+
+bool sha256_backend_is_available(const sha256_backend * backend)
+{
+    return backend != NULL && backend->available != NULL && backend->available();
+}
+
+const sha256_backend * sha256_backend_active(void)
+{
+    // Racing first calls all settle on the same backend, so no lock is needed
+    if (active_backend == NULL) {
+        for (size_t i = 0; i < BACKEND_COUNT; i++) {
+            if (sha256_backend_is_available(backends[i])) {
+                active_backend = backends[i];
+                break;
+            }
+        }
+    }
+    return active_backend;
+}
+
+bool sha256_backend_select(const char * name)
+{
+    for (size_t i = 0; i < BACKEND_COUNT; i++) {
+        if (strcmp(backends[i]->name, name) == 0 && sha256_backend_is_available(backends[i])) {
+            active_backend = backends[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+static void load_block(const uint8_t * data, uint32_t block[SHA256_BLOCK_WORDS])
+{
+    for (int i = 0; i < SHA256_BLOCK_WORDS; i++) {
+        block[i] = sha256_load_be32(data + i * 4);
+    }
+}
+
+// Software padding driver for backends without a whole-message hash; leaves the state words
+static void hash_state(const sha256_backend * backend, const uint8_t * data, size_t len, uint32_t state[SHA256_STATE_WORDS])
+{
+    uint32_t block[SHA256_BLOCK_WORDS];
+    memcpy(state, SHA256_IV, SHA256_STATE_WORDS * sizeof(uint32_t));
+
+    size_t offset = 0;
+    for (; len - offset >= SHA256_BLOCK_SIZE; offset += SHA256_BLOCK_SIZE) {
+        load_block(data + offset, block);
+        backend->compress(state, block);
+    }
+
+    // Tail, 0x80 terminator and the 64-bit bit length; spills into a second block past 55 bytes
+    uint8_t tail[SHA256_BLOCK_SIZE * 2] = {0};
+    size_t remaining = len - offset;
+    if (remaining > 0) {
+        memcpy(tail, data + offset, remaining);
+    }
+    tail[remaining] = 0x80;
+    size_t tail_len = remaining < 56 ? SHA256_BLOCK_SIZE : SHA256_BLOCK_SIZE * 2;
+    uint64_t bits = (uint64_t) len * 8;
+    for (int i = 0; i < 8; i++) {
+        tail[tail_len - 1 - i] = bits >> (i * 8);
+    }
+    for (size_t i = 0; i < tail_len; i += SHA256_BLOCK_SIZE) {
+        load_block(tail + i, block);
+        backend->compress(state, block);
+    }
+}
+
+void sha256_hash_with(const sha256_backend * backend, const uint8_t * data, size_t len, uint8_t digest[SHA256_DIGEST_SIZE])
+{
+    if (backend->hash != NULL) {
+        backend->hash(data, len, digest);
+        return;
+    }
+
+    uint32_t state[SHA256_STATE_WORDS];
+    hash_state(backend, data, len, state);
+    for (int i = 0; i < SHA256_STATE_WORDS; i++) {
+        sha256_store_be32(digest + i * 4, state[i]);
+    }
+}
+
+void sha256_double_with(const sha256_backend * backend, const uint8_t * data, size_t len, uint8_t digest[SHA256_DIGEST_SIZE])
+{
+    if (backend->hash != NULL) {
+        uint8_t first[SHA256_DIGEST_SIZE];
+        backend->hash(data, len, first);
+        backend->hash(first, sizeof(first), digest);
+        return;
+    }
+
+    // The first digest is the state words, so the second hash is one compression of those
+    // words and the constant 32 byte padding
+    uint32_t block[SHA256_BLOCK_WORDS];
+    hash_state(backend, data, len, block);
+    memcpy(block + SHA256_STATE_WORDS, SHA256_PAD_32, sizeof(SHA256_PAD_32));
+
+    uint32_t state[SHA256_STATE_WORDS];
+    memcpy(state, SHA256_IV, sizeof(state));
+    backend->compress(state, block);
+    for (int i = 0; i < SHA256_STATE_WORDS; i++) {
+        sha256_store_be32(digest + i * 4, state[i]);
+    }
+}
+
+void sha256_compress_lanes_with(const sha256_backend * backend, uint32_t (*states)[SHA256_STATE_WORDS],
+                                const uint32_t (*blocks)[SHA256_BLOCK_WORDS], size_t count)
+{
+    if (backend->compress_lanes != NULL) {
+        backend->compress_lanes(states, blocks, count);
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        backend->compress(states[i], blocks[i]);
+    }
+}
+
+void sha256_hash(const uint8_t * data, size_t len, uint8_t digest[SHA256_DIGEST_SIZE])
+{
+    sha256_hash_with(sha256_backend_active(), data, len, digest);
+}
+
+void sha256_double(const uint8_t * data, size_t len, uint8_t digest[SHA256_DIGEST_SIZE])
+{
+    sha256_double_with(sha256_backend_active(), data, len, digest);
+}
+
+void sha256_midstate(const uint8_t data[SHA256_BLOCK_SIZE], uint32_t state[SHA256_STATE_WORDS])
+{
+    uint32_t block[SHA256_BLOCK_WORDS];
+    load_block(data, block);
+    memcpy(state, SHA256_IV, SHA256_STATE_WORDS * sizeof(uint32_t));
+    sha256_backend_active()->compress(state, block);
+}
+
+void sha256_compress(uint32_t state[SHA256_STATE_WORDS], const uint32_t block[SHA256_BLOCK_WORDS])
+{
+    sha256_backend_active()->compress(state, block);
+}
+
+void sha256_compress_lanes(uint32_t (*states)[SHA256_STATE_WORDS], const uint32_t (*blocks)[SHA256_BLOCK_WORDS],
+                           size_t count)
+{
+    sha256_compress_lanes_with(sha256_backend_active(), states, blocks, count);
+}
@@ -0,0 +1,33 @@
+#include "sha256_backend.h"
+
+// ESP32 SHA peripheral backend. Whole messages (coinbase and merkle hashing) go through
+// mbedTLS, which ESP-IDF routes to the peripheral. Single compressions from an arbitrary
+// state stay in software: loading a midstate into the peripheral and reading it back costs
+// more than the one block it would save, and those are what nonce verification runs on.
+
+#ifdef ESP_PLATFORM
+
+#include "mbedtls/sha256.h"
+
+static bool esp32_available(void)
+{
+    return true;
+}
+
+static void esp32_hash(const uint8_t * data, size_t len, uint8_t digest[SHA256_DIGEST_SIZE])
+{
+    mbedtls_sha256(data, len, digest, 0);
+}
+
+const sha256_backend sha256_backend_esp32 = {
+    .name = "esp32-sha",
+    .available = esp32_available,
+    .compress = sha256_core_compress,
+    .hash = esp32_hash,
+};
+
+#else
+
+const sha256_backend sha256_backend_esp32 = {.name = "esp32-sha"};
+
+#endif
@@ -0,0 +1,159 @@
+#include "sha256_backend.h"
+
+// SHA-NI single-block and AVX2 8-lane backends for host builds (simulator, tests, benchmarks).
+// Functions carry their own target attributes so the rest of the component needs no ISA flags,
+// and cpuid decides at runtime whether they are used.
+
+#if (defined(__x86_64__) || defined(__i386__)) && !defined(ESP_PLATFORM) && defined(__GNUC__)
+
+#include <cpuid.h>
+#include <immintrin.h>
+
+static bool shani_available(void)
+{
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_SSE4_1)) {
+        return false;
+    }
+    if (__get_cpuid_max(0, NULL) < 7) {
+        return false;
+    }
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    return (ebx & (1u << 29)) != 0;
+}
+
+__attribute__((target("sha,sse4.1"))) static void shani_compress(uint32_t state[SHA256_STATE_WORDS],
+                                                                  const uint32_t block[SHA256_BLOCK_WORDS])
+{
+    // The SHA extensions keep the state as ABEF/CDGH pairs
+    __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) &state[0]), 0xB1);
+    __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) &state[4]), 0x1B);
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+    __m128i abef_save = state0;
+    __m128i cdgh_save = state1;
+
+    // Words are already in host order, no byte shuffle needed
+    __m128i msg[4];
+    for (int i = 0; i < 4; i++) {
+        msg[i] = _mm_loadu_si128((const __m128i *) &block[i * 4]);
+    }
+
+    for (int i = 0; i < 16; i++) {
+        __m128i wk = _mm_add_epi32(msg[i & 3], _mm_loadu_si128((const __m128i *) &SHA256_K[i * 4]));
+        state1 = _mm_sha256rnds2_epu32(state1, state0, wk);
+        state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(wk, 0x0E));
+
+        // Schedule the words four groups ahead into the slot just consumed
+        if (i < 12) {
+            __m128i next = _mm_sha256msg1_epu32(msg[i & 3], msg[(i + 1) & 3]);
+            next = _mm_add_epi32(next, _mm_alignr_epi8(msg[(i + 3) & 3], msg[(i + 2) & 3], 4));
+            msg[i & 3] = _mm_sha256msg2_epu32(next, msg[(i + 3) & 3]);
+        }
+    }
+
+    state0 = _mm_add_epi32(state0, abef_save);
+    state1 = _mm_add_epi32(state1, cdgh_save);
+
+    tmp = _mm_shuffle_epi32(state0, 0x1B);
+    state1 = _mm_shuffle_epi32(state1, 0xB1);
+    _mm_storeu_si128((__m128i *) &state[0], _mm_blend_epi16(tmp, state1, 0xF0));
+    _mm_storeu_si128((__m128i *) &state[4], _mm_alignr_epi8(state1, tmp, 8));
+}
+
+const sha256_backend sha256_backend_shani = {
+    .name = "sha-ni",
+    .available = shani_available,
+    .compress = shani_compress,
+};
+
+static bool avx2_available(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+#define AVX2_LANES 8
+
+#define V_ROTR(x, n) _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - (n)))
+#define V_XOR3(a, b, c) _mm256_xor_si256(_mm256_xor_si256(a, b), c)
+#define V_EP0(x) V_XOR3(V_ROTR(x, 2), V_ROTR(x, 13), V_ROTR(x, 22))
+#define V_EP1(x) V_XOR3(V_ROTR(x, 6), V_ROTR(x, 11), V_ROTR(x, 25))
+#define V_SIG0(x) V_XOR3(V_ROTR(x, 7), V_ROTR(x, 18), _mm256_srli_epi32(x, 3))
+#define V_SIG1(x) V_XOR3(V_ROTR(x, 17), V_ROTR(x, 19), _mm256_srli_epi32(x, 10))
+#define V_CH(x, y, z) _mm256_xor_si256(_mm256_and_si256(x, y), _mm256_andnot_si256(x, z))
+#define V_MAJ(x, y, z) _mm256_or_si256(_mm256_and_si256(x, y), _mm256_and_si256(z, _mm256_or_si256(x, y)))
+
+// Eight independent compressions, one per 32-bit lane
+__attribute__((target("avx2"))) static void avx2_compress_x8(uint32_t (*states)[SHA256_STATE_WORDS],
+                                                             const uint32_t (*blocks)[SHA256_BLOCK_WORDS])
+{
+    __m256i w[64];
+    __m256i v[SHA256_STATE_WORDS];
+    __m256i save[SHA256_STATE_WORDS];
+
+    for (int t = 0; t < 16; t++) {
+        w[t] = _mm256_setr_epi32(blocks[0][t], blocks[1][t], blocks[2][t], blocks[3][t], blocks[4][t], blocks[5][t],
+                                 blocks[6][t], blocks[7][t]);
+    }
+    for (int t = 16; t < 64; t++) {
+        w[t] = _mm256_add_epi32(_mm256_add_epi32(V_SIG1(w[t - 2]), w[t - 7]),
+                                _mm256_add_epi32(V_SIG0(w[t - 15]), w[t - 16]));
+    }
+    for (int i = 0; i < SHA256_STATE_WORDS; i++) {
+        v[i] = _mm256_setr_epi32(states[0][i], states[1][i], states[2][i], states[3][i], states[4][i], states[5][i],
+                                 states[6][i], states[7][i]);
+        save[i] = v[i];
+    }
+
+    __m256i a = v[0], b = v[1], c = v[2], d = v[3], e = v[4], f = v[5], g = v[6], h = v[7];
+    for (int t = 0; t < 64; t++) {
+        __m256i t1 = _mm256_add_epi32(_mm256_add_epi32(h, V_EP1(e)),
+                                      _mm256_add_epi32(V_CH(e, f, g), _mm256_add_epi32(_mm256_set1_epi32(SHA256_K[t]), w[t])));
+        __m256i t2 = _mm256_add_epi32(V_EP0(a), V_MAJ(a, b, c));
+        h = g;
+        g = f;
+        f = e;
+        e = _mm256_add_epi32(d, t1);
+        d = c;
+        c = b;
+        b = a;
+        a = _mm256_add_epi32(t1, t2);
+    }
+    v[0] = a, v[1] = b, v[2] = c, v[3] = d, v[4] = e, v[5] = f, v[6] = g, v[7] = h;
+
+    for (int i = 0; i < SHA256_STATE_WORDS; i++) {
+        uint32_t out[AVX2_LANES];
+        _mm256_storeu_si256((__m256i *) out, _mm256_add_epi32(v[i], save[i]));
+        for (int lane = 0; lane < AVX2_LANES; lane++) {
+            states[lane][i] = out[lane];
+        }
+    }
+}
+
+static void avx2_compress_lanes(uint32_t (*states)[SHA256_STATE_WORDS], const uint32_t (*blocks)[SHA256_BLOCK_WORDS],
+                                size_t count)
+{
+    size_t i = 0;
+    for (; i + AVX2_LANES <= count; i += AVX2_LANES) {
+        avx2_compress_x8(states + i, blocks + i);
+    }
+    for (; i < count; i++) {
+        sha256_core_compress(states[i], blocks[i]);
+    }
+}
+
+// Single blocks gain nothing from lanes; the backend exists for batched work
+const sha256_backend sha256_backend_avx2 = {
+    .name = "avx2-x8",
+    .available = avx2_available,
+    .compress = sha256_core_compress,
+    .compress_lanes = avx2_compress_lanes,
+};
+
+#else
+
+const sha256_backend sha256_backend_shani = {.name = "sha-ni"};
+const sha256_backend sha256_backend_avx2 = {.name = "avx2-x8"};
+
+#endif
@@ -0,0 +1,143 @@
+#include <string.h>
+#include <ctype.h>
+#include "share_filter.h"
+
+// ================================================================================================
+// STRATUM ERROR CODES
+// ================================================================================================
+
+// Error codes from the stratum v1 spec, sent as the first element of the error array
+#define STRATUM_ERROR_JOB_NOT_FOUND 21
+#define STRATUM_ERROR_DUPLICATE_SHARE 22
+#define STRATUM_ERROR_LOW_DIFFICULTY 23
+
+// ================================================================================================
+// NOTIFY GENERATION TRACKING
+// ================================================================================================
+
+void share_filter_init(share_filter * filter)
+{
+    memset(filter, 0, sizeof(*filter));
+}
+
+/**
+ * Track a new mining.notify and return the generation its jobs must be stamped with
+ *
+ * The generation advances when the pool asks for clean jobs or the previous block hash
+ * changes (some pools send a new block without setting clean_jobs), which is exactly
+ * when every older job becomes unsubmittable.
+ *
+ * @param prev_block_hash - Hex prev hash as sent in the notify
+ * @param clean_jobs - The notify's clean_jobs flag
+ * @return Generation for jobs built from this notify
+ */
+uint32_t share_filter_on_notify(share_filter * filter, const char * prev_block_hash, bool clean_jobs)
+{
+    bool new_block = strncmp(filter->prev_block_hash, prev_block_hash, PREV_BLOCK_HASH_HEX_SIZE - 1) != 0;
+
+    if (new_block) {
+        strncpy(filter->prev_block_hash, prev_block_hash, PREV_BLOCK_HASH_HEX_SIZE - 1);
+        filter->prev_block_hash[PREV_BLOCK_HASH_HEX_SIZE - 1] = '\0';
+    }
+    if (new_block || clean_jobs) {
+        filter->generation++;
+    }
+    return filter->generation;
+}
+
+/**
+ * A share is certainly stale when its job predates the latest clean/new-block notify
+ * Reads a single word so the result task can call it without taking a lock
+ */
+bool share_filter_is_stale(const share_filter * filter, uint32_t job_generation)
+{
+    return job_generation != filter->generation;
+}
+
+void share_filter_record_suppressed(share_filter * filter)
+{
+    filter->stale_suppressed++;
+}
+
+// ================================================================================================
+// REJECT CLASSIFICATION
+// ================================================================================================
+
+static bool contains_nocase(const char * haystack, const char * needle)
+{
+    size_t needle_len = strlen(needle);
+    for (; *haystack != '\0'; haystack++) {
+        size_t i = 0;
+        while (i < needle_len && haystack[i] != '\0' && tolower((unsigned char) haystack[i]) == needle[i]) {
+            i++;
+        }
+        if (i == needle_len) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Map a pool's reject to a reason
+ * Pools disagree on codes and wording, so the message text wins when it is recognised
+ * (e.g. ckpool answers "Stale", public-pool "Job not found", bitcoind-style pools "high-hash")
+ *
+ * @param error_code - First element of the error array, 0 when absent
+ * @param error_str - Error message or reject-reason, may be NULL
+ */
+share_reject_reason share_filter_classify_reject(int error_code, const char * error_str)
+{
+    if (error_str != NULL) {
+        if (contains_nocase(error_str, "stale")) {
+            return SHARE_REJECT_STALE;
+        }
+        if (contains_nocase(error_str, "duplicate")) {
+            return SHARE_REJECT_DUPLICATE;
+        }
+        if (contains_nocase(error_str, "low difficulty") || contains_nocase(error_str, "low diff") ||
+            contains_nocase(error_str, "above target") || contains_nocase(error_str, "high-hash")) {
+            return SHARE_REJECT_LOW_DIFFICULTY;
+        }
+        if (contains_nocase(error_str, "job not found") || contains_nocase(error_str, "unknown-work") ||
+            contains_nocase(error_str, "invalid job")) {
+            return SHARE_REJECT_JOB_NOT_FOUND;
+        }
+    }
+
+    switch (error_code) {
+        case STRATUM_ERROR_JOB_NOT_FOUND:
+            return SHARE_REJECT_JOB_NOT_FOUND;
+        case STRATUM_ERROR_DUPLICATE_SHARE:
+            return SHARE_REJECT_DUPLICATE;
+        case STRATUM_ERROR_LOW_DIFFICULTY:
+            return SHARE_REJECT_LOW_DIFFICULTY;
+        default:
+            return SHARE_REJECT_OTHER;
+    }
+}
+
+void share_filter_record_reject(share_filter * filter, share_reject_reason reason)
+{
+    if (reason >= SHARE_REJECT_REASON_COUNT) {
+        reason = SHARE_REJECT_OTHER;
+    }
+    filter->rejects[reason]++;
+}
+
+const char * share_filter_reject_reason_str(share_reject_reason reason)
+{
+    switch (reason) {
+        case SHARE_REJECT_STALE:
+            return "stale";
+        case SHARE_REJECT_LOW_DIFFICULTY:
+            return "lowDifficulty";
+        case SHARE_REJECT_DUPLICATE:
+            return "duplicate";
+        case SHARE_REJECT_JOB_NOT_FOUND:
+            return "jobNotFound";
+        case SHARE_REJECT_OTHER:
+        default:
+            return "other";
+    }
+}
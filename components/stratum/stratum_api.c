@@ -5,23 +5,25 @@
  *****************************************************************************/
 
 #include "stratum_api.h"
+#include "line_buffer.h"
 #include "cJSON.h"
 #include "esp_log.h"
 #include "esp_ota_ops.h"
 #include "lwip/sockets.h"
 #include "utils.h"
+#include "hex_codec.h"
 #include "esp_timer.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <inttypes.h>
 
 #define BUFFER_SIZE 1024
 static const char * TAG = "stratum_api";
 
-static char * json_rpc_buffer = NULL;
-static size_t json_rpc_buffer_size = 0;
-static int last_parsed_request_id = -1;
+static line_buffer rx_buffer;
+static uint32_t malformed_messages = 0;
 
 static RequestTiming request_timings[MAX_REQUEST_IDS];
 static bool initialized = false;
@@ -69,87 +71,153 @@ double STRATUM_V1_get_response_time_ms(int request_id)
     return response_time;
 }
 
-static void debug_stratum_tx(const char *);
+static void debug_stratum_tx(const char *, int);
 int _parse_stratum_subscribe_result_message(const char * result_json_str, char ** extranonce, int * extranonce2_len);
 
-void STRATUM_V1_initialize_buffer()
+void STRATUM_V1_initialize_buffer(size_t max_line_length)
 {
-    json_rpc_buffer = malloc(BUFFER_SIZE);
-    json_rpc_buffer_size = BUFFER_SIZE;
-    if (json_rpc_buffer == NULL) {
-        printf("Error: Failed to allocate memory for buffer\n");
-        exit(1);
+    if (rx_buffer.data != NULL) {
+        line_buffer_free(&rx_buffer);
     }
-    memset(json_rpc_buffer, 0, BUFFER_SIZE);
+    if (!line_buffer_init(&rx_buffer, BUFFER_SIZE, max_line_length)) {
+        ESP_LOGE(TAG, "Failed to allocate stratum receive buffer");
+    }
+}
+
+void STRATUM_V1_reset_buffer()
+{
+    line_buffer_reset(&rx_buffer);
 }
 
 void cleanup_stratum_buffer()
 {
-    free(json_rpc_buffer);
+    line_buffer_free(&rx_buffer);
 }
 
-static void realloc_json_buffer(size_t len)
+char * STRATUM_V1_receive_jsonrpc_line(int sockfd)
 {
-    size_t old, new;
+    if (rx_buffer.data == NULL) {
+        STRATUM_V1_initialize_buffer(STRATUM_DEFAULT_MAX_LINE_LENGTH);
+        if (rx_buffer.data == NULL) {
+            return NULL;
+        }
+    }
 
-    old = strlen(json_rpc_buffer);
-    new = old + len + 1;
+    char recv_buffer[BUFFER_SIZE];
+    char * line;
 
-    if (new < json_rpc_buffer_size) {
-        return;
+    while ((line = line_buffer_next_line(&rx_buffer)) == NULL) {
+        int nbytes = recv(sockfd, recv_buffer, BUFFER_SIZE, 0);
+        if (nbytes <= 0) {
+            if (nbytes == 0) {
+                ESP_LOGI(TAG, "Error: recv (connection closed by pool)");
+            } else {
+                ESP_LOGI(TAG, "Error: recv (errno %d: %s)", errno, strerror(errno));
+            }
+            line_buffer_reset(&rx_buffer);
+            return NULL;
+        }
+
+        switch (line_buffer_append(&rx_buffer, recv_buffer, nbytes)) {
+            case LINE_BUFFER_OVERSIZED:
+                ESP_LOGW(TAG, "Discarding stratum line longer than %u bytes", (unsigned) rx_buffer.max_line_length);
+                break;
+            case LINE_BUFFER_NO_MEMORY:
+                ESP_LOGW(TAG, "Out of memory assembling stratum line, discarding it");
+                break;
+            default:
+                break;
+        }
     }
+    return line;
+}
 
-    new = new + (BUFFER_SIZE - (new % BUFFER_SIZE));
-    void * new_sockbuf = realloc(json_rpc_buffer, new);
+void STRATUM_V1_get_rx_stats(StratumRxStats * stats)
+{
+    stats->max_line_length = rx_buffer.max_line_length;
+    stats->buffer_high_water = rx_buffer.high_water;
+    stats->lines_received = rx_buffer.lines;
+    stats->lines_dropped = rx_buffer.dropped_lines;
+    stats->malformed_messages = malformed_messages;
+}
 
-    if (new_sockbuf == NULL) {
-        fprintf(stderr, "Error: realloc failed in recalloc_sock()\n");
-        ESP_LOGI(TAG, "Restarting System because of ERROR: realloc failed in recalloc_sock");
-        vTaskDelay(1000 / portTICK_PERIOD_MS);
-        esp_restart();
-    }
+// Returns the string at index of a JSON array, or NULL when it is missing or not a string
+static const char * array_string(const cJSON * array, int index)
+{
+    cJSON * item = cJSON_GetArrayItem(array, index);
+    return cJSON_IsString(item) ? item->valuestring : NULL;
+}
 
-    json_rpc_buffer = new_sockbuf;
-    memset(json_rpc_buffer + old, 0, new - old);
-    json_rpc_buffer_size = new;
+// A message the pool got wrong is dropped on its own; the session carries on with the next line
+static void discard_malformed(StratumApiV1Message * message, const char * stratum_json)
+{
+    ESP_LOGW(TAG, "Discarding malformed stratum message: %.128s", stratum_json);
+    malformed_messages++;
+    message->method = STRATUM_UNKNOWN;
 }
 
-char * STRATUM_V1_receive_jsonrpc_line(int sockfd)
+/**
+ * Build a mining_notify from the params array of a mining.notify
+ * Every field is validated before anything is allocated, so a short or oversized notify
+ * costs nothing but the log line
+ *
+ * @return The new work, or NULL when params are missing, mistyped or have too many branches
+ */
+static mining_notify * parse_mining_notify(const cJSON * params, int * should_abandon_work)
 {
-    if (json_rpc_buffer == NULL) {
-        STRATUM_V1_initialize_buffer();
+    const char * job_id = array_string(params, 0);
+    const char * prev_block_hash = array_string(params, 1);
+    const char * coinbase_1 = array_string(params, 2);
+    const char * coinbase_2 = array_string(params, 3);
+    cJSON * merkle_branch = cJSON_GetArrayItem(params, 4);
+    const char * version = array_string(params, 5);
+    const char * target = array_string(params, 6);
+    const char * ntime = array_string(params, 7);
+
+    if (job_id == NULL || prev_block_hash == NULL || coinbase_1 == NULL || coinbase_2 == NULL ||
+        !cJSON_IsArray(merkle_branch) || version == NULL || target == NULL || ntime == NULL) {
+        return NULL;
     }
-    char *line, *tok = NULL;
-    char recv_buffer[BUFFER_SIZE];
-    int nbytes;
-    size_t buflen = 0;
-
-    if (!strstr(json_rpc_buffer, "\n")) {
-        do {
-            memset(recv_buffer, 0, BUFFER_SIZE);
-            nbytes = recv(sockfd, recv_buffer, BUFFER_SIZE - 1, 0);
-            if (nbytes == -1) {
-                ESP_LOGI(TAG, "Error: recv (errno %d: %s)", errno, strerror(errno));
-                if (json_rpc_buffer) {
-                    free(json_rpc_buffer);
-                    json_rpc_buffer=0;
-                }
-                return 0;
-            }
 
-            realloc_json_buffer(nbytes);
-            strncat(json_rpc_buffer, recv_buffer, nbytes);
-        } while (!strstr(json_rpc_buffer, "\n"));
+    int n_merkle_branches = cJSON_GetArraySize(merkle_branch);
+    if (n_merkle_branches > MAX_MERKLE_BRANCHES) {
+        ESP_LOGW(TAG, "Too many Merkle branches: %d", n_merkle_branches);
+        return NULL;
     }
-    buflen = strlen(json_rpc_buffer);
-    tok = strtok(json_rpc_buffer, "\n");
-    line = strdup(tok);
-    int len = strlen(line);
-    if (buflen > len + 1)
-        memmove(json_rpc_buffer, json_rpc_buffer + len + 1, buflen - len + 1);
-    else
-        strcpy(json_rpc_buffer, "");
-    return line;
+    for (int i = 0; i < n_merkle_branches; i++) {
+        const char * branch = array_string(merkle_branch, i);
+        if (branch == NULL || strlen(branch) != HASH_SIZE * 2) {
+            return NULL;
+        }
+    }
+
+    mining_notify * new_work = calloc(1, sizeof(mining_notify));
+    if (new_work == NULL) {
+        return NULL;
+    }
+    new_work->job_id = strdup(job_id);
+    new_work->prev_block_hash = strdup(prev_block_hash);
+    new_work->coinbase_1 = strdup(coinbase_1);
+    new_work->coinbase_2 = strdup(coinbase_2);
+    new_work->n_merkle_branches = n_merkle_branches;
+    new_work->merkle_branches = malloc(HASH_SIZE * (n_merkle_branches > 0 ? n_merkle_branches : 1));
+    if (new_work->job_id == NULL || new_work->prev_block_hash == NULL || new_work->coinbase_1 == NULL ||
+        new_work->coinbase_2 == NULL || new_work->merkle_branches == NULL) {
+        STRATUM_V1_free_mining_notify(new_work);
+        return NULL;
+    }
+    for (int i = 0; i < n_merkle_branches; i++) {
+        hex2bin(array_string(merkle_branch, i), new_work->merkle_branches + HASH_SIZE * i, HASH_SIZE);
+    }
+
+    new_work->version = strtoul(version, NULL, 16);
+    new_work->target = strtoul(target, NULL, 16);
+    new_work->ntime = strtoul(ntime, NULL, 16);
+
+    // params can be varible length
+    int paramsLength = cJSON_GetArraySize(params);
+    *should_abandon_work = cJSON_IsTrue(cJSON_GetArrayItem(params, paramsLength - 1));
+    return new_work;
 }
 
 void STRATUM_V1_parse(StratumApiV1Message * message, const char * stratum_json)
@@ -157,13 +225,17 @@ void STRATUM_V1_parse(StratumApiV1Message * message, const char * stratum_json)
     ESP_LOGI(TAG, "rx: %s", stratum_json); // debug incoming stratum messages
 
     cJSON * json = cJSON_Parse(stratum_json);
+    if (json == NULL) {
+        message->message_id = -1;
+        discard_malformed(message, stratum_json);
+        return;
+    }
 
     cJSON * id_json = cJSON_GetObjectItem(json, "id");
     int64_t parsed_id = -1;
     if (id_json != NULL && cJSON_IsNumber(id_json)) {
         parsed_id = id_json->valueint;
     }
-    last_parsed_request_id = parsed_id;
     message->message_id = parsed_id;
 
     cJSON * method_json = cJSON_GetObjectItem(json, "method");
@@ -191,6 +263,7 @@ void STRATUM_V1_parse(StratumApiV1Message * message, const char * stratum_json)
         cJSON * result_json = cJSON_GetObjectItem(json, "result");
         cJSON * error_json = cJSON_GetObjectItem(json, "error");
         cJSON * reject_reason_json = cJSON_GetObjectItem(json, "reject-reason");
+        message->error_code = 0;
 
         // if the result is null, then it's a fail
         if (result_json == NULL) {
@@ -207,6 +280,10 @@ void STRATUM_V1_parse(StratumApiV1Message * message, const char * stratum_json)
                 result = STRATUM_RESULT;
             }
             if (cJSON_IsArray(error_json)) {
+                cJSON * error_code = cJSON_GetArrayItem(error_json, 0);
+                if (cJSON_IsNumber(error_code)) {
+                    message->error_code = error_code->valueint;
+                }
                 int len = cJSON_GetArraySize(error_json);
                 if (len >= 2) {
                     cJSON * error_msg = cJSON_GetArrayItem(error_json, 1);
@@ -238,7 +315,7 @@ void STRATUM_V1_parse(StratumApiV1Message * message, const char * stratum_json)
             result = STRATUM_RESULT_SUBSCRIBE;
 
             cJSON * extranonce2_len_json = cJSON_GetArrayItem(result_json, 2);
-            if (extranonce2_len_json == NULL) {
+            if (!cJSON_IsNumber(extranonce2_len_json)) {
                 ESP_LOGE(TAG, "Unable to parse extranonce2_len: %s", result_json->valuestring);
                 message->response_success = false;
                 goto done;
@@ -246,7 +323,7 @@ void STRATUM_V1_parse(StratumApiV1Message * message, const char * stratum_json)
             message->extranonce_2_len = extranonce2_len_json->valueint;
 
             cJSON * extranonce_json = cJSON_GetArrayItem(result_json, 1);
-            if (extranonce_json == NULL) {
+            if (!cJSON_IsString(extranonce_json)) {
                 ESP_LOGE(TAG, "Unable parse extranonce: %s", result_json->valuestring);
                 message->response_success = false;
                 goto done;
@@ -255,8 +332,13 @@ void STRATUM_V1_parse(StratumApiV1Message * message, const char * stratum_json)
             message->response_success = true;
         //if the id is STRATUM_ID_CONFIGURE parse it
         } else if (parsed_id == STRATUM_ID_CONFIGURE) {
+            cJSON * enabled = cJSON_GetObjectItem(result_json, "version-rolling");
             cJSON * mask = cJSON_GetObjectItem(result_json, "version-rolling.mask");
-            if (mask != NULL) {
+            if (cJSON_IsFalse(enabled)) {
+                // the pool refused, e.g. it cannot grant min-bit-count bits
+                result = STRATUM_RESULT_VERSION_MASK;
+                message->version_mask = 0;
+            } else if (cJSON_IsString(mask)) {
                 result = STRATUM_RESULT_VERSION_MASK;
                 message->version_mask = strtoul(mask->valuestring, NULL, 16);
             } else {
@@ -271,50 +353,36 @@ void STRATUM_V1_parse(StratumApiV1Message * message, const char * stratum_json)
     message->method = result;
 
     if (message->method == MINING_NOTIFY) {
-
-        mining_notify * new_work = malloc(sizeof(mining_notify));
-        // new_work->difficulty = difficulty;
-        cJSON * params = cJSON_GetObjectItem(json, "params");
-        new_work->job_id = strdup(cJSON_GetArrayItem(params, 0)->valuestring);
-        new_work->prev_block_hash = strdup(cJSON_GetArrayItem(params, 1)->valuestring);
-        new_work->coinbase_1 = strdup(cJSON_GetArrayItem(params, 2)->valuestring);
-        new_work->coinbase_2 = strdup(cJSON_GetArrayItem(params, 3)->valuestring);
-
-        cJSON * merkle_branch = cJSON_GetArrayItem(params, 4);
-        new_work->n_merkle_branches = cJSON_GetArraySize(merkle_branch);
-        if (new_work->n_merkle_branches > MAX_MERKLE_BRANCHES) {
-            printf("Too many Merkle branches.\n");
-            abort();
+        message->mining_notification = parse_mining_notify(cJSON_GetObjectItem(json, "params"), &message->should_abandon_work);
+        if (message->mining_notification == NULL) {
+            discard_malformed(message, stratum_json);
         }
-        new_work->merkle_branches = malloc(HASH_SIZE * new_work->n_merkle_branches);
-        for (size_t i = 0; i < new_work->n_merkle_branches; i++) {
-            hex2bin(cJSON_GetArrayItem(merkle_branch, i)->valuestring, new_work->merkle_branches + HASH_SIZE * i, HASH_SIZE);
-        }
-
-        new_work->version = strtoul(cJSON_GetArrayItem(params, 5)->valuestring, NULL, 16);
-        new_work->target = strtoul(cJSON_GetArrayItem(params, 6)->valuestring, NULL, 16);
-        new_work->ntime = strtoul(cJSON_GetArrayItem(params, 7)->valuestring, NULL, 16);
-
-        message->mining_notification = new_work;
-
-        // params can be varible length
-        int paramsLength = cJSON_GetArraySize(params);
-        int value = cJSON_IsTrue(cJSON_GetArrayItem(params, paramsLength - 1));
-        message->should_abandon_work = value;
     } else if (message->method == MINING_SET_DIFFICULTY) {
         cJSON * params = cJSON_GetObjectItem(json, "params");
-        uint32_t difficulty = cJSON_GetArrayItem(params, 0)->valueint;
-        message->new_difficulty = difficulty;
+        cJSON * difficulty = cJSON_GetArrayItem(params, 0);
+        if (cJSON_IsNumber(difficulty)) {
+            message->new_difficulty = difficulty->valuedouble;
+        } else {
+            discard_malformed(message, stratum_json);
+        }
     } else if (message->method == MINING_SET_VERSION_MASK) {
         cJSON * params = cJSON_GetObjectItem(json, "params");
-        uint32_t version_mask = strtoul(cJSON_GetArrayItem(params, 0)->valuestring, NULL, 16);
-        message->version_mask = version_mask;
+        const char * version_mask = array_string(params, 0);
+        if (version_mask != NULL) {
+            message->version_mask = strtoul(version_mask, NULL, 16);
+        } else {
+            discard_malformed(message, stratum_json);
+        }
     } else if (message->method == MINING_SET_EXTRANONCE) {
         cJSON * params = cJSON_GetObjectItem(json, "params");
-        char * extranonce_str = cJSON_GetArrayItem(params, 0)->valuestring;
-        uint32_t extranonce_2_len = cJSON_GetArrayItem(params, 1)->valueint;
-        message->extranonce_str = strdup(extranonce_str);
-        message->extranonce_2_len = extranonce_2_len;
+        const char * extranonce_str = array_string(params, 0);
+        cJSON * extranonce_2_len = cJSON_GetArrayItem(params, 1);
+        if (extranonce_str != NULL && cJSON_IsNumber(extranonce_2_len)) {
+            message->extranonce_str = strdup(extranonce_str);
+            message->extranonce_2_len = extranonce_2_len->valueint;
+        } else {
+            discard_malformed(message, stratum_json);
+        }
     }
     done:
     cJSON_Delete(json);
@@ -369,7 +437,7 @@ int STRATUM_V1_subscribe(int socket, int send_uid, const char * model)
     const esp_app_desc_t *app_desc = esp_app_get_description();
     const char *version = app_desc->version;	
     sprintf(subscribe_msg, "{\"id\": %d, \"method\": \"mining.subscribe\", \"params\": [\"bitaxe/%s/%s\"]}\n", send_uid, model, version);
-    debug_stratum_tx(subscribe_msg);
+    debug_stratum_tx(subscribe_msg, send_uid);
 
     return write(socket, subscribe_msg, strlen(subscribe_msg));
 }
@@ -378,7 +446,7 @@ int STRATUM_V1_suggest_difficulty(int socket, int send_uid, uint32_t difficulty)
 {
     char difficulty_msg[BUFFER_SIZE];
     sprintf(difficulty_msg, "{\"id\": %d, \"method\": \"mining.suggest_difficulty\", \"params\": [%ld]}\n", send_uid, difficulty);
-    debug_stratum_tx(difficulty_msg);
+    debug_stratum_tx(difficulty_msg, send_uid);
 
     return write(socket, difficulty_msg, strlen(difficulty_msg));
 }
@@ -387,7 +455,7 @@ int STRATUM_V1_extranonce_subscribe(int socket, int send_uid)
 {
     char extranonce_msg[BUFFER_SIZE];
     sprintf(extranonce_msg, "{\"id\": %d, \"method\": \"mining.extranonce.subscribe\", \"params\": []}\n", send_uid);
-    debug_stratum_tx(extranonce_msg);
+    debug_stratum_tx(extranonce_msg, send_uid);
 
     return write(socket, extranonce_msg, strlen(extranonce_msg));
 }
@@ -397,7 +465,7 @@ int STRATUM_V1_authorize(int socket, int send_uid, const char * username, const
     char authorize_msg[BUFFER_SIZE];
     sprintf(authorize_msg, "{\"id\": %d, \"method\": \"mining.authorize\", \"params\": [\"%s\", \"%s\"]}\n", send_uid, username,
             pass);
-    debug_stratum_tx(authorize_msg);
+    debug_stratum_tx(authorize_msg, send_uid);
 
     return write(socket, authorize_msg, strlen(authorize_msg));
 }
@@ -412,30 +480,41 @@ int STRATUM_V1_submit_share(int socket, int send_uid, const char * username, con
                             const char * extranonce_2, const uint32_t ntime,
                             const uint32_t nonce, const uint32_t version)
 {
+    // Fixed-width fields are formatted directly rather than through printf's %08x
+    char ntime_hex[9] = {0}, nonce_hex[9] = {0}, version_hex[9] = {0};
+    hex_encode_u32(ntime, ntime_hex);
+    hex_encode_u32(nonce, nonce_hex);
+    hex_encode_u32(version, version_hex);
+
     char submit_msg[BUFFER_SIZE];
     sprintf(submit_msg,
-            "{\"id\": %d, \"method\": \"mining.submit\", \"params\": [\"%s\", \"%s\", \"%s\", \"%08lx\", \"%08lx\", \"%08lx\"]}\n",
-            send_uid, username, jobid, extranonce_2, ntime, nonce, version);
-    debug_stratum_tx(submit_msg);
+            "{\"id\": %d, \"method\": \"mining.submit\", \"params\": [\"%s\", \"%s\", \"%s\", \"%s\", \"%s\", \"%s\"]}\n",
+            send_uid, username, jobid, extranonce_2, ntime_hex, nonce_hex, version_hex);
+    debug_stratum_tx(submit_msg, send_uid);
 
     return write(socket, submit_msg, strlen(submit_msg));
 }
 
-int STRATUM_V1_configure_version_rolling(int socket, int send_uid, uint32_t * version_mask)
+/**
+ * BIP310 mining.configure asking for version rolling on version_mask
+ * The pool answers with the subset of the mask it allows, or refuses when it cannot
+ * grant at least min_bit_count bits.
+ */
+int STRATUM_V1_configure_version_rolling(int socket, int send_uid, uint32_t version_mask, int min_bit_count)
 {
     char configure_msg[BUFFER_SIZE * 2];
     sprintf(configure_msg,
             "{\"id\": %d, \"method\": \"mining.configure\", \"params\": [[\"version-rolling\"], {\"version-rolling.mask\": "
-            "\"ffffffff\"}]}\n",
-            send_uid);
-    debug_stratum_tx(configure_msg);
+            "\"%08" PRIx32 "\", \"version-rolling.min-bit-count\": %d}]}\n",
+            send_uid, version_mask, min_bit_count);
+    debug_stratum_tx(configure_msg, send_uid);
 
     return write(socket, configure_msg, strlen(configure_msg));
 }
 
-static void debug_stratum_tx(const char * msg)
+static void debug_stratum_tx(const char * msg, int request_id)
 {
-    STRATUM_V1_stamp_tx(last_parsed_request_id);
+    STRATUM_V1_stamp_tx(request_id);
     //remove the trailing newline
     char * newline = strchr(msg, '\n');
     if (newline != NULL) {
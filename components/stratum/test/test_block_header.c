@@ -0,0 +1,112 @@
+#include "unity.h"
+#include "block_header.h"
+#include "mining.h"
+#include "utils.h"
+#include <string.h>
+
+static const char * GENESIS_HEADER = "0100000000000000000000000000000000000000000000000000000000000000000000003ba3edfd7a7b12b27a"
+                                     "c72c3e67768f617fc81bc3888a51323a9fb8aa4b1e5e4a29ab5f49ffff001d1dac2b7c";
+
+static uint32_t next_random(uint32_t * seed)
+{
+    *seed = *seed * 1664525 + 1013904223;
+    return *seed;
+}
+
+TEST_CASE("Block header struct is the serialized header", "[block_header]")
+{
+    uint8_t bytes[80];
+    hex2bin(GENESIS_HEADER, bytes, sizeof(bytes));
+
+    block_header_t header = {0};
+    header.version = 1;
+    hex2bin("3ba3edfd7a7b12b27ac72c3e67768f617fc81bc3888a51323a9fb8aa4b1e5e4a", header.merkle_root, 32);
+    header.ntime = 1231006505;
+    header.nbits = 0x1d00ffff;
+    header.nonce = 2083236893;
+    TEST_ASSERT_EQUAL_MEMORY(bytes, &header, sizeof(header));
+
+    uint8_t digest[32];
+    block_header_hash(&header, digest);
+    reverse_bytes(digest, sizeof(digest));
+    char hex[65];
+    bin2hex(digest, sizeof(digest), hex, sizeof(hex));
+    TEST_ASSERT_EQUAL_STRING("000000000019d6689c085ae165831e934ff763ae46a2a6c172b3f1b60a8ce26f", hex);
+}
+
+TEST_CASE("Block header hash matches the padded hash on every backend", "[block_header]")
+{
+    const char * active = sha256_backend_active()->name;
+    uint32_t seed = 3;
+
+    for (size_t b = 0; b < sha256_backend_count(); b++) {
+        const sha256_backend * backend = sha256_backend_at(b);
+        if (!sha256_backend_is_available(backend)) {
+            continue;
+        }
+        TEST_ASSERT_TRUE(sha256_backend_select(backend->name));
+
+        for (int round = 0; round < 50; round++) {
+            block_header_t header;
+            uint8_t * bytes = (uint8_t *) &header;
+            for (size_t i = 0; i < sizeof(header); i++) {
+                bytes[i] = next_random(&seed) >> 24;
+            }
+
+            uint8_t expected[32], actual[32];
+            sha256_double(bytes, sizeof(header), expected);
+            block_header_hash(&header, actual);
+            TEST_ASSERT_EQUAL_MEMORY_MESSAGE(expected, actual, 32, backend->name);
+        }
+
+        // The constant 32 byte padding in sha256_double against two padded hashes
+        for (size_t len = 0; len < 130; len++) {
+            uint8_t data[130], first[32], expected[32], actual[32];
+            for (size_t i = 0; i < len; i++) {
+                data[i] = next_random(&seed) >> 24;
+            }
+            sha256_hash(data, len, first);
+            sha256_hash(first, sizeof(first), expected);
+            sha256_double(data, len, actual);
+            TEST_ASSERT_EQUAL_MEMORY_MESSAGE(expected, actual, 32, backend->name);
+        }
+    }
+    sha256_backend_select(active);
+}
+
+TEST_CASE("Block header from a job hashes to the nonce difficulty", "[block_header]")
+{
+    mining_notify notify_message = {0};
+    notify_message.prev_block_hash = "d02b10fc0d4711eae1a805af50a8a83312a2215e00017f2b0000000000000000";
+    notify_message.version = 0x20000004;
+    notify_message.target = 0x1705ae3a;
+    notify_message.ntime = 0x646ff1a9;
+    notify_message.difficulty = 4;
+    bm_job job = construct_bm_job(&notify_message, "6d0359c451434605c52a5a9ce074340be47c2c63840731f9edf1db3f26b1cdd9", 0);
+
+    // the layout header construction used before block_header_t
+    const uint32_t nonce = 0x276E8947;
+    uint8_t bytes[80];
+    memcpy(bytes, &job.version, 4);
+    memcpy(bytes + 4, job.prev_block_hash, 32);
+    memcpy(bytes + 36, job.merkle_root, 32);
+    memcpy(bytes + 68, &job.ntime, 4);
+    memcpy(bytes + 72, &job.target, 4);
+    memcpy(bytes + 76, &nonce, 4);
+
+    block_header_t header;
+    construct_block_header(&job, job.version, nonce, &header);
+    TEST_ASSERT_EQUAL_MEMORY(bytes, &header, sizeof(header));
+
+    uint32_t midstate[SHA256_STATE_WORDS];
+    uint32_t hash[SHA256_STATE_WORDS];
+    block_header_midstate(&header, midstate);
+    block_header_hash_from_midstate(&header, midstate, hash);
+
+    uint256_t value;
+    for (int i = 0; i < SHA256_STATE_WORDS; i++) {
+        value.w[i] = flip32(hash[i]);
+    }
+    TEST_ASSERT_EQUAL_DOUBLE(test_nonce_value(&job, nonce, job.version), uint256_to_difficulty(&value));
+    TEST_ASSERT_EQUAL_INT(18, (int) uint256_to_difficulty(&value));
+}
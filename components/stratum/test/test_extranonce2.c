@@ -0,0 +1,117 @@
+#include "unity.h"
+#include "extranonce2.h"
+#include <stdlib.h>
+#include <string.h>
+
+TEST_CASE("Extranonce2 covers every value of short fields once", "[extranonce2]")
+{
+    // lengths 1 and 2 are small enough to walk completely, with and without an offset
+    static uint8_t seen[65536];
+    for (size_t len = 1; len <= 2; len++) {
+        const uint64_t total = 1ULL << (8 * len);
+        const uint64_t offsets[] = {0, 1, total - 1, 12345};
+        for (int o = 0; o < 4; o++) {
+            extranonce2_space space;
+            TEST_ASSERT_TRUE(extranonce2_space_init(&space, len, 0, 1, offsets[o]));
+            memset(seen, 0, sizeof(seen));
+
+            uint64_t value;
+            for (uint64_t i = 0; i < total; i++) {
+                TEST_ASSERT_TRUE(extranonce2_next(&space, &value));
+                TEST_ASSERT_TRUE(value < total);
+                TEST_ASSERT_EQUAL(0, seen[value]);
+                seen[value] = 1;
+                if (i == 0) {
+                    TEST_ASSERT_EQUAL_UINT64(offsets[o] % total, value);
+                }
+            }
+            TEST_ASSERT_TRUE(extranonce2_space_exhausted(&space));
+            TEST_ASSERT_FALSE(extranonce2_next(&space, &value));
+
+            extranonce2_space_reset(&space);
+            TEST_ASSERT_FALSE(extranonce2_space_exhausted(&space));
+            TEST_ASSERT_TRUE(extranonce2_next(&space, &value));
+            TEST_ASSERT_EQUAL_UINT64(offsets[o] % total, value);
+        }
+    }
+}
+
+TEST_CASE("Extranonce2 partitions never overlap", "[extranonce2]")
+{
+    static uint8_t seen[65536];
+    for (uint32_t count = 1; count <= 7; count++) {
+        memset(seen, 0, sizeof(seen));
+        for (uint32_t index = 0; index < count; index++) {
+            extranonce2_space space;
+            TEST_ASSERT_TRUE(extranonce2_space_init(&space, 2, index, count, 1000 * index + 77));
+            TEST_ASSERT_EQUAL_UINT64(65536 / count, space.partition_size);
+
+            uint64_t value;
+            while (extranonce2_next(&space, &value)) {
+                TEST_ASSERT_TRUE(value < 65536);
+                TEST_ASSERT_TRUE(value >= space.partition_start && value < space.partition_start + space.partition_size);
+                TEST_ASSERT_EQUAL(0, seen[value]);
+                seen[value] = 1;
+            }
+            TEST_ASSERT_EQUAL_UINT64(space.partition_size, space.used);
+        }
+    }
+
+    extranonce2_space space;
+    TEST_ASSERT_TRUE(extranonce2_space_init(&space, 1, 255, 256, 0));
+    TEST_ASSERT_FALSE(extranonce2_space_init(&space, 1, 0, 257, 0));
+    TEST_ASSERT_FALSE(extranonce2_space_init(&space, 1, 2, 2, 0));
+    TEST_ASSERT_FALSE(extranonce2_space_init(&space, 0, 0, 1, 0));
+}
+
+TEST_CASE("Extranonce2 partitions of long fields", "[extranonce2]")
+{
+    for (size_t len = 3; len <= 8; len++) {
+        for (uint32_t count = 1; count <= 4; count++) {
+            for (uint32_t index = 0; index < count; index++) {
+                extranonce2_space space;
+                // an offset past the end of the partition wraps into it
+                TEST_ASSERT_TRUE(extranonce2_space_init(&space, len, index, count, UINT64_MAX - 2));
+
+                uint64_t size = space.partition_size;
+                if (len < 8) {
+                    TEST_ASSERT_EQUAL_UINT64((1ULL << (8 * len)) / count, size);
+                } else if (count == 1) {
+                    TEST_ASSERT_EQUAL_UINT64(0, size);  // all 2^64 values
+                } else {
+                    TEST_ASSERT_EQUAL_UINT64(count == 2 ? 1ULL << 63 : count == 4 ? 1ULL << 62 : UINT64_MAX / 3, size);
+                }
+
+                uint64_t value, previous = 0;
+                for (int i = 0; i < 10; i++) {
+                    TEST_ASSERT_TRUE(extranonce2_next(&space, &value));
+                    TEST_ASSERT_TRUE(value - space.partition_start < size || size == 0);
+                    if (i > 0) {
+                        // consecutive, or wrapped back to the start of the partition
+                        TEST_ASSERT_TRUE(value == previous + 1 || value == space.partition_start);
+                    }
+                    previous = value;
+                }
+                TEST_ASSERT_FALSE(extranonce2_space_exhausted(&space));
+            }
+        }
+    }
+}
+
+TEST_CASE("Extranonce2 is written little-endian and zero padded", "[extranonce2]")
+{
+    const char * expected[] = {"ef", "efcd", "efcdab", "efcdab89", "efcdab8967", "efcdab896745", "efcdab89674523",
+                               "efcdab8967452301", "efcdab896745230100", "efcdab89674523010000000000000000"};
+    const size_t lengths[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 16};
+    for (int i = 0; i < 10; i++) {
+        char * hex = extranonce2_to_hex(0x0123456789abcdefULL, lengths[i]);
+        TEST_ASSERT_EQUAL_STRING(expected[i], hex);
+        free(hex);
+    }
+
+    uint8_t field[12];
+    memset(field, 0xaa, sizeof(field));
+    extranonce2_write(0x0102, field, 10);
+    const uint8_t written[12] = {0x02, 0x01, 0, 0, 0, 0, 0, 0, 0, 0, 0xaa, 0xaa};
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(written, field, sizeof(field));
+}
@@ -0,0 +1,237 @@
+#include "unity.h"
+#include "hex_codec.h"
+#include "utils.h"
+#include "esp_timer.h"
+#include <stdio.h>
+#include <string.h>
+
+// The byte-at-a-time codec utils.c had before hex_codec, kept as the reference
+
+static int legacy_hex2char(uint8_t x, char * c)
+{
+    if (x <= 9) {
+        *c = x + '0';
+    } else if (x <= 15) {
+        *c = x - 10 + 'a';
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+static size_t legacy_bin2hex(const uint8_t * buf, size_t buflen, char * hex, size_t hexlen)
+{
+    if ((hexlen + 1) < buflen * 2) {
+        return 0;
+    }
+    for (size_t i = 0; i < buflen; i++) {
+        if (legacy_hex2char(buf[i] >> 4, &hex[2 * i]) < 0) {
+            return 0;
+        }
+        if (legacy_hex2char(buf[i] & 0xf, &hex[2 * i + 1]) < 0) {
+            return 0;
+        }
+    }
+    hex[2 * buflen] = '\0';
+    return 2 * buflen;
+}
+
+static uint8_t legacy_hex2val(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    } else {
+        return 0;
+    }
+}
+
+static size_t legacy_hex2bin(const char * hex, uint8_t * bin, size_t bin_len)
+{
+    size_t len = 0;
+    while (*hex && len < bin_len) {
+        bin[len] = legacy_hex2val(*hex++) << 4;
+        if (!*hex) {
+            len++;
+            break;
+        }
+        bin[len++] |= legacy_hex2val(*hex++);
+    }
+    return len;
+}
+
+static uint32_t next_random(uint32_t * seed)
+{
+    *seed ^= *seed << 13;
+    *seed ^= *seed >> 17;
+    *seed ^= *seed << 5;
+    return *seed;
+}
+
+TEST_CASE("Hex codec round trips every byte", "[hex_codec]")
+{
+    uint8_t bin[256];
+    for (int i = 0; i < 256; i++) {
+        bin[i] = i;
+    }
+
+    char hex[513];
+    hex_encode(bin, sizeof(bin), hex);
+    TEST_ASSERT_EQUAL(512, strlen(hex));
+    TEST_ASSERT_EQUAL_STRING_LEN("000102030405060708090a0b0c0d0e0f10", hex, 34);
+    TEST_ASSERT_EQUAL_STRING("fcfdfeff", hex + 504);
+
+    uint8_t decoded[256];
+    TEST_ASSERT_TRUE(hex_decode(hex, sizeof(decoded), decoded));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(bin, decoded, sizeof(bin));
+
+    for (int i = 0; i < 512; i++) {
+        if (hex[i] >= 'a') {
+            hex[i] -= 'a' - 'A';
+        }
+    }
+    memset(decoded, 0, sizeof(decoded));
+    TEST_ASSERT_TRUE(hex_decode(hex, sizeof(decoded), decoded));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(bin, decoded, sizeof(bin));
+}
+
+TEST_CASE("Hex decode rejects every non-digit at every position", "[hex_codec]")
+{
+    char hex[97];
+    uint8_t bin[48];
+    memset(hex, '7', 96);
+    hex[96] = '\0';
+
+    for (int c = 1; c < 256; c++) {
+        if (hex_digit_value((char) c) >= 0) {
+            continue;
+        }
+        // positions in the vector blocks and in the scalar tail
+        for (int pos = 0; pos < 96; pos += 5) {
+            hex[pos] = (char) c;
+            TEST_ASSERT_FALSE(hex_decode(hex, 48, bin));
+            hex[pos] = '7';
+        }
+    }
+    TEST_ASSERT_TRUE(hex_decode(hex, 48, bin));
+
+    int digits = 0;
+    for (int c = 0; c < 256; c++) {
+        digits += hex_digit_value((char) c) >= 0;
+    }
+    TEST_ASSERT_EQUAL(22, digits);
+}
+
+TEST_CASE("Hex codec matches the byte-at-a-time functions", "[hex_codec]")
+{
+    // digits, both cases, separators and bytes the vector compares must not mistake for digits
+    static const char alphabet[] = "0123456789abcdefABCDEF0123456789abcdef gG:/@`\x10\x19\x80\xc1\xe6";
+    uint32_t seed = 0x12345678;
+
+    for (int round = 0; round < 2000; round++) {
+        size_t len = next_random(&seed) % 80;
+        uint8_t bin[80];
+        for (size_t i = 0; i < len; i++) {
+            bin[i] = next_random(&seed);
+        }
+
+        char expected_hex[161], actual_hex[161];
+        TEST_ASSERT_EQUAL(legacy_bin2hex(bin, len, expected_hex, sizeof(expected_hex)),
+                          bin2hex(bin, len, actual_hex, sizeof(actual_hex)));
+        TEST_ASSERT_EQUAL_STRING(expected_hex, actual_hex);
+
+        // mostly valid strings of any length, some with a stray character, decoded into a
+        // buffer that may be shorter or longer than the string
+        char hex[170];
+        size_t hex_len = next_random(&seed) % 169;
+        bool dirty = next_random(&seed) % 4 == 0;
+        for (size_t i = 0; i < hex_len; i++) {
+            hex[i] = alphabet[next_random(&seed) % (dirty ? sizeof(alphabet) - 1 : 22)];
+        }
+        hex[hex_len] = '\0';
+
+        size_t bin_len = next_random(&seed) % 90;
+        uint8_t expected[90], actual[90];
+        memset(expected, 0xa5, sizeof(expected));
+        memset(actual, 0xa5, sizeof(actual));
+        TEST_ASSERT_EQUAL(legacy_hex2bin(hex, expected, bin_len), hex2bin(hex, actual, bin_len));
+        TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, actual, sizeof(expected));
+    }
+
+    for (int c = 0; c < 256; c++) {
+        TEST_ASSERT_EQUAL(legacy_hex2val((char) c), hex2val((char) c));
+    }
+    for (int x = 0; x < 256; x++) {
+        char expected = 0, actual = 0;
+        TEST_ASSERT_EQUAL(legacy_hex2char(x, &expected), hex2char(x, &actual));
+        TEST_ASSERT_EQUAL(expected, actual);
+    }
+}
+
+TEST_CASE("Hex encode u32 is fixed width", "[hex_codec]")
+{
+    const uint32_t values[] = {0, 1, 0xf, 0x10, 0x276e8947, 0x1fffe000, 0xdeadbeef, 0xffffffff};
+    uint32_t seed = 99;
+    for (int i = 0; i < 1000; i++) {
+        uint32_t value = i < 8 ? values[i] : next_random(&seed);
+        char expected[9], actual[9] = {0};
+        snprintf(expected, sizeof(expected), "%08x", (unsigned int) value);
+        hex_encode_u32(value, actual);
+        TEST_ASSERT_EQUAL_STRING(expected, actual);
+    }
+}
+
+TEST_CASE("Hex codec throughput", "[hex_codec][bench]")
+{
+    // a merkle branch, a typical coinbase half, and a large block
+    const size_t sizes[] = {32, 100, 4096};
+    static uint8_t bin[4096];
+    static char hex[8193];
+    uint32_t seed = 5;
+    for (size_t i = 0; i < sizeof(bin); i++) {
+        bin[i] = next_random(&seed);
+    }
+
+    for (int s = 0; s < 3; s++) {
+        size_t len = sizes[s];
+        int iterations = 2000000 / len;
+        volatile uint8_t sink = 0;
+
+        int64_t start = esp_timer_get_time();
+        for (int i = 0; i < iterations; i++) {
+            legacy_bin2hex(bin, len, hex, sizeof(hex));
+            sink += hex[i % len];
+        }
+        int64_t legacy_encode = esp_timer_get_time() - start;
+
+        start = esp_timer_get_time();
+        for (int i = 0; i < iterations; i++) {
+            bin2hex(bin, len, hex, sizeof(hex));
+            sink += hex[i % len];
+        }
+        int64_t encode = esp_timer_get_time() - start;
+
+        start = esp_timer_get_time();
+        for (int i = 0; i < iterations; i++) {
+            legacy_hex2bin(hex, bin, len);
+            sink += bin[i % len];
+        }
+        int64_t legacy_decode = esp_timer_get_time() - start;
+
+        start = esp_timer_get_time();
+        for (int i = 0; i < iterations; i++) {
+            hex2bin(hex, bin, len);
+            sink += bin[i % len];
+        }
+        int64_t decode = esp_timer_get_time() - start;
+
+        double mb = (double) len * iterations;
+        printf("hex %4u bytes: encode %.0f -> %.0f MB/s, decode %.0f -> %.0f MB/s\n", (unsigned) len,
+               mb / (legacy_encode ? legacy_encode : 1), mb / (encode ? encode : 1), mb / (legacy_decode ? legacy_decode : 1),
+               mb / (decode ? decode : 1));
+        (void) sink;
+    }
+}
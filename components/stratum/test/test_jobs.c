@@ -0,0 +1,23 @@
+#include "test_jobs.h"
+
+bm_job construct_test_job(uint32_t version_mask)
+{
+    mining_notify notify_message = {0};
+    notify_message.prev_block_hash = "0c859545a3498373a57452fac22eb7113df2a465000543520000000000000000";
+    notify_message.version = 0x20000004;
+    notify_message.target = 0x1705ae3a;
+    notify_message.ntime = 0x647025b5;
+    notify_message.difficulty = 512;
+    return construct_bm_job(&notify_message, "5bdc1968499c3393873edf8e07a1c3a50a97fc3a9d1a376bbf77087dd63778eb", version_mask);
+}
+
+bm_job construct_low_difficulty_test_job(uint32_t version_mask)
+{
+    mining_notify notify_message = {0};
+    notify_message.prev_block_hash = "d02b10fc0d4711eae1a805af50a8a83312a2215e00017f2b0000000000000000";
+    notify_message.version = 0x20000004;
+    notify_message.target = 0x1705ae3a;
+    notify_message.ntime = 0x646ff1a9;
+    notify_message.difficulty = 4;
+    return construct_bm_job(&notify_message, "6d0359c451434605c52a5a9ce074340be47c2c63840731f9edf1db3f26b1cdd9", version_mask);
+}
@@ -0,0 +1,14 @@
+#ifndef TEST_JOBS_H_
+#define TEST_JOBS_H_
+
+#include "mining.h"
+
+// Jobs built from real notifies, for tests that need a header with a share of known difficulty
+
+// nonce 0x0a029ed1 at the notify's version is a difficulty 683 share; pool difficulty 512
+bm_job construct_test_job(uint32_t version_mask);
+
+// nonce 0x276e8947 at the notify's version is a difficulty 18 share; pool difficulty 4
+bm_job construct_low_difficulty_test_job(uint32_t version_mask);
+
+#endif /* TEST_JOBS_H_ */
@@ -0,0 +1,109 @@
+#include "unity.h"
+#include "line_buffer.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_CHUNK_SIZE 64
+#define TEST_MAX_LINE 256
+
+static void append_str(line_buffer * buffer, const char * data)
+{
+    line_buffer_append(buffer, data, strlen(data));
+}
+
+static void assert_next_line(line_buffer * buffer, const char * expected)
+{
+    char * line = line_buffer_next_line(buffer);
+    TEST_ASSERT_NOT_NULL(line);
+    TEST_ASSERT_EQUAL_STRING(expected, line);
+    free(line);
+}
+
+TEST_CASE("Line buffer splits and reassembles lines", "[line_buffer]")
+{
+    line_buffer buffer;
+    TEST_ASSERT_TRUE(line_buffer_init(&buffer, TEST_CHUNK_SIZE, TEST_MAX_LINE));
+
+    append_str(&buffer, "{\"id\":1}\n{\"id\"");
+    assert_next_line(&buffer, "{\"id\":1}");
+    TEST_ASSERT_NULL(line_buffer_next_line(&buffer));
+
+    append_str(&buffer, ":2}\r\n\n{\"id\":3}\n");
+    assert_next_line(&buffer, "{\"id\":2}");
+    assert_next_line(&buffer, "{\"id\":3}");
+    TEST_ASSERT_NULL(line_buffer_next_line(&buffer));
+    TEST_ASSERT_EQUAL(3, buffer.lines);
+    TEST_ASSERT_EQUAL(0, buffer.dropped_lines);
+
+    line_buffer_free(&buffer);
+}
+
+TEST_CASE("Line buffer discards an oversized line and resyncs", "[line_buffer]")
+{
+    line_buffer buffer;
+    TEST_ASSERT_TRUE(line_buffer_init(&buffer, TEST_CHUNK_SIZE, TEST_MAX_LINE));
+
+    char junk[TEST_CHUNK_SIZE];
+    memset(junk, 'x', sizeof(junk));
+
+    append_str(&buffer, "{\"id\":1}\n");
+    // a runaway line arriving one receive chunk at a time, far past the budget
+    for (int i = 0; i < 64; i++) {
+        line_buffer_append(&buffer, junk, sizeof(junk));
+        TEST_ASSERT_LESS_OR_EQUAL(TEST_MAX_LINE + TEST_CHUNK_SIZE, buffer.capacity);
+    }
+    append_str(&buffer, "xxxx\n{\"id\":2}\n");
+
+    assert_next_line(&buffer, "{\"id\":1}");
+    assert_next_line(&buffer, "{\"id\":2}");
+    TEST_ASSERT_NULL(line_buffer_next_line(&buffer));
+    TEST_ASSERT_EQUAL(1, buffer.dropped_lines);
+    TEST_ASSERT_LESS_OR_EQUAL(TEST_MAX_LINE + TEST_CHUNK_SIZE, buffer.high_water);
+
+    line_buffer_free(&buffer);
+}
+
+TEST_CASE("Line buffer keeps a line of exactly the maximum length", "[line_buffer]")
+{
+    line_buffer buffer;
+    TEST_ASSERT_TRUE(line_buffer_init(&buffer, TEST_CHUNK_SIZE, TEST_MAX_LINE));
+
+    char line[TEST_MAX_LINE + 2];
+    memset(line, 'a', TEST_MAX_LINE);
+    line[TEST_MAX_LINE] = '\n';
+    line[TEST_MAX_LINE + 1] = '\0';
+    append_str(&buffer, line);
+    line[TEST_MAX_LINE] = '\0';
+    assert_next_line(&buffer, line);
+
+    // one byte more is dropped, even when the newline arrives in the same chunk
+    memset(line, 'b', TEST_MAX_LINE + 1);
+    line[TEST_MAX_LINE + 1] = '\0';
+    append_str(&buffer, line);
+    append_str(&buffer, "\nok\n");
+    assert_next_line(&buffer, "ok");
+    TEST_ASSERT_EQUAL(1, buffer.dropped_lines);
+
+    line_buffer_free(&buffer);
+}
+
+TEST_CASE("Line buffer reset returns grown memory", "[line_buffer]")
+{
+    line_buffer buffer;
+    TEST_ASSERT_TRUE(line_buffer_init(&buffer, TEST_CHUNK_SIZE, TEST_MAX_LINE));
+
+    char partial[200];
+    memset(partial, 'p', sizeof(partial));
+    line_buffer_append(&buffer, partial, sizeof(partial));
+    TEST_ASSERT_GREATER_THAN(TEST_CHUNK_SIZE, buffer.capacity);
+
+    line_buffer_reset(&buffer);
+    TEST_ASSERT_EQUAL(TEST_CHUNK_SIZE, buffer.capacity);
+    TEST_ASSERT_EQUAL(0, buffer.len);
+
+    // the half line from before the reset must not leak into the next session
+    append_str(&buffer, "{\"id\":1}\n");
+    assert_next_line(&buffer, "{\"id\":1}");
+
+    line_buffer_free(&buffer);
+}
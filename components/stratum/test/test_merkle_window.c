@@ -0,0 +1,228 @@
+#include "unity.h"
+#include "merkle_window.h"
+#include "mining.h"
+#include "utils.h"
+#include "extranonce2.h"
+#include "esp_timer.h"
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_BRANCHES 12
+
+static uint8_t merkles[TEST_BRANCHES][32];
+
+static extranonce2_space make_space(size_t len)
+{
+    extranonce2_space space;
+    extranonce2_space_init(&space, len, 0, 1, 0);
+    return space;
+}
+
+static mining_notify make_notify(void)
+{
+    for (int i = 0; i < TEST_BRANCHES; i++) {
+        memset(merkles[i], i * 17, 32);
+    }
+    mining_notify notify_message = {0};
+    notify_message.coinbase_1 = "01000000010000000000000000000000000000000000000000000000000000000000000000ffffffff20020862062f503253482f04b8864e5008";
+    notify_message.coinbase_2 = "072f736c7573682f000000000100f2052a010000001976a914d23fcdf86f7e756a64a7a9688ef9903327048ed988ac00000000";
+    notify_message.merkle_branches = (uint8_t *) merkles;
+    notify_message.n_merkle_branches = TEST_BRANCHES;
+    notify_message.prev_block_hash = "d02b10fc0d4711eae1a805af50a8a83312a2215e00017f2b0000000000000000";
+    notify_message.version = 0x20000004;
+    notify_message.target = 0x1705ae3a;
+    notify_message.ntime = 0x646ff1a9;
+    notify_message.difficulty = 4;
+    return notify_message;
+}
+
+// The job create_jobs_task built before the window, from hex strings end to end
+static bm_job string_path_job(mining_notify * notify, uint32_t extranonce_2, uint32_t version_mask)
+{
+    char * extranonce_2_str = extranonce_2_generate(extranonce_2, 4);
+    char * coinbase_tx = construct_coinbase_tx(notify->coinbase_1, notify->coinbase_2, "e9695791", extranonce_2_str);
+    char * merkle_root = calculate_merkle_root_hash(coinbase_tx, merkles, TEST_BRANCHES);
+    bm_job job = construct_bm_job(notify, merkle_root, version_mask);
+    free(extranonce_2_str);
+    free(coinbase_tx);
+    free(merkle_root);
+    return job;
+}
+
+static void assert_same_job(const bm_job * expected, const bm_job * actual)
+{
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected->merkle_root, actual->merkle_root, 32);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected->merkle_root_be, actual->merkle_root_be, 32);
+    TEST_ASSERT_EQUAL_UINT8(expected->num_midstates, actual->num_midstates);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected->midstates, actual->midstates, expected->num_midstates * 32);
+    TEST_ASSERT_EQUAL_UINT32_ARRAY(expected->midstate_versions, actual->midstate_versions, expected->num_midstates);
+}
+
+TEST_CASE("Merkle window matches the string job path", "[merkle_window]")
+{
+    mining_notify notify = make_notify();
+    extranonce2_space space = make_space(4);
+    merkle_window window;
+    TEST_ASSERT_TRUE(merkle_window_init(&window, 4));
+    TEST_ASSERT_TRUE(merkle_window_reset(&window, &notify, "e9695791", &space, 0x1fffe000));
+
+    while (merkle_window_fill_one(&window)) {
+    }
+    TEST_ASSERT_EQUAL_UINT16(4, window.count);
+
+    // four from the ring, then the ring is empty and the rest are computed on demand
+    for (uint32_t i = 0; i < 6; i++) {
+        merkle_window_entry entry;
+        bool precomputed;
+        TEST_ASSERT_TRUE(merkle_window_take(&window, &entry, &precomputed));
+        TEST_ASSERT_EQUAL(i < 4, precomputed);
+        TEST_ASSERT_EQUAL_UINT32(i, entry.extranonce_2);
+
+        bm_job expected = string_path_job(&notify, i, 0x1fffe000);
+        bm_job actual = construct_bm_job_from_root(&notify, entry.merkle_root, 0x1fffe000, entry.midstates);
+        assert_same_job(&expected, &actual);
+
+        char * expected_hex = extranonce_2_generate(i, 4);
+        char * actual_hex = extranonce2_to_hex(entry.extranonce_2, 4);
+        TEST_ASSERT_EQUAL_STRING(expected_hex, actual_hex);
+        free(expected_hex);
+        free(actual_hex);
+    }
+    TEST_ASSERT_EQUAL_UINT32(4, window.precomputed);
+    TEST_ASSERT_EQUAL_UINT32(2, window.computed_inline);
+
+    merkle_window_free(&window);
+}
+
+TEST_CASE("Merkle window recomputes midstates on a version mask change", "[merkle_window]")
+{
+    mining_notify notify = make_notify();
+    extranonce2_space space = make_space(4);
+    merkle_window window;
+    TEST_ASSERT_TRUE(merkle_window_init(&window, 8));
+    TEST_ASSERT_TRUE(merkle_window_reset(&window, &notify, "e9695791", &space, 0));
+
+    merkle_window_entry entry;
+    bool precomputed;
+    merkle_window_take(&window, &entry, &precomputed);
+    TEST_ASSERT_TRUE(merkle_window_fill_one(&window));
+    TEST_ASSERT_TRUE(merkle_window_fill_one(&window));
+
+    // extranonce2 1 and 2 were computed for the old mask and keep their roots under the new one
+    merkle_window_set_version_mask(&window, 0x1fffe000);
+    TEST_ASSERT_EQUAL_UINT16(2, window.count);
+    for (uint32_t i = 1; i <= 2; i++) {
+        TEST_ASSERT_TRUE(merkle_window_take(&window, &entry, &precomputed));
+        TEST_ASSERT_TRUE(precomputed);
+        TEST_ASSERT_EQUAL_UINT32(i, entry.extranonce_2);
+
+        bm_job expected = string_path_job(&notify, i, 0x1fffe000);
+        bm_job actual = construct_bm_job_from_root(&notify, entry.merkle_root, 0x1fffe000, entry.midstates);
+        assert_same_job(&expected, &actual);
+    }
+
+    merkle_window_free(&window);
+}
+
+TEST_CASE("Merkle window memory accounting", "[merkle_window]")
+{
+    mining_notify notify = make_notify();
+    extranonce2_space space = make_space(4);
+    merkle_window window;
+    TEST_ASSERT_TRUE(merkle_window_init(&window, 16));
+    TEST_ASSERT_EQUAL(16 * sizeof(merkle_window_entry), merkle_window_memory(&window));
+
+    extranonce2_space space8 = make_space(8);
+    size_t coinbase_len = (strlen(notify.coinbase_1) + strlen(notify.coinbase_2)) / 2 + 4 + 8;
+    TEST_ASSERT_TRUE(merkle_window_reset(&window, &notify, "e9695791", &space8, 0));
+    TEST_ASSERT_EQUAL(coinbase_len, window.coinbase_len);
+    TEST_ASSERT_EQUAL(16 * sizeof(merkle_window_entry) + coinbase_len, merkle_window_memory(&window));
+
+    // a shorter coinbase reuses the buffer
+    TEST_ASSERT_TRUE(merkle_window_reset(&window, &notify, "e9695791", &space, 0));
+    TEST_ASSERT_EQUAL(coinbase_len - 4, window.coinbase_len);
+    TEST_ASSERT_EQUAL(16 * sizeof(merkle_window_entry) + coinbase_len, merkle_window_memory(&window));
+
+    // without a ring every entry is computed on demand
+    merkle_window_free(&window);
+    TEST_ASSERT_TRUE(merkle_window_init(&window, 0));
+    TEST_ASSERT_TRUE(merkle_window_reset(&window, &notify, "e9695791", &space, 0));
+    TEST_ASSERT_FALSE(merkle_window_fill_one(&window));
+    merkle_window_entry entry;
+    bool precomputed;
+    TEST_ASSERT_TRUE(merkle_window_take(&window, &entry, &precomputed));
+    TEST_ASSERT_FALSE(precomputed);
+    merkle_window_free(&window);
+}
+
+TEST_CASE("Merkle window stops when extranonce2 runs out", "[merkle_window]")
+{
+    mining_notify notify = make_notify();
+    extranonce2_space space;
+    TEST_ASSERT_TRUE(extranonce2_space_init(&space, 1, 3, 4, 0));  // 64 values, 192 to 255
+    merkle_window window;
+    TEST_ASSERT_TRUE(merkle_window_init(&window, 16));
+    TEST_ASSERT_TRUE(merkle_window_reset(&window, &notify, "e9695791", &space, 0));
+
+    merkle_window_entry entry;
+    bool precomputed;
+    for (int i = 0; i < 64; i++) {
+        merkle_window_fill_one(&window);
+        TEST_ASSERT_TRUE(merkle_window_take(&window, &entry, &precomputed));
+        TEST_ASSERT_EQUAL_UINT32(192 + i, entry.extranonce_2);
+    }
+    TEST_ASSERT_FALSE(merkle_window_fill_one(&window));
+    TEST_ASSERT_FALSE(merkle_window_take(&window, &entry, &precomputed));
+
+    // a new notify starts the partition over
+    TEST_ASSERT_TRUE(merkle_window_reset(&window, &notify, "e9695791", &space, 0));
+    TEST_ASSERT_TRUE(merkle_window_take(&window, &entry, &precomputed));
+    TEST_ASSERT_EQUAL_UINT32(192, entry.extranonce_2);
+    merkle_window_free(&window);
+}
+
+TEST_CASE("Merkle window job latency", "[merkle_window][bench]")
+{
+    const int iterations = 2000;
+    const int capacity = 64;
+    mining_notify notify = make_notify();
+    extranonce2_space space = make_space(4);
+    merkle_window window;
+    TEST_ASSERT_TRUE(merkle_window_init(&window, capacity));
+    TEST_ASSERT_TRUE(merkle_window_reset(&window, &notify, "e9695791", &space, 0x1fffe000));
+
+    merkle_window_entry entry;
+    bool precomputed;
+    volatile uint32_t sink = 0;
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < iterations; i++) {
+        merkle_window_take(&window, &entry, &precomputed);
+        bm_job job = construct_bm_job_from_root(&notify, entry.merkle_root, 0x1fffe000, entry.midstates);
+        sink += job.midstates[0][0];
+    }
+    int64_t inline_us = esp_timer_get_time() - start;
+
+    int64_t ready_us = 0;
+    for (int done = 0; done < iterations; done += capacity) {
+        while (merkle_window_fill_one(&window)) {
+        }
+        start = esp_timer_get_time();
+        for (int i = 0; i < capacity; i++) {
+            merkle_window_take(&window, &entry, &precomputed);
+            bm_job job = construct_bm_job_from_root(&notify, entry.merkle_root, 0x1fffe000, entry.midstates);
+            sink += job.midstates[0][0];
+        }
+        ready_us += esp_timer_get_time() - start;
+    }
+    if (ready_us == 0) {
+        ready_us = 1;
+    }
+    int precomputed_jobs = (iterations + capacity - 1) / capacity * capacity;
+
+    printf("merkle window: %u bytes for %d entries, job on demand %.2f us, job from window %.3f us\n",
+           (unsigned) merkle_window_memory(&window), capacity, (double) inline_us / iterations,
+           (double) ready_us / precomputed_jobs);
+    TEST_ASSERT_EQUAL_UINT32(precomputed_jobs, window.precomputed);
+    (void) sink;
+    merkle_window_free(&window);
+}
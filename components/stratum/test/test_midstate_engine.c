@@ -0,0 +1,162 @@
+#include "unity.h"
+#include "midstate_engine.h"
+#include "mining.h"
+#include "utils.h"
+#include "esp_timer.h"
+#include <stdio.h>
+#include <string.h>
+
+static void test_header(block_header_t * header, uint32_t seed)
+{
+    uint8_t * bytes = (uint8_t *) header;
+    for (size_t i = 0; i < sizeof(*header); i++) {
+        seed = seed * 1664525 + 1013904223;
+        bytes[i] = seed >> 24;
+    }
+}
+
+// The midstates as built before the engine: one increment_bitmask and one full compression each
+static void reference_midstates(const block_header_t * header, uint32_t version_mask, size_t count,
+                                uint32_t (*states)[SHA256_STATE_WORDS], uint32_t * versions)
+{
+    block_header_t rolled = *header;
+    for (size_t i = 0; i < count; i++) {
+        versions[i] = rolled.version;
+        block_header_midstate(&rolled, states[i]);
+        rolled.version = increment_bitmask(rolled.version, version_mask);
+    }
+}
+
+TEST_CASE("Midstate engine version matches repeated increment_bitmask", "[midstate_engine]")
+{
+    const uint32_t masks[] = {0, 0x00002000, 0x00006000, 0x1fffe000, 0x00ffff00, 0x10002000, 0x80000001, 0xffffffff};
+    const uint32_t versions[] = {0x20000004, 0x3fffe004, 0x20006000, 0xffffffff};
+
+    for (size_t m = 0; m < sizeof(masks) / sizeof(masks[0]); m++) {
+        for (size_t v = 0; v < sizeof(versions) / sizeof(versions[0]); v++) {
+            uint32_t expected = versions[v];
+            for (uint32_t index = 0; index < 70; index++) {
+                TEST_ASSERT_EQUAL_HEX32(expected, midstate_engine_version(versions[v], masks[m], index));
+                expected = increment_bitmask(expected, masks[m]);
+            }
+        }
+    }
+
+    // far indexes wrap inside the mask
+    TEST_ASSERT_EQUAL_HEX32(0x20000004, midstate_engine_version(0x20000004, 0x1fffe000, 0x10000));
+    TEST_ASSERT_EQUAL_HEX32(0x20002004, midstate_engine_version(0x20000004, 0x1fffe000, 0x10001));
+}
+
+TEST_CASE("Midstate engine matches sequential midstates", "[midstate_engine]")
+{
+    const uint32_t masks[] = {0, 0x00006000, 0x1fffe000, 0x10002000};
+
+    for (uint32_t seed = 1; seed <= 8; seed++) {
+        block_header_t header;
+        test_header(&header, seed);
+        uint32_t mask = masks[seed % 4];
+
+        // counts around the lane width, and a batch starting part way through the versions
+        uint32_t expected[40][SHA256_STATE_WORDS];
+        uint32_t expected_versions[40];
+        reference_midstates(&header, mask, 40, expected, expected_versions);
+
+        midstate_engine engine;
+        midstate_engine_init(&engine, &header, mask);
+        const size_t counts[] = {1, 4, 7, 8, 9, 17, 40};
+        for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+            uint32_t states[40][SHA256_STATE_WORDS];
+            uint32_t versions[40];
+            midstate_engine_run(&engine, 0, counts[c], states, versions);
+            TEST_ASSERT_EQUAL_UINT32_ARRAY(expected, states, counts[c] * SHA256_STATE_WORDS);
+            TEST_ASSERT_EQUAL_UINT32_ARRAY(expected_versions, versions, counts[c]);
+        }
+
+        uint32_t states[20][SHA256_STATE_WORDS];
+        midstate_engine_run(&engine, 13, 20, states, NULL);
+        TEST_ASSERT_EQUAL_UINT32_ARRAY(expected[13], states, 20 * SHA256_STATE_WORDS);
+    }
+}
+
+// Values calculated from esp-miner/components/stratum/test/verifiers/bm1397.py
+TEST_CASE("Midstate engine reproduces the BM1397 job vector", "[midstate_engine]")
+{
+    mining_notify notify_message = {0};
+    notify_message.prev_block_hash = "bf44fd3513dc7b837d60e5c628b572b448d204a8000007490000000000000000";
+    notify_message.version = 0x20000004;
+    notify_message.target = 0x1705dd01;
+    notify_message.ntime = 0x64658bd8;
+    notify_message.difficulty = 512;
+    const char * merkle_root = "cd1be82132ef0d12053dcece1fa0247fcfdb61d4dbd3eb32ea9ef9b4c604a846";
+
+    uint8_t expected_midstate_bin[32];
+    hex2bin("91DFEA528A9F73683D0D495DD6DD7415E1CA21CB411759E3E05D7D5FF285314D", expected_midstate_bin, 32);
+    reverse_bytes(expected_midstate_bin, 32);
+
+    bm_job job = construct_bm_job(&notify_message, merkle_root, STRATUM_DEFAULT_VERSION_MASK);
+    TEST_ASSERT_EQUAL_UINT8(4, job.num_midstates);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected_midstate_bin, job.midstates[0], 32);
+
+    // the other three are the same header one, two and three version rolls on
+    block_header_t header;
+    construct_block_header(&job, job.version, 0, &header);
+    uint32_t version = job.version;
+    for (int i = 0; i < 4; i++) {
+        uint32_t state[SHA256_STATE_WORDS];
+        header.version = version;
+        block_header_midstate(&header, state);
+        for (int w = 0; w < SHA256_STATE_WORDS; w++) {
+            uint8_t word[4];
+            memcpy(word, job.midstates[i] + 28 - w * 4, 4);
+            TEST_ASSERT_EQUAL_HEX32(state[w], (uint32_t) word[0] << 24 | word[1] << 16 | word[2] << 8 | word[3]);
+        }
+        TEST_ASSERT_EQUAL_HEX32(version, job.midstate_versions[i]);
+        TEST_ASSERT_EQUAL_HEX32(version, bm_job_midstate_version(&job, i));
+        version = increment_bitmask(version, job.version_mask);
+    }
+
+    // the result path maps any index the chip reports, including ones past the job's midstates
+    TEST_ASSERT_EQUAL_HEX32(version, bm_job_midstate_version(&job, 4));
+    bm_job single = construct_bm_job(&notify_message, merkle_root, 0);
+    TEST_ASSERT_EQUAL_UINT8(1, single.num_midstates);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected_midstate_bin, single.midstates[0], 32);
+    TEST_ASSERT_EQUAL_HEX32(single.version, bm_job_midstate_version(&single, 3));
+}
+
+TEST_CASE("Midstate throughput", "[midstate_engine][bench]")
+{
+    const int iterations = 20000;
+    const size_t batches[] = {4, 8, 32};
+    block_header_t header;
+    test_header(&header, 7);
+    volatile uint32_t sink = 0;
+
+    for (size_t b = 0; b < sizeof(batches) / sizeof(batches[0]); b++) {
+        size_t count = batches[b];
+        uint32_t states[32][SHA256_STATE_WORDS];
+        uint32_t versions[32];
+
+        int64_t start = esp_timer_get_time();
+        for (int i = 0; i < iterations; i++) {
+            header.nonce = i;
+            reference_midstates(&header, 0x1fffe000, count, states, versions);
+            sink += states[count - 1][0];
+        }
+        int64_t sequential_us = esp_timer_get_time() - start;
+
+        midstate_engine engine;
+        start = esp_timer_get_time();
+        for (int i = 0; i < iterations; i++) {
+            header.nonce = i;
+            midstate_engine_init(&engine, &header, 0x1fffe000);
+            midstate_engine_run(&engine, 0, count, states, versions);
+            sink += states[count - 1][0];
+        }
+        int64_t engine_us = esp_timer_get_time() - start;
+
+        printf("midstates (%s, %u per job): sequential %.0f/s, engine %.0f/s\n", sha256_backend_active()->name,
+               (unsigned) count, iterations * count * 1e6 / (sequential_us ? sequential_us : 1),
+               iterations * count * 1e6 / (engine_us ? engine_us : 1));
+    }
+    TEST_ASSERT_TRUE(sink != 0);
+}
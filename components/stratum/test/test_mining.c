@@ -1,8 +1,12 @@
 #include "unity.h"
 #include "mining.h"
+#include "test_jobs.h"
 #include "utils.h"
+#include "mbedtls/sha256.h"
+#include "esp_timer.h"
 
 #include <limits.h>
+#include <string.h>
 
 TEST_CASE("Check coinbase tx construction", "[mining]")
 {
@@ -72,7 +76,7 @@ TEST_CASE("Validate bm job construction", "[mining]")
     hex2bin("91DFEA528A9F73683D0D495DD6DD7415E1CA21CB411759E3E05D7D5FF285314D", expected_midstate_bin, 32);
     // bytes are reversed for the midstate on the bm job command packet
     reverse_bytes(expected_midstate_bin, 32);
-    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected_midstate_bin, job.midstate, 32);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected_midstate_bin, job.midstates[0], 32);
 }
 
 TEST_CASE("Validate version mask incrementing", "[mining]")
@@ -106,7 +110,7 @@ TEST_CASE("Validate version mask incrementing", "[mining]")
 //     hex2bin("5FD281AF6A1750EAEE502C04067738BD46C82FC22112FFE797CE7F035D276126", expected_midstate_bin, 32);
 //     // bytes are reversed for the midstate on the bm job command packet
 //     reverse_bytes(expected_midstate_bin, 32);
-//     TEST_ASSERT_EQUAL_UINT8_ARRAY(expected_midstate_bin, job.midstate, 32);
+//     TEST_ASSERT_EQUAL_UINT8_ARRAY(expected_midstate_bin, job.midstates[0], 32);
 //     TEST_ASSERT_EQUAL_UINT32(0x1705ae3a, job.target);
 //     TEST_ASSERT_EQUAL_UINT32(0x6470e2a1, job.ntime);
 //     TEST_ASSERT_EQUAL_UINT8(0x8a, job.merkle_root[28]);
@@ -145,11 +149,11 @@ TEST_CASE("Test nonce diff checking", "[mining test_nonce]")
     notify_message.version = 0x20000004;
     notify_message.target = 0x1705ae3a;
     notify_message.ntime = 0x646ff1a9;
-    const char *merkle_root = "6d0359c451434605c52a5a9ce074340be47c2c63840731f9edf1db3f26b1cdd9a9f16f64";
+    const char *merkle_root = "6d0359c451434605c52a5a9ce074340be47c2c63840731f9edf1db3f26b1cdd9";
     bm_job job = construct_bm_job(&notify_message, merkle_root, 0);
 
     uint32_t nonce = 0x276E8947;
-    double diff = test_nonce_value(&job, nonce, 0);
+    double diff = test_nonce_value(&job, nonce, job.version);
     TEST_ASSERT_EQUAL_INT(18, (int)diff);
 }
 
@@ -185,6 +189,96 @@ TEST_CASE("Test nonce diff checking 2", "[mining test_nonce]")
     bm_job job = construct_bm_job(&notify_message, merkle_root, 0);
 
     uint32_t nonce = 0x0a029ed1;
-    double diff = test_nonce_value(&job, nonce, 0);
+    double diff = test_nonce_value(&job, nonce, job.version);
     TEST_ASSERT_EQUAL_INT(683, (int)diff);
 }
+
+// test_nonce_value before the midstate fast path: full double SHA256 of the 80 byte header
+static double reference_nonce_value(const bm_job *job, uint32_t nonce, uint32_t rolled_version)
+{
+    unsigned char header[80];
+    memcpy(header, &rolled_version, 4);
+    memcpy(header + 4, job->prev_block_hash, 32);
+    memcpy(header + 36, job->merkle_root, 32);
+    memcpy(header + 68, &job->ntime, 4);
+    memcpy(header + 72, &job->target, 4);
+    memcpy(header + 76, &nonce, 4);
+
+    unsigned char hash_buffer[32];
+    unsigned char hash_result[32];
+    mbedtls_sha256(header, 80, hash_buffer, 0);
+    mbedtls_sha256(hash_buffer, 32, hash_result, 0);
+
+    return 26959535291011309493156476344723991336010898738574164086137773096960.0 / le256todouble(hash_result);
+}
+
+TEST_CASE("Fast nonce verification matches full header hash", "[mining test_nonce]")
+{
+    bm_job job = construct_test_job(STRATUM_DEFAULT_VERSION_MASK);
+    TEST_ASSERT_EQUAL_UINT8(4, job.num_midstates);
+
+    // the known share, then a spread of nonces over the midstate versions, versions only
+    // reachable through the job cache, and a version repeated to hit that cache
+    TEST_ASSERT_TRUE(reference_nonce_value(&job, 0x0a029ed1, job.version) == test_nonce_value(&job, 0x0a029ed1, job.version));
+
+    uint32_t rolled_version = job.version;
+    for (int v = 0; v < 12; v++) {
+        uint32_t version = v < 8 ? rolled_version : job.version | ((uint32_t) (v * 0x2b7) << 13 & STRATUM_DEFAULT_VERSION_MASK);
+        for (uint32_t i = 0; i < 64; i++) {
+            uint32_t nonce = i * 0x9e3779b9;
+            TEST_ASSERT_TRUE(reference_nonce_value(&job, nonce, version) == test_nonce_value(&job, nonce, version));
+        }
+        rolled_version = increment_bitmask(rolled_version, job.version_mask);
+    }
+}
+
+TEST_CASE("Ticket check only rejects nonces below ticket difficulty", "[mining test_nonce]")
+{
+    bm_job job = construct_test_job(0);
+
+    double diff = test_nonce_value_ticket(&job, 0x0a029ed1, job.version, 256);
+    TEST_ASSERT_TRUE(diff == reference_nonce_value(&job, 0x0a029ed1, job.version));
+    TEST_ASSERT_EQUAL_INT(683, (int) diff);
+    TEST_ASSERT_TRUE(test_nonce_value_ticket(&job, 0x0a029ed1, job.version, 683) > 0.0);
+    TEST_ASSERT_TRUE(test_nonce_value_ticket(&job, 0x0a029ed1, job.version, 684) == 0.0);
+
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t nonce = i * 0x9e3779b9;
+        double reference = reference_nonce_value(&job, nonce, job.version);
+        double ticket = test_nonce_value_ticket(&job, nonce, job.version, 1);
+        if (reference >= 1.0) {
+            TEST_ASSERT_TRUE(ticket == reference);
+        } else {
+            TEST_ASSERT_TRUE(ticket == 0.0 || ticket == reference);
+        }
+    }
+}
+
+TEST_CASE("Nonce verification throughput", "[mining][bench]")
+{
+    const int iterations = 20000;
+    bm_job job = construct_test_job(STRATUM_DEFAULT_VERSION_MASK);
+    volatile double sink = 0;
+
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < iterations; i++) {
+        sink += reference_nonce_value(&job, i, job.version);
+    }
+    int64_t reference_us = esp_timer_get_time() - start;
+
+    start = esp_timer_get_time();
+    for (int i = 0; i < iterations; i++) {
+        sink += test_nonce_value(&job, i, job.version);
+    }
+    int64_t fast_us = esp_timer_get_time() - start;
+
+    start = esp_timer_get_time();
+    for (int i = 0; i < iterations; i++) {
+        sink += test_nonce_value_ticket(&job, i, job.version, 256);
+    }
+    int64_t ticket_us = esp_timer_get_time() - start;
+
+    printf("nonce verification: full header %.0f/s, midstate %.0f/s, midstate + ticket check %.0f/s\n",
+           iterations * 1e6 / reference_us, iterations * 1e6 / fast_us, iterations * 1e6 / ticket_us);
+    TEST_ASSERT_TRUE(sink >= 0);
+}
@@ -0,0 +1,127 @@
+#include "unity.h"
+#include "mining.h"
+#include "sha256_backend.h"
+#include "test_jobs.h"
+#include "esp_timer.h"
+#include <stdio.h>
+#include <string.h>
+
+static uint32_t next_random(uint32_t * seed)
+{
+    *seed = *seed * 1664525 + 1013904223;
+    return *seed;
+}
+
+TEST_CASE("Batched nonce verification matches single", "[nonce_batch]")
+{
+    bm_job jobs[3] = {construct_low_difficulty_test_job(0), construct_low_difficulty_test_job(0x1fffe000),
+                      construct_low_difficulty_test_job(0x1fffe000)};
+    jobs[2].ntime += 7;
+
+    // odd count so the last pass is a partial one, with the known diff 18 nonce in the middle
+    nonce_check checks[21];
+    uint32_t seed = 1;
+    for (int i = 0; i < 21; i++) {
+        checks[i].job = &jobs[i % 3];
+        checks[i].nonce = next_random(&seed);
+        checks[i].rolled_version = checks[i].job->version;
+        if (i % 3 != 0) {
+            // rolled versions inside and beyond the job's midstates
+            checks[i].rolled_version |= (next_random(&seed) & 0x1fffe000);
+        }
+    }
+    checks[9].nonce = 0x276E8947;
+
+    const uint32_t tickets[] = {0, 256};
+    for (int t = 0; t < 2; t++) {
+        nonce_result batch[21];
+        test_nonce_batch(checks, 21, tickets[t], batch);
+        for (int i = 0; i < 21; i++) {
+            nonce_result single = test_nonce_result(checks[i].job, checks[i].nonce, checks[i].rolled_version, tickets[t]);
+            TEST_ASSERT_EQUAL_DOUBLE(single.difficulty, batch[i].difficulty);
+            TEST_ASSERT_EQUAL(single.pool_share, batch[i].pool_share);
+            TEST_ASSERT_EQUAL(single.block, batch[i].block);
+        }
+    }
+
+    nonce_result batch[21];
+    test_nonce_batch(checks, 21, 0, batch);
+    TEST_ASSERT_EQUAL_INT(18, (int) batch[9].difficulty);
+    TEST_ASSERT_TRUE(batch[9].pool_share);
+}
+
+TEST_CASE("Batched nonce verification agrees on every backend", "[nonce_batch]")
+{
+    bm_job job = construct_low_difficulty_test_job(0x1fffe000);
+    nonce_check checks[NONCE_BATCH_LANES + 3];
+    for (int i = 0; i < NONCE_BATCH_LANES + 3; i++) {
+        checks[i] = (nonce_check) {&job, 0x276E8947 + (i == 0 ? 0 : i * 101), job.version};
+    }
+
+    nonce_result expected[NONCE_BATCH_LANES + 3];
+    test_nonce_batch(checks, NONCE_BATCH_LANES + 3, 0, expected);
+
+    const char * active = sha256_backend_active()->name;
+    for (size_t b = 0; b < sha256_backend_count(); b++) {
+        const sha256_backend * backend = sha256_backend_at(b);
+        if (!sha256_backend_is_available(backend)) {
+            continue;
+        }
+        TEST_ASSERT_TRUE(sha256_backend_select(backend->name));
+
+        nonce_result actual[NONCE_BATCH_LANES + 3];
+        test_nonce_batch(checks, NONCE_BATCH_LANES + 3, 0, actual);
+        for (int i = 0; i < NONCE_BATCH_LANES + 3; i++) {
+            TEST_ASSERT_EQUAL_DOUBLE_MESSAGE(expected[i].difficulty, actual[i].difficulty, backend->name);
+        }
+    }
+    sha256_backend_select(active);
+}
+
+/**
+ * Verification cost per nonce on each backend, singly and in batches, and the share of one
+ * core it would take at the result rates a BM1370 chain reaches at low ticket masks
+ */
+TEST_CASE("Batched nonce verification throughput", "[nonce_batch][bench]")
+{
+    enum { NONCES = 20000, BATCH = 16 };
+    static nonce_check checks[NONCES];
+    static nonce_result results[NONCES];
+    bm_job jobs[4];
+    for (int i = 0; i < 4; i++) {
+        jobs[i] = construct_low_difficulty_test_job(0x1fffe000);
+    }
+    uint32_t seed = 7;
+    for (int i = 0; i < NONCES; i++) {
+        // results arrive a few per job and version before the chip moves on
+        bm_job * job = &jobs[(i / 32) % 4];
+        checks[i] = (nonce_check) {job, next_random(&seed), job->version | (((i / 8) << 13) & 0x1fffe000)};
+    }
+
+    const char * active = sha256_backend_active()->name;
+    for (size_t b = 0; b < sha256_backend_count(); b++) {
+        const sha256_backend * backend = sha256_backend_at(b);
+        if (!sha256_backend_is_available(backend)) {
+            continue;
+        }
+        sha256_backend_select(backend->name);
+
+        int64_t start = esp_timer_get_time();
+        for (int i = 0; i < NONCES; i++) {
+            results[i] = test_nonce_result(checks[i].job, checks[i].nonce, checks[i].rolled_version, 256);
+        }
+        double single_us = (double) (esp_timer_get_time() - start) / NONCES;
+
+        start = esp_timer_get_time();
+        for (int i = 0; i < NONCES; i += BATCH) {
+            test_nonce_batch(checks + i, BATCH, 256, results + i);
+        }
+        double batch_us = (double) (esp_timer_get_time() - start) / NONCES;
+
+        printf("nonce verify %-10s single %.3f us, batch of %d %.3f us; core load at 1k/10k/100k nonces/s: "
+               "single %.2f/%.1f/%.1f%%, batched %.2f/%.1f/%.1f%%\n",
+               backend->name, single_us, BATCH, batch_us, single_us * 0.1, single_us, single_us * 10, batch_us * 0.1,
+               batch_us, batch_us * 10);
+    }
+    sha256_backend_select(active);
+}
@@ -0,0 +1,116 @@
+#include "unity.h"
+#include "ntime_roll.h"
+#include "mining.h"
+#include "utils.h"
+#include "sha256_backend.h"
+#include "test_jobs.h"
+#include "esp_timer.h"
+#include <stdio.h>
+#include <string.h>
+
+static double header_difficulty(const bm_job * job, uint32_t nonce)
+{
+    uint8_t header[80];
+    memcpy(header, &job->version, 4);
+    memcpy(header + 4, job->prev_block_hash, 32);
+    memcpy(header + 36, job->merkle_root, 32);
+    memcpy(header + 68, &job->ntime, 4);
+    memcpy(header + 72, &job->target, 4);
+    memcpy(header + 76, &nonce, 4);
+
+    uint8_t digest[32];
+    uint256_t hash;
+    sha256_double(header, sizeof(header), digest);
+    uint256_from_le_bytes(&hash, digest);
+    return uint256_to_difficulty(&hash);
+}
+
+TEST_CASE("ntime window follows the pool clock", "[ntime_roll]")
+{
+    ntime_window window;
+    ntime_window_init(&window, 1000, 5000000, 60);
+
+    TEST_ASSERT_EQUAL_UINT32(1060, ntime_window_max(&window, 5000000));
+    TEST_ASSERT_TRUE(ntime_window_allows(&window, 1000, 5000000));
+    TEST_ASSERT_TRUE(ntime_window_allows(&window, 1060, 5000000));
+    TEST_ASSERT_FALSE(ntime_window_allows(&window, 1061, 5000000));
+    TEST_ASSERT_FALSE(ntime_window_allows(&window, 999, 5000000));
+
+    // ten seconds later the pool's clock has moved on with ours
+    TEST_ASSERT_EQUAL_UINT32(1070, ntime_window_max(&window, 15000000));
+    TEST_ASSERT_TRUE(ntime_window_allows(&window, 1070, 15000000));
+    TEST_ASSERT_FALSE(ntime_window_allows(&window, 1071, 15000000));
+
+    // a clock that appears to run backwards never widens the window
+    TEST_ASSERT_EQUAL_UINT32(1060, ntime_window_max(&window, 0));
+
+    ntime_window_init(&window, 0xfffffff0, 0, 0);
+    TEST_ASSERT_TRUE(ntime_window_allows(&window, 4, 20000000));
+    TEST_ASSERT_FALSE(ntime_window_allows(&window, 5, 20000000));
+    TEST_ASSERT_FALSE(ntime_window_allows(&window, 0xffffffef, 20000000));
+}
+
+TEST_CASE("ntime rolled jobs hash the rolled header", "[ntime_roll]")
+{
+    bm_job job = construct_low_difficulty_test_job(0);
+    bm_job rolled = construct_bm_job_rolled_ntime(&job, job.ntime + 5);
+
+    TEST_ASSERT_EQUAL_UINT32(job.ntime + 5, rolled.ntime);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(job.midstates, rolled.midstates, job.num_midstates * 32);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(job.merkle_root, rolled.merkle_root, 32);
+    TEST_ASSERT_NULL(rolled.jobid);
+    TEST_ASSERT_NULL(rolled.extranonce2);
+
+    // same nonce, different header: the rolled job must not reuse the original's result
+    const uint32_t nonce = 0x276E8947;
+    TEST_ASSERT_EQUAL_INT(18, (int) test_nonce_value(&job, nonce, job.version));
+    for (uint32_t n = nonce; n < nonce + 64; n++) {
+        TEST_ASSERT_EQUAL_DOUBLE(header_difficulty(&rolled, n), test_nonce_value(&rolled, n, rolled.version));
+    }
+}
+
+TEST_CASE("Job generation throughput", "[ntime_roll][bench]")
+{
+    const int iterations = 2000;
+    const char * coinbase_1 = "01000000010000000000000000000000000000000000000000000000000000000000000000ffffffff20020862062f503253482f04b8864e5008";
+    const char * coinbase_2 = "072f736c7573682f000000000100f2052a010000001976a914d23fcdf86f7e756a64a7a9688ef9903327048ed988ac00000000";
+    uint8_t merkles[12][32];
+    for (int i = 0; i < 12; i++) {
+        memset(merkles[i], i * 17, 32);
+    }
+    mining_notify notify_message = {0};
+    notify_message.prev_block_hash = "d02b10fc0d4711eae1a805af50a8a83312a2215e00017f2b0000000000000000";
+    notify_message.version = 0x20000004;
+    notify_message.target = 0x1705ae3a;
+    notify_message.ntime = 0x646ff1a9;
+    notify_message.difficulty = 4;
+
+    bm_job job = {0};
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < iterations; i++) {
+        char * extranonce_2 = extranonce_2_generate(i, 4);
+        char * coinbase_tx = construct_coinbase_tx(coinbase_1, coinbase_2, "e9695791", extranonce_2);
+        char * merkle_root = calculate_merkle_root_hash(coinbase_tx, merkles, 12);
+        job = construct_bm_job(&notify_message, merkle_root, 0x1fffe000);
+        free(extranonce_2);
+        free(coinbase_tx);
+        free(merkle_root);
+    }
+    int64_t extranonce2_us = esp_timer_get_time() - start;
+
+    volatile uint32_t sink = 0;
+    start = esp_timer_get_time();
+    for (int i = 0; i < iterations; i++) {
+        bm_job rolled = construct_bm_job_rolled_ntime(&job, job.ntime + 1 + (i & 7));
+        sink += rolled.ntime;
+    }
+    int64_t ntime_us = esp_timer_get_time() - start;
+    if (ntime_us == 0) {
+        ntime_us = 1;
+    }
+
+    printf("job generation: extranonce2 %.0f jobs/s (%.2f us/job), ntime rolled %.0f jobs/s (%.3f us/job)\n",
+           iterations * 1e6 / extranonce2_us, (double) extranonce2_us / iterations, iterations * 1e6 / ntime_us,
+           (double) ntime_us / iterations);
+    TEST_ASSERT_TRUE(sink > 0);
+}
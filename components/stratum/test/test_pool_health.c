@@ -0,0 +1,208 @@
+#include "unity.h"
+#include "pool_health.h"
+
+#define SEC(s) ((int64_t) (s) * 1000000)
+
+static pool_health_monitor monitor;
+
+static void setup_monitor(void)
+{
+    pool_health_policy policy;
+    pool_health_policy_default(&policy);
+    pool_health_init(&monitor, &policy, 0);
+}
+
+// Scripted healthy pool: connected, notifies on schedule, shares accepted with a low RTT
+static void run_healthy(pool_health * pool, int64_t from_us, int64_t to_us)
+{
+    for (int64_t t = from_us; t <= to_us; t += SEC(30)) {
+        pool_health_record_notify(pool, t);
+        pool_health_record_share(pool, POOL_SHARE_ACCEPTED, 120);
+    }
+}
+
+TEST_CASE("Fresh pools score full marks", "[pool_health]")
+{
+    setup_monitor();
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 100.0, pool_health_score(&monitor.pools[POOL_HEALTH_PRIMARY], &monitor.policy, 0));
+    TEST_ASSERT_EQUAL(POOL_HEALTH_PRIMARY, pool_health_select(&monitor, true, 0));
+    TEST_ASSERT_EQUAL(POOL_SWITCH_NONE, monitor.last_switch_reason);
+}
+
+TEST_CASE("Healthy primary is kept", "[pool_health]")
+{
+    setup_monitor();
+    pool_health * primary = &monitor.pools[POOL_HEALTH_PRIMARY];
+    pool_health_record_connect(primary, true);
+    pool_health_record_session(primary, 0);
+    run_healthy(primary, 0, SEC(3600));
+
+    TEST_ASSERT_EQUAL(POOL_HEALTH_PRIMARY, pool_health_select(&monitor, true, SEC(3600)));
+    TEST_ASSERT_EQUAL(0, monitor.switch_count);
+    TEST_ASSERT_GREATER_THAN(90, primary->score);
+}
+
+TEST_CASE("Consecutive connect failures force failover", "[pool_health]")
+{
+    setup_monitor();
+    pool_health * primary = &monitor.pools[POOL_HEALTH_PRIMARY];
+
+    pool_health_record_connect(primary, false);
+    pool_health_record_connect(primary, false);
+    TEST_ASSERT_EQUAL(POOL_HEALTH_PRIMARY, pool_health_select(&monitor, true, SEC(10)));
+
+    pool_health_record_connect(primary, false);
+    TEST_ASSERT_EQUAL(POOL_HEALTH_FALLBACK, pool_health_select(&monitor, true, SEC(15)));
+    TEST_ASSERT_EQUAL(POOL_SWITCH_CONNECT_FAILURES, monitor.last_switch_reason);
+    TEST_ASSERT_EQUAL(1, monitor.switch_count);
+}
+
+TEST_CASE("Connect failures ignore dwell time", "[pool_health]")
+{
+    setup_monitor();
+    pool_health * fallback = &monitor.pools[POOL_HEALTH_FALLBACK];
+    for (int i = 0; i < 3; i++) {
+        pool_health_record_connect(&monitor.pools[POOL_HEALTH_PRIMARY], false);
+    }
+    TEST_ASSERT_EQUAL(POOL_HEALTH_FALLBACK, pool_health_select(&monitor, true, SEC(1)));
+
+    // fallback dies too right away, toggle back like the old retry logic did
+    for (int i = 0; i < 3; i++) {
+        pool_health_record_connect(fallback, false);
+    }
+    TEST_ASSERT_EQUAL(POOL_HEALTH_PRIMARY, pool_health_select(&monitor, true, SEC(2)));
+    TEST_ASSERT_EQUAL(0, monitor.pools[POOL_HEALTH_PRIMARY].consecutive_connect_failures);
+}
+
+TEST_CASE("Silent pool fails over after dwell", "[pool_health]")
+{
+    setup_monitor();
+    pool_health * primary = &monitor.pools[POOL_HEALTH_PRIMARY];
+    pool_health_record_connect(primary, true);
+    pool_health_record_session(primary, 0);
+    run_healthy(primary, 0, SEC(300));
+
+    // the pool stops sending mining.notify but keeps the socket open
+    TEST_ASSERT_EQUAL(POOL_HEALTH_PRIMARY, pool_health_select(&monitor, true, SEC(360)));
+    TEST_ASSERT_EQUAL(POOL_HEALTH_PRIMARY, pool_health_select(&monitor, true, SEC(420)));
+    TEST_ASSERT_EQUAL(POOL_HEALTH_FALLBACK, pool_health_select(&monitor, true, SEC(600)));
+    TEST_ASSERT_EQUAL(POOL_SWITCH_DEGRADED, monitor.last_switch_reason);
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 0.0, primary->freshness_score);
+    TEST_ASSERT_FALSE(primary->connected);
+}
+
+TEST_CASE("Reject storm fails over", "[pool_health]")
+{
+    setup_monitor();
+    pool_health * primary = &monitor.pools[POOL_HEALTH_PRIMARY];
+    pool_health_record_connect(primary, true);
+    pool_health_record_session(primary, 0);
+    run_healthy(primary, 0, SEC(300));
+    TEST_ASSERT_EQUAL(POOL_HEALTH_PRIMARY, pool_health_select(&monitor, true, SEC(300)));
+
+    // notifies keep arriving but every share is rejected, half of them as stale, and answered slowly
+    for (int i = 0; i < 20; i++) {
+        pool_health_record_share(primary, i % 2 ? POOL_SHARE_REJECTED : POOL_SHARE_STALE, 2500);
+    }
+    pool_health_record_notify(primary, SEC(330));
+    TEST_ASSERT_EQUAL(POOL_HEALTH_FALLBACK, pool_health_select(&monitor, true, SEC(330)));
+    TEST_ASSERT_EQUAL(POOL_SWITCH_DEGRADED, monitor.last_switch_reason);
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 100.0, primary->freshness_score);
+    TEST_ASSERT_LESS_THAN(50, primary->reject_score);
+    TEST_ASSERT_LESS_THAN(50, primary->stale_score);
+    TEST_ASSERT_LESS_THAN(10, primary->rtt_score);
+}
+
+TEST_CASE("Occasional rejects do not fail over", "[pool_health]")
+{
+    setup_monitor();
+    pool_health * primary = &monitor.pools[POOL_HEALTH_PRIMARY];
+    pool_health_record_connect(primary, true);
+    pool_health_record_session(primary, 0);
+    for (int i = 0; i < 200; i++) {
+        pool_health_record_share(primary, i % 20 ? POOL_SHARE_ACCEPTED : POOL_SHARE_REJECTED, 150);
+    }
+    pool_health_record_notify(primary, SEC(600));
+    TEST_ASSERT_EQUAL(POOL_HEALTH_PRIMARY, pool_health_select(&monitor, true, SEC(600)));
+    TEST_ASSERT_GREATER_THAN(monitor.policy.fail_score, primary->score);
+}
+
+TEST_CASE("Degraded pool is held for the dwell time", "[pool_health]")
+{
+    setup_monitor();
+    monitor.policy.min_dwell_ms = 600000;
+    pool_health * primary = &monitor.pools[POOL_HEALTH_PRIMARY];
+    pool_health_record_connect(primary, true);
+    pool_health_record_session(primary, 0);
+
+    // silent from the start: degraded well before min_dwell_ms has passed
+    TEST_ASSERT_EQUAL(POOL_HEALTH_PRIMARY, pool_health_select(&monitor, true, SEC(300)));
+    TEST_ASSERT_LESS_THAN(monitor.policy.fail_score, primary->score);
+    TEST_ASSERT_EQUAL(0, monitor.switch_count);
+
+    TEST_ASSERT_EQUAL(POOL_HEALTH_FALLBACK, pool_health_select(&monitor, true, SEC(601)));
+}
+
+TEST_CASE("Return to primary uses hysteresis", "[pool_health]")
+{
+    setup_monitor();
+    pool_health * primary = &monitor.pools[POOL_HEALTH_PRIMARY];
+    pool_health * fallback = &monitor.pools[POOL_HEALTH_FALLBACK];
+
+    for (int i = 0; i < 3; i++) {
+        pool_health_record_connect(primary, false);
+    }
+    TEST_ASSERT_EQUAL(POOL_HEALTH_FALLBACK, pool_health_select(&monitor, true, SEC(10)));
+    pool_health_record_connect(fallback, true);
+    pool_health_record_session(fallback, SEC(10));
+    run_healthy(fallback, SEC(10), SEC(1000));
+
+    // heartbeat probes keep failing: no way back
+    pool_health_record_connect(primary, false);
+    TEST_ASSERT_EQUAL(POOL_HEALTH_FALLBACK, pool_health_select(&monitor, true, SEC(1000)));
+
+    // one or two good probes are not enough, connect history still drags the score down
+    pool_health_record_connect(primary, true);
+    TEST_ASSERT_EQUAL(POOL_HEALTH_FALLBACK, pool_health_select(&monitor, true, SEC(1060)));
+    pool_health_record_connect(primary, true);
+    TEST_ASSERT_EQUAL(POOL_HEALTH_FALLBACK, pool_health_select(&monitor, true, SEC(1120)));
+    TEST_ASSERT_GREATER_THAN(monitor.policy.fail_score, primary->score);
+    TEST_ASSERT_LESS_THAN(monitor.policy.return_score, primary->score);
+
+    // a third good probe lifts it over return_score
+    pool_health_record_connect(primary, true);
+    TEST_ASSERT_EQUAL(POOL_HEALTH_PRIMARY, pool_health_select(&monitor, true, SEC(1180)));
+    TEST_ASSERT_EQUAL(POOL_SWITCH_RETURN_TO_PRIMARY, monitor.last_switch_reason);
+    TEST_ASSERT_EQUAL(2, monitor.switch_count);
+}
+
+TEST_CASE("Standby reject history fades", "[pool_health]")
+{
+    setup_monitor();
+    pool_health * primary = &monitor.pools[POOL_HEALTH_PRIMARY];
+    for (int i = 0; i < 60; i++) {
+        pool_health_record_share(primary, POOL_SHARE_REJECTED, -1);
+    }
+    pool_health_score(primary, &monitor.policy, SEC(1));
+    TEST_ASSERT_LESS_THAN(10, primary->reject_score);
+
+    pool_health_score(primary, &monitor.policy, SEC(1) + (int64_t) monitor.policy.min_dwell_ms * 1000 * 4);
+    TEST_ASSERT_GREATER_THAN(60, primary->reject_score);
+}
+
+TEST_CASE("Without fallback the primary is always used", "[pool_health]")
+{
+    setup_monitor();
+    pool_health * primary = &monitor.pools[POOL_HEALTH_PRIMARY];
+    for (int i = 0; i < 5; i++) {
+        pool_health_record_connect(primary, false);
+    }
+    TEST_ASSERT_EQUAL(POOL_HEALTH_PRIMARY, pool_health_select(&monitor, false, SEC(10)));
+    TEST_ASSERT_EQUAL(0, monitor.switch_count);
+    TEST_ASSERT_EQUAL(0, primary->consecutive_connect_failures);
+
+    // fallback removed while it was in use
+    monitor.active = POOL_HEALTH_FALLBACK;
+    TEST_ASSERT_EQUAL(POOL_HEALTH_PRIMARY, pool_health_select(&monitor, false, SEC(20)));
+    TEST_ASSERT_EQUAL(POOL_SWITCH_NO_FALLBACK, monitor.last_switch_reason);
+}
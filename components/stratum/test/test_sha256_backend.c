@@ -0,0 +1,160 @@
+#include "unity.h"
+#include "sha256_backend.h"
+#include "utils.h"
+#include "esp_timer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void assert_digest(const sha256_backend * backend, const char * expected_hex, const uint8_t digest[SHA256_DIGEST_SIZE])
+{
+    char hex[SHA256_DIGEST_SIZE * 2 + 1];
+    bin2hex(digest, SHA256_DIGEST_SIZE, hex, sizeof(hex));
+    TEST_ASSERT_EQUAL_STRING_MESSAGE(expected_hex, hex, backend->name);
+}
+
+TEST_CASE("Every available SHA-256 backend matches the FIPS 180-2 vectors", "[sha256]")
+{
+    const char * two_block = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+    uint8_t * million_a = malloc(1000000);
+    TEST_ASSERT_NOT_NULL(million_a);
+    memset(million_a, 'a', 1000000);
+
+    int tested = 0;
+    for (size_t i = 0; i < sha256_backend_count(); i++) {
+        const sha256_backend * backend = sha256_backend_at(i);
+        if (!sha256_backend_is_available(backend)) {
+            continue;
+        }
+        uint8_t digest[SHA256_DIGEST_SIZE];
+
+        sha256_hash_with(backend, NULL, 0, digest);
+        assert_digest(backend, "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855", digest);
+        sha256_hash_with(backend, (const uint8_t *) "abc", 3, digest);
+        assert_digest(backend, "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad", digest);
+        sha256_hash_with(backend, (const uint8_t *) two_block, strlen(two_block), digest);
+        assert_digest(backend, "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1", digest);
+        sha256_hash_with(backend, million_a, 1000000, digest);
+        assert_digest(backend, "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0", digest);
+        tested++;
+    }
+    free(million_a);
+
+    // generic is always there
+    TEST_ASSERT_GREATER_OR_EQUAL(1, tested);
+    TEST_ASSERT_TRUE(sha256_backend_is_available(sha256_backend_active()));
+}
+
+TEST_CASE("SHA-256 backends agree on block headers, midstates and lanes", "[sha256]")
+{
+    // Genesis block header; its double hash is the genesis block hash
+    uint8_t header[80];
+    hex2bin("0100000000000000000000000000000000000000000000000000000000000000000000003ba3edfd7a7b12b27ac72c3e67768f617fc81bc388"
+            "8a51323a9fb8aa4b1e5e4a29ab5f49ffff001d1dac2b7c",
+            header, sizeof(header));
+
+    uint32_t states[13][SHA256_STATE_WORDS];
+    uint32_t blocks[13][SHA256_BLOCK_WORDS];
+    uint32_t expected[13][SHA256_STATE_WORDS];
+    uint32_t seed = 0x12345678;
+    for (int lane = 0; lane < 13; lane++) {
+        for (int i = 0; i < SHA256_STATE_WORDS; i++) {
+            seed = seed * 1664525 + 1013904223;
+            states[lane][i] = expected[lane][i] = seed;
+        }
+        for (int i = 0; i < SHA256_BLOCK_WORDS; i++) {
+            seed = seed * 1664525 + 1013904223;
+            blocks[lane][i] = seed;
+        }
+        sha256_core_compress(expected[lane], blocks[lane]);
+    }
+
+    const char * active = sha256_backend_active()->name;
+    for (size_t i = 0; i < sha256_backend_count(); i++) {
+        const sha256_backend * backend = sha256_backend_at(i);
+        if (!sha256_backend_is_available(backend)) {
+            continue;
+        }
+        uint8_t digest[SHA256_DIGEST_SIZE];
+        sha256_double_with(backend, header, sizeof(header), digest);
+        assert_digest(backend, "6fe28c0ab6f1b372c1a6a246ae63f74f931e8365e15a089c68d6190000000000", digest);
+
+        TEST_ASSERT_TRUE(sha256_backend_select(backend->name));
+        uint8_t midstate[32];
+        midstate_sha256_bin(header, sizeof(header), midstate);
+        uint32_t state[SHA256_STATE_WORDS];
+        sha256_midstate(header, state);
+        uint32_t reference[SHA256_STATE_WORDS];
+        memcpy(reference, SHA256_IV, sizeof(reference));
+        uint32_t block[SHA256_BLOCK_WORDS];
+        for (int w = 0; w < SHA256_BLOCK_WORDS; w++) {
+            block[w] = sha256_load_be32(header + w * 4);
+        }
+        sha256_core_compress(reference, block);
+        TEST_ASSERT_EQUAL_HEX32_ARRAY_MESSAGE(reference, state, SHA256_STATE_WORDS, backend->name);
+        TEST_ASSERT_EQUAL_MEMORY_MESSAGE(reference, midstate, sizeof(midstate), backend->name);
+
+        // 13 lanes covers a full 8 lane batch and a remainder
+        uint32_t lanes[13][SHA256_STATE_WORDS];
+        memcpy(lanes, states, sizeof(lanes));
+        sha256_compress_lanes_with(backend, lanes, (const uint32_t (*)[SHA256_BLOCK_WORDS]) blocks, 13);
+        TEST_ASSERT_EQUAL_HEX32_ARRAY_MESSAGE(expected, lanes, 13 * SHA256_STATE_WORDS, backend->name);
+    }
+    TEST_ASSERT_TRUE(sha256_backend_select(active));
+
+    TEST_ASSERT_FALSE(sha256_backend_select("no-such-backend"));
+    TEST_ASSERT_EQUAL_STRING(active, sha256_backend_active()->name);
+}
+
+TEST_CASE("SHA-256 backend throughput", "[sha256][bench]")
+{
+    const size_t buffer_len = 64 * 1024;
+    const int buffer_rounds = 32;
+    const int header_hashes = 50000;
+    const int lane_blocks = 8 * 4096;
+
+    uint8_t * buffer = malloc(buffer_len);
+    uint32_t (*states)[SHA256_STATE_WORDS] = calloc(lane_blocks, sizeof(*states));
+    uint32_t (*blocks)[SHA256_BLOCK_WORDS] = calloc(lane_blocks, sizeof(*blocks));
+    TEST_ASSERT_NOT_NULL(buffer);
+    TEST_ASSERT_NOT_NULL(states);
+    TEST_ASSERT_NOT_NULL(blocks);
+    for (size_t i = 0; i < buffer_len; i++) {
+        buffer[i] = i * 31;
+    }
+    uint8_t header[80] = {0};
+    uint8_t digest[SHA256_DIGEST_SIZE];
+
+    for (size_t i = 0; i < sha256_backend_count(); i++) {
+        const sha256_backend * backend = sha256_backend_at(i);
+        if (!sha256_backend_is_available(backend)) {
+            printf("%-10s not available\n", backend->name);
+            continue;
+        }
+
+        int64_t start = esp_timer_get_time();
+        for (int r = 0; r < buffer_rounds; r++) {
+            sha256_hash_with(backend, buffer, buffer_len, digest);
+            buffer[0] = digest[0];
+        }
+        int64_t bulk_us = esp_timer_get_time() - start;
+
+        start = esp_timer_get_time();
+        for (int n = 0; n < header_hashes; n++) {
+            memcpy(header + 76, &n, sizeof(n));
+            sha256_double_with(backend, header, sizeof(header), digest);
+        }
+        int64_t header_us = esp_timer_get_time() - start;
+
+        start = esp_timer_get_time();
+        sha256_compress_lanes_with(backend, states, (const uint32_t (*)[SHA256_BLOCK_WORDS]) blocks, lane_blocks);
+        int64_t lanes_us = esp_timer_get_time() - start;
+
+        printf("%-10s %8.1f MB/s  %10.0f header double hashes/s  %10.0f lane blocks/s\n", backend->name,
+               (double) buffer_len * buffer_rounds / bulk_us, header_hashes * 1e6 / header_us, lane_blocks * 1e6 / lanes_us);
+    }
+
+    free(buffer);
+    free(states);
+    free(blocks);
+}
@@ -0,0 +1,143 @@
+#include "unity.h"
+#include "share_filter.h"
+#include "stratum_api.h"
+#include <stdio.h>
+
+#define MOCK_MAX_JOBS 64
+
+// Minimal pool model: hands out notifies and, like a real pool, only accepts shares for
+// jobs announced since the last clean_jobs / new block.
+typedef struct
+{
+    int block;
+    int first_valid_job;
+    int next_job;
+    char prev_block_hash[PREV_BLOCK_HASH_HEX_SIZE];
+} mock_pool;
+
+typedef struct
+{
+    int pool_job;
+    uint32_t generation;
+} mock_job;
+
+static void mock_pool_new_block(mock_pool * pool)
+{
+    pool->block++;
+    snprintf(pool->prev_block_hash, sizeof(pool->prev_block_hash), "%064x", pool->block);
+}
+
+static mock_job mock_pool_notify(mock_pool * pool, share_filter * filter, bool clean_jobs)
+{
+    if (clean_jobs) {
+        pool->first_valid_job = pool->next_job;
+    }
+    mock_job job = {.pool_job = pool->next_job++};
+    job.generation = share_filter_on_notify(filter, pool->prev_block_hash, clean_jobs);
+    return job;
+}
+
+static bool mock_pool_accepts(const mock_pool * pool, const mock_job * job)
+{
+    return job->pool_job >= pool->first_valid_job;
+}
+
+TEST_CASE("Share filter tracks notify generations", "[share_filter]")
+{
+    share_filter filter;
+    share_filter_init(&filter);
+
+    uint32_t first = share_filter_on_notify(&filter, "00000000000000000001a2b3", true);
+    TEST_ASSERT_FALSE(share_filter_is_stale(&filter, first));
+
+    // same block, no clean_jobs: older jobs stay valid
+    uint32_t update = share_filter_on_notify(&filter, "00000000000000000001a2b3", false);
+    TEST_ASSERT_EQUAL(first, update);
+    TEST_ASSERT_FALSE(share_filter_is_stale(&filter, first));
+
+    // clean_jobs on the same block invalidates them
+    uint32_t clean = share_filter_on_notify(&filter, "00000000000000000001a2b3", true);
+    TEST_ASSERT_TRUE(share_filter_is_stale(&filter, first));
+    TEST_ASSERT_FALSE(share_filter_is_stale(&filter, clean));
+
+    // a new prev hash is a new block even if the pool forgot clean_jobs
+    uint32_t next_block = share_filter_on_notify(&filter, "00000000000000000004d5e6", false);
+    TEST_ASSERT_TRUE(share_filter_is_stale(&filter, clean));
+    TEST_ASSERT_FALSE(share_filter_is_stale(&filter, next_block));
+}
+
+TEST_CASE("Share filter drops only certainly stale shares across rapid block changes", "[share_filter]")
+{
+    share_filter filter;
+    share_filter_init(&filter);
+    mock_pool pool = {0};
+    mock_job jobs[MOCK_MAX_JOBS];
+    int job_count = 0;
+    int submitted = 0, rejected = 0, suppressed = 0, would_have_been_accepted = 0;
+
+    // blocks arrive faster than the ASIC drains its work: every block gets a clean notify
+    // and a couple of updates, with shares coming back for every job issued so far
+    for (int block = 0; block < 8; block++) {
+        mock_pool_new_block(&pool);
+        jobs[job_count++] = mock_pool_notify(&pool, &filter, true);
+        jobs[job_count++] = mock_pool_notify(&pool, &filter, false);
+        if (block % 3 == 2) {
+            // the pool forgets clean_jobs on an orphan race: new prev hash, clean flag unset
+            mock_pool_new_block(&pool);
+            pool.first_valid_job = pool.next_job;
+        }
+        jobs[job_count++] = mock_pool_notify(&pool, &filter, false);
+
+        for (int i = 0; i < job_count; i++) {
+            bool accepted = mock_pool_accepts(&pool, &jobs[i]);
+            if (share_filter_is_stale(&filter, jobs[i].generation)) {
+                share_filter_record_suppressed(&filter);
+                suppressed++;
+                would_have_been_accepted += accepted;
+                continue;
+            }
+            submitted++;
+            if (!accepted) {
+                share_filter_record_reject(&filter, SHARE_REJECT_STALE);
+                rejected++;
+            }
+        }
+    }
+
+    TEST_ASSERT_EQUAL(0, rejected);
+    TEST_ASSERT_EQUAL(0, would_have_been_accepted);
+    TEST_ASSERT_GREATER_THAN(0, suppressed);
+    TEST_ASSERT_GREATER_THAN(0, submitted);
+    TEST_ASSERT_EQUAL(suppressed, filter.stale_suppressed);
+    TEST_ASSERT_EQUAL(0, filter.rejects[SHARE_REJECT_STALE]);
+}
+
+TEST_CASE("Share filter classifies pool rejects", "[share_filter]")
+{
+    TEST_ASSERT_EQUAL(SHARE_REJECT_STALE, share_filter_classify_reject(0, "Stale"));
+    TEST_ASSERT_EQUAL(SHARE_REJECT_STALE, share_filter_classify_reject(21, "Job not found (=stale)"));
+    TEST_ASSERT_EQUAL(SHARE_REJECT_STALE, share_filter_classify_reject(0, "stale-prevblk"));
+    TEST_ASSERT_EQUAL(SHARE_REJECT_JOB_NOT_FOUND, share_filter_classify_reject(21, "Job not found"));
+    TEST_ASSERT_EQUAL(SHARE_REJECT_JOB_NOT_FOUND, share_filter_classify_reject(21, NULL));
+    TEST_ASSERT_EQUAL(SHARE_REJECT_DUPLICATE, share_filter_classify_reject(22, "Duplicate share"));
+    TEST_ASSERT_EQUAL(SHARE_REJECT_DUPLICATE, share_filter_classify_reject(0, "duplicate"));
+    TEST_ASSERT_EQUAL(SHARE_REJECT_LOW_DIFFICULTY, share_filter_classify_reject(23, "Low difficulty share"));
+    TEST_ASSERT_EQUAL(SHARE_REJECT_LOW_DIFFICULTY, share_filter_classify_reject(0, "Above target 2"));
+    TEST_ASSERT_EQUAL(SHARE_REJECT_LOW_DIFFICULTY, share_filter_classify_reject(0, "high-hash"));
+    TEST_ASSERT_EQUAL(SHARE_REJECT_LOW_DIFFICULTY, share_filter_classify_reject(23, "unknown"));
+    TEST_ASSERT_EQUAL(SHARE_REJECT_OTHER, share_filter_classify_reject(24, "Unauthorized worker"));
+    TEST_ASSERT_EQUAL(SHARE_REJECT_OTHER, share_filter_classify_reject(0, NULL));
+}
+
+TEST_CASE("Share filter classifies parsed stratum errors", "[share_filter]")
+{
+    StratumApiV1Message message = {};
+    STRATUM_V1_parse(&message, "{\"id\":9,\"result\":null,\"error\":[22,\"Duplicate share\",null]}");
+    TEST_ASSERT_EQUAL(STRATUM_RESULT, message.method);
+    TEST_ASSERT_EQUAL(22, message.error_code);
+    TEST_ASSERT_EQUAL(SHARE_REJECT_DUPLICATE, share_filter_classify_reject(message.error_code, message.error_str));
+
+    STRATUM_V1_parse(&message, "{\"reject-reason\":\"Above target 2\",\"result\":false,\"error\":null,\"id\":10}");
+    TEST_ASSERT_EQUAL(0, message.error_code);
+    TEST_ASSERT_EQUAL(SHARE_REJECT_LOW_DIFFICULTY, share_filter_classify_reject(message.error_code, message.error_str));
+}
@@ -1,5 +1,7 @@
 #include "unity.h"
 #include "stratum_api.h"
+#include <stdlib.h>
+#include <string.h>
 
 TEST_CASE("Parse stratum method", "[stratum]")
 {
@@ -68,6 +70,15 @@ TEST_CASE("Parse stratum set_difficulty params", "[mining.set_difficulty]")
     TEST_ASSERT_EQUAL(1638, stratum_api_v1_message.new_difficulty);
 }
 
+TEST_CASE("Parse fractional stratum set_difficulty params", "[mining.set_difficulty]")
+{
+    const char *json_string = "{\"id\":null,\"method\":\"mining.set_difficulty\",\"params\":[1024.5]}";
+    StratumApiV1Message stratum_api_v1_message = {};
+    STRATUM_V1_parse(&stratum_api_v1_message, json_string);
+    TEST_ASSERT_EQUAL(MINING_SET_DIFFICULTY, stratum_api_v1_message.method);
+    TEST_ASSERT_EQUAL_DOUBLE(1024.5, stratum_api_v1_message.new_difficulty);
+}
+
 TEST_CASE("Parse stratum notify params", "[mining.notify]")
 {
     StratumApiV1Message stratum_api_v1_message = {};
@@ -169,6 +180,7 @@ TEST_CASE("Parse stratum result error", "[stratum]")
     TEST_ASSERT_EQUAL(STRATUM_RESULT, stratum_api_v1_message.method);
     TEST_ASSERT_FALSE(stratum_api_v1_message.response_success);
     TEST_ASSERT_EQUAL_STRING("Job not found", stratum_api_v1_message.error_str);
+    TEST_ASSERT_EQUAL(21, stratum_api_v1_message.error_code);
 }
 
 TEST_CASE("Parse stratum result alternative error", "[stratum]")
@@ -181,3 +193,51 @@ TEST_CASE("Parse stratum result alternative error", "[stratum]")
     TEST_ASSERT_FALSE(stratum_api_v1_message.response_success);
     TEST_ASSERT_EQUAL_STRING("Above target 2", stratum_api_v1_message.error_str);
 }
+
+TEST_CASE("Parse drops malformed stratum messages without aborting", "[stratum]")
+{
+    StratumApiV1Message message = {};
+    StratumRxStats before, after;
+    STRATUM_V1_get_rx_stats(&before);
+
+    STRATUM_V1_parse(&message, "{\"id\":null,\"method\":\"mining.notify\",\"params\":[\"1d2e0c4\",\"66");
+    TEST_ASSERT_EQUAL(STRATUM_UNKNOWN, message.method);
+
+    STRATUM_V1_parse(&message, "{\"id\":null,\"method\":\"mining.notify\",\"params\":[\"1d2e0c4\"]}");
+    TEST_ASSERT_EQUAL(STRATUM_UNKNOWN, message.method);
+
+    STRATUM_V1_parse(&message, "{\"id\":null,\"method\":\"mining.set_difficulty\",\"params\":[]}");
+    TEST_ASSERT_EQUAL(STRATUM_UNKNOWN, message.method);
+
+    STRATUM_V1_parse(&message, "{\"id\":null,\"method\":\"mining.set_version_mask\",\"params\":[536862720]}");
+    TEST_ASSERT_EQUAL(STRATUM_UNKNOWN, message.method);
+
+    STRATUM_V1_get_rx_stats(&after);
+    TEST_ASSERT_EQUAL(before.malformed_messages + 4, after.malformed_messages);
+}
+
+TEST_CASE("Parse drops a notify with too many merkle branches", "[stratum]")
+{
+    const char * branch = "\"2b77d9e413e8121cd7a17ff46029591051d0922bd90b2b2a38811af1cb57a2b2\"";
+    size_t branch_len = strlen(branch);
+    size_t size = 512 + (MAX_MERKLE_BRANCHES + 1) * (branch_len + 1);
+    char * json = malloc(size);
+    TEST_ASSERT_NOT_NULL(json);
+
+    strcpy(json, "{\"id\":null,\"method\":\"mining.notify\",\"params\":[\"1d2e0c4\","
+                 "\"6c264ba0d5c5ce3b7ba6d4e0b1e7d3b2e1a7d6b2000000000000000000000000\",\"01\",\"02\",[");
+    for (int i = 0; i < MAX_MERKLE_BRANCHES + 1; i++) {
+        if (i > 0) {
+            strcat(json, ",");
+        }
+        strcat(json, branch);
+    }
+    strcat(json, "],\"20000000\",\"1705ae3a\",\"647025b5\",true]}");
+
+    StratumApiV1Message message = {};
+    STRATUM_V1_parse(&message, json);
+    TEST_ASSERT_EQUAL(STRATUM_UNKNOWN, message.method);
+    TEST_ASSERT_NULL(message.mining_notification);
+
+    free(json);
+}
@@ -0,0 +1,256 @@
+#include "unity.h"
+#include "uint256.h"
+#include "mining.h"
+#include <stdio.h>
+#include <string.h>
+
+static void assert_uint256_hex(const char * expected, const uint256_t * value)
+{
+    uint8_t bytes[32];
+    char hex[65];
+    uint256_to_le_bytes(value, bytes);
+    for (int i = 0; i < 32; i++) {
+        sprintf(hex + i * 2, "%02x", bytes[31 - i]);
+    }
+    TEST_ASSERT_EQUAL_STRING(expected, hex);
+}
+
+static uint256_t from_hex(const char * hex)
+{
+    uint256_t value;
+    TEST_ASSERT_TRUE(uint256_set_hex(&value, hex));
+    return value;
+}
+
+// Bitcoin Core arith_uint256_tests.cpp, bignum_SetCompact
+TEST_CASE("Compact nBits matches Bitcoin Core", "[uint256]")
+{
+    const uint32_t zero_compacts[] = {0, 0x00123456, 0x01003456, 0x02000056, 0x03000000, 0x04000000,
+                                      0x00923456, 0x01803456, 0x02800056, 0x03800000, 0x04800000};
+    uint256_t num;
+    bool negative, overflow;
+
+    for (size_t i = 0; i < sizeof(zero_compacts) / sizeof(zero_compacts[0]); i++) {
+        uint256_set_compact(&num, zero_compacts[i], &negative, &overflow);
+        TEST_ASSERT_TRUE(uint256_is_zero(&num));
+        TEST_ASSERT_EQUAL_HEX32(0, uint256_get_compact(&num, false));
+        TEST_ASSERT_FALSE(negative);
+        TEST_ASSERT_FALSE(overflow);
+    }
+
+    uint256_set_compact(&num, 0x01123456, &negative, &overflow);
+    assert_uint256_hex("0000000000000000000000000000000000000000000000000000000000000012", &num);
+    TEST_ASSERT_EQUAL_HEX32(0x01120000, uint256_get_compact(&num, false));
+    TEST_ASSERT_FALSE(negative);
+    TEST_ASSERT_FALSE(overflow);
+
+    // never generate compacts with the 0x00800000 bit set
+    num = from_hex("80");
+    TEST_ASSERT_EQUAL_HEX32(0x02008000, uint256_get_compact(&num, false));
+
+    uint256_set_compact(&num, 0x01fedcba, &negative, &overflow);
+    assert_uint256_hex("000000000000000000000000000000000000000000000000000000000000007e", &num);
+    TEST_ASSERT_EQUAL_HEX32(0x01fe0000, uint256_get_compact(&num, true));
+    TEST_ASSERT_TRUE(negative);
+    TEST_ASSERT_FALSE(overflow);
+
+    uint256_set_compact(&num, 0x02123456, &negative, &overflow);
+    assert_uint256_hex("0000000000000000000000000000000000000000000000000000000000001234", &num);
+    TEST_ASSERT_EQUAL_HEX32(0x02123400, uint256_get_compact(&num, false));
+
+    uint256_set_compact(&num, 0x03123456, &negative, &overflow);
+    assert_uint256_hex("0000000000000000000000000000000000000000000000000000000000123456", &num);
+    TEST_ASSERT_EQUAL_HEX32(0x03123456, uint256_get_compact(&num, false));
+
+    uint256_set_compact(&num, 0x04123456, &negative, &overflow);
+    assert_uint256_hex("0000000000000000000000000000000000000000000000000000000012345600", &num);
+    TEST_ASSERT_EQUAL_HEX32(0x04123456, uint256_get_compact(&num, false));
+
+    uint256_set_compact(&num, 0x04923456, &negative, &overflow);
+    assert_uint256_hex("0000000000000000000000000000000000000000000000000000000012345600", &num);
+    TEST_ASSERT_EQUAL_HEX32(0x04923456, uint256_get_compact(&num, true));
+    TEST_ASSERT_TRUE(negative);
+    TEST_ASSERT_FALSE(overflow);
+
+    uint256_set_compact(&num, 0x05009234, &negative, &overflow);
+    assert_uint256_hex("0000000000000000000000000000000000000000000000000000000092340000", &num);
+    TEST_ASSERT_EQUAL_HEX32(0x05009234, uint256_get_compact(&num, false));
+
+    uint256_set_compact(&num, 0x20123456, &negative, &overflow);
+    assert_uint256_hex("1234560000000000000000000000000000000000000000000000000000000000", &num);
+    TEST_ASSERT_EQUAL_HEX32(0x20123456, uint256_get_compact(&num, false));
+    TEST_ASSERT_FALSE(negative);
+    TEST_ASSERT_FALSE(overflow);
+
+    uint256_set_compact(&num, 0xff123456, &negative, &overflow);
+    TEST_ASSERT_FALSE(negative);
+    TEST_ASSERT_TRUE(overflow);
+
+    // mainnet proof of work limit
+    uint256_set_compact(&num, 0x1d00ffff, &negative, &overflow);
+    assert_uint256_hex("00000000ffff0000000000000000000000000000000000000000000000000000", &num);
+    TEST_ASSERT_EQUAL_HEX32(0x1d00ffff, uint256_get_compact(&num, false));
+}
+
+TEST_CASE("uint256 shifts, division and conversion", "[uint256]")
+{
+    uint256_t r1 = from_hex("7d1de5eaf9b156d53208f033b5aa8122d2d2355d5e12292b121156cfdb4a529c");
+    uint256_t r2 = from_hex("70b8b3dd1f1b54e1ea2a4e1c8f66a3ce2e1f0d8ba8b9c6d9ea96dddfc5dd2c0a");
+    uint256_t a, b, q;
+
+    uint256_shl(&a, &r1, 100);
+    assert_uint256_hex("5aa8122d2d2355d5e12292b121156cfdb4a529c0000000000000000000000000", &a);
+    uint256_shr(&a, &r1, 100);
+    assert_uint256_hex("00000000000000000000000007d1de5eaf9b156d53208f033b5aa8122d2d2355", &a);
+    uint256_shl(&a, &r1, 256);
+    TEST_ASSERT_TRUE(uint256_is_zero(&a));
+
+    uint256_shr(&b, &r2, 128);
+    uint256_div(&q, &r1, &b);
+    assert_uint256_hex("000000000000000000000000000000011c26981520bd1b9b127e2b96c21f7dac", &q);
+
+    uint256_set_u64(&b, 0x1234567);
+    uint256_div(&q, &r1, &b);
+    assert_uint256_hex("0000006df747477f558e1c906a069db4c7fc0a0dd0e1a797689e656b541b3c6a", &q);
+
+    uint256_shr(&b, &r1, 200);
+    uint256_div(&q, &r2, &b);
+    assert_uint256_hex("00000000000000e6a35c9b3e43c8e8db56ccdb3bae83b1483bea13443b8d8013", &q);
+
+    uint256_div(&q, &r1, &r1);
+    assert_uint256_hex("0000000000000000000000000000000000000000000000000000000000000001", &q);
+    uint256_shr(&a, &r2, 10);
+    uint256_div(&q, &a, &r1);
+    TEST_ASSERT_TRUE(uint256_is_zero(&q));
+
+    TEST_ASSERT_EQUAL(-1, uint256_cmp(&r2, &r1));
+    TEST_ASSERT_EQUAL(1, uint256_cmp(&r1, &r2));
+    TEST_ASSERT_EQUAL(0, uint256_cmp(&r1, &r1));
+    TEST_ASSERT_EQUAL(1, uint256_leading_zeros(&r1));
+    uint256_set_u64(&a, 1);
+    TEST_ASSERT_EQUAL(255, uint256_leading_zeros(&a));
+
+    TEST_ASSERT_DOUBLE_WITHIN(1e62, 5.659193147262352e+76, uint256_to_double(&r1));
+    TEST_ASSERT_FALSE(uint256_set_hex(&a, "xyz"));
+}
+
+TEST_CASE("Difficulty to target is exact for pool difficulties", "[uint256]")
+{
+    uint256_t target;
+
+    uint256_from_difficulty(&target, 1);
+    assert_uint256_hex("00000000ffff0000000000000000000000000000000000000000000000000000", &target);
+    uint256_from_difficulty(&target, 2);
+    assert_uint256_hex("000000007fff8000000000000000000000000000000000000000000000000000", &target);
+    uint256_from_difficulty(&target, 3);
+    assert_uint256_hex("0000000055550000000000000000000000000000000000000000000000000000", &target);
+    uint256_from_difficulty(&target, 1638);
+    assert_uint256_hex("0000000000280258258258258258258258258258258258258258258258258258", &target);
+    uint256_from_difficulty(&target, 65536);
+    assert_uint256_hex("000000000000ffff000000000000000000000000000000000000000000000000", &target);
+    uint256_from_difficulty(&target, 1152921504606846976.0);
+    assert_uint256_hex("00000000000000000000000ffff0000000000000000000000000000000000000", &target);
+
+    // fractional difficulties used to be truncated to an integer
+    uint256_from_difficulty(&target, 0.5);
+    assert_uint256_hex("00000001fffe0000000000000000000000000000000000000000000000000000", &target);
+    uint256_from_difficulty(&target, 1024.5);
+    assert_uint256_hex("00000000003ff7c107df041f7c107df041f7c107df041f7c107df041f7c107df", &target);
+    uint256_from_difficulty(&target, 12345678.9);
+    assert_uint256_hex("000000000000015be3156dbe3f6e5fe06f8e87601e948ae2ba55f266db2a89c3", &target);
+
+    // tiny difficulties keep their precision, and saturate once the target passes 2^256
+    uint256_from_difficulty(&target, 0.001);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-15, 0.001, uint256_to_difficulty(&target));
+    uint256_from_difficulty(&target, 1e-9);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-21, 1e-9, uint256_to_difficulty(&target));
+    uint256_from_difficulty(&target, 1e-12);
+    assert_uint256_hex("ffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff", &target);
+    uint256_from_difficulty(&target, 0);
+    assert_uint256_hex("ffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff", &target);
+}
+
+TEST_CASE("Network difficulty from nBits", "[uint256]")
+{
+    uint256_t target;
+
+    uint256_set_compact(&target, 0x1d00ffff, NULL, NULL);
+    TEST_ASSERT_EQUAL_DOUBLE(1.0, uint256_to_difficulty(&target));
+    uint256_set_compact(&target, 0x1705ae3a, NULL, NULL);
+    TEST_ASSERT_DOUBLE_WITHIN(0.01, 49549703178592.68, uint256_to_difficulty(&target));
+    // Bitcoin Core blockchain_tests get_difficulty_for_very_high_target
+    uint256_set_compact(&target, 0x12345678, NULL, NULL);
+    TEST_ASSERT_DOUBLE_WITHIN(1e10, 5913134931067755359633408.0, uint256_to_difficulty(&target));
+}
+
+TEST_CASE("Leading zero check agrees with a full compare", "[uint256]")
+{
+    uint256_t value;
+    uint256_target target;
+    uint32_t seed = 0xdeadbeef;
+
+    for (int t = 0; t < 64; t++) {
+        uint256_from_difficulty(&value, 1 << (t % 24));
+        // make some targets non-round so hashes land on the boundary limb
+        value.w[(t % 7)] ^= t * 2654435761u;
+        uint256_target_init(&target, &value);
+
+        for (int i = 0; i < 500; i++) {
+            uint256_t hash = target.value;
+            for (int w = 0; w < 8; w++) {
+                seed = seed * 1664525 + 1013904223;
+                // perturb a few limbs, biased towards the target's top limb
+                if ((seed >> 28) < 5) {
+                    hash.w[w] = seed;
+                }
+            }
+            if (i % 3 == 0) {
+                uint256_shr(&hash, &hash, seed % 16);
+            }
+            TEST_ASSERT_EQUAL(uint256_cmp(&hash, &target.value) <= 0, uint256_target_met(&target, &hash));
+        }
+    }
+
+    uint256_set_u64(&value, 0);
+    uint256_target_init(&target, &value);
+    TEST_ASSERT_TRUE(uint256_target_met(&target, &value));
+}
+
+TEST_CASE("Jobs classify nonces against exact pool and network targets", "[uint256][mining]")
+{
+    mining_notify notify_message;
+    notify_message.prev_block_hash = "d02b10fc0d4711eae1a805af50a8a83312a2215e00017f2b0000000000000000";
+    notify_message.version = 0x20000004;
+    notify_message.target = 0x1705ae3a;
+    notify_message.ntime = 0x646ff1a9;
+    notify_message.generation = 0;
+    const char *merkle_root = "6d0359c451434605c52a5a9ce074340be47c2c63840731f9edf1db3f26b1cdd9";
+    const uint32_t nonce = 0x276E8947; // worth 18.04
+
+    notify_message.difficulty = 18.0;
+    bm_job job = construct_bm_job(&notify_message, merkle_root, 0);
+    nonce_result result = test_nonce_result(&job, nonce, job.version, 0);
+    TEST_ASSERT_TRUE(result.pool_share);
+    TEST_ASSERT_FALSE(result.block);
+
+    // a fractional pool difficulty is no longer truncated to 18
+    notify_message.difficulty = 18.5;
+    job = construct_bm_job(&notify_message, merkle_root, 0);
+    result = test_nonce_result(&job, nonce, job.version, 0);
+    TEST_ASSERT_EQUAL_INT(18, (int) result.difficulty);
+    TEST_ASSERT_FALSE(result.pool_share);
+
+    uint256_t expected;
+    uint256_from_difficulty(&expected, 18.5);
+    TEST_ASSERT_EQUAL(0, uint256_cmp(&expected, &job.pool_target.value));
+    uint256_set_compact(&expected, 0x1705ae3a, NULL, NULL);
+    TEST_ASSERT_EQUAL(0, uint256_cmp(&expected, &job.network_target.value));
+
+    notify_message.difficulty = 4;
+    job = construct_bm_job(&notify_message, merkle_root, 0);
+    for (uint32_t n = 0; n < 2000; n++) {
+        result = test_nonce_result(&job, n, job.version, 0);
+        TEST_ASSERT_EQUAL(result.difficulty >= 4, result.pool_share);
+        TEST_ASSERT_FALSE(result.block);
+    }
+}
@@ -0,0 +1,85 @@
+#include "unity.h"
+#include "version_rolling.h"
+#include "mining.h"
+#include "stratum_api.h"
+#include "test_jobs.h"
+
+TEST_CASE("Version rolling midstate count follows granted bits", "[version_rolling]")
+{
+    TEST_ASSERT_EQUAL(0, version_rolling_bit_count(0));
+    TEST_ASSERT_EQUAL(16, version_rolling_bit_count(0x1fffe000));
+    TEST_ASSERT_EQUAL(2, version_rolling_bit_count(0x00006000));
+    TEST_ASSERT_EQUAL(2, version_rolling_bit_count(0x10002000));
+
+    TEST_ASSERT_EQUAL_UINT8(1, version_rolling_midstate_count(0));
+    TEST_ASSERT_EQUAL_UINT8(1, version_rolling_midstate_count(0x00002000));
+    TEST_ASSERT_EQUAL_UINT8(4, version_rolling_midstate_count(0x00006000));
+    TEST_ASSERT_EQUAL_UINT8(4, version_rolling_midstate_count(0x10002000));
+    TEST_ASSERT_EQUAL_UINT8(4, version_rolling_midstate_count(0x1fffe000));
+
+    TEST_ASSERT_EQUAL_UINT8(1, construct_test_job(0).num_midstates);
+    TEST_ASSERT_EQUAL_UINT8(1, construct_test_job(0x00002000).num_midstates);
+    TEST_ASSERT_EQUAL_UINT8(4, construct_test_job(0x00006000).num_midstates);
+}
+
+TEST_CASE("Version rolling negotiation keeps only requested bits", "[version_rolling]")
+{
+    TEST_ASSERT_EQUAL_HEX32(0x1fffe000, version_rolling_negotiate(VERSION_ROLLING_REQUEST_MASK, 0xffffffff));
+    TEST_ASSERT_EQUAL_HEX32(0x00ffe000, version_rolling_negotiate(VERSION_ROLLING_REQUEST_MASK, 0x00ffe000));
+    TEST_ASSERT_EQUAL_HEX32(0x00006000, version_rolling_negotiate(VERSION_ROLLING_REQUEST_MASK, 0xe0006fff));
+    TEST_ASSERT_EQUAL_HEX32(0, version_rolling_negotiate(VERSION_ROLLING_REQUEST_MASK, 0));
+}
+
+TEST_CASE("Midstate versions stay inside sparse masks", "[version_rolling]")
+{
+    // two bits with a gap: every midstate must get its own version and never touch other bits
+    uint32_t mask = 0x10002000;
+    bm_job job = construct_test_job(mask);
+    uint32_t versions[4];
+    versions[0] = job.version;
+    for (int i = 1; i < 4; i++) {
+        versions[i] = increment_bitmask(versions[i - 1], mask);
+    }
+    for (int i = 0; i < 4; i++) {
+        TEST_ASSERT_TRUE(version_rolling_is_allowed(job.version, versions[i], mask));
+        for (int j = 0; j < i; j++) {
+            TEST_ASSERT_NOT_EQUAL(versions[j], versions[i]);
+        }
+    }
+    // and it wraps back to the job version
+    TEST_ASSERT_EQUAL_HEX32(job.version, increment_bitmask(versions[3], mask));
+
+    TEST_ASSERT_EQUAL_HEX32(0x20002004, increment_bitmask(0x20000004, 0x1fffe000));
+    TEST_ASSERT_EQUAL_HEX32(0x20000004, increment_bitmask(0x3fffe004, 0x1fffe000));
+}
+
+TEST_CASE("Mock pool changes the version mask mid-session", "[version_rolling]")
+{
+    StratumApiV1Message message = {};
+
+    // configure: pool grants the full BIP320 range
+    STRATUM_V1_parse(&message, "{\"id\":1,\"result\":{\"version-rolling\":true,\"version-rolling.mask\":\"1fffe000\"},\"error\":null}");
+    TEST_ASSERT_EQUAL(STRATUM_RESULT_VERSION_MASK, message.method);
+    uint32_t mask = version_rolling_negotiate(VERSION_ROLLING_REQUEST_MASK, message.version_mask);
+    bm_job before = construct_test_job(mask);
+    TEST_ASSERT_EQUAL_UINT8(4, before.num_midstates);
+    uint32_t rolled_high = before.version | 0x10000000;
+    TEST_ASSERT_TRUE(version_rolling_is_allowed(before.version, rolled_high, mask));
+
+    // mid-session the pool narrows the mask to a single bit
+    STRATUM_V1_parse(&message, "{\"id\":null,\"method\":\"mining.set_version_mask\",\"params\":[\"00002000\"]}");
+    TEST_ASSERT_EQUAL(MINING_SET_VERSION_MASK, message.method);
+    mask = version_rolling_negotiate(VERSION_ROLLING_REQUEST_MASK, message.version_mask);
+    TEST_ASSERT_EQUAL_HEX32(0x00002000, mask);
+    bm_job after = construct_test_job(mask);
+    TEST_ASSERT_EQUAL_UINT8(1, after.num_midstates);
+
+    // shares still coming back from work rolled on the old mask are no longer acceptable
+    TEST_ASSERT_FALSE(version_rolling_is_allowed(before.version, rolled_high, mask));
+    TEST_ASSERT_TRUE(version_rolling_is_allowed(before.version, before.version | 0x2000, mask));
+
+    // a pool that refuses version rolling turns it off
+    STRATUM_V1_parse(&message, "{\"id\":1,\"result\":{\"version-rolling\":false},\"error\":null}");
+    TEST_ASSERT_EQUAL(STRATUM_RESULT_VERSION_MASK, message.method);
+    TEST_ASSERT_EQUAL_HEX32(0, message.version_mask);
+}
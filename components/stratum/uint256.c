@@ -0,0 +1,298 @@
+#include <string.h>
+#include <math.h>
+#include "uint256.h"
+
+#define LIMBS 8
+
+void uint256_set_u64(uint256_t * r, uint64_t v)
+{
+    memset(r, 0, sizeof(*r));
+    r->w[0] = (uint32_t) v;
+    r->w[1] = (uint32_t) (v >> 32);
+}
+
+void uint256_set_max(uint256_t * r)
+{
+    memset(r, 0xff, sizeof(*r));
+}
+
+void uint256_from_le_bytes(uint256_t * r, const uint8_t bytes[32])
+{
+    for (int i = 0; i < LIMBS; i++) {
+        r->w[i] = (uint32_t) bytes[i * 4] | ((uint32_t) bytes[i * 4 + 1] << 8) | ((uint32_t) bytes[i * 4 + 2] << 16) |
+                  ((uint32_t) bytes[i * 4 + 3] << 24);
+    }
+}
+
+void uint256_to_le_bytes(const uint256_t * a, uint8_t bytes[32])
+{
+    for (int i = 0; i < LIMBS; i++) {
+        bytes[i * 4] = a->w[i];
+        bytes[i * 4 + 1] = a->w[i] >> 8;
+        bytes[i * 4 + 2] = a->w[i] >> 16;
+        bytes[i * 4 + 3] = a->w[i] >> 24;
+    }
+}
+
+static int hex_value(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+bool uint256_set_hex(uint256_t * r, const char * hex)
+{
+    memset(r, 0, sizeof(*r));
+    if (hex[0] == '0' && (hex[1] == 'x' || hex[1] == 'X')) {
+        hex += 2;
+    }
+    size_t len = strlen(hex);
+    if (len > 64) {
+        return false;
+    }
+    // Last digit is the least significant nibble
+    for (size_t i = 0; i < len; i++) {
+        int v = hex_value(hex[len - 1 - i]);
+        if (v < 0) {
+            return false;
+        }
+        r->w[i / 8] |= (uint32_t) v << ((i % 8) * 4);
+    }
+    return true;
+}
+
+bool uint256_is_zero(const uint256_t * a)
+{
+    for (int i = 0; i < LIMBS; i++) {
+        if (a->w[i] != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int uint256_cmp(const uint256_t * a, const uint256_t * b)
+{
+    for (int i = LIMBS - 1; i >= 0; i--) {
+        if (a->w[i] != b->w[i]) {
+            return a->w[i] < b->w[i] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+int uint256_leading_zeros(const uint256_t * a)
+{
+    for (int i = LIMBS - 1; i >= 0; i--) {
+        if (a->w[i] != 0) {
+            return (LIMBS - 1 - i) * 32 + __builtin_clz(a->w[i]);
+        }
+    }
+    return 256;
+}
+
+void uint256_shl(uint256_t * r, const uint256_t * a, unsigned int shift)
+{
+    uint256_t result = {0};
+    unsigned int limbs = shift / 32;
+    unsigned int bits = shift % 32;
+    for (int i = LIMBS - 1; i >= (int) limbs; i--) {
+        result.w[i] = a->w[i - limbs] << bits;
+        if (bits != 0 && i - (int) limbs - 1 >= 0) {
+            result.w[i] |= a->w[i - limbs - 1] >> (32 - bits);
+        }
+    }
+    *r = result;
+}
+
+void uint256_shr(uint256_t * r, const uint256_t * a, unsigned int shift)
+{
+    uint256_t result = {0};
+    unsigned int limbs = shift / 32;
+    unsigned int bits = shift % 32;
+    for (int i = 0; i + (int) limbs < LIMBS; i++) {
+        result.w[i] = a->w[i + limbs] >> bits;
+        if (bits != 0 && i + limbs + 1 < LIMBS) {
+            result.w[i] |= a->w[i + limbs + 1] << (32 - bits);
+        }
+    }
+    *r = result;
+}
+
+void uint256_sub(uint256_t * r, const uint256_t * a, const uint256_t * b)
+{
+    uint32_t borrow = 0;
+    for (int i = 0; i < LIMBS; i++) {
+        uint64_t diff = (uint64_t) a->w[i] - b->w[i] - borrow;
+        r->w[i] = (uint32_t) diff;
+        borrow = (diff >> 32) & 1;
+    }
+}
+
+/**
+ * Shift-subtract long division, one quotient bit per step
+ * Only used when a job or difficulty changes, never per nonce.
+ */
+void uint256_div(uint256_t * q, const uint256_t * a, const uint256_t * b)
+{
+    uint256_t num = *a;
+    uint256_t div = *b;
+    uint256_t quotient = {0};
+
+    int num_bits = 256 - uint256_leading_zeros(&num);
+    int div_bits = 256 - uint256_leading_zeros(&div);
+    if (div_bits == 0 || div_bits > num_bits) {
+        *q = quotient;
+        return;
+    }
+
+    int shift = num_bits - div_bits;
+    uint256_shl(&div, &div, shift);
+    for (; shift >= 0; shift--) {
+        if (uint256_cmp(&num, &div) >= 0) {
+            uint256_sub(&num, &num, &div);
+            quotient.w[shift / 32] |= 1u << (shift % 32);
+        }
+        uint256_shr(&div, &div, 1);
+    }
+    *q = quotient;
+}
+
+double uint256_to_double(const uint256_t * a)
+{
+    double ret = 0.0;
+    double fact = 1.0;
+    for (int i = 0; i < LIMBS; i++) {
+        ret += fact * a->w[i];
+        fact *= 4294967296.0;
+    }
+    return ret;
+}
+
+void uint256_set_compact(uint256_t * r, uint32_t compact, bool * negative, bool * overflow)
+{
+    int size = compact >> 24;
+    uint32_t word = compact & 0x007fffff;
+    if (size <= 3) {
+        word >>= 8 * (3 - size);
+        uint256_set_u64(r, word);
+    } else {
+        // shifts of 256 bits or more leave zero, and are flagged as overflow below
+        uint256_set_u64(r, word);
+        uint256_shl(r, r, 8 * (size - 3));
+    }
+    if (negative != NULL) {
+        *negative = word != 0 && (compact & 0x00800000) != 0;
+    }
+    if (overflow != NULL) {
+        *overflow = word != 0 && (size > 34 || (word > 0xff && size > 33) || (word > 0xffff && size > 32));
+    }
+}
+
+uint32_t uint256_get_compact(const uint256_t * a, bool negative)
+{
+    int size = (256 - uint256_leading_zeros(a) + 7) / 8;
+    uint32_t compact;
+    if (size <= 3) {
+        compact = a->w[0] << 8 * (3 - size);
+    } else {
+        uint256_t shifted;
+        uint256_shr(&shifted, a, 8 * (size - 3));
+        compact = shifted.w[0];
+    }
+    // The 0x00800000 bit is the sign, so a mantissa that would set it moves up a byte
+    if (compact & 0x00800000) {
+        compact >>= 8;
+        size++;
+    }
+    compact |= (uint32_t) size << 24;
+    compact |= (negative && (compact & 0x007fffff)) ? 0x00800000 : 0;
+    return compact;
+}
+
+void uint256_difficulty_one(uint256_t * r)
+{
+    uint256_set_u64(r, 0xFFFF);
+    uint256_shl(r, r, 208);
+}
+
+/**
+ * Pool difficulties are doubles in mining.set_difficulty and can be fractional, so the divisor
+ * is the exact binary value of the double: difficulty = mantissa / 2^shift with a 53-bit mantissa.
+ */
+void uint256_from_difficulty(uint256_t * target, double difficulty)
+{
+    if (!(difficulty > 0.0)) {
+        uint256_set_max(target);
+        return;
+    }
+    if (isinf(difficulty)) {
+        memset(target, 0, sizeof(*target));
+        return;
+    }
+
+    int exponent;
+    double fraction = frexp(difficulty, &exponent);
+    uint64_t mantissa = (uint64_t) ldexp(fraction, 53);
+    int shift = 53 - exponent;
+    while (shift > 0 && (mantissa & 1) == 0) {
+        mantissa >>= 1;
+        shift--;
+    }
+
+    uint256_t one, divisor;
+    uint256_difficulty_one(&one);
+    uint256_set_u64(&divisor, mantissa);
+
+    if (shift < 0) {
+        // difficulty above 2^53: the divisor grows instead, anything past 256 bits needs a zero hash
+        if (64 - __builtin_clzll(mantissa) - shift > 256) {
+            memset(target, 0, sizeof(*target));
+            return;
+        }
+        uint256_shl(&divisor, &divisor, -shift);
+        uint256_div(target, &one, &divisor);
+    } else if (shift <= 32) {
+        // The difficulty 1 target has 224 bits, so up to 32 bits of scaling fit
+        uint256_shl(&one, &one, shift);
+        uint256_div(target, &one, &divisor);
+    } else {
+        // Divide first and scale after; the quotient still has over 170 significant bits
+        uint256_div(target, &one, &divisor);
+        if (uint256_leading_zeros(target) < shift) {
+            uint256_set_max(target);
+            return;
+        }
+        uint256_shl(target, target, shift);
+    }
+}
+
+double uint256_to_difficulty(const uint256_t * value)
+{
+    uint256_t one;
+    uint256_difficulty_one(&one);
+    return uint256_to_double(&one) / uint256_to_double(value);
+}
+
+void uint256_target_init(uint256_target * target, const uint256_t * value)
+{
+    target->value = *value;
+    target->leading_zeros = uint256_leading_zeros(value);
+}
+
+bool uint256_target_met(const uint256_target * target, const uint256_t * hash)
+{
+    // Leading zeros of the hash only need its first non-zero limb
+    int limb = LIMBS - 1;
+    while (limb > 0 && hash->w[limb] == 0) {
+        limb--;
+    }
+    int hash_zeros = hash->w[limb] == 0 ? 256 : (LIMBS - 1 - limb) * 32 + __builtin_clz(hash->w[limb]);
+
+    if (hash_zeros != target->leading_zeros) {
+        return hash_zeros > target->leading_zeros;
+    }
+    return uint256_cmp(hash, &target->value) <= 0;
+}
@@ -1,9 +1,11 @@
 #include "utils.h"
 
+#include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 
-#include "mbedtls/sha256.h"
+#include "sha256_backend.h"
+#include "hex_codec.h"
 
 #ifndef bswap_16
 #define bswap_16(a) ((((uint16_t)(a) << 8) & 0xff00) | (((uint16_t)(a) >> 8) & 0xff))
@@ -61,19 +63,12 @@ void flip32bytes(void *dest_p, const void *src_p)
 
 int hex2char(uint8_t x, char *c)
 {
-    if (x <= 9)
-    {
-        *c = x + '0';
-    }
-    else if (x <= 15)
-    {
-        *c = x - 10 + 'a';
-    }
-    else
+    if (x > 15)
     {
         return -1;
     }
 
+    *c = "0123456789abcdef"[x];
     return 0;
 }
 
@@ -84,57 +79,34 @@ size_t bin2hex(const uint8_t *buf, size_t buflen, char *hex, size_t hexlen)
         return 0;
     }
 
-    for (size_t i = 0; i < buflen; i++)
-    {
-        if (hex2char(buf[i] >> 4, &hex[2 * i]) < 0)
-        {
-            return 0;
-        }
-        if (hex2char(buf[i] & 0xf, &hex[2 * i + 1]) < 0)
-        {
-            return 0;
-        }
-    }
-
-    hex[2 * buflen] = '\0';
+    hex_encode(buf, buflen, hex);
     return 2 * buflen;
 }
 
 uint8_t hex2val(char c)
 {
-    if (c >= '0' && c <= '9')
-    {
-        return c - '0';
-    }
-    else if (c >= 'a' && c <= 'f')
-    {
-        return c - 'a' + 10;
-    }
-    else if (c >= 'A' && c <= 'F')
-    {
-        return c - 'A' + 10;
-    }
-    else
-    {
-        return 0;
-    }
+    int value = hex_digit_value(c);
+    return value < 0 ? 0 : value;
 }
 
 size_t hex2bin(const char *hex, uint8_t *bin, size_t bin_len)
 {
-    size_t len = 0;
+    // Stops at the terminator or when bin is full; a trailing odd digit fills a high nibble
+    size_t digits = strnlen(hex, 2 * bin_len);
+    size_t len = digits / 2;
 
-    while (*hex && len < bin_len)
+    if (!hex_decode(hex, len, bin))
     {
-        bin[len] = hex2val(*hex++) << 4;
-
-        if (!*hex)
+        // Rare: non-hex characters decode as 0, as they always have
+        for (size_t i = 0; i < len; i++)
         {
-            len++;
-            break;
+            bin[i] = (hex2val(hex[2 * i]) << 4) | hex2val(hex[2 * i + 1]);
         }
+    }
 
-        bin[len++] |= hex2val(*hex++);
+    if (digits % 2)
+    {
+        bin[len++] = hex2val(hex[digits - 1]) << 4;
     }
 
     return len;
@@ -171,10 +143,9 @@ char *double_sha256(const char *hex_string)
     uint8_t *bin = malloc(bin_len);
     hex2bin(hex_string, bin, bin_len);
 
-    unsigned char first_hash_output[32], second_hash_output[32];
+    unsigned char second_hash_output[32];
 
-    mbedtls_sha256(bin, bin_len, first_hash_output, 0);
-    mbedtls_sha256(first_hash_output, 32, second_hash_output, 0);
+    sha256_double(bin, bin_len, second_hash_output);
 
     free(bin);
 
@@ -185,44 +156,25 @@ char *double_sha256(const char *hex_string)
 
 uint8_t *double_sha256_bin(const uint8_t *data, const size_t data_len)
 {
-    uint8_t first_hash_output[32];
     uint8_t *second_hash_output = malloc(32);
 
-    mbedtls_sha256(data, data_len, first_hash_output, 0);
-    mbedtls_sha256(first_hash_output, 32, second_hash_output, 0);
+    sha256_double(data, data_len, second_hash_output);
 
     return second_hash_output;
 }
 
 void single_sha256_bin(const uint8_t *data, const size_t data_len, uint8_t *dest)
 {
-    // mbedtls_sha256(data, data_len, dest, 0);
-
-    // Initialize SHA256 context
-    mbedtls_sha256_context sha256_ctx;
-    mbedtls_sha256_init(&sha256_ctx);
-    mbedtls_sha256_starts(&sha256_ctx, 0);
-
-    // Compute first SHA256 hash of header
-    mbedtls_sha256_update(&sha256_ctx, data, 64);
-    unsigned char hash[32];
-    mbedtls_sha256_finish(&sha256_ctx, hash);
-
-    // Compute midstate from hash
-    memcpy(dest, hash, 32);
+    sha256_hash(data, data_len, dest);
 }
 
 void midstate_sha256_bin(const uint8_t *data, const size_t data_len, uint8_t *dest)
 {
-    mbedtls_sha256_context midstate;
-
-    // Calculate midstate
-    mbedtls_sha256_init(&midstate);
-    mbedtls_sha256_starts(&midstate, 0);
-    mbedtls_sha256_update(&midstate, data, 64);
+    uint32_t state[SHA256_STATE_WORDS];
 
-    // memcpy(dest, midstate.state, 32);
-     flip32bytes(dest, midstate.state);
+    // Calculate midstate of the first 64 bytes, state words in little-endian as the ASICs take them
+    sha256_midstate(data, state);
+    memcpy(dest, state, 32);
 }
 
 void swap_endian_words(const char *hex_words, uint8_t *output)
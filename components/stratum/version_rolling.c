@@ -0,0 +1,42 @@
+#include "version_rolling.h"
+
+int version_rolling_bit_count(uint32_t mask)
+{
+    int count = 0;
+    for (; mask != 0; mask &= mask - 1) {
+        count++;
+    }
+    return count;
+}
+
+/**
+ * Effective mask once the pool has answered mining.configure or sent mining.set_version_mask
+ * A pool may only grant bits we asked for; anything else it sends is ignored rather than
+ * rolled, since those bits would not reach the chip and shares built on them would be rejected.
+ *
+ * @param requested_mask - Mask sent in mining.configure
+ * @param pool_mask - Mask from the pool, 0 when version rolling was refused
+ */
+uint32_t version_rolling_negotiate(uint32_t requested_mask, uint32_t pool_mask)
+{
+    return requested_mask & pool_mask;
+}
+
+/**
+ * Number of BM1397 midstates a job can carry under mask
+ * The chip takes either one or four midstates; four needs four distinct versions, so
+ * anything under two bits falls back to a single midstate instead of repeating work.
+ */
+uint8_t version_rolling_midstate_count(uint32_t mask)
+{
+    return version_rolling_bit_count(mask) >= 2 ? VERSION_ROLLING_MAX_MIDSTATES : 1;
+}
+
+/**
+ * A rolled version is only acceptable to the pool if it differs from the job version
+ * inside the negotiated mask
+ */
+bool version_rolling_is_allowed(uint32_t version, uint32_t rolled_version, uint32_t mask)
+{
+    return ((version ^ rolled_version) & ~mask) == 0;
+}
@@ -3,14 +3,19 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include "asic_register_task.h"
 #include "asic_task.h"
 #include "bm1370.h"
 #include "bm1368.h"
 #include "bm1366.h"
 #include "bm1397.h"
+#include "autotune.h"
 #include "common.h"
+#include "core_stats.h"
+#include "pool_health.h"
 #include "power_management_task.h"
 #include "serial.h"
+#include "share_filter.h"
 #include "stratum_api.h"
 #include "work_queue.h"
 
@@ -46,6 +51,10 @@ typedef struct
     void (*set_difficulty_mask_fn)(int);
     void (*send_work_fn)(void * GLOBAL_STATE, bm_job * next_bm_job);
     void (*set_version_mask)(uint32_t);
+    bool (*set_frequency_fn)(float);
+    bool (*set_chip_frequency_fn)(uint8_t, float, float); // NULL where the chips share one PLL setting
+    void (*read_register_fn)(int, uint8_t);
+    void (*job_interval_fn)(job_interval *, float, uint16_t, uint32_t);
 } AsicFunctions;
 
 typedef struct
@@ -80,6 +89,38 @@ typedef struct
     bool is_screen_active;
 } SystemModule;
 
+typedef struct
+{
+    uint32_t notifies_dropped;   // skipped while free heap was below CONFIG_STRATUM_LOW_HEAP_BYTES
+    uint32_t min_free_heap;      // lowest free heap seen by the stratum task
+    uint32_t stack_high_water;   // least free stack the stratum task has had, in bytes
+} StratumRxModule;
+
+typedef struct
+{
+    uint32_t extranonce2_jobs;   // jobs with a fresh coinbase and merkle root
+    uint32_t ntime_jobs;         // jobs derived from one of those by rolling ntime
+    uint64_t extranonce2_us;     // time spent building extranonce2 jobs
+    uint64_t ntime_us;           // time spent deriving ntime jobs
+    uint32_t precomputed_jobs;   // extranonce2 jobs whose merkle root came from the window
+    uint32_t window_bytes;       // memory held by the merkle window
+    uint32_t notify_to_job_us;   // time from the last notify arriving to its first job queued
+    uint32_t notify_to_job_max_us;
+    uint32_t extranonce2_exhausted; // notifies that ran out of extranonce2 values before the next one
+} JobSourceModule;
+
+typedef struct
+{
+    uint32_t batches;            // test_nonce_batch calls from the result task
+    uint32_t nonces;             // nonces verified in those batches
+    uint32_t max_batch;          // most nonces drained from the UART at once
+    uint32_t last_batch_us;      // time the last batch took to verify
+    uint64_t verify_us;          // time spent verifying all batches
+    uint32_t last_latency_us;    // UART arrival to verified, for the last result
+    uint32_t max_latency_us;
+    uint64_t latency_us;         // summed over all results
+} NonceVerifyModule;
+
 typedef struct
 {
     bool active;
@@ -109,6 +150,12 @@ typedef struct
     AsicTaskModule ASIC_TASK_MODULE;
     PowerManagementModule POWER_MANAGEMENT_MODULE;
     SelfTestModule SELF_TEST_MODULE;
+    StratumRxModule STRATUM_RX_MODULE;
+    JobSourceModule JOB_SOURCE_MODULE;
+    NonceVerifyModule NONCE_VERIFY_MODULE;
+    AsicRegisterModule ASIC_REGISTER_MODULE;
+    core_stats core_stats;
+    autotune autotune;
 
     char * extranonce_str;
     int extranonce_2_len;
@@ -117,11 +164,16 @@ typedef struct
     uint8_t * valid_jobs;
     pthread_mutex_t valid_jobs_lock;
 
-    uint32_t stratum_difficulty;
+    double stratum_difficulty;
     uint32_t version_mask;
     bool new_stratum_version_rolling_msg;
 
+    pool_health_monitor pool_health;
+    pthread_mutex_t pool_health_lock;
+    share_filter share_filter;
+
     int sock;
+    int send_uid;
     bool ASIC_initalized;
 } GlobalState;
 
@@ -2,6 +2,7 @@ import { HttpClient, HttpEvent } from '@angular/common/http';
 import { Injectable } from '@angular/core';
 import { delay, Observable, of } from 'rxjs';
 import { eASICModel } from 'src/models/enum/eASICModel';
+import { ICoreStats } from 'src/models/ICoreStats';
 import { ISystemInfo } from 'src/models/ISystemInfo';
 
 import { environment } from '../../environments/environment';
@@ -116,6 +117,11 @@ export class SystemService {
   }
 
 
+  // Per-core counters changed after `since`; pass the returned sequence next time for a delta
+  public getCoreStats(since: number = 0, uri: string = ''): Observable<ICoreStats> {
+    return this.httpClient.get(`${uri}/api/system/cores?since=${since}`) as Observable<ICoreStats>;
+  }
+
   public getSwarmInfo(uri: string = ''): Observable<{ ip: string }[]> {
     return this.httpClient.get(`${uri}/api/swarm/info`) as Observable<{ ip: string }[]>;
   }
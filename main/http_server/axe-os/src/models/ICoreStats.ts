@@ -0,0 +1,19 @@
+// One row per small core changed since the sequence asked for: [slot, valid, invalid, bestDiff, lastSeen, flags].
+// slot = core * smallCores + small core, lastSeen is uptime in seconds, 0 for never.
+export type CoreStatsSlot = [number, number, number, number, number, number];
+
+export enum eCoreFlag {
+    Silent = 0x01,
+    Errors = 0x02
+}
+
+export interface ICoreStats {
+    sequence: number,
+    uptimeSeconds: number,
+    cores: number,
+    smallCores: number,
+    results: number,
+    unknown: number,
+    flagged: number,
+    slots: CoreStatsSlot[]
+}
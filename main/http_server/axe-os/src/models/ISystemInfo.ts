@@ -1,5 +1,142 @@
 import { eASICModel } from './enum/eASICModel';
 
+export interface IPoolHealthScore {
+    score: number,
+    connectScore: number,
+    freshnessScore: number,
+    rejectScore: number,
+    staleScore: number,
+    rttScore: number,
+    submitRttMs: number,
+    connectAttempts: number,
+    connectFailures: number,
+    sharesAccepted: number,
+    sharesRejected: number,
+    sharesStale: number,
+    connected: boolean
+}
+
+export interface IPoolHealth {
+    active: 'primary' | 'fallback',
+    switchCount: number,
+    lastSwitchReason: string,
+    activeForSeconds: number,
+    primary: IPoolHealthScore,
+    fallback: IPoolHealthScore,
+    failScore: number,
+    returnScore: number,
+    minDwellSeconds: number
+}
+
+export interface IStratumRx {
+    maxLineLength: number,
+    bufferHighWater: number,
+    linesReceived: number,
+    linesDropped: number,
+    malformedMessages: number,
+    notifiesDropped: number,
+    minFreeHeap: number,
+    stackHighWater: number
+}
+
+export interface IJobSource {
+    ntimeRolls: number,
+    extranonce2Jobs: number,
+    ntimeJobs: number,
+    extranonce2UsPerJob: number,
+    ntimeUsPerJob: number,
+    merkleWindow: number,
+    merkleWindowBytes: number,
+    precomputedJobs: number,
+    notifyToJobUs: number,
+    notifyToJobMaxUs: number,
+    extranonce2Exhausted: number
+}
+
+export interface INonceVerify {
+    batches: number,
+    nonces: number,
+    maxBatch: number,
+    lastBatchUs: number,
+    usPerNonce: number,
+    lastLatencyUs: number,
+    maxLatencyUs: number,
+    avgLatencyUs: number,
+    duplicates: number,
+    duplicateSetEvictions: number
+}
+
+export interface IUartFrames {
+    jobFrames: number,
+    registerFrames: number,
+    crcErrors: number,
+    resyncs: number,
+    droppedBytes: number,
+    fifoOverflows: number,
+    bufferFull: number,
+    queueDrops: number,
+    queueMax: number
+}
+
+export interface IAsicJobs {
+    intervalMs: number,
+    fullSpaceMs: number,
+    jobs: number,
+    lastCoverage: number,
+    avgCoverage: number,
+    maxCoverage: number,
+    overruns: number,
+    queuedJobs: number,
+    templateAgeMs: number,
+    avgTemplateAgeMs: number,
+    maxTemplateAgeMs: number,
+    notifyToChipMs: number,
+    notifyToChipMaxMs: number,
+    nonceSchedule?: {
+        notify: INonceSchedule,
+        lastNotify: INonceSchedule,
+        total: INonceSchedule
+    }
+}
+
+export interface INonceSchedule {
+    headers: number,
+    dispatches: number,
+    repeats: number,
+    overlaps: number,
+    coverage: number
+}
+
+export interface IAutotuneChip {
+    frequency: number,
+    state: 'climbing' | 'confirming' | 'stable',
+    errorRate: number,
+    healthyWindows: number,
+    failedWindows: number
+}
+
+export interface IAutotune {
+    enabled: number,
+    chips: IAutotuneChip[]
+}
+
+export interface IAsicRegisterChip {
+    hashRate: number,
+    errorFlag: number,
+    nonceErrors: number,
+    nonceOverflows: number,
+    ageMs: number
+}
+
+export interface IAsicRegisters {
+    polls: number,
+    reads: number,
+    replies: number,
+    timeouts: number,
+    unmatched: number,
+    chips: IAsicRegisterChip[]
+}
+
 export interface ISystemInfo {
 
     flipscreen: number;
@@ -13,6 +150,13 @@ export interface ISystemInfo {
     bestDiff: string,
     bestSessionDiff: string,
     freeHeap: number,
+    stratumRx?: IStratumRx,
+    jobSource?: IJobSource,
+    nonceVerify?: INonceVerify,
+    uartFrames?: IUartFrames,
+    asicJobs?: IAsicJobs,
+    autotune?: IAutotune,
+    asicRegisters?: IAsicRegisters,
     coreVoltage: number,
     hostname: string,
     macAddr: string,
@@ -20,6 +164,14 @@ export interface ISystemInfo {
     wifiStatus: string,
     sharesAccepted: number,
     sharesRejected: number,
+    sharesRejectedReasons?: {
+        stale: number,
+        lowDifficulty: number,
+        duplicate: number,
+        jobNotFound: number,
+        other: number
+    },
+    staleSharesSuppressed?: number,
     uptimeSeconds: number,
     asicCount: number,
     smallCoreCount: number,
@@ -29,6 +181,7 @@ export interface ISystemInfo {
     fallbackStratumURL: string,
     fallbackStratumPort: number,
     isUsingFallbackStratum: boolean,
+    poolHealth?: IPoolHealth,
     stratumUser: string,
     fallbackStratumUser: string,
     frequency: number,
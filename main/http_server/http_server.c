@@ -15,6 +15,7 @@
 #include "freertos/task.h"
 #include "global_state.h"
 #include "nvs_config.h"
+#include "serial.h"
 #include "vcore.h"
 #include <fcntl.h>
 #include <string.h>
@@ -395,6 +396,18 @@ static esp_err_t PATCH_update_settings(httpd_req_t * req)
     if ((item = cJSON_GetObjectItem(root, "fallbackStratumPort")) != NULL) {
         nvs_config_set_u16(NVS_CONFIG_FALLBACK_STRATUM_PORT, item->valueint);
     }
+    if ((item = cJSON_GetObjectItem(root, "poolFailScore")) != NULL) {
+        nvs_config_set_u16(NVS_CONFIG_POOL_FAIL_SCORE, item->valueint);
+    }
+    if ((item = cJSON_GetObjectItem(root, "poolReturnScore")) != NULL) {
+        nvs_config_set_u16(NVS_CONFIG_POOL_RETURN_SCORE, item->valueint);
+    }
+    if ((item = cJSON_GetObjectItem(root, "poolMinDwellSeconds")) != NULL) {
+        nvs_config_set_u16(NVS_CONFIG_POOL_MIN_DWELL, item->valueint);
+    }
+    if ((item = cJSON_GetObjectItem(root, "poolNotifyIntervalSeconds")) != NULL && item->valueint > 0) {
+        nvs_config_set_u16(NVS_CONFIG_POOL_NOTIFY_INTERVAL, item->valueint);
+    }
     if ((item = cJSON_GetObjectItem(root, "ssid")) != NULL) {
         nvs_config_set_string(NVS_CONFIG_WIFI_SSID, item->valuestring);
     }
@@ -410,6 +423,9 @@ static esp_err_t PATCH_update_settings(httpd_req_t * req)
     if ((item = cJSON_GetObjectItem(root, "frequency")) != NULL && item->valueint > 0) {
         nvs_config_set_u16(NVS_CONFIG_ASIC_FREQ, item->valueint);
     }
+    if ((item = cJSON_GetObjectItem(root, "autotune")) != NULL) {
+        nvs_config_set_u16(NVS_CONFIG_AUTOTUNE, item->valueint);
+    }
     if ((item = cJSON_GetObjectItem(root, "flipscreen")) != NULL) {
         nvs_config_set_u16(NVS_CONFIG_FLIP_SCREEN, item->valueint);
     }
@@ -462,6 +478,205 @@ static esp_err_t POST_restart(httpd_req_t * req)
     return ESP_OK;
 }
 
+static cJSON * pool_health_to_json(const pool_health * pool)
+{
+    cJSON * item = cJSON_CreateObject();
+    cJSON_AddNumberToObject(item, "score", pool->score);
+    cJSON_AddNumberToObject(item, "connectScore", pool->connect_score);
+    cJSON_AddNumberToObject(item, "freshnessScore", pool->freshness_score);
+    cJSON_AddNumberToObject(item, "rejectScore", pool->reject_score);
+    cJSON_AddNumberToObject(item, "staleScore", pool->stale_score);
+    cJSON_AddNumberToObject(item, "rttScore", pool->rtt_score);
+    cJSON_AddNumberToObject(item, "submitRttMs", pool->submit_rtt_ms);
+    cJSON_AddNumberToObject(item, "connectAttempts", pool->connect_attempts);
+    cJSON_AddNumberToObject(item, "connectFailures", pool->connect_failures);
+    cJSON_AddNumberToObject(item, "sharesAccepted", pool->shares_accepted);
+    cJSON_AddNumberToObject(item, "sharesRejected", pool->shares_rejected);
+    cJSON_AddNumberToObject(item, "sharesStale", pool->shares_stale);
+    cJSON_AddBoolToObject(item, "connected", pool->connected);
+    return item;
+}
+
+static cJSON * pool_health_monitor_to_json(GlobalState * GLOBAL_STATE)
+{
+    cJSON * health = cJSON_CreateObject();
+
+    pthread_mutex_lock(&GLOBAL_STATE->pool_health_lock);
+    const pool_health_monitor * monitor = &GLOBAL_STATE->pool_health;
+    cJSON_AddStringToObject(health, "active", monitor->active == POOL_HEALTH_FALLBACK ? "fallback" : "primary");
+    cJSON_AddNumberToObject(health, "switchCount", monitor->switch_count);
+    cJSON_AddStringToObject(health, "lastSwitchReason", pool_health_switch_reason_str(monitor->last_switch_reason));
+    cJSON_AddNumberToObject(health, "activeForSeconds", (esp_timer_get_time() - monitor->active_since_us) / 1000000);
+    cJSON_AddItemToObject(health, "primary", pool_health_to_json(&monitor->pools[POOL_HEALTH_PRIMARY]));
+    cJSON_AddItemToObject(health, "fallback", pool_health_to_json(&monitor->pools[POOL_HEALTH_FALLBACK]));
+    cJSON_AddNumberToObject(health, "failScore", monitor->policy.fail_score);
+    cJSON_AddNumberToObject(health, "returnScore", monitor->policy.return_score);
+    cJSON_AddNumberToObject(health, "minDwellSeconds", monitor->policy.min_dwell_ms / 1000);
+    pthread_mutex_unlock(&GLOBAL_STATE->pool_health_lock);
+
+    return health;
+}
+
+static cJSON * stratum_rx_to_json(GlobalState * GLOBAL_STATE)
+{
+    StratumRxStats stats;
+    STRATUM_V1_get_rx_stats(&stats);
+
+    cJSON * rx = cJSON_CreateObject();
+    cJSON_AddNumberToObject(rx, "maxLineLength", stats.max_line_length);
+    cJSON_AddNumberToObject(rx, "bufferHighWater", stats.buffer_high_water);
+    cJSON_AddNumberToObject(rx, "linesReceived", stats.lines_received);
+    cJSON_AddNumberToObject(rx, "linesDropped", stats.lines_dropped);
+    cJSON_AddNumberToObject(rx, "malformedMessages", stats.malformed_messages);
+    cJSON_AddNumberToObject(rx, "notifiesDropped", GLOBAL_STATE->STRATUM_RX_MODULE.notifies_dropped);
+    cJSON_AddNumberToObject(rx, "minFreeHeap", GLOBAL_STATE->STRATUM_RX_MODULE.min_free_heap);
+    cJSON_AddNumberToObject(rx, "stackHighWater", GLOBAL_STATE->STRATUM_RX_MODULE.stack_high_water);
+    return rx;
+}
+
+static cJSON * job_source_to_json(GlobalState * GLOBAL_STATE)
+{
+    JobSourceModule * jobs = &GLOBAL_STATE->JOB_SOURCE_MODULE;
+
+    cJSON * source = cJSON_CreateObject();
+    cJSON_AddNumberToObject(source, "ntimeRolls", CONFIG_STRATUM_NTIME_ROLLS);
+    cJSON_AddNumberToObject(source, "extranonce2Jobs", jobs->extranonce2_jobs);
+    cJSON_AddNumberToObject(source, "ntimeJobs", jobs->ntime_jobs);
+    cJSON_AddNumberToObject(source, "extranonce2UsPerJob",
+                            jobs->extranonce2_jobs ? (double) jobs->extranonce2_us / jobs->extranonce2_jobs : 0);
+    cJSON_AddNumberToObject(source, "ntimeUsPerJob", jobs->ntime_jobs ? (double) jobs->ntime_us / jobs->ntime_jobs : 0);
+    cJSON_AddNumberToObject(source, "merkleWindow", CONFIG_STRATUM_MERKLE_WINDOW);
+    cJSON_AddNumberToObject(source, "merkleWindowBytes", jobs->window_bytes);
+    cJSON_AddNumberToObject(source, "precomputedJobs", jobs->precomputed_jobs);
+    cJSON_AddNumberToObject(source, "notifyToJobUs", jobs->notify_to_job_us);
+    cJSON_AddNumberToObject(source, "notifyToJobMaxUs", jobs->notify_to_job_max_us);
+    cJSON_AddNumberToObject(source, "extranonce2Exhausted", jobs->extranonce2_exhausted);
+    return source;
+}
+
+static cJSON * nonce_verify_to_json(GlobalState * GLOBAL_STATE)
+{
+    NonceVerifyModule * verify = &GLOBAL_STATE->NONCE_VERIFY_MODULE;
+
+    cJSON * json = cJSON_CreateObject();
+    cJSON_AddNumberToObject(json, "batches", verify->batches);
+    cJSON_AddNumberToObject(json, "nonces", verify->nonces);
+    cJSON_AddNumberToObject(json, "maxBatch", verify->max_batch);
+    cJSON_AddNumberToObject(json, "lastBatchUs", verify->last_batch_us);
+    cJSON_AddNumberToObject(json, "usPerNonce", verify->nonces ? (double) verify->verify_us / verify->nonces : 0);
+    cJSON_AddNumberToObject(json, "lastLatencyUs", verify->last_latency_us);
+    cJSON_AddNumberToObject(json, "maxLatencyUs", verify->max_latency_us);
+    cJSON_AddNumberToObject(json, "avgLatencyUs", verify->nonces ? (double) verify->latency_us / verify->nonces : 0);
+
+    const result_set * seen = &GLOBAL_STATE->ASIC_TASK_MODULE.result_set;
+    cJSON_AddNumberToObject(json, "duplicates", seen->duplicates);
+    cJSON_AddNumberToObject(json, "duplicateSetEvictions", seen->evictions);
+    return json;
+}
+
+static cJSON * uart_frames_to_json(void)
+{
+    asic_frame_stats stats = SERIAL_frame_stats();
+    serial_rx_stats rx = SERIAL_rx_stats();
+
+    cJSON * json = cJSON_CreateObject();
+    cJSON_AddNumberToObject(json, "jobFrames", stats.job_frames);
+    cJSON_AddNumberToObject(json, "registerFrames", stats.register_frames);
+    cJSON_AddNumberToObject(json, "crcErrors", stats.crc_errors);
+    cJSON_AddNumberToObject(json, "resyncs", stats.resyncs);
+    cJSON_AddNumberToObject(json, "droppedBytes", stats.dropped_bytes);
+    cJSON_AddNumberToObject(json, "fifoOverflows", rx.fifo_overflows);
+    cJSON_AddNumberToObject(json, "bufferFull", rx.buffer_full);
+    cJSON_AddNumberToObject(json, "queueDrops", rx.queue_drops);
+    cJSON_AddNumberToObject(json, "queueMax", rx.queue_max);
+    return json;
+}
+
+static cJSON * nonce_schedule_stats_to_json(const nonce_schedule_stats * stats)
+{
+    cJSON * json = cJSON_CreateObject();
+    cJSON_AddNumberToObject(json, "headers", stats->headers);
+    cJSON_AddNumberToObject(json, "dispatches", stats->dispatches);
+    cJSON_AddNumberToObject(json, "repeats", stats->repeats);
+    cJSON_AddNumberToObject(json, "overlaps", stats->overlaps);
+    // share of the nonce space of the headers dispatched that was handed out
+    cJSON_AddNumberToObject(json, "coverage",
+                            stats->headers ? (double) stats->assigned / ((double) stats->headers * NONCE_SCHEDULE_SUBRANGES) : 0);
+    return json;
+}
+
+static cJSON * asic_jobs_to_json(GlobalState * GLOBAL_STATE)
+{
+    const job_interval * interval = &GLOBAL_STATE->ASIC_TASK_MODULE.job_interval;
+    const job_coverage * coverage = &GLOBAL_STATE->ASIC_TASK_MODULE.job_coverage;
+
+    cJSON * json = cJSON_CreateObject();
+    cJSON_AddNumberToObject(json, "intervalMs", interval->interval_ms);
+    cJSON_AddNumberToObject(json, "fullSpaceMs", interval->full_ms);
+    cJSON_AddNumberToObject(json, "jobs", coverage->jobs);
+    cJSON_AddNumberToObject(json, "lastCoverage", coverage->last_coverage);
+    cJSON_AddNumberToObject(json, "avgCoverage", coverage->jobs ? coverage->coverage_sum / coverage->jobs : 0);
+    cJSON_AddNumberToObject(json, "maxCoverage", coverage->max_coverage);
+    cJSON_AddNumberToObject(json, "overruns", coverage->overruns);
+    cJSON_AddNumberToObject(json, "queuedJobs", GLOBAL_STATE->ASIC_jobs_queue.count);
+    cJSON_AddNumberToObject(json, "templateAgeMs", coverage->last_template_age_ms);
+    cJSON_AddNumberToObject(json, "avgTemplateAgeMs", coverage->templates ? coverage->template_age_sum / coverage->templates : 0);
+    cJSON_AddNumberToObject(json, "maxTemplateAgeMs", coverage->max_template_age_ms);
+    cJSON_AddNumberToObject(json, "notifyToChipMs", coverage->notify_to_chip_ms);
+    cJSON_AddNumberToObject(json, "notifyToChipMaxMs", coverage->notify_to_chip_max_ms);
+
+    const nonce_schedule * schedule = &GLOBAL_STATE->ASIC_TASK_MODULE.nonce_schedule;
+    cJSON * nonces = cJSON_AddObjectToObject(json, "nonceSchedule");
+    cJSON_AddItemToObject(nonces, "notify", nonce_schedule_stats_to_json(&schedule->notify));
+    cJSON_AddItemToObject(nonces, "lastNotify", nonce_schedule_stats_to_json(&schedule->last_notify));
+    cJSON_AddItemToObject(nonces, "total", nonce_schedule_stats_to_json(&schedule->total));
+    return json;
+}
+
+static cJSON * asic_registers_to_json(GlobalState * GLOBAL_STATE)
+{
+    const AsicRegisterModule * module = &GLOBAL_STATE->ASIC_REGISTER_MODULE;
+    uint32_t now_ms = esp_timer_get_time() / 1000;
+
+    cJSON * json = cJSON_CreateObject();
+    cJSON_AddNumberToObject(json, "polls", module->polls);
+    cJSON_AddNumberToObject(json, "reads", module->reads.reads);
+    cJSON_AddNumberToObject(json, "replies", module->reads.replies);
+    cJSON_AddNumberToObject(json, "timeouts", module->reads.timeouts);
+    cJSON_AddNumberToObject(json, "unmatched", module->reads.unmatched);
+    cJSON * chips = cJSON_AddArrayToObject(json, "chips");
+    for (int i = 0; i < GLOBAL_STATE->asic_count && i < ASIC_REGISTER_MAX_CHIPS; i++) {
+        cJSON * chip = cJSON_CreateObject();
+        cJSON_AddNumberToObject(chip, "hashRate", module->hash_rate[i]);
+        cJSON_AddNumberToObject(chip, "errorFlag", module->error_flag[i]);
+        cJSON_AddNumberToObject(chip, "nonceErrors", module->nonce_errors[i]);
+        cJSON_AddNumberToObject(chip, "nonceOverflows", module->nonce_overflows[i]);
+        cJSON_AddNumberToObject(chip, "ageMs", module->updated_ms[i] ? now_ms - module->updated_ms[i] : -1);
+        cJSON_AddItemToArray(chips, chip);
+    }
+    return json;
+}
+
+static cJSON * autotune_to_json(GlobalState * GLOBAL_STATE)
+{
+    const autotune * tuner = &GLOBAL_STATE->autotune;
+
+    cJSON * json = cJSON_CreateObject();
+    cJSON_AddNumberToObject(json, "enabled", nvs_config_get_u16(NVS_CONFIG_AUTOTUNE, AUTOTUNE_DEFAULT));
+    cJSON * chips = cJSON_AddArrayToObject(json, "chips");
+    for (int i = 0; i < tuner->chip_count; i++) {
+        const autotune_chip * chip = &tuner->chips[i];
+        cJSON * item = cJSON_CreateObject();
+        cJSON_AddNumberToObject(item, "frequency", chip->frequency);
+        cJSON_AddStringToObject(item, "state", autotune_state_str(chip->state));
+        cJSON_AddNumberToObject(item, "errorRate", chip->last_error_rate);
+        cJSON_AddNumberToObject(item, "healthyWindows", chip->healthy_windows);
+        cJSON_AddNumberToObject(item, "failedWindows", chip->failed_windows);
+        cJSON_AddItemToArray(chips, item);
+    }
+    return json;
+}
+
 /* Simple handler for getting system handler */
 static esp_err_t GET_system_info(httpd_req_t * req)
 {
@@ -503,8 +718,16 @@ static esp_err_t GET_system_info(httpd_req_t * req)
     cJSON_AddNumberToObject(root, "stratumDiff", GLOBAL_STATE->stratum_difficulty);
 
     cJSON_AddNumberToObject(root, "isUsingFallbackStratum", GLOBAL_STATE->SYSTEM_MODULE.is_using_fallback);
+    cJSON_AddItemToObject(root, "poolHealth", pool_health_monitor_to_json(GLOBAL_STATE));
 
     cJSON_AddNumberToObject(root, "freeHeap", esp_get_free_heap_size());
+    cJSON_AddItemToObject(root, "stratumRx", stratum_rx_to_json(GLOBAL_STATE));
+    cJSON_AddItemToObject(root, "jobSource", job_source_to_json(GLOBAL_STATE));
+    cJSON_AddItemToObject(root, "nonceVerify", nonce_verify_to_json(GLOBAL_STATE));
+    cJSON_AddItemToObject(root, "uartFrames", uart_frames_to_json());
+    cJSON_AddItemToObject(root, "asicJobs", asic_jobs_to_json(GLOBAL_STATE));
+    cJSON_AddItemToObject(root, "autotune", autotune_to_json(GLOBAL_STATE));
+    cJSON_AddItemToObject(root, "asicRegisters", asic_registers_to_json(GLOBAL_STATE));
     cJSON_AddNumberToObject(root, "coreVoltage", nvs_config_get_u16(NVS_CONFIG_ASIC_VOLTAGE, CONFIG_ASIC_VOLTAGE));
     cJSON_AddNumberToObject(root, "coreVoltageActual", VCORE_get_voltage_mv(GLOBAL_STATE));
     cJSON_AddNumberToObject(root, "frequency", nvs_config_get_u16(NVS_CONFIG_ASIC_FREQ, CONFIG_ASIC_FREQUENCY));
@@ -514,6 +737,12 @@ static esp_err_t GET_system_info(httpd_req_t * req)
     cJSON_AddStringToObject(root, "wifiStatus", GLOBAL_STATE->SYSTEM_MODULE.wifi_status);
     cJSON_AddNumberToObject(root, "sharesAccepted", GLOBAL_STATE->SYSTEM_MODULE.shares_accepted);
     cJSON_AddNumberToObject(root, "sharesRejected", GLOBAL_STATE->SYSTEM_MODULE.shares_rejected);
+    cJSON * reject_reasons = cJSON_CreateObject();
+    for (int i = 0; i < SHARE_REJECT_REASON_COUNT; i++) {
+        cJSON_AddNumberToObject(reject_reasons, share_filter_reject_reason_str(i), GLOBAL_STATE->share_filter.rejects[i]);
+    }
+    cJSON_AddItemToObject(root, "sharesRejectedReasons", reject_reasons);
+    cJSON_AddNumberToObject(root, "staleSharesSuppressed", GLOBAL_STATE->share_filter.stale_suppressed);
     cJSON_AddNumberToObject(root, "uptimeSeconds", (esp_timer_get_time() - GLOBAL_STATE->SYSTEM_MODULE.start_time) / 1000000);
     cJSON_AddNumberToObject(root, "asicCount", GLOBAL_STATE->asic_count);
     uint16_t small_core_count = 0;
@@ -574,6 +803,87 @@ static esp_err_t GET_system_info(httpd_req_t * req)
     return ESP_OK;
 }
 
+// Room kept in the scratch buffer for one more JSON row of /api/system/cores
+#define CORE_STATS_JSON_ROW_MAX 128
+
+/*
+ * Per-core counters changed after ?since=<sequence>, all of them without it. The reply carries
+ * the sequence to pass next time. ?format=binary sends the packed core_stats_encode() layout,
+ * otherwise each slot is a JSON row [slot, valid, invalid, bestDiff, lastSeen, flags].
+ */
+static esp_err_t GET_system_cores(httpd_req_t * req)
+{
+    if (is_network_allowed(req) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
+    }
+
+    if (set_cors_headers(req) != ESP_OK) {
+        httpd_resp_send_500(req);
+        return ESP_OK;
+    }
+
+    uint32_t since = 0;
+    bool binary = false;
+    char query[64];
+    char value[16];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        if (httpd_query_key_value(query, "since", value, sizeof(value)) == ESP_OK) {
+            since = strtoul(value, NULL, 10);
+        }
+        if (httpd_query_key_value(query, "format", value, sizeof(value)) == ESP_OK) {
+            binary = strcmp(value, "binary") == 0;
+        }
+    }
+
+    const core_stats * cores = &GLOBAL_STATE->core_stats;
+    uint32_t now_s = esp_timer_get_time() / 1000000;
+
+    if (binary) {
+        size_t size = core_stats_encode_size(cores);
+        uint8_t * buf = malloc(size);
+        if (buf == NULL) {
+            httpd_resp_send_500(req);
+            return ESP_OK;
+        }
+        size_t len = core_stats_encode(cores, since, now_s, buf, size);
+        httpd_resp_set_type(req, "application/octet-stream");
+        httpd_resp_send(req, (const char *) buf, len);
+        free(buf);
+        return ESP_OK;
+    }
+
+    httpd_resp_set_type(req, "application/json");
+
+    // read before the rows, so anything that changes while they are sent comes again next time
+    uint32_t sequence = cores->sequence;
+    char * chunk = ((rest_server_context_t *) (req->user_ctx))->scratch;
+    int len = snprintf(chunk, SCRATCH_BUFSIZE,
+                       "{\"sequence\":%" PRIu32 ",\"uptimeSeconds\":%" PRIu32 ",\"cores\":%d,\"smallCores\":%d,"
+                       "\"results\":%" PRIu32 ",\"unknown\":%" PRIu32 ",\"flagged\":%d,\"slots\":[",
+                       sequence, now_s, cores->cores, cores->small_cores, cores->results, cores->unknown, cores->flagged);
+
+    bool first = true;
+    for (uint16_t slot = 0; slot < cores->slots; slot++) {
+        if (cores->updated[slot] <= since) {
+            continue;
+        }
+        if (len > SCRATCH_BUFSIZE - CORE_STATS_JSON_ROW_MAX) {
+            if (httpd_resp_send_chunk(req, chunk, len) != ESP_OK) {
+                return ESP_FAIL;
+            }
+            len = 0;
+        }
+        len += snprintf(chunk + len, SCRATCH_BUFSIZE - len, "%s[%d,%" PRIu32 ",%d,%.0f,%" PRIu32 ",%d]", first ? "" : ",",
+                        slot, cores->valid[slot], cores->invalid[slot], cores->best_diff[slot], cores->last_seen_s[slot],
+                        cores->flags[slot]);
+        first = false;
+    }
+    len += snprintf(chunk + len, SCRATCH_BUFSIZE - len, "]}");
+    httpd_resp_send_chunk(req, chunk, len);
+    httpd_resp_send_chunk(req, NULL, 0);
+    return ESP_OK;
+}
+
 esp_err_t POST_WWW_update(httpd_req_t * req)
 {
     if (is_network_allowed(req) != ESP_OK) {
@@ -854,6 +1164,14 @@ esp_err_t start_rest_server(void * pvParameters)
     };
     httpd_register_uri_handler(server, &system_info_get_uri);
 
+    httpd_uri_t system_cores_get_uri = {
+        .uri = "/api/system/cores",
+        .method = HTTP_GET,
+        .handler = GET_system_cores,
+        .user_ctx = rest_context
+    };
+    httpd_register_uri_handler(server, &system_cores_get_uri);
+
     httpd_uri_t swarm_options_uri = {
         .uri = "/api/swarm",
         .method = HTTP_OPTIONS,
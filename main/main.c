@@ -5,6 +5,7 @@
 // #include "protocol_examples_common.h"
 #include "main.h"
 
+#include "asic_register_task.h"
 #include "asic_result_task.h"
 #include "asic_task.h"
 #include "create_jobs_task.h"
@@ -34,6 +35,7 @@ static GlobalState GLOBAL_STATE = {
     .extranonce_2_len = 0, 
     .abandon_work = 0, 
     .version_mask = 0,
+    .pool_health_lock = PTHREAD_MUTEX_INITIALIZER,
     .ASIC_initalized = false
 };
 
@@ -140,6 +142,7 @@ void app_main(void)
         xTaskCreate(create_jobs_task, "stratum miner", 8192, (void *) &GLOBAL_STATE, 10, NULL);
         xTaskCreate(ASIC_task, "asic", 8192, (void *) &GLOBAL_STATE, 10, NULL);
         xTaskCreate(ASIC_result_task, "asic result", 8192, (void *) &GLOBAL_STATE, 15, NULL);
+        xTaskCreate(ASIC_register_task, "asic register", 4096, (void *) &GLOBAL_STATE, 5, NULL);
     }
 }
 
@@ -30,6 +30,13 @@
 #define NVS_CONFIG_SELF_TEST "selftest"
 #define NVS_CONFIG_OVERHEAT_MODE "overheat_mode"
 #define NVS_CONFIG_SWARM "swarmconfig"
+#define NVS_CONFIG_POOL_FAIL_SCORE "poolfailscore"
+#define NVS_CONFIG_POOL_RETURN_SCORE "poolretscore"
+#define NVS_CONFIG_POOL_MIN_DWELL "pooldwell"
+#define NVS_CONFIG_POOL_NOTIFY_INTERVAL "poolnotifyint"
+#define NVS_CONFIG_EXTRANONCE2_OFFSET "en2offset"
+#define NVS_CONFIG_AUTOTUNE "autotune"
+#define NVS_CONFIG_AUTOTUNE_PROFILE "autotuneprof"
 
 // Theme configuration
 #define NVS_CONFIG_THEME_SCHEME "themescheme"
@@ -1,6 +1,7 @@
 #include <string.h>
 #include "esp_event.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "nvs_flash.h"
 #include "nvs_config.h"
 #include "nvs_device.h"
@@ -14,13 +15,6 @@
 // and retrieval of device settings critical to mining operations.
 static const char * TAG = "nvs_device";
 
-// Developer Notes:
-// This static constant represents the total nonce space available for a 32-bit nonce (2^32 = 4,294,967,296). It’s used
-// in calculating the ASIC job frequency (commented out in the code), which determines how often new mining jobs are
-// sent to the ASIC based on its frequency and core count. Although currently unused in favor of hardcoded values, it
-// reflects the theoretical maximum number of nonces an ASIC can process per job, a key parameter in mining performance.
-static const double NONCE_SPACE = 4294967296.0; //  2^32
-
 // Developer Notes:
 // This function initializes the NVS flash storage system, which stores persistent configuration data for the mining
 // device (e.g., Wi-Fi credentials, ASIC settings). It attempts to initialize NVS and, if it fails due to no free pages
@@ -102,6 +96,8 @@ esp_err_t NVSDevice_parse_config(GlobalState * GLOBAL_STATE) {
     ESP_LOGI(TAG, "Found Device Model: %s", GLOBAL_STATE->device_model_str);
     ESP_LOGI(TAG, "Found Board Version: %d", GLOBAL_STATE->board_version);
 
+    uint16_t cores = 0;
+    uint16_t small_cores = 0;
     GLOBAL_STATE->asic_model_str = nvs_config_get_string(NVS_CONFIG_ASIC_MODEL, "");
     if (strcmp(GLOBAL_STATE->asic_model_str, "BM1366") == 0) {
         ESP_LOGI(TAG, "ASIC: %dx BM1366 (%" PRIu64 " cores)", GLOBAL_STATE->asic_count, BM1366_CORE_COUNT);
@@ -111,9 +107,14 @@ esp_err_t NVSDevice_parse_config(GlobalState * GLOBAL_STATE) {
                                         .set_max_baud_fn = BM1366_set_max_baud,
                                         .set_difficulty_mask_fn = BM1366_set_job_difficulty_mask,
                                         .send_work_fn = BM1366_send_work,
-                                        .set_version_mask = BM1366_set_version_mask};
-        GLOBAL_STATE->asic_job_frequency_ms = 2000; //ms
+                                        .set_version_mask = BM1366_set_version_mask,
+                                        .set_frequency_fn = BM1366_set_frequency,
+                                        .read_register_fn = BM1366_read_register,
+                                        .set_chip_frequency_fn = BM1366_set_chip_frequency,
+                                        .job_interval_fn = BM1366_job_interval};
         GLOBAL_STATE->ASIC_difficulty = BM1366_ASIC_DIFFICULTY;
+        cores = BM1366_CORE_COUNT;
+        small_cores = BM1366_CHIP.small_core_mask + 1;
 
         GLOBAL_STATE->ASIC_functions = ASIC_functions;
         } else if (strcmp(GLOBAL_STATE->asic_model_str, "BM1370") == 0) {
@@ -124,9 +125,14 @@ esp_err_t NVSDevice_parse_config(GlobalState * GLOBAL_STATE) {
                                         .set_max_baud_fn = BM1370_set_max_baud,
                                         .set_difficulty_mask_fn = BM1370_set_job_difficulty_mask,
                                         .send_work_fn = BM1370_send_work,
-                                        .set_version_mask = BM1370_set_version_mask};
-        GLOBAL_STATE->asic_job_frequency_ms = 500; //ms
+                                        .set_version_mask = BM1370_set_version_mask,
+                                        .set_frequency_fn = BM1370_set_frequency,
+                                        .read_register_fn = BM1370_read_register,
+                                        .set_chip_frequency_fn = BM1370_set_chip_frequency,
+                                        .job_interval_fn = BM1370_job_interval};
         GLOBAL_STATE->ASIC_difficulty = BM1370_ASIC_DIFFICULTY;
+        cores = BM1370_CORE_COUNT;
+        small_cores = BM1370_CHIP.small_core_mask + 1;
 
         GLOBAL_STATE->ASIC_functions = ASIC_functions;
     } else if (strcmp(GLOBAL_STATE->asic_model_str, "BM1368") == 0) {
@@ -137,9 +143,14 @@ esp_err_t NVSDevice_parse_config(GlobalState * GLOBAL_STATE) {
                                         .set_max_baud_fn = BM1368_set_max_baud,
                                         .set_difficulty_mask_fn = BM1368_set_job_difficulty_mask,
                                         .send_work_fn = BM1368_send_work,
-                                        .set_version_mask = BM1368_set_version_mask};
-        GLOBAL_STATE->asic_job_frequency_ms = 500; //ms
+                                        .set_version_mask = BM1368_set_version_mask,
+                                        .set_frequency_fn = BM1368_set_frequency,
+                                        .read_register_fn = BM1368_read_register,
+                                        .set_chip_frequency_fn = BM1368_set_chip_frequency,
+                                        .job_interval_fn = BM1368_job_interval};
         GLOBAL_STATE->ASIC_difficulty = BM1368_ASIC_DIFFICULTY;
+        cores = BM1368_CORE_COUNT;
+        small_cores = BM1368_CHIP.small_core_mask + 1;
 
         GLOBAL_STATE->ASIC_functions = ASIC_functions;
     } else if (strcmp(GLOBAL_STATE->asic_model_str, "BM1397") == 0) {
@@ -150,9 +161,14 @@ esp_err_t NVSDevice_parse_config(GlobalState * GLOBAL_STATE) {
                                         .set_max_baud_fn = BM1397_set_max_baud,
                                         .set_difficulty_mask_fn = BM1397_set_job_difficulty_mask,
                                         .send_work_fn = BM1397_send_work,
-                                        .set_version_mask = BM1397_set_version_mask};
-        GLOBAL_STATE->asic_job_frequency_ms = (NONCE_SPACE / (double) (GLOBAL_STATE->POWER_MANAGEMENT_MODULE.frequency_value * BM1397_SMALL_CORE_COUNT * 1000)) / (double) GLOBAL_STATE->asic_count;
+                                        .set_version_mask = BM1397_set_version_mask,
+                                        .set_frequency_fn = BM1397_set_frequency,
+                                        .read_register_fn = BM1397_read_register,
+                                        .job_interval_fn = BM1397_job_interval};
         GLOBAL_STATE->ASIC_difficulty = BM1397_ASIC_DIFFICULTY;
+        cores = BM1397_CORE_COUNT;
+        // the low bits of its result job ids are the midstate, not a small core
+        small_cores = 1;
 
         GLOBAL_STATE->ASIC_functions = ASIC_functions;
     } else {
@@ -166,5 +182,11 @@ esp_err_t NVSDevice_parse_config(GlobalState * GLOBAL_STATE) {
         return ESP_FAIL;
     }
 
+    if (!core_stats_init(&GLOBAL_STATE->core_stats, cores, small_cores, esp_timer_get_time() / 1000000)) {
+        ESP_LOGE(TAG, "No memory for the stats of %d cores", cores * small_cores);
+    }
+    // frequency ramps slow down when bad nonces come back
+    bm13xx_set_error_counter(&GLOBAL_STATE->core_stats.errors);
+
     return ESP_OK;
 }
@@ -458,6 +458,7 @@ void self_test(void * pvParameters)
             hash_rate = (sum * 4294967296) / (duration * 1000000000);
             ESP_LOGI(TAG, "Nonce %lu Nonce difficulty %.32f.", asic_result->nonce, nonce_diff);
             ESP_LOGI(TAG, "%f Gh/s  , duration %f",hash_rate, duration);
+            bm_job_release(asic_result->job);
         }
     }
 
@@ -46,7 +46,7 @@ static void _suffix_string(uint64_t, char *, size_t, int);
 // - _check_for_best_diff: Updates the best difficulty metrics when a new nonce is found.
 // - _suffix_string (repeated): Already declared above, formats large numbers with suffixes.
 static esp_err_t ensure_overheat_mode_config();
-static void _check_for_best_diff(GlobalState * GLOBAL_STATE, double diff, uint8_t job_id);
+static void _check_for_best_diff(GlobalState * GLOBAL_STATE, double diff, bool found_block, const bm_job * job);
 static void _suffix_string(uint64_t val, char * buf, size_t bufsiz, int sigdigits);
 
 // Developer Notes:
@@ -231,7 +231,7 @@ void SYSTEM_notify_new_ntime(GlobalState * GLOBAL_STATE, uint32_t ntime)
 // smoothing it with a weighted average once the buffer is full (HISTORY_LENGTH). The hashrate reflects the device’s
 // mining performance in hashes per second. It then calls _check_for_best_diff to update best difficulty records. This
 // function is central to performance monitoring, providing real-time feedback on mining efficiency and success.
-void SYSTEM_notify_found_nonce(GlobalState * GLOBAL_STATE, double found_diff, uint8_t job_id)
+void SYSTEM_notify_found_nonce(GlobalState * GLOBAL_STATE, double found_diff, bool found_block, const bm_job * job)
 {
     SystemModule * module = &GLOBAL_STATE->SYSTEM_MODULE;
 
@@ -260,38 +260,26 @@ void SYSTEM_notify_found_nonce(GlobalState * GLOBAL_STATE, double found_diff, ui
         module->current_hashrate = ((module->current_hashrate * 9) + rolling_rate) / 10;
     }
 
-    _check_for_best_diff(GLOBAL_STATE, found_diff, job_id);
-}
-
-// Developer Notes:
-// This static function calculates the Bitcoin network difficulty from an nBits value (a compact representation of the
-// target hash). It extracts the mantissa (23 bits) and exponent (8 bits) from nBits, computes the target as mantissa * 256^(exponent-3),
-// and derives difficulty as (2^208 * 65535) / target. This reflects the network’s mining difficulty, where a lower target
-// means higher difficulty. It’s used in _check_for_best_diff to compare a found nonce’s difficulty against the network’s,
-// determining if a block was found. This is a key calculation for validating mining success beyond pool shares.
-static double _calculate_network_difficulty(uint32_t nBits)
-{
-    uint32_t mantissa = nBits & 0x007fffff;
-    uint8_t exponent = (nBits >> 24) & 0xff;
-
-    double target = (double) mantissa * pow(256, (exponent - 3));
-
-    double difficulty = (pow(2, 208) * 65535) / target;
-
-    return difficulty;
+    _check_for_best_diff(GLOBAL_STATE, found_diff, found_block, job);
 }
 
 // Developer Notes:
 // This static function updates the best difficulty metrics (session and all-time) when a new nonce is found. It compares
 // the found difficulty (diff) against the session best (best_session_nonce_diff), updating it and its string representation
-// if higher. If it exceeds the all-time best (best_nonce_diff), it updates that too, persists it to NVS, and checks if it
-// surpasses the network difficulty (via _calculate_network_difficulty) to flag a block find (FOUND_BLOCK). The function
+// if higher. If it exceeds the all-time best (best_nonce_diff), it updates that too and persists it to NVS. A nonce that
+// met the job's network target (found_block, an exact 256-bit compare made in test_nonce_result) flags a block find
+// (FOUND_BLOCK) whether or not it is a new best. The function
 // uses _suffix_string to format difficulty strings for display. It’s a critical evaluation step, tracking mining achievements
 // and detecting block discoveries.
-static void _check_for_best_diff(GlobalState * GLOBAL_STATE, double diff, uint8_t job_id)
+static void _check_for_best_diff(GlobalState * GLOBAL_STATE, double diff, bool found_block, const bm_job * job)
 {
     SystemModule * module = &GLOBAL_STATE->SYSTEM_MODULE;
 
+    if (found_block) {
+        module->FOUND_BLOCK = true;
+        ESP_LOGI(TAG, "FOUND BLOCK!!!!!!!!!!!!!!!!!!!!!! %f >= %f", diff, uint256_to_difficulty(&job->network_target.value));
+    }
+
     if ((uint64_t) diff > module->best_session_nonce_diff) {
         module->best_session_nonce_diff = (uint64_t) diff;
         _suffix_string((uint64_t) diff, module->best_session_diff_string, DIFF_STRING_SIZE, 0);
@@ -306,12 +294,7 @@ static void _check_for_best_diff(GlobalState * GLOBAL_STATE, double diff, uint8_
 
     _suffix_string((uint64_t) diff, module->best_diff_string, DIFF_STRING_SIZE, 0);
 
-    double network_diff = _calculate_network_difficulty(GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job_id]->target);
-    if (diff > network_diff) {
-        module->FOUND_BLOCK = true;
-        ESP_LOGI(TAG, "FOUND BLOCK!!!!!!!!!!!!!!!!!!!!!! %f > %f", diff, network_diff);
-    }
-    ESP_LOGI(TAG, "Network diff: %f", network_diff);
+    ESP_LOGI(TAG, "Network diff: %f", uint256_to_difficulty(&job->network_target.value));
 }
 
 // Developer Notes:
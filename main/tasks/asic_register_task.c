@@ -0,0 +1,81 @@
+#include <inttypes.h>
+
+#include "global_state.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const char *TAG = "asic_register";
+
+// How often the counters are read, and how long every chip gets to answer
+#define POLL_INTERVAL_MS 10000
+#define READ_TIMEOUT_MS 1000
+
+static const uint8_t polled_registers[] = {
+    BM13XX_REG_HASH_RATE,
+    BM13XX_REG_ERROR_FLAG,
+    BM13XX_REG_NONCE_ERROR_COUNTER,
+    BM13XX_REG_NONCE_OVERFLOW_COUNTER,
+};
+
+static uint32_t uptime_ms(void)
+{
+    return esp_timer_get_time() / 1000;
+}
+
+// Runs in the result task, which reads the replies off the UART along with the nonces
+static void store_register(void *ctx, uint8_t chip_index, uint8_t reg, uint32_t value)
+{
+    AsicRegisterModule *module = (AsicRegisterModule *)ctx;
+
+    if (chip_index >= ASIC_REGISTER_MAX_CHIPS) {
+        return;
+    }
+    switch (reg) {
+    case BM13XX_REG_HASH_RATE:
+        module->hash_rate[chip_index] = value;
+        break;
+    case BM13XX_REG_ERROR_FLAG:
+        module->error_flag[chip_index] = value;
+        break;
+    case BM13XX_REG_NONCE_ERROR_COUNTER:
+        module->nonce_errors[chip_index] = value;
+        break;
+    case BM13XX_REG_NONCE_OVERFLOW_COUNTER:
+        module->nonce_overflows[chip_index] = value;
+        break;
+    }
+    module->updated_ms[chip_index] = uptime_ms();
+}
+
+void ASIC_register_task(void *pvParameters)
+{
+    GlobalState *GLOBAL_STATE = (GlobalState *)pvParameters;
+    AsicRegisterModule *module = &GLOBAL_STATE->ASIC_REGISTER_MODULE;
+
+    register_reads_init(&module->reads);
+    bm13xx_set_register_reads(&module->reads);
+
+    while (1) {
+        vTaskDelay((POLL_INTERVAL_MS - READ_TIMEOUT_MS) / portTICK_PERIOD_MS);
+
+        // every chip answers each read, in between its nonces
+        uint32_t now = uptime_ms();
+        for (size_t i = 0; i < sizeof(polled_registers); i++) {
+            if (register_reads_begin(&module->reads, REGISTER_READ_ALL, polled_registers[i], READ_TIMEOUT_MS, now,
+                                     store_register, module)) {
+                (*GLOBAL_STATE->ASIC_functions.read_register_fn)(REGISTER_READ_ALL, polled_registers[i]);
+            }
+        }
+
+        // stop taking replies once the chips have had their time, rather than at the next poll;
+        // a tick over, as the delay may end up to a tick short
+        vTaskDelay(READ_TIMEOUT_MS / portTICK_PERIOD_MS + 1);
+        if (register_reads_expire(&module->reads, uptime_ms()) > 0) {
+            ESP_LOGW(TAG, "No chip answered a register read (%" PRIu32 " timeouts)", module->reads.timeouts);
+        }
+        module->polls++;
+    }
+}
@@ -0,0 +1,24 @@
+#ifndef ASIC_REGISTER_TASK_H_
+#define ASIC_REGISTER_TASK_H_
+
+#include "register_reads.h"
+
+// Chips whose registers are kept; the rest of a longer chain is read but not stored
+#define ASIC_REGISTER_MAX_CHIPS 32
+
+typedef struct
+{
+    register_reads reads;
+    uint32_t polls;
+
+    // raw register values, per chip
+    uint32_t hash_rate[ASIC_REGISTER_MAX_CHIPS];
+    uint32_t error_flag[ASIC_REGISTER_MAX_CHIPS];
+    uint32_t nonce_errors[ASIC_REGISTER_MAX_CHIPS];
+    uint32_t nonce_overflows[ASIC_REGISTER_MAX_CHIPS];
+    uint32_t updated_ms[ASIC_REGISTER_MAX_CHIPS]; // uptime of the chip's last reply, 0 for none yet
+} AsicRegisterModule;
+
+void ASIC_register_task(void *pvParameters);
+
+#endif /* ASIC_REGISTER_TASK_H_ */
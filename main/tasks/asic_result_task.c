@@ -6,60 +6,207 @@
 #include "esp_log.h"
 #include "nvs_config.h"
 #include "utils.h"
+#include "version_rolling.h"
 #include "stratum_task.h"
+#include "esp_timer.h"
 #include <lwip/tcpip.h>
 
 static const char *TAG = "asic_result";
 
+// Most results drained from the UART and verified together
+#define RESULT_BATCH_MAX 16
+// How often the per-core counters are checked for silent or erroring cores
+#define CORE_CHECK_INTERVAL_S 60
+// Newly flagged cores logged one by one per check, the rest only show up in /api/system/cores
+#define CORE_CHECK_LOG_MAX 8
+
+static int drain_results(GlobalState *GLOBAL_STATE, task_result *results, int64_t *received_us);
+static void handle_result(GlobalState *GLOBAL_STATE, const task_result *asic_result, nonce_result result);
+static void check_cores(core_stats *cores, uint32_t now_s);
+
 void ASIC_result_task(void *pvParameters)
 {
     GlobalState *GLOBAL_STATE = (GlobalState *)pvParameters;
+    task_result results[RESULT_BATCH_MAX];
+    int64_t received_us[RESULT_BATCH_MAX];
+    nonce_check checks[RESULT_BATCH_MAX];
+    nonce_result verified[RESULT_BATCH_MAX];
+    uint32_t last_core_check_s = 0;
 
     while (1)
     {
-        task_result *asic_result = (*GLOBAL_STATE->ASIC_functions.receive_result_fn)(GLOBAL_STATE);
+        int count = drain_results(GLOBAL_STATE, results, received_us);
+        if (count == 0)
+        {
+            continue;
+        }
+
+        // check the nonce difficulties together, nonces under the chip's ticket difficulty
+        // are rejected before the difficulty math
+        for (int i = 0; i < count; i++) {
+            checks[i].job = results[i].job;
+            checks[i].nonce = results[i].nonce;
+            checks[i].rolled_version = results[i].rolled_version;
+        }
+
+        int64_t start = esp_timer_get_time();
+        test_nonce_batch(checks, count, GLOBAL_STATE->ASIC_difficulty, verified);
+        int64_t now = esp_timer_get_time();
+        uint32_t elapsed = now - start;
+
+        NonceVerifyModule *stats = &GLOBAL_STATE->NONCE_VERIFY_MODULE;
+        stats->batches++;
+        stats->nonces += count;
+        stats->verify_us += elapsed;
+        stats->last_batch_us = elapsed;
+        if (count > stats->max_batch) {
+            stats->max_batch = count;
+        }
+        for (int i = 0; i < count; i++) {
+            uint32_t latency = now - received_us[i];
+            stats->latency_us += latency;
+            stats->last_latency_us = latency;
+            if (latency > stats->max_latency_us) {
+                stats->max_latency_us = latency;
+            }
+        }
 
+        for (int i = 0; i < count; i++) {
+            handle_result(GLOBAL_STATE, &results[i], verified[i]);
+        }
+
+        uint32_t now_s = now / 1000000;
+        for (int i = 0; i < count; i++) {
+            core_stats_record(&GLOBAL_STATE->core_stats, results[i].core_id, results[i].small_core_id, verified[i].difficulty, now_s);
+            autotune_record(&GLOBAL_STATE->autotune, results[i].chip_index, verified[i].difficulty > 0);
+            bm_job_release(results[i].job);
+        }
+        if (now_s - last_core_check_s >= CORE_CHECK_INTERVAL_S) {
+            last_core_check_s = now_s;
+            check_cores(&GLOBAL_STATE->core_stats, now_s);
+        }
+    }
+}
+
+/**
+ * Wait for one result, then take whatever else the chips have already sent, grouped by job so
+ * each job's cached first-block state is reused. Results for jobs no longer valid are dropped.
+ * Each result kept holds a reference to its job, released once it has been handled.
+ */
+static int drain_results(GlobalState *GLOBAL_STATE, task_result *results, int64_t *received_us)
+{
+    int count = 0;
+    do {
+        task_result *asic_result = (*GLOBAL_STATE->ASIC_functions.receive_result_fn)(GLOBAL_STATE);
         if (asic_result == NULL)
         {
-            continue;
+            break;
         }
 
         uint8_t job_id = asic_result->job_id;
-
         if (GLOBAL_STATE->valid_jobs[job_id] == 0)
         {
             ESP_LOGI(TAG, "Invalid job nonce found, 0x%02X", job_id);
+            bm_job_release(asic_result->job);
             continue;
         }
 
-        // check the nonce difficulty
-        double nonce_diff = test_nonce_value(
-            GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job_id],
-            asic_result->nonce,
-            asic_result->rolled_version);
+        // an echoed or rediscovered result would only come back from the pool as a duplicate share
+        if (!result_set_insert(&GLOBAL_STATE->ASIC_TASK_MODULE.result_set, job_id, asic_result->nonce,
+                               asic_result->rolled_version))
+        {
+            ESP_LOGI(TAG, "Duplicate nonce %08" PRIX32 " for job 0x%02X", asic_result->nonce, job_id);
+            bm_job_release(asic_result->job);
+            continue;
+        }
+
+        // insert after the last result for the same job, or at the end
+        int at = count;
+        for (int i = count - 1; i >= 0; i--) {
+            if (results[i].job == asic_result->job) {
+                at = i + 1;
+                break;
+            }
+        }
+        memmove(&results[at + 1], &results[at], (count - at) * sizeof(task_result));
+        memmove(&received_us[at + 1], &received_us[at], (count - at) * sizeof(int64_t));
+        results[at] = *asic_result;
+        received_us[at] = SERIAL_frame_received_us();
+        count++;
+    } while (count < RESULT_BATCH_MAX && SERIAL_rx_pending() > 0);
+
+    return count;
+}
 
+static void handle_result(GlobalState *GLOBAL_STATE, const task_result *asic_result, nonce_result result)
+{
+    // the job the nonce was verified against, whatever the slot holds by now
+    const bm_job *job = asic_result->job;
+    double nonce_diff = result.difficulty;
+
+    if (nonce_diff == 0.0) {
+        ESP_LOGW(TAG, "Ver: %08" PRIX32 " Nonce %08" PRIX32 " below ticket difficulty %" PRIu32, asic_result->rolled_version, asic_result->nonce, GLOBAL_STATE->ASIC_difficulty);
+    } else {
         //log the ASIC response
-        ESP_LOGI(TAG, "Ver: %08" PRIX32 " Nonce %08" PRIX32 " diff %.1f of %ld.", asic_result->rolled_version, asic_result->nonce, nonce_diff, GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job_id]->pool_diff);
+        ESP_LOGI(TAG, "Ver: %08" PRIX32 " Nonce %08" PRIX32 " diff %.1f of %g.", asic_result->rolled_version, asic_result->nonce, nonce_diff, job->pool_diff);
+    }
 
-        if (nonce_diff > GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job_id]->pool_diff)
-        {
-            char * user = GLOBAL_STATE->SYSTEM_MODULE.is_using_fallback ? nvs_config_get_string(NVS_CONFIG_FALLBACK_STRATUM_USER, FALLBACK_STRATUM_USER) : nvs_config_get_string(NVS_CONFIG_STRATUM_USER, STRATUM_USER);
-            int ret = STRATUM_V1_submit_share(
-                GLOBAL_STATE->sock,
-                user,
-                GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job_id]->jobid,
-                GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job_id]->extranonce2,
-                GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job_id]->ntime,
-                asic_result->nonce,
-                asic_result->rolled_version ^ GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job_id]->version);
-            free(user);
-
-            if (ret < 0) {
-                ESP_LOGI(TAG, "Unable to write share to socket. Closing connection. Ret: %d (errno %d: %s)", ret, errno, strerror(errno));
-                stratum_close_connection(GLOBAL_STATE);
-            }
+    if (result.pool_share &&
+        share_filter_is_stale(&GLOBAL_STATE->share_filter, job->generation))
+    {
+        // the pool has moved on to a new block or asked for clean jobs, it would only reject this
+        ESP_LOGI(TAG, "Suppressing stale share for job %s", job->jobid);
+        share_filter_record_suppressed(&GLOBAL_STATE->share_filter);
+    }
+    else if (result.pool_share &&
+             !version_rolling_is_allowed(job->version,
+                                         asic_result->rolled_version, GLOBAL_STATE->version_mask))
+    {
+        // rolled on bits the pool took back with mining.set_version_mask
+        ESP_LOGI(TAG, "Dropping share rolled outside version mask %08" PRIX32, GLOBAL_STATE->version_mask);
+    }
+    else if (result.pool_share)
+    {
+        char * user = GLOBAL_STATE->SYSTEM_MODULE.is_using_fallback ? nvs_config_get_string(NVS_CONFIG_FALLBACK_STRATUM_USER, FALLBACK_STRATUM_USER) : nvs_config_get_string(NVS_CONFIG_STRATUM_USER, STRATUM_USER);
+        int ret = STRATUM_V1_submit_share(
+            GLOBAL_STATE->sock,
+            GLOBAL_STATE->send_uid++,
+            user,
+            job->jobid,
+            job->extranonce2,
+            job->ntime,
+            asic_result->nonce,
+            asic_result->rolled_version ^ job->version);
+        free(user);
+
+        if (ret < 0) {
+            ESP_LOGI(TAG, "Unable to write share to socket. Closing connection. Ret: %d (errno %d: %s)", ret, errno, strerror(errno));
+            stratum_close_connection(GLOBAL_STATE);
         }
+    }
+
+    SYSTEM_notify_found_nonce(GLOBAL_STATE, nonce_diff, result.block, job);
+}
+
+static void check_cores(core_stats *cores, uint32_t now_s)
+{
+    uint32_t before = cores->sequence;
+    if (core_stats_check(cores, now_s) == 0) {
+        return;
+    }
 
-        SYSTEM_notify_found_nonce(GLOBAL_STATE, nonce_diff, job_id);
+    // the check bumps the sequence of every slot whose flags it changed
+    int logged = 0;
+    for (uint16_t slot = 0; slot < cores->slots && logged < CORE_CHECK_LOG_MAX; slot++) {
+        if (cores->updated[slot] > before && cores->flags[slot]) {
+            logged++;
+            ESP_LOGW(TAG, "Core %d/%d%s%s: %" PRIu32 " valid, %d invalid, last seen %" PRIu32 "s ago",
+                     slot / cores->small_cores, slot % cores->small_cores,
+                     (cores->flags[slot] & CORE_STATS_SILENT) ? " silent" : "",
+                     (cores->flags[slot] & CORE_STATS_ERRORS) ? " erroring" : "",
+                     cores->valid[slot], cores->invalid[slot],
+                     now_s - (cores->last_seen_s[slot] ? cores->last_seen_s[slot] : cores->started_s));
+        }
     }
-}
\ No newline at end of file
+    ESP_LOGW(TAG, "%d of %d cores flagged", cores->flagged, cores->slots);
+}
@@ -4,6 +4,7 @@
 #include "bm1397.h"
 #include <string.h>
 #include "esp_log.h"
+#include "esp_timer.h"
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -12,6 +13,23 @@ static const char *TAG = "ASIC_task";
 
 // static bm_job ** active_jobs; is required to keep track of the active jobs since the
 
+// How long each job stays on the chain: most of the time the chain takes to cover its nonces
+// for every version it rolls at the current frequency. Each chip searches its own share of the
+// nonces, so with the chips tuned apart the fastest one sets the pace.
+static void update_job_interval(GlobalState *GLOBAL_STATE)
+{
+    job_interval *interval = &GLOBAL_STATE->ASIC_TASK_MODULE.job_interval;
+    float frequency = autotune_max_frequency(&GLOBAL_STATE->autotune, GLOBAL_STATE->POWER_MANAGEMENT_MODULE.frequency_value);
+
+    GLOBAL_STATE->ASIC_TASK_MODULE.job_interval_stale = false;
+    (*GLOBAL_STATE->ASIC_functions.job_interval_fn)(interval, frequency,
+                                                    GLOBAL_STATE->asic_count, GLOBAL_STATE->version_mask);
+    GLOBAL_STATE->asic_job_frequency_ms = interval->interval_ms;
+
+    ESP_LOGI(TAG, "ASIC Job Interval: %.2f ms (the chain covers a job in %.2f ms at %.2f GH/s)", interval->interval_ms,
+             interval->full_ms, interval->hashrate / 1e9);
+}
+
 void ASIC_task(void *pvParameters)
 {
     GlobalState *GLOBAL_STATE = (GlobalState *)pvParameters;
@@ -27,7 +45,11 @@ void ASIC_task(void *pvParameters)
         GLOBAL_STATE->valid_jobs[i] = 0;
     }
 
-    ESP_LOGI(TAG, "ASIC Job Interval: %.2f ms", GLOBAL_STATE->asic_job_frequency_ms);
+    nonce_schedule_init(&GLOBAL_STATE->ASIC_TASK_MODULE.nonce_schedule);
+    result_set_init(&GLOBAL_STATE->ASIC_TASK_MODULE.result_set);
+    update_job_interval(GLOBAL_STATE);
+    int64_t last_job_us = 0;
+    int64_t last_notify_us = 0;
     SYSTEM_notify_mining_started(GLOBAL_STATE);
     ESP_LOGI(TAG, "ASIC Ready!");
 
@@ -38,10 +60,29 @@ void ASIC_task(void *pvParameters)
 
         if (next_bm_job->pool_diff != GLOBAL_STATE->stratum_difficulty)
         {
-            ESP_LOGI(TAG, "New pool difficulty %lu", next_bm_job->pool_diff);
+            ESP_LOGI(TAG, "New pool difficulty %g", next_bm_job->pool_diff);
             GLOBAL_STATE->stratum_difficulty = next_bm_job->pool_diff;
         }
 
+        // the chain worked on the previous job until now, however long the queue kept us waiting
+        int64_t now_us = esp_timer_get_time();
+        if (last_job_us != 0) {
+            job_coverage_record(&GLOBAL_STATE->ASIC_TASK_MODULE.job_coverage, &GLOBAL_STATE->ASIC_TASK_MODULE.job_interval,
+                                (now_us - last_job_us) / 1000.0);
+        }
+        last_job_us = now_us;
+
+        // notifies that did not come through the stratum task have no arrival time
+        if (next_bm_job->notify_us != 0) {
+            job_coverage_record_age(&GLOBAL_STATE->ASIC_TASK_MODULE.job_coverage, (now_us - next_bm_job->notify_us) / 1000.0,
+                                    next_bm_job->notify_us != last_notify_us);
+            last_notify_us = next_bm_job->notify_us;
+        }
+
+        if (GLOBAL_STATE->ASIC_TASK_MODULE.job_interval_stale) {
+            update_job_interval(GLOBAL_STATE);
+        }
+
         (*GLOBAL_STATE->ASIC_functions.send_work_fn)(GLOBAL_STATE, next_bm_job); // send the job to the ASIC
 
         // Time to execute the above code is ~0.3ms
@@ -3,7 +3,10 @@
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
+#include "job_interval.h"
 #include "mining.h"
+#include "nonce_schedule.h"
+#include "result_set.h"
 typedef struct
 {
     // ASIC may not return the nonce in the same order as the jobs were sent
@@ -12,6 +15,14 @@ typedef struct
     bm_job **active_jobs;
     //semaphone
     SemaphoreHandle_t semaphore;
+    // set when the frequency or version mask changes, the ASIC task then works the interval out again
+    bool job_interval_stale;
+    job_interval job_interval;
+    job_coverage job_coverage;
+    // where each job's chips start in its nonce space
+    nonce_schedule nonce_schedule;
+    // results already seen for each job id, so none goes to the pool twice
+    result_set result_set;
 } AsicTaskModule;
 
 void ASIC_task(void *pvParameters);
@@ -3,6 +3,13 @@
 #include "esp_log.h"
 #include "esp_system.h"
 #include "mining.h"
+#include "version_rolling.h"
+#include "ntime_roll.h"
+#include "merkle_window.h"
+#include "extranonce2.h"
+#include "nvs_config.h"
+#include "esp_random.h"
+#include "esp_timer.h"
 #include <limits.h>
 #include "string.h"
 
@@ -10,15 +17,29 @@
 
 static const char *TAG = "create_jobs_task";
 
-#define QUEUE_LOW_WATER_MARK 10 // Adjust based on your requirements
+// Most jobs ever kept queued; job_interval_queue_depth keeps fewer when each job stays on long
+#define QUEUE_LOW_WATER_MARK 10
 
+static merkle_window window;
+
+static uint64_t extranonce_2_boot_offset(void);
 static bool should_generate_more_work(GlobalState *GLOBAL_STATE);
-static void generate_work(GlobalState *GLOBAL_STATE, mining_notify *notification, uint32_t extranonce_2);
+static void apply_version_mask(GlobalState *GLOBAL_STATE);
+static bool generate_work(GlobalState *GLOBAL_STATE, mining_notify *notification);
+static void record_notify_to_job(GlobalState *GLOBAL_STATE, mining_notify *notification);
+static void generate_ntime_work(GlobalState *GLOBAL_STATE, mining_notify *notification, const bm_job *job, const char *extranonce_2_str);
+static bool enqueue_job(GlobalState *GLOBAL_STATE, const bm_job *job, const char *jobid, const char *extranonce_2_str);
 
 void create_jobs_task(void *pvParameters)
 {
     GlobalState *GLOBAL_STATE = (GlobalState *)pvParameters;
 
+    if (!merkle_window_init(&window, CONFIG_STRATUM_MERKLE_WINDOW)) {
+        ESP_LOGE(TAG, "Failed to allocate merkle window, computing roots on demand");
+        merkle_window_init(&window, 0);
+    }
+    uint64_t extranonce_2_offset = extranonce_2_boot_offset();
+
     while (1)
     {
         mining_notify *mining_notification = (mining_notify *)queue_dequeue(&GLOBAL_STATE->stratum_queue);
@@ -30,25 +51,53 @@ void create_jobs_task(void *pvParameters)
 
         ESP_LOGI(TAG, "New Work Dequeued %s", mining_notification->job_id);
 
-        if (GLOBAL_STATE->new_stratum_version_rolling_msg) {
-            ESP_LOGI(TAG, "Set chip version rolls %i", (int)(GLOBAL_STATE->version_mask >> 13));
-            (GLOBAL_STATE->ASIC_functions.set_version_mask)(GLOBAL_STATE->version_mask);
-            GLOBAL_STATE->new_stratum_version_rolling_msg = false;
+        apply_version_mask(GLOBAL_STATE);
+
+        extranonce2_space extranonce_2_space;
+        if (!extranonce2_space_init(&extranonce_2_space, GLOBAL_STATE->extranonce_2_len, CONFIG_STRATUM_EXTRANONCE2_PARTITION,
+                                    CONFIG_STRATUM_EXTRANONCE2_PARTITIONS, extranonce_2_offset)) {
+            ESP_LOGE(TAG, "No extranonce2 partition %d of %d in %d bytes", CONFIG_STRATUM_EXTRANONCE2_PARTITION,
+                     CONFIG_STRATUM_EXTRANONCE2_PARTITIONS, GLOBAL_STATE->extranonce_2_len);
+            STRATUM_V1_free_mining_notify(mining_notification);
+            continue;
         }
 
-        uint32_t extranonce_2 = 0;
+        if (!merkle_window_reset(&window, mining_notification, GLOBAL_STATE->extranonce_str, &extranonce_2_space,
+                                 GLOBAL_STATE->version_mask)) {
+            ESP_LOGE(TAG, "Failed to allocate coinbase for %s", mining_notification->job_id);
+            STRATUM_V1_free_mining_notify(mining_notification);
+            continue;
+        }
+        GLOBAL_STATE->JOB_SOURCE_MODULE.window_bytes = merkle_window_memory(&window);
+
+        // jobs still queued from the previous notify are valid but mine its older template
+        ASIC_jobs_queue_clear(&GLOBAL_STATE->ASIC_jobs_queue);
+
+        bool first_job = true;
+        bool exhausted = false;
         while (GLOBAL_STATE->stratum_queue.count < 1 && GLOBAL_STATE->abandon_work == 0)
         {
-            if (should_generate_more_work(GLOBAL_STATE))
-            {
-                generate_work(GLOBAL_STATE, mining_notification, extranonce_2);
+            // the pool may change the mask mid-session with mining.set_version_mask
+            apply_version_mask(GLOBAL_STATE);
+            merkle_window_set_version_mask(&window, GLOBAL_STATE->version_mask);
 
-                // Increase extranonce_2 for the next job.
-                extranonce_2++;
+            if (should_generate_more_work(GLOBAL_STATE) && !exhausted)
+            {
+                if (generate_work(GLOBAL_STATE, mining_notification)) {
+                    if (first_job) {
+                        record_notify_to_job(GLOBAL_STATE, mining_notification);
+                        first_job = false;
+                    }
+                } else if (window.count == 0 && extranonce2_space_exhausted(&window.extranonce_2)) {
+                    // every coinbase this device may build for the notify is queued or hashed
+                    ESP_LOGW(TAG, "extranonce2 space exhausted for %s, waiting for new work", mining_notification->job_id);
+                    GLOBAL_STATE->JOB_SOURCE_MODULE.extranonce2_exhausted++;
+                    exhausted = true;
+                }
             }
-            else
+            else if (!merkle_window_fill_one(&window))
             {
-                // If no more work needed, wait a bit before checking again.
+                // If no more work needed and the window is full, wait a bit before checking again.
                 vTaskDelay(100 / portTICK_PERIOD_MS);
             }
         }
@@ -64,52 +113,146 @@ void create_jobs_task(void *pvParameters)
     }
 }
 
+static void apply_version_mask(GlobalState *GLOBAL_STATE)
+{
+    if (!GLOBAL_STATE->new_stratum_version_rolling_msg) {
+        return;
+    }
+    GLOBAL_STATE->new_stratum_version_rolling_msg = false;
+
+    uint32_t version_mask = GLOBAL_STATE->version_mask;
+    ESP_LOGI(TAG, "Set chip version rolls %i, %d midstates", (int)(version_mask >> 13), version_rolling_midstate_count(version_mask));
+    (GLOBAL_STATE->ASIC_functions.set_version_mask)(version_mask);
+    // rolled versions multiply each job's search space
+    GLOBAL_STATE->ASIC_TASK_MODULE.job_interval_stale = true;
+
+    // queued jobs carry midstates and a mask the pool no longer accepts
+    ASIC_jobs_queue_clear(&GLOBAL_STATE->ASIC_jobs_queue);
+}
+
+/**
+ * Random extranonce2 starting point for this boot, kept in NVS so it always differs from the
+ * last boot's: a restart on the same notify then does not walk coinbases already hashed
+ */
+static uint64_t extranonce_2_boot_offset(void)
+{
+    uint64_t previous = nvs_config_get_u64(NVS_CONFIG_EXTRANONCE2_OFFSET, 0);
+    uint64_t offset;
+    do {
+        offset = ((uint64_t)esp_random() << 32) | esp_random();
+    } while (offset == previous);
+    nvs_config_set_u64(NVS_CONFIG_EXTRANONCE2_OFFSET, offset);
+    return offset;
+}
+
 static bool should_generate_more_work(GlobalState *GLOBAL_STATE)
 {
-    return GLOBAL_STATE->ASIC_jobs_queue.count < QUEUE_LOW_WATER_MARK;
+    return GLOBAL_STATE->ASIC_jobs_queue.count <
+           job_interval_queue_depth(&GLOBAL_STATE->ASIC_TASK_MODULE.job_interval, QUEUE_LOW_WATER_MARK);
 }
 
-static void generate_work(GlobalState *GLOBAL_STATE, mining_notify *notification, uint32_t extranonce_2)
+/**
+ * Queue the job for the next extranonce2, taking its merkle root and midstates from the
+ * window when they were computed while the queue was full
+ */
+static bool generate_work(GlobalState *GLOBAL_STATE, mining_notify *notification)
 {
-    char *extranonce_2_str = extranonce_2_generate(extranonce_2, GLOBAL_STATE->extranonce_2_len);
+    int64_t start = esp_timer_get_time();
+
+    merkle_window_entry entry;
+    bool precomputed;
+    if (!merkle_window_take(&window, &entry, &precomputed)) {
+        return false;
+    }
+
+    char *extranonce_2_str = extranonce2_to_hex(entry.extranonce_2, window.extranonce_2.len);
     if (extranonce_2_str == NULL) {
         ESP_LOGE(TAG, "Failed to generate extranonce_2");
-        return;
+        return false;
     }
 
-    char *coinbase_tx = construct_coinbase_tx(notification->coinbase_1, notification->coinbase_2, GLOBAL_STATE->extranonce_str, extranonce_2_str);
-    if (coinbase_tx == NULL) {
-        ESP_LOGE(TAG, "Failed to construct coinbase_tx");
-        free(extranonce_2_str);
+    bm_job next_job = construct_bm_job_from_root(notification, entry.merkle_root, GLOBAL_STATE->version_mask, entry.midstates);
+
+    bool queued = enqueue_job(GLOBAL_STATE, &next_job, notification->job_id, extranonce_2_str);
+    if (queued) {
+        GLOBAL_STATE->JOB_SOURCE_MODULE.extranonce2_jobs++;
+        GLOBAL_STATE->JOB_SOURCE_MODULE.precomputed_jobs += precomputed;
+        GLOBAL_STATE->JOB_SOURCE_MODULE.extranonce2_us += esp_timer_get_time() - start;
+
+        generate_ntime_work(GLOBAL_STATE, notification, &next_job, extranonce_2_str);
+    }
+
+    free(extranonce_2_str);
+    return queued;
+}
+
+static void record_notify_to_job(GlobalState *GLOBAL_STATE, mining_notify *notification)
+{
+    // notifies that did not come through the stratum task have no arrival time
+    if (notification->received_us == 0) {
         return;
     }
 
-    char *merkle_root = calculate_merkle_root_hash(coinbase_tx, (uint8_t(*)[32])notification->merkle_branches, notification->n_merkle_branches);
-    if (merkle_root == NULL) {
-        ESP_LOGE(TAG, "Failed to calculate merkle_root");
-        free(extranonce_2_str);
-        free(coinbase_tx);
+    uint32_t latency = esp_timer_get_time() - notification->received_us;
+    GLOBAL_STATE->JOB_SOURCE_MODULE.notify_to_job_us = latency;
+    if (latency > GLOBAL_STATE->JOB_SOURCE_MODULE.notify_to_job_max_us) {
+        GLOBAL_STATE->JOB_SOURCE_MODULE.notify_to_job_max_us = latency;
+    }
+}
+
+/**
+ * Queue up to CONFIG_STRATUM_NTIME_ROLLS more jobs from the merkle root of job, each one
+ * second of ntime further on, while the queue wants work and the pool would accept the ntime.
+ * Shares from these submit the rolled ntime, which the job carries.
+ */
+static void generate_ntime_work(GlobalState *GLOBAL_STATE, mining_notify *notification, const bm_job *job, const char *extranonce_2_str)
+{
+    // notifies that did not come through the stratum task have no arrival time to bound against
+    if (notification->received_us == 0) {
         return;
     }
 
-    bm_job next_job = construct_bm_job(notification, merkle_root, GLOBAL_STATE->version_mask);
+    int64_t start = esp_timer_get_time();
+    ntime_window window;
+    ntime_window_init(&window, notification->ntime, notification->received_us, CONFIG_STRATUM_NTIME_MAX_AHEAD);
+
+    for (uint32_t roll = 1; roll <= CONFIG_STRATUM_NTIME_ROLLS && should_generate_more_work(GLOBAL_STATE); roll++) {
+        uint32_t ntime = notification->ntime + roll;
+        if (!ntime_window_allows(&window, ntime, start)) {
+            break;
+        }
+
+        bm_job rolled_job = construct_bm_job_rolled_ntime(job, ntime);
+        if (!enqueue_job(GLOBAL_STATE, &rolled_job, notification->job_id, extranonce_2_str)) {
+            break;
+        }
+
+        int64_t now = esp_timer_get_time();
+        GLOBAL_STATE->JOB_SOURCE_MODULE.ntime_jobs++;
+        GLOBAL_STATE->JOB_SOURCE_MODULE.ntime_us += now - start;
+        start = now;
+    }
+}
 
+static bool enqueue_job(GlobalState *GLOBAL_STATE, const bm_job *job, const char *jobid, const char *extranonce_2_str)
+{
     bm_job *queued_next_job = malloc(sizeof(bm_job));
     if (queued_next_job == NULL) {
         ESP_LOGE(TAG, "Failed to allocate memory for queued_next_job");
-        free(extranonce_2_str);
-        free(coinbase_tx);
-        free(merkle_root);
-        return;
+        return false;
     }
 
-    memcpy(queued_next_job, &next_job, sizeof(bm_job));
-    queued_next_job->extranonce2 = extranonce_2_str; // Transfer ownership
-    queued_next_job->jobid = strdup(notification->job_id);
-    queued_next_job->version_mask = GLOBAL_STATE->version_mask;
+    memcpy(queued_next_job, job, sizeof(bm_job));
+    queued_next_job->extranonce2 = strdup(extranonce_2_str);
+    queued_next_job->jobid = strdup(jobid);
+    if (queued_next_job->extranonce2 == NULL || queued_next_job->jobid == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate memory for queued_next_job");
+        free(queued_next_job->extranonce2);
+        free(queued_next_job->jobid);
+        free(queued_next_job);
+        return false;
+    }
 
     queue_enqueue(&GLOBAL_STATE->ASIC_jobs_queue, queued_next_job);
-
-    free(coinbase_tx);
-    free(merkle_root);
-}
\ No newline at end of file
+    return true;
+}
@@ -3,6 +3,7 @@
 #include "INA260.h"
 #include "bm1397.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "global_state.h"
@@ -32,6 +33,12 @@
 #define SUPRA_POWER_OFFSET 5
 #define GAMMA_POWER_OFFSET 5
 
+// The autotuner holds climbing chips this far below THROTTLE_TEMP
+#define AUTOTUNE_TEMP_MARGIN 10.0
+// Frequency step, the PLL ramp's own
+#define AUTOTUNE_STEP_MHZ 6.25
+#define AUTOTUNE_PROFILE_MAX (AUTOTUNE_MAX_CHIPS * 8)
+
 static const char * TAG = "power_management";
 
 // static float _fbound(float value, float lower_bound, float upper_bound)
@@ -76,6 +83,102 @@ static double automatic_fan_speed(float chip_temp, GlobalState * GLOBAL_STATE)
 	return result;
 }
 
+static uint32_t uptime_ms(void)
+{
+    return esp_timer_get_time() / 1000;
+}
+
+// Starts tuning every chip around base_mhz, the frequency the whole chain runs at. With restore the
+// chips go straight to the profile kept in NVS, as long as it was made for this chain.
+static void autotune_start(GlobalState * GLOBAL_STATE, float base_mhz, bool restore)
+{
+    autotune * tuner = &GLOBAL_STATE->autotune;
+
+    if (GLOBAL_STATE->ASIC_functions.set_chip_frequency_fn == NULL) {
+        ESP_LOGW(TAG, "Autotune is not available for the %s", GLOBAL_STATE->asic_model_str);
+        return;
+    }
+
+    autotune_config config = {
+        .min_mhz = base_mhz - CONFIG_ASIC_AUTOTUNE_RANGE_MHZ,
+        .max_mhz = base_mhz + CONFIG_ASIC_AUTOTUNE_RANGE_MHZ,
+        .step_mhz = AUTOTUNE_STEP_MHZ,
+        .window_results = CONFIG_ASIC_AUTOTUNE_WINDOW_RESULTS,
+        .window_timeout_ms = CONFIG_ASIC_AUTOTUNE_WINDOW_TIMEOUT_S * 1000,
+        .max_error_rate = CONFIG_ASIC_AUTOTUNE_MAX_ERROR_PERMILLE / 1000.0,
+    };
+    if (config.min_mhz < AUTOTUNE_STEP_MHZ) {
+        config.min_mhz = AUTOTUNE_STEP_MHZ;
+    }
+    if (!autotune_init(tuner, &config, GLOBAL_STATE->asic_count, base_mhz, uptime_ms())) {
+        ESP_LOGW(TAG, "Autotune takes up to %d chips, the chain has %d", AUTOTUNE_MAX_CHIPS, GLOBAL_STATE->asic_count);
+        return;
+    }
+
+    if (restore) {
+        float frequencies[AUTOTUNE_MAX_CHIPS];
+        char * profile = nvs_config_get_string(NVS_CONFIG_AUTOTUNE_PROFILE, "");
+        int count = autotune_parse_profile(profile, frequencies, AUTOTUNE_MAX_CHIPS);
+        free(profile);
+
+        if (count == tuner->chip_count) {
+            autotune_restore(tuner, frequencies, uptime_ms());
+            for (int i = 0; i < tuner->chip_count; i++) {
+                GLOBAL_STATE->ASIC_functions.set_chip_frequency_fn(i, base_mhz, tuner->chips[i].frequency);
+            }
+            GLOBAL_STATE->ASIC_TASK_MODULE.job_interval_stale = true;
+            ESP_LOGI(TAG, "Autotune restored the frequencies of %d chips", count);
+            return;
+        }
+    }
+
+    // a profile for another frequency or chain would be restored on the next boot otherwise
+    nvs_config_set_string(NVS_CONFIG_AUTOTUNE_PROFILE, "");
+    ESP_LOGI(TAG, "Autotune started at %.2fMHz, between %.2fMHz and %.2fMHz", base_mhz, config.min_mhz, config.max_mhz);
+}
+
+// Ramps every chip back to base_mhz, where the chain-wide frequency code expects them
+static void autotune_release(GlobalState * GLOBAL_STATE, float base_mhz)
+{
+    autotune * tuner = &GLOBAL_STATE->autotune;
+    uint16_t chip_count = tuner->chip_count;
+
+    autotune_stop(tuner);
+    for (int i = 0; i < chip_count; i++) {
+        GLOBAL_STATE->ASIC_functions.set_chip_frequency_fn(i, tuner->chips[i].frequency, base_mhz);
+    }
+    GLOBAL_STATE->ASIC_TASK_MODULE.job_interval_stale = true;
+}
+
+static void autotune_apply(GlobalState * GLOBAL_STATE)
+{
+    autotune * tuner = &GLOBAL_STATE->autotune;
+    bool allow_up = GLOBAL_STATE->POWER_MANAGEMENT_MODULE.chip_temp_avg < THROTTLE_TEMP - AUTOTUNE_TEMP_MARGIN;
+
+    if (autotune_step(tuner, uptime_ms(), allow_up) > 0) {
+        for (int i = 0; i < tuner->chip_count; i++) {
+            autotune_chip * chip = &tuner->chips[i];
+            if (!chip->changed) {
+                continue;
+            }
+            chip->changed = false;
+            ESP_LOGI(TAG, "Autotune: chip %d %.2fMHz -> %.2fMHz (%s, %.1f%% errors)", i, chip->previous_frequency,
+                     chip->frequency, autotune_state_str(chip->state), chip->last_error_rate * 100);
+            if (!GLOBAL_STATE->ASIC_functions.set_chip_frequency_fn(i, chip->previous_frequency, chip->frequency)) {
+                ESP_LOGE(TAG, "Autotune: failed to set the frequency of chip %d", i);
+            }
+        }
+        GLOBAL_STATE->ASIC_TASK_MODULE.job_interval_stale = true;
+    }
+
+    if (tuner->settled) {
+        char profile[AUTOTUNE_PROFILE_MAX];
+        autotune_format_profile(tuner, profile, sizeof(profile));
+        nvs_config_set_string(NVS_CONFIG_AUTOTUNE_PROFILE, profile);
+        tuner->settled = false;
+    }
+}
+
 void POWER_MANAGEMENT_task(void * pvParameters)
 {
     ESP_LOGI(TAG, "Starting");
@@ -123,6 +226,8 @@ void POWER_MANAGEMENT_task(void * pvParameters)
     vTaskDelay(500 / portTICK_PERIOD_MS);
     uint16_t last_core_voltage = 0.0;
     uint16_t last_asic_frequency = power_management->frequency_value;
+    uint16_t last_autotune = nvs_config_get_u16(NVS_CONFIG_AUTOTUNE, AUTOTUNE_DEFAULT);
+    bool autotune_started = false;
     
     while (1) {
 
@@ -288,13 +393,39 @@ void POWER_MANAGEMENT_task(void * pvParameters)
 
         if (asic_frequency != last_asic_frequency) {
             ESP_LOGI(TAG, "New ASIC frequency requested: %uMHz (current: %uMHz)", asic_frequency, last_asic_frequency);
-            if (do_frequency_transition((float)asic_frequency)) {
+            bool retune = GLOBAL_STATE->autotune.chip_count > 0;
+            if (retune) {
+                autotune_release(GLOBAL_STATE, power_management->frequency_value);
+            }
+            if (GLOBAL_STATE->ASIC_functions.set_frequency_fn((float)asic_frequency)) {
                 power_management->frequency_value = (float)asic_frequency;
+                GLOBAL_STATE->ASIC_TASK_MODULE.job_interval_stale = true;
                 ESP_LOGI(TAG, "Successfully transitioned to new ASIC frequency: %uMHz", asic_frequency);
             } else {
                 ESP_LOGE(TAG, "Failed to transition to new ASIC frequency: %uMHz", asic_frequency);
             }
             last_asic_frequency = asic_frequency;
+
+            // the whole chain runs at the new frequency, so the tuning starts over from there
+            if (retune) {
+                autotune_start(GLOBAL_STATE, power_management->frequency_value, false);
+            }
+        }
+
+        uint16_t autotune_enabled = nvs_config_get_u16(NVS_CONFIG_AUTOTUNE, last_autotune);
+        if (GLOBAL_STATE->ASIC_initalized && (!autotune_started || autotune_enabled != last_autotune)) {
+            if (autotune_enabled) {
+                autotune_start(GLOBAL_STATE, power_management->frequency_value, true);
+            } else if (autotune_started) {
+                // back to one frequency for the whole chain
+                autotune_release(GLOBAL_STATE, power_management->frequency_value);
+                ESP_LOGI(TAG, "Autotune stopped");
+            }
+            autotune_started = true;
+            last_autotune = autotune_enabled;
+        }
+        if (GLOBAL_STATE->autotune.chip_count > 0) {
+            autotune_apply(GLOBAL_STATE);
         }
 
         // Check for changing of overheat mode
@@ -1,6 +1,13 @@
 #ifndef POWER_MANAGEMENT_TASK_H_
 #define POWER_MANAGEMENT_TASK_H_
 
+// NVS_CONFIG_AUTOTUNE when unset
+#ifdef CONFIG_ASIC_AUTOTUNE
+#define AUTOTUNE_DEFAULT 1
+#else
+#define AUTOTUNE_DEFAULT 0
+#endif
+
 typedef struct
 {
     uint16_t fan_perc;
@@ -10,6 +10,9 @@
 #include "stratum_task.h"
 #include "work_queue.h"
 #include "esp_wifi.h"
+#include "esp_timer.h"
+#include "pool_health.h"
+#include "version_rolling.h"
 #include <esp_sntp.h>
 #include <time.h>
 
@@ -23,9 +26,11 @@
 #define FALLBACK_STRATUM_PW CONFIG_FALLBACK_STRATUM_PW
 #define STRATUM_DIFFICULTY CONFIG_STRATUM_DIFFICULTY
 
-#define MAX_RETRY_ATTEMPTS 3
 #define MAX_CRITICAL_RETRY_ATTEMPTS 5
 
+#define POOL_HEALTH_CHECK_INTERVAL_MS 10000
+#define PRIMARY_PROBE_INTERVAL_US (60 * 1000000LL)
+
 static const char * TAG = "stratum_task";
 
 static StratumApiV1Message stratum_api_v1_message = {};
@@ -43,6 +48,110 @@ bool is_wifi_connected() {
     }
 }
 
+static bool has_fallback_pool(GlobalState * GLOBAL_STATE)
+{
+    return GLOBAL_STATE->SYSTEM_MODULE.fallback_pool_url != NULL && GLOBAL_STATE->SYSTEM_MODULE.fallback_pool_url[0] != '\0';
+}
+
+static pool_health * active_pool_health(GlobalState * GLOBAL_STATE)
+{
+    return &GLOBAL_STATE->pool_health.pools[GLOBAL_STATE->pool_health.active];
+}
+
+static void load_pool_health_policy(pool_health_policy * policy)
+{
+    pool_health_policy_default(policy);
+    policy->fail_score = nvs_config_get_u16(NVS_CONFIG_POOL_FAIL_SCORE, CONFIG_POOL_HEALTH_FAIL_SCORE);
+    policy->return_score = nvs_config_get_u16(NVS_CONFIG_POOL_RETURN_SCORE, CONFIG_POOL_HEALTH_RETURN_SCORE);
+    policy->min_dwell_ms = nvs_config_get_u16(NVS_CONFIG_POOL_MIN_DWELL, CONFIG_POOL_HEALTH_MIN_DWELL_S) * 1000;
+    policy->notify_interval_ms = nvs_config_get_u16(NVS_CONFIG_POOL_NOTIFY_INTERVAL, CONFIG_POOL_HEALTH_NOTIFY_INTERVAL_S) * 1000;
+    policy->max_connect_failures = CONFIG_POOL_HEALTH_MAX_CONNECT_FAILURES;
+    policy->rtt_target_ms = CONFIG_POOL_HEALTH_RTT_TARGET_MS;
+}
+
+// Runs the switching policy and mirrors the result into is_using_fallback.
+// Returns true when the active pool changed.
+static bool select_pool(GlobalState * GLOBAL_STATE)
+{
+    pthread_mutex_lock(&GLOBAL_STATE->pool_health_lock);
+    int previous = GLOBAL_STATE->pool_health.active;
+    int selected = pool_health_select(&GLOBAL_STATE->pool_health, has_fallback_pool(GLOBAL_STATE), esp_timer_get_time());
+    pool_switch_reason reason = GLOBAL_STATE->pool_health.last_switch_reason;
+    float primary_score = GLOBAL_STATE->pool_health.pools[POOL_HEALTH_PRIMARY].score;
+    float fallback_score = GLOBAL_STATE->pool_health.pools[POOL_HEALTH_FALLBACK].score;
+    pthread_mutex_unlock(&GLOBAL_STATE->pool_health_lock);
+
+    GLOBAL_STATE->SYSTEM_MODULE.is_using_fallback = selected == POOL_HEALTH_FALLBACK;
+    if (selected == previous) {
+        return false;
+    }
+
+    ESP_LOGW(TAG, "Switching to %s pool (%s), scores: primary %.0f fallback %.0f",
+             selected == POOL_HEALTH_FALLBACK ? "fallback" : "primary",
+             pool_health_switch_reason_str(reason), primary_score, fallback_score);
+    return true;
+}
+
+static void record_connect(GlobalState * GLOBAL_STATE, bool success)
+{
+    pthread_mutex_lock(&GLOBAL_STATE->pool_health_lock);
+    pool_health * pool = active_pool_health(GLOBAL_STATE);
+    pool_health_record_connect(pool, success);
+    if (success) {
+        pool_health_record_session(pool, esp_timer_get_time());
+    }
+    pthread_mutex_unlock(&GLOBAL_STATE->pool_health_lock);
+}
+
+static void record_share_result(GlobalState * GLOBAL_STATE, const StratumApiV1Message * message)
+{
+    pool_share_result result = POOL_SHARE_ACCEPTED;
+    if (!message->response_success) {
+        share_reject_reason reason = share_filter_classify_reject(message->error_code, message->error_str);
+        share_filter_record_reject(&GLOBAL_STATE->share_filter, reason);
+        ESP_LOGW(TAG, "Share rejected as %s", share_filter_reject_reason_str(reason));
+        result = reason == SHARE_REJECT_STALE || reason == SHARE_REJECT_JOB_NOT_FOUND ? POOL_SHARE_STALE : POOL_SHARE_REJECTED;
+    }
+    double rtt_ms = STRATUM_V1_get_response_time_ms(message->message_id);
+
+    pthread_mutex_lock(&GLOBAL_STATE->pool_health_lock);
+    pool_health_record_share(active_pool_health(GLOBAL_STATE), result, rtt_ms);
+    pthread_mutex_unlock(&GLOBAL_STATE->pool_health_lock);
+}
+
+// Applies a mask from the configure result or mining.set_version_mask. The chip and the job
+// builder pick it up through new_stratum_version_rolling_msg in create_jobs_task.
+static void set_version_mask(GlobalState * GLOBAL_STATE, uint32_t pool_mask)
+{
+    uint32_t version_mask = version_rolling_negotiate(VERSION_ROLLING_REQUEST_MASK, pool_mask);
+    int bits = version_rolling_bit_count(version_mask);
+
+    if (pool_mask != 0 && bits < VERSION_ROLLING_MIN_BIT_COUNT) {
+        ESP_LOGW(TAG, "Pool granted %d version bits (mask %08lx), fewer than the %d requested", bits, pool_mask,
+                 VERSION_ROLLING_MIN_BIT_COUNT);
+    }
+    if (version_mask == GLOBAL_STATE->version_mask) {
+        return;
+    }
+
+    ESP_LOGI(TAG, "Set version mask: %08lx (%d bits, %d midstates)", version_mask, bits,
+             version_rolling_midstate_count(version_mask));
+    GLOBAL_STATE->version_mask = version_mask;
+    GLOBAL_STATE->new_stratum_version_rolling_msg = true;
+}
+
+// Heap and stack accounting for the receive path, returns the current free heap
+static uint32_t account_stratum_memory(GlobalState * GLOBAL_STATE)
+{
+    StratumRxModule * module = &GLOBAL_STATE->STRATUM_RX_MODULE;
+    uint32_t free_heap = esp_get_free_heap_size();
+    if (module->min_free_heap == 0 || free_heap < module->min_free_heap) {
+        module->min_free_heap = free_heap;
+    }
+    module->stack_high_water = uxTaskGetStackHighWaterMark(NULL);
+    return free_heap;
+}
+
 void cleanQueue(GlobalState * GLOBAL_STATE) {
     ESP_LOGI(TAG, "Clean Jobs: clearing queue");
     GLOBAL_STATE->abandon_work = 1;
@@ -64,78 +173,83 @@ void stratum_close_connection(GlobalState * GLOBAL_STATE)
     }
 
     ESP_LOGE(TAG, "Shutting down socket and restarting...");
+    pthread_mutex_lock(&GLOBAL_STATE->pool_health_lock);
+    pool_health_record_disconnect(active_pool_health(GLOBAL_STATE));
+    pthread_mutex_unlock(&GLOBAL_STATE->pool_health_lock);
     shutdown(GLOBAL_STATE->sock, SHUT_RDWR);
     close(GLOBAL_STATE->sock);
     cleanQueue(GLOBAL_STATE);
     vTaskDelay(1000 / portTICK_PERIOD_MS);
 }
 
+// Bare TCP connect to the primary pool, used to score it while mining on the fallback.
+static bool stratum_probe_primary(void)
+{
+    char host_ip[INET_ADDRSTRLEN];
+    ESP_LOGD(TAG, "Running Heartbeat on: %s!", primary_stratum_url);
+
+    struct hostent *primary_dns_addr = gethostbyname(primary_stratum_url);
+    if (primary_dns_addr == NULL) {
+        ESP_LOGD(TAG, "Heartbeat. Failed DNS check for: %s!", primary_stratum_url);
+        return false;
+    }
+    inet_ntop(AF_INET, (void *)primary_dns_addr->h_addr_list[0], host_ip, sizeof(host_ip));
+
+    struct sockaddr_in dest_addr;
+    dest_addr.sin_addr.s_addr = inet_addr(host_ip);
+    dest_addr.sin_family = AF_INET;
+    dest_addr.sin_port = htons(primary_stratum_port);
+
+    int sock = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
+    if (sock < 0) {
+        ESP_LOGD(TAG, "Heartbeat. Failed socket create check!");
+        return false;
+    }
+
+    int err = connect(sock, (struct sockaddr *)&dest_addr, sizeof(struct sockaddr_in6));
+    if (err != 0)
+    {
+        ESP_LOGD(TAG, "Heartbeat. Failed connect check: %s:%d (errno %d: %s)", host_ip, primary_stratum_port, errno, strerror(errno));
+        close(sock);
+        return false;
+    }
+    shutdown(sock, SHUT_RDWR);
+    close(sock);
+    return true;
+}
+
+// Periodically re-scores both pools. While on the fallback it also probes the primary so it can
+// earn its way back; the switch itself is left to the pool health policy and its hysteresis.
 void stratum_primary_heartbeat(void * pvParameters)
 {
     GlobalState * GLOBAL_STATE = (GlobalState *) pvParameters;
+    int64_t last_probe_us = 0;
 
     ESP_LOGI(TAG, "Starting heartbeat thread for primary endpoint: %s", primary_stratum_url);
     vTaskDelay(10000 / portTICK_PERIOD_MS);
 
-    int addr_family = AF_INET;
-    int ip_protocol = IPPROTO_IP;
-
     while (1)
     {
-        if (GLOBAL_STATE->SYSTEM_MODULE.is_using_fallback == false) {
-            vTaskDelay(10000 / portTICK_PERIOD_MS);
-            continue;
-        }
-
-        char host_ip[INET_ADDRSTRLEN];
-        ESP_LOGD(TAG, "Running Heartbeat on: %s!", primary_stratum_url);
+        vTaskDelay(POOL_HEALTH_CHECK_INTERVAL_MS / portTICK_PERIOD_MS);
 
         if (!is_wifi_connected()) {
             ESP_LOGD(TAG, "Heartbeat. Failed WiFi check!");
-            vTaskDelay(10000 / portTICK_PERIOD_MS);
             continue;
         }
 
-        struct hostent *primary_dns_addr = gethostbyname(primary_stratum_url);
-        if (primary_dns_addr == NULL) {
-            ESP_LOGD(TAG, "Heartbeat. Failed DNS check for: %s!", primary_stratum_url);
-            vTaskDelay(60000 / portTICK_PERIOD_MS);
-            continue;
-        }
-        inet_ntop(AF_INET, (void *)primary_dns_addr->h_addr_list[0], host_ip, sizeof(host_ip));
+        int64_t now_us = esp_timer_get_time();
+        if (GLOBAL_STATE->SYSTEM_MODULE.is_using_fallback && now_us - last_probe_us >= PRIMARY_PROBE_INTERVAL_US) {
+            bool reachable = stratum_probe_primary();
+            last_probe_us = now_us;
 
-        struct sockaddr_in dest_addr;
-        dest_addr.sin_addr.s_addr = inet_addr(host_ip);
-        dest_addr.sin_family = AF_INET;
-        dest_addr.sin_port = htons(primary_stratum_port);
-
-        int sock = socket(addr_family, SOCK_STREAM, ip_protocol);
-        if (sock < 0) {
-            ESP_LOGD(TAG, "Heartbeat. Failed socket create check!");
-            vTaskDelay(60000 / portTICK_PERIOD_MS);
-            close(sock);
-            continue;
-        }
-
-        int err = connect(sock, (struct sockaddr *)&dest_addr, sizeof(struct sockaddr_in6));
-        if (err != 0)
-        {
-            ESP_LOGD(TAG, "Heartbeat. Failed connect check: %s:%d (errno %d: %s)", host_ip, primary_stratum_port, errno, strerror(errno));
-            close(sock);
-            vTaskDelay(60000 / portTICK_PERIOD_MS);
-            continue;
+            pthread_mutex_lock(&GLOBAL_STATE->pool_health_lock);
+            pool_health_record_connect(&GLOBAL_STATE->pool_health.pools[POOL_HEALTH_PRIMARY], reachable);
+            pthread_mutex_unlock(&GLOBAL_STATE->pool_health_lock);
         }
-        shutdown(sock, SHUT_RDWR);
-        close(sock);
 
-        if (GLOBAL_STATE->SYSTEM_MODULE.is_using_fallback) {
-            ESP_LOGI(TAG, "Heartbeat successful and in fallback mode. Switching back to primary.");
-            GLOBAL_STATE->SYSTEM_MODULE.is_using_fallback = false;
+        if (select_pool(GLOBAL_STATE)) {
             stratum_close_connection(GLOBAL_STATE);
-            vTaskDelay(60000 / portTICK_PERIOD_MS);
-            continue;
         }
-        vTaskDelay(60000 / portTICK_PERIOD_MS);
     }
 }
 
@@ -148,16 +262,20 @@ void stratum_task(void * pvParameters)
     char * stratum_url = GLOBAL_STATE->SYSTEM_MODULE.pool_url;
     uint16_t port = GLOBAL_STATE->SYSTEM_MODULE.pool_port;
 
-    STRATUM_V1_initialize_buffer();
+    STRATUM_V1_initialize_buffer(CONFIG_STRATUM_MAX_LINE_LENGTH);
     char host_ip[20];
     int addr_family = AF_INET;
     int ip_protocol = IPPROTO_IP;
-    int retry_attempts = 0;
     int retry_critical_attempts = 0;
     struct timeval timeout = {};
     timeout.tv_sec = 5;
     timeout.tv_usec = 0;
 
+    pool_health_policy policy;
+    load_pool_health_policy(&policy);
+    pool_health_init(&GLOBAL_STATE->pool_health, &policy, esp_timer_get_time());
+    share_filter_init(&GLOBAL_STATE->share_filter);
+
     xTaskCreate(stratum_primary_heartbeat, "stratum primary heartbeat", 4096, pvParameters, 1, NULL);
 
     ESP_LOGI(TAG, "Trying to get IP for URL: %s", stratum_url);
@@ -169,26 +287,14 @@ void stratum_task(void * pvParameters)
             continue;
         }
 
-        if (retry_attempts >= MAX_RETRY_ATTEMPTS)
-        {
-            if (GLOBAL_STATE->SYSTEM_MODULE.fallback_pool_url == NULL || GLOBAL_STATE->SYSTEM_MODULE.fallback_pool_url[0] == '\0') {
-                ESP_LOGI(TAG, "Unable to switch to fallback. No url configured. (retries: %d)...", retry_attempts);
-                GLOBAL_STATE->SYSTEM_MODULE.is_using_fallback = false;
-                retry_attempts = 0;
-                continue;
-            }
-
-            GLOBAL_STATE->SYSTEM_MODULE.is_using_fallback = !GLOBAL_STATE->SYSTEM_MODULE.is_using_fallback;
-            ESP_LOGI(TAG, "Switching target due to too many failures (retries: %d)...", retry_attempts);
-            retry_attempts = 0;
-        }
+        select_pool(GLOBAL_STATE);
 
         stratum_url = GLOBAL_STATE->SYSTEM_MODULE.is_using_fallback ? GLOBAL_STATE->SYSTEM_MODULE.fallback_pool_url : GLOBAL_STATE->SYSTEM_MODULE.pool_url;
         port = GLOBAL_STATE->SYSTEM_MODULE.is_using_fallback ? GLOBAL_STATE->SYSTEM_MODULE.fallback_pool_port : GLOBAL_STATE->SYSTEM_MODULE.pool_port;
 
         struct hostent *dns_addr = gethostbyname(stratum_url);
         if (dns_addr == NULL) {
-            retry_attempts++;
+            record_connect(GLOBAL_STATE, false);
             vTaskDelay(1000 / portTICK_PERIOD_MS);
             continue;
         }
@@ -217,7 +323,7 @@ void stratum_task(void * pvParameters)
         int err = connect(GLOBAL_STATE->sock, (struct sockaddr *)&dest_addr, sizeof(struct sockaddr_in6));
         if (err != 0)
         {
-            retry_attempts++;
+            record_connect(GLOBAL_STATE, false);
             ESP_LOGE(TAG, "Socket unable to connect to %s:%d (errno %d: %s)", stratum_url, port, errno, strerror(errno));
             // close the socket
             shutdown(GLOBAL_STATE->sock, SHUT_RDWR);
@@ -226,32 +332,37 @@ void stratum_task(void * pvParameters)
             vTaskDelay(5000 / portTICK_PERIOD_MS);
             continue;
         }
-        retry_attempts = 0;
+        record_connect(GLOBAL_STATE, true);
 
         if (setsockopt(GLOBAL_STATE->sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)) != 0) {
             ESP_LOGE(TAG, "Fail to setsockopt SO_SNDTIMEO");
         }
 
-        STRATUM_V1_reset_uid();
+        GLOBAL_STATE->send_uid = 1;
+        STRATUM_V1_reset_buffer();
         cleanQueue(GLOBAL_STATE);
 
+        // No version rolling until this pool grants it
+        set_version_mask(GLOBAL_STATE, 0);
+
         ///// Start Stratum Action
         // mining.configure - ID: 1
-        STRATUM_V1_configure_version_rolling(GLOBAL_STATE->sock, &GLOBAL_STATE->version_mask);
+        STRATUM_V1_configure_version_rolling(GLOBAL_STATE->sock, GLOBAL_STATE->send_uid++, VERSION_ROLLING_REQUEST_MASK,
+                                             VERSION_ROLLING_MIN_BIT_COUNT);
 
         // mining.subscribe - ID: 2
-        STRATUM_V1_subscribe(GLOBAL_STATE->sock, GLOBAL_STATE->asic_model_str);
+        STRATUM_V1_subscribe(GLOBAL_STATE->sock, GLOBAL_STATE->send_uid++, GLOBAL_STATE->asic_model_str);
 
         char * username = GLOBAL_STATE->SYSTEM_MODULE.is_using_fallback ? nvs_config_get_string(NVS_CONFIG_FALLBACK_STRATUM_USER, FALLBACK_STRATUM_USER) : nvs_config_get_string(NVS_CONFIG_STRATUM_USER, STRATUM_USER);
         char * password = GLOBAL_STATE->SYSTEM_MODULE.is_using_fallback ? nvs_config_get_string(NVS_CONFIG_FALLBACK_STRATUM_PASS, FALLBACK_STRATUM_PW) : nvs_config_get_string(NVS_CONFIG_STRATUM_PASS, STRATUM_PW);
 
         //mining.authorize - ID: 3
-        STRATUM_V1_authenticate(GLOBAL_STATE->sock, username, password);
+        STRATUM_V1_authorize(GLOBAL_STATE->sock, GLOBAL_STATE->send_uid++, username, password);
         free(password);
         free(username);
 
         //mining.suggest_difficulty - ID: 4
-        STRATUM_V1_suggest_difficulty(GLOBAL_STATE->sock, STRATUM_DIFFICULTY);
+        STRATUM_V1_suggest_difficulty(GLOBAL_STATE->sock, GLOBAL_STATE->send_uid++, STRATUM_DIFFICULTY);
 
         // Everything is set up, lets make sure we don't abandon work unnecessarily.
         GLOBAL_STATE->abandon_work = 0;
@@ -266,9 +377,31 @@ void stratum_task(void * pvParameters)
             ESP_LOGI(TAG, "rx: %s", line); // debug incoming stratum messages
             STRATUM_V1_parse(&stratum_api_v1_message, line);
             free(line);
+            uint32_t free_heap = account_stratum_memory(GLOBAL_STATE);
 
             if (stratum_api_v1_message.method == MINING_NOTIFY) {
+                stratum_api_v1_message.mining_notification->received_us = esp_timer_get_time();
                 SYSTEM_notify_new_ntime(GLOBAL_STATE, stratum_api_v1_message.mining_notification->ntime);
+                pthread_mutex_lock(&GLOBAL_STATE->pool_health_lock);
+                pool_health_record_notify(active_pool_health(GLOBAL_STATE), stratum_api_v1_message.mining_notification->received_us);
+                pthread_mutex_unlock(&GLOBAL_STATE->pool_health_lock);
+
+                uint32_t previous_generation = GLOBAL_STATE->share_filter.generation;
+                stratum_api_v1_message.mining_notification->generation = share_filter_on_notify(
+                    &GLOBAL_STATE->share_filter, stratum_api_v1_message.mining_notification->prev_block_hash,
+                    stratum_api_v1_message.should_abandon_work);
+
+                // Under memory pressure only take work that replaces what is queued; an update to
+                // the current block can be skipped without losing anything but fresher transactions
+                if (free_heap < CONFIG_STRATUM_LOW_HEAP_BYTES &&
+                    stratum_api_v1_message.mining_notification->generation == previous_generation &&
+                    GLOBAL_STATE->stratum_queue.count > 0) {
+                    ESP_LOGW(TAG, "Low heap (%lu bytes), dropping mining.notify update", free_heap);
+                    GLOBAL_STATE->STRATUM_RX_MODULE.notifies_dropped++;
+                    STRATUM_V1_free_mining_notify(stratum_api_v1_message.mining_notification);
+                    continue;
+                }
+
                 if (stratum_api_v1_message.should_abandon_work &&
                     (GLOBAL_STATE->stratum_queue.count > 0 || GLOBAL_STATE->ASIC_jobs_queue.count > 0)) {
                     cleanQueue(GLOBAL_STATE);
@@ -282,14 +415,11 @@ void stratum_task(void * pvParameters)
             } else if (stratum_api_v1_message.method == MINING_SET_DIFFICULTY) {
                 if (stratum_api_v1_message.new_difficulty != SYSTEM_TASK_MODULE.stratum_difficulty) {
                     SYSTEM_TASK_MODULE.stratum_difficulty = stratum_api_v1_message.new_difficulty;
-                    ESP_LOGI(TAG, "Set stratum difficulty: %ld", SYSTEM_TASK_MODULE.stratum_difficulty);
+                    ESP_LOGI(TAG, "Set stratum difficulty: %g", SYSTEM_TASK_MODULE.stratum_difficulty);
                 }
             } else if (stratum_api_v1_message.method == MINING_SET_VERSION_MASK ||
                     stratum_api_v1_message.method == STRATUM_RESULT_VERSION_MASK) {
-                // 1fffe000
-                ESP_LOGI(TAG, "Set version mask: %08lx", stratum_api_v1_message.version_mask);
-                GLOBAL_STATE->version_mask = stratum_api_v1_message.version_mask;
-                GLOBAL_STATE->new_stratum_version_rolling_msg = true;
+                set_version_mask(GLOBAL_STATE, stratum_api_v1_message.version_mask);
             } else if (stratum_api_v1_message.method == STRATUM_RESULT_SUBSCRIBE) {
                 GLOBAL_STATE->extranonce_str = stratum_api_v1_message.extranonce_str;
                 GLOBAL_STATE->extranonce_2_len = stratum_api_v1_message.extranonce_2_len;
@@ -298,6 +428,7 @@ void stratum_task(void * pvParameters)
                 stratum_close_connection(GLOBAL_STATE);
                 break;
             } else if (stratum_api_v1_message.method == STRATUM_RESULT) {
+                record_share_result(GLOBAL_STATE, &stratum_api_v1_message);
                 if (stratum_api_v1_message.response_success) {
                     ESP_LOGI(TAG, "message result accepted");
                     SYSTEM_notify_accepted_share(GLOBAL_STATE);